@@ -17,8 +17,11 @@
 #include <unistd.h>
 
 #include "miscadmin.h"
+#include "postmaster/bgworker_internals.h"
+#include "utils/builtins.h"
 #include "utils/guc.h"
 #include "utils/rel.h"
+#include "utils/varlena.h"
 
 #include "citus_version.h"
 #include "columnar/columnar.h"
@@ -40,6 +43,10 @@ int columnar_compression = DEFAULT_COMPRESSION_TYPE;
 int columnar_stripe_row_limit = DEFAULT_STRIPE_ROW_COUNT;
 int columnar_chunk_group_row_limit = DEFAULT_CHUNK_ROW_COUNT;
 int columnar_compression_level = 3;
+bool columnar_enable_vectorized_filter = false;
+bool columnar_enable_column_encoding = false;
+bool columnar_enable_prefetch = true;
+int columnar_max_parallel_compression_workers = 0;
 
 static const struct config_enum_entry columnar_compression_options[] =
 {
@@ -115,6 +122,75 @@ columnar_init_gucs()
 							NULL,
 							NULL,
 							NULL);
+
+	DefineCustomBoolVariable("columnar.enable_vectorized_filter",
+							 gettext_noop("Enables evaluating simple pushed down quals "
+										  "over whole chunk groups at once."),
+							 gettext_noop("When enabled, quals in the form of "
+										  "\"column <op> constant\" that are pushed "
+										  "down into columnar are evaluated over the "
+										  "decoded column arrays of each chunk group, "
+										  "so that rows that don't satisfy them are "
+										  "skipped before being returned to the "
+										  "executor."),
+							 &columnar_enable_vectorized_filter,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("columnar.enable_column_encoding",
+							 gettext_noop("Enables lightweight encodings for columnar "
+										  "chunks"),
+							 gettext_noop("When enabled, newly written chunks are "
+										  "run-length, frame-of-reference, delta or "
+										  "dictionary encoded before compression when "
+										  "that makes them smaller."),
+							 &columnar_enable_column_encoding,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomBoolVariable("columnar.enable_prefetch",
+							 gettext_noop("Enables prefetching stripe data when "
+										  "scanning columnar tables"),
+							 gettext_noop("When enabled, a scan issues prefetch "
+										  "requests for the chunks it selected from "
+										  "the next stripe while the current stripe "
+										  "is being processed. Prefetching is also "
+										  "disabled when effective_io_concurrency is "
+										  "0."),
+							 &columnar_enable_prefetch,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL,
+							 NULL,
+							 NULL);
+
+	DefineCustomIntVariable("columnar.max_parallel_compression_workers",
+							gettext_noop("Sets the maximum number of parallel workers "
+										 "used to compress a stripe."),
+							gettext_noop("When set, the chunks of a stripe are "
+										 "compressed by parallel workers and the "
+										 "writing backend when the stripe is flushed, "
+										 "rather than one by one as they fill up. "
+										 "Parallel workers are taken from the pool "
+										 "established by max_parallel_workers."),
+							&columnar_max_parallel_compression_workers,
+							0,
+							0,
+							MAX_PARALLEL_WORKER_LIMIT,
+							PGC_USERSET,
+							0,
+							NULL,
+							NULL,
+							NULL);
 }
 
 
@@ -143,6 +219,34 @@ ParseCompressionType(const char *compressionTypeString)
 }
 
 
+/*
+ * ColumnarOptionColumnNameList splits a comma separated list of column names,
+ * as used in the bloom_filter_columns and sort_key options, into a list of
+ * names. Unquoted names are downcased like regular identifiers.
+ */
+List *
+ColumnarOptionColumnNameList(const char *columnNames)
+{
+	List *columnNameList = NIL;
+
+	if (columnNames == NULL)
+	{
+		return NIL;
+	}
+
+	/* SplitIdentifierString modifies its input */
+	char *rawColumnNames = pstrdup(columnNames);
+	if (!SplitIdentifierString(rawColumnNames, ',', &columnNameList))
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("invalid list syntax for column names: %s",
+							   quote_literal_cstr(columnNames))));
+	}
+
+	return columnNameList;
+}
+
+
 /*
  * CompressionTypeStr returns string representation of a compression type.
  * For compression algorithms that are invalid or not compiled, it
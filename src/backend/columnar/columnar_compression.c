@@ -14,8 +14,13 @@
 #include "postgres.h"
 
 #include "citus_version.h"
+#include "access/parallel.h"
+#include "access/xact.h"
 #include "common/pg_lzcompress.h"
 #include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "utils/snapmgr.h"
 
 #include "columnar/columnar_compression.h"
 
@@ -48,6 +53,42 @@ typedef struct ColumnarCompressHeader
 									  len) (((ColumnarCompressHeader *) (ptr))->rawsize = \
 												(len))
 
+/* shm_toc keys used by parallel compression */
+#define PARALLEL_KEY_COMPRESSION_SHARED UINT64CONST(0xC0A0000000000001)
+#define PARALLEL_KEY_COMPRESSION_DATA UINT64CONST(0xC0A0000000000002)
+
+/*
+ * ParallelCompressionBuffer describes where a buffer that is compressed in
+ * parallel lives in the data area of the parallel compression DSM segment.
+ * The compressed output has room for as many bytes as the input, buffers
+ * that don't compress into that space are kept uncompressed.
+ */
+typedef struct ParallelCompressionBuffer
+{
+	Size inputOffset;
+	Size outputOffset;
+	int inputLength;
+	int outputLength;
+	bool compressed;
+} ParallelCompressionBuffer;
+
+/*
+ * ParallelCompressionShared is shared by the leader and the parallel workers
+ * of a parallel compression. Participants pick the next buffer to compress
+ * using nextBufferIndex until all buffers are claimed.
+ */
+typedef struct ParallelCompressionShared
+{
+	CompressionType compressionType;
+	int compressionLevel;
+	int bufferCount;
+	pg_atomic_uint32 nextBufferIndex;
+	ParallelCompressionBuffer bufferArray[FLEXIBLE_ARRAY_MEMBER];
+} ParallelCompressionShared;
+
+
+static void CompressSharedBuffers(ParallelCompressionShared *shared, char *dataArea);
+
 
 /*
  * CompressBuffer compresses the given buffer with the given compression type
@@ -264,3 +305,178 @@ DecompressBuffer(StringInfo buffer,
 		}
 	}
 }
+
+
+/*
+ * CompressBuffersInParallel compresses each of the given buffers with the given
+ * compression type and level, using up to parallelWorkerCount parallel workers
+ * in addition to the current backend. Buffers that are compressed are replaced
+ * in bufferArray by their compressed form allocated in the current memory
+ * context, and compressedArray tells which of the buffers were compressed.
+ *
+ * Falls back to compressing the buffers in the current backend if parallel
+ * workers cannot be used, e.g. when we are already in parallel mode, or when
+ * there is no active snapshot to pass to the workers, which is the case when
+ * pending writes are flushed at commit.
+ */
+void
+CompressBuffersInParallel(StringInfo *bufferArray, bool *compressedArray,
+						  int bufferCount, CompressionType compressionType,
+						  int compressionLevel, int parallelWorkerCount)
+{
+	parallelWorkerCount = Min(parallelWorkerCount, bufferCount - 1);
+
+	if (parallelWorkerCount <= 0 || IsInParallelMode() || !ActiveSnapshotSet())
+	{
+		StringInfo compressionBuffer = makeStringInfo();
+
+		for (int bufferIndex = 0; bufferIndex < bufferCount; bufferIndex++)
+		{
+			compressedArray[bufferIndex] =
+				CompressBuffer(bufferArray[bufferIndex], compressionBuffer,
+							   compressionType, compressionLevel);
+			if (compressedArray[bufferIndex])
+			{
+				StringInfo compressedBuffer = makeStringInfo();
+				appendBinaryStringInfo(compressedBuffer, compressionBuffer->data,
+									   compressionBuffer->len);
+				bufferArray[bufferIndex] = compressedBuffer;
+			}
+		}
+
+		return;
+	}
+
+	Size sharedSize = add_size(offsetof(ParallelCompressionShared, bufferArray),
+							   mul_size(bufferCount,
+										sizeof(ParallelCompressionBuffer)));
+	Size dataSize = 0;
+	for (int bufferIndex = 0; bufferIndex < bufferCount; bufferIndex++)
+	{
+		dataSize = add_size(dataSize, mul_size(bufferArray[bufferIndex]->len, 2));
+	}
+
+	EnterParallelMode();
+
+	ParallelContext *parallelContext =
+		CreateParallelContext("citus_columnar", "ColumnarParallelCompressionMain",
+							  parallelWorkerCount);
+
+	shm_toc_estimate_chunk(&parallelContext->estimator, sharedSize);
+	shm_toc_estimate_chunk(&parallelContext->estimator, dataSize);
+	shm_toc_estimate_keys(&parallelContext->estimator, 2);
+
+	InitializeParallelDSM(parallelContext);
+
+	ParallelCompressionShared *shared = shm_toc_allocate(parallelContext->toc,
+														 sharedSize);
+	shared->compressionType = compressionType;
+	shared->compressionLevel = compressionLevel;
+	shared->bufferCount = bufferCount;
+	pg_atomic_init_u32(&shared->nextBufferIndex, 0);
+
+	char *dataArea = shm_toc_allocate(parallelContext->toc, dataSize);
+	Size dataOffset = 0;
+
+	for (int bufferIndex = 0; bufferIndex < bufferCount; bufferIndex++)
+	{
+		StringInfo buffer = bufferArray[bufferIndex];
+		ParallelCompressionBuffer *sharedBuffer = &shared->bufferArray[bufferIndex];
+
+		sharedBuffer->inputOffset = dataOffset;
+		sharedBuffer->outputOffset = dataOffset + buffer->len;
+		sharedBuffer->inputLength = buffer->len;
+		sharedBuffer->outputLength = 0;
+		sharedBuffer->compressed = false;
+
+		memcpy(dataArea + dataOffset, buffer->data, buffer->len);
+		dataOffset += 2 * (Size) buffer->len;
+	}
+
+	shm_toc_insert(parallelContext->toc, PARALLEL_KEY_COMPRESSION_SHARED, shared);
+	shm_toc_insert(parallelContext->toc, PARALLEL_KEY_COMPRESSION_DATA, dataArea);
+
+	LaunchParallelWorkers(parallelContext);
+
+	elog(DEBUG1, "compressing %d buffers with %d parallel workers", bufferCount,
+		 parallelContext->nworkers_launched);
+
+	/* the leader compresses buffers too, it does all the work if no worker started */
+	CompressSharedBuffers(shared, dataArea);
+
+	WaitForParallelWorkersToFinish(parallelContext);
+
+	for (int bufferIndex = 0; bufferIndex < bufferCount; bufferIndex++)
+	{
+		ParallelCompressionBuffer *sharedBuffer = &shared->bufferArray[bufferIndex];
+
+		compressedArray[bufferIndex] = sharedBuffer->compressed;
+		if (sharedBuffer->compressed)
+		{
+			StringInfo compressedBuffer = makeStringInfo();
+			appendBinaryStringInfo(compressedBuffer,
+								   dataArea + sharedBuffer->outputOffset,
+								   sharedBuffer->outputLength);
+			bufferArray[bufferIndex] = compressedBuffer;
+		}
+	}
+
+	DestroyParallelContext(parallelContext);
+	ExitParallelMode();
+}
+
+
+/*
+ * ColumnarParallelCompressionMain is the entry point of the parallel workers
+ * started by CompressBuffersInParallel.
+ */
+void
+ColumnarParallelCompressionMain(dsm_segment *segment, shm_toc *toc)
+{
+	ParallelCompressionShared *shared =
+		shm_toc_lookup(toc, PARALLEL_KEY_COMPRESSION_SHARED, false);
+	char *dataArea = shm_toc_lookup(toc, PARALLEL_KEY_COMPRESSION_DATA, false);
+
+	CompressSharedBuffers(shared, dataArea);
+}
+
+
+/*
+ * CompressSharedBuffers compresses buffers of the given parallel compression
+ * until no buffers are left to compress. Compressed data is only kept if it is
+ * not larger than the input.
+ */
+static void
+CompressSharedBuffers(ParallelCompressionShared *shared, char *dataArea)
+{
+	StringInfo compressionBuffer = makeStringInfo();
+
+	while (true)
+	{
+		uint32 bufferIndex = pg_atomic_fetch_add_u32(&shared->nextBufferIndex, 1);
+		if (bufferIndex >= (uint32) shared->bufferCount)
+		{
+			break;
+		}
+
+		ParallelCompressionBuffer *sharedBuffer = &shared->bufferArray[bufferIndex];
+
+		StringInfoData inputBuffer = { 0 };
+		inputBuffer.data = dataArea + sharedBuffer->inputOffset;
+		inputBuffer.len = sharedBuffer->inputLength;
+		inputBuffer.maxlen = sharedBuffer->inputLength;
+
+		bool compressed = CompressBuffer(&inputBuffer, compressionBuffer,
+										 shared->compressionType,
+										 shared->compressionLevel);
+		if (compressed && compressionBuffer->len <= sharedBuffer->inputLength)
+		{
+			memcpy(dataArea + sharedBuffer->outputOffset, compressionBuffer->data,
+				   compressionBuffer->len);
+			sharedBuffer->outputLength = compressionBuffer->len;
+			sharedBuffer->compressed = true;
+		}
+
+		CHECK_FOR_INTERRUPTS();
+	}
+}
@@ -17,9 +17,16 @@
 #include <math.h>
 
 #include "access/amapi.h"
+#include "access/parallel.h"
+#include "access/relscan.h"
 #include "access/skey.h"
+#include "access/table.h"
+#include "access/tableam.h"
+#include "catalog/pg_aggregate.h"
 #include "catalog/pg_am.h"
+#include "catalog/pg_namespace.h"
 #include "catalog/pg_statistic.h"
+#include "catalog/pg_type.h"
 #include "commands/defrem.h"
 #include "miscadmin.h"
 #include "nodes/extensible.h"
@@ -32,13 +39,20 @@
 #include "optimizer/pathnode.h"
 #include "optimizer/paths.h"
 #include "optimizer/plancat.h"
+#include "optimizer/planmain.h"
+#include "optimizer/planner.h"
 #include "optimizer/restrictinfo.h"
+#include "optimizer/tlist.h"
+#include "parser/parse_oper.h"
 #include "utils/builtins.h"
+#include "utils/datum.h"
 #include "utils/lsyscache.h"
 #include "utils/relcache.h"
 #include "utils/ruleutils.h"
 #include "utils/selfuncs.h"
+#include "utils/snapmgr.h"
 #include "utils/spccache.h"
+#include "utils/syscache.h"
 
 #include "columnar/columnar.h"
 #include "columnar/columnar_customscan.h"
@@ -56,9 +70,80 @@ typedef struct ColumnarScanState
 
 	ExprContext *css_RuntimeContext;
 	List *qual;
+
+	/*
+	 * Shared state of a parallel scan, NULL if the scan is not parallel.
+	 * parallelSnapshot is the snapshot shared with the parallel workers, see
+	 * ColumnarScan_BeginCustomScan.
+	 */
+	ParallelTableScanDesc parallelScan;
+	Snapshot parallelSnapshot;
+	bool parallelSnapshotRegistered;
 } ColumnarScanState;
 
 
+/*
+ * ColumnarAggregateKind represents the aggregates that ColumnarAggregate can
+ * compute. count(*), min() and max() can be answered from the chunk group
+ * metadata, the others need the values of the rows.
+ */
+typedef enum ColumnarAggregateKind
+{
+	COLUMNAR_AGGREGATE_COUNT_STAR,
+	COLUMNAR_AGGREGATE_MIN,
+	COLUMNAR_AGGREGATE_MAX,
+	COLUMNAR_AGGREGATE_COUNT,
+	COLUMNAR_AGGREGATE_SUM,
+	COLUMNAR_AGGREGATE_AVG
+} ColumnarAggregateKind;
+
+
+/*
+ * ColumnarAggregateState represents the state for a columnar aggregate scan,
+ * which computes the aggregates of a single columnar table without grouping.
+ * If all aggregates can be answered from the chunk group metadata, chunk
+ * groups whose rows are all known to satisfy the quals are not read. The
+ * chunk groups that are read are aggregated a whole chunk group at a time if
+ * the columnar reader can evaluate the quals over their column arrays, and
+ * row by row otherwise.
+ */
+typedef struct ColumnarAggregateState
+{
+	CustomScanState custom_scanstate; /* must be first field */
+
+	Relation relation;
+	TableScanDesc scanDesc;
+	TupleTableSlot *rowSlot;
+	ExprContext *css_RuntimeContext;
+	ExprContext *rowContext;
+
+	/* quals with base relation Vars, and their ExprState for the rows read */
+	List *qual;
+	ExprState *qualState;
+
+	int aggregateCount;
+	ColumnarAggregateKind *aggregateKinds;
+	AttrNumber *aggregateAttrs;
+	FmgrInfo **comparisonFunctions;
+
+	/* accumulated values, in the per query memory context */
+	int64 rowCount;
+	Datum *aggregateValues;
+	bool *aggregateNulls;
+
+	/* number and sum of the non-NULL values for count(), sum() and avg() */
+	int64 *aggregateCounts;
+	int64 *aggregateSums;
+
+	/* whether all aggregates can be answered from the chunk group metadata */
+	bool answerFromMetadata;
+
+	bool aggregatesReturned;
+	int64 chunkGroupsAnswered;
+	int64 chunkGroupsBatched;
+} ColumnarAggregateState;
+
+
 typedef bool (*PathPredicate)(Path *path);
 
 
@@ -75,7 +160,8 @@ static void CostColumnarScan(PlannerInfo *root, RelOptInfo *rel, Oid relationId,
 static void AddColumnarScanPaths(PlannerInfo *root, RelOptInfo *rel,
 								 RangeTblEntry *rte);
 static void AddColumnarScanPath(PlannerInfo *root, RelOptInfo *rel,
-								RangeTblEntry *rte, Relids required_relids);
+								RangeTblEntry *rte, Relids required_relids,
+								int parallelWorkers);
 
 /* helper functions to be used when costing paths or altering them */
 static void RemovePathsByPredicate(RelOptInfo *rel, PathPredicate removePathPredicate);
@@ -86,6 +172,8 @@ static int RelationIdGetNumberOfAttributes(Oid relationId);
 static Cost ColumnarPerStripeScanCost(RelOptInfo *rel, Oid relationId,
 									  int numberOfColumnsRead);
 static uint64 ColumnarTableStripeCount(Oid relationId);
+static int ColumnarScanParallelWorkers(RelOptInfo *rel, Oid relationId);
+static double ColumnarParallelDivisor(Path *path);
 static Path * CreateColumnarSeqScanPath(PlannerInfo *root, RelOptInfo *rel,
 										Oid relationId);
 static void AddColumnarScanPathsRec(PlannerInfo *root, RelOptInfo *rel,
@@ -93,11 +181,25 @@ static void AddColumnarScanPathsRec(PlannerInfo *root, RelOptInfo *rel,
 									Relids candidateRelids,
 									int depthLimit);
 
+/* functions to compute aggregates while scanning columnar tables */
+static void AddColumnarAggregatePath(PlannerInfo *root, RelOptInfo *input_rel,
+									 RelOptInfo *output_rel);
+static bool ColumnarAggregateSupported(Aggref *aggref, Index relid,
+									   ColumnarAggregateKind *aggregateKind,
+									   AttrNumber *aggregateAttr);
+static bool ColumnarAggregateUsesMetadata(ColumnarAggregateKind aggregateKind);
+static void CostColumnarAggregatePath(PlannerInfo *root, RelOptInfo *rel,
+									  Oid relationId, CustomPath *cpath,
+									  bool answerFromMetadata);
+
 /* hooks and callbacks */
 static void ColumnarSetRelPathlistHook(PlannerInfo *root, RelOptInfo *rel, Index rti,
 									   RangeTblEntry *rte);
 static void ColumnarGetRelationInfoHook(PlannerInfo *root, Oid relationObjectId,
 										bool inhparent, RelOptInfo *rel);
+static void ColumnarCreateUpperPathsHook(PlannerInfo *root, UpperRelationKind stage,
+										 RelOptInfo *input_rel, RelOptInfo *output_rel,
+										 void *extra);
 static Plan * ColumnarScanPath_PlanCustomPath(PlannerInfo *root,
 											  RelOptInfo *rel,
 											  struct CustomPath *best_path,
@@ -116,6 +218,48 @@ static void ColumnarScan_EndCustomScan(CustomScanState *node);
 static void ColumnarScan_ReScanCustomScan(CustomScanState *node);
 static void ColumnarScan_ExplainCustomScan(CustomScanState *node, List *ancestors,
 										   ExplainState *es);
+static Size ColumnarScan_EstimateDSMCustomScan(CustomScanState *node,
+											   ParallelContext *pcxt);
+static void ColumnarScan_InitializeDSMCustomScan(CustomScanState *node,
+												 ParallelContext *pcxt,
+												 void *coordinate);
+static void ColumnarScan_ReInitializeDSMCustomScan(CustomScanState *node,
+												   ParallelContext *pcxt,
+												   void *coordinate);
+static void ColumnarScan_InitializeWorkerCustomScan(CustomScanState *node,
+													shm_toc *toc,
+													void *coordinate);
+static Plan * ColumnarAggregatePath_PlanCustomPath(PlannerInfo *root,
+												   RelOptInfo *rel,
+												   struct CustomPath *best_path,
+												   List *tlist,
+												   List *clauses,
+												   List *custom_plans);
+static Node * ColumnarAggregate_CreateCustomScanState(CustomScan *cscan);
+static void ColumnarAggregate_BeginCustomScan(CustomScanState *node, EState *estate,
+											  int eflags);
+static TupleTableSlot * ColumnarAggregate_ExecCustomScan(CustomScanState *node);
+static void ColumnarAggregate_EndCustomScan(CustomScanState *node);
+static void ColumnarAggregate_ReScanCustomScan(CustomScanState *node);
+static void ColumnarAggregate_ExplainCustomScan(CustomScanState *node,
+												List *ancestors,
+												ExplainState *es);
+static bool ColumnarAggregateCoveredChunkGroup(StripeMetadata *stripeMetadata,
+											   StripeSkipList *stripeSkipList,
+											   uint32 chunkIndex, void *arg);
+static void ColumnarAggregateChunkGroupBatch(ChunkData *chunkData,
+											 const bool *selectionMask, void *arg);
+static bool ColumnarAggregateIntegerValues(Form_pg_attribute attributeForm,
+										   Datum *valueArray, uint32 rowCount,
+										   int64 *integerValues);
+static Datum ColumnarAggregateIntegerDatum(Oid typeId, int64 value);
+static void ColumnarAggregateAccumulate(ColumnarAggregateState *aggregateState,
+										int aggregateIndex, Datum value);
+static void ColumnarAggregateAdvance(ColumnarAggregateState *aggregateState,
+									 int aggregateIndex, Datum value);
+static Datum ColumnarAggregateFinalValue(ColumnarAggregateState *aggregateState,
+										 int aggregateIndex, bool *isNull);
+static void ColumnarAggregateReset(ColumnarAggregateState *aggregateState);
 
 /* helper functions to build strings for EXPLAIN */
 static const char * ColumnarPushdownClausesStr(List *context, List *clauses);
@@ -131,9 +275,12 @@ static Bitmapset * ColumnarAttrNeeded(ScanState *ss);
 /* saved hook value in case of unload */
 static set_rel_pathlist_hook_type PreviousSetRelPathlistHook = NULL;
 static get_relation_info_hook_type PreviousGetRelationInfoHook = NULL;
+static create_upper_paths_hook_type PreviousCreateUpperPathsHook = NULL;
 
 static bool EnableColumnarCustomScan = true;
 static bool EnableColumnarQualPushdown = true;
+static bool EnableColumnarParallelScan = true;
+static bool EnableColumnarAggregatePushdown = true;
 static double ColumnarQualPushdownCorrelationThreshold = 0.9;
 static int ColumnarMaxCustomScanPaths = 64;
 static int ColumnarPlannerDebugLevel = DEBUG3;
@@ -158,9 +305,35 @@ const struct CustomExecMethods ColumnarScanExecuteMethods = {
 	.EndCustomScan = ColumnarScan_EndCustomScan,
 	.ReScanCustomScan = ColumnarScan_ReScanCustomScan,
 
+	.EstimateDSMCustomScan = ColumnarScan_EstimateDSMCustomScan,
+	.InitializeDSMCustomScan = ColumnarScan_InitializeDSMCustomScan,
+	.ReInitializeDSMCustomScan = ColumnarScan_ReInitializeDSMCustomScan,
+	.InitializeWorkerCustomScan = ColumnarScan_InitializeWorkerCustomScan,
+
 	.ExplainCustomScan = ColumnarScan_ExplainCustomScan,
 };
 
+const struct CustomPathMethods ColumnarAggregatePathMethods = {
+	.CustomName = "ColumnarAggregate",
+	.PlanCustomPath = ColumnarAggregatePath_PlanCustomPath,
+};
+
+const struct CustomScanMethods ColumnarAggregateScanMethods = {
+	.CustomName = "ColumnarAggregate",
+	.CreateCustomScanState = ColumnarAggregate_CreateCustomScanState,
+};
+
+const struct CustomExecMethods ColumnarAggregateExecuteMethods = {
+	.CustomName = "ColumnarAggregate",
+
+	.BeginCustomScan = ColumnarAggregate_BeginCustomScan,
+	.ExecCustomScan = ColumnarAggregate_ExecCustomScan,
+	.EndCustomScan = ColumnarAggregate_EndCustomScan,
+	.ReScanCustomScan = ColumnarAggregate_ReScanCustomScan,
+
+	.ExplainCustomScan = ColumnarAggregate_ExplainCustomScan,
+};
+
 static const struct config_enum_entry debug_level_options[] = {
 	{ "debug5", DEBUG5, false },
 	{ "debug4", DEBUG4, false },
@@ -189,6 +362,9 @@ columnar_customscan_init()
 	PreviousGetRelationInfoHook = get_relation_info_hook;
 	get_relation_info_hook = ColumnarGetRelationInfoHook;
 
+	PreviousCreateUpperPathsHook = create_upper_paths_hook;
+	create_upper_paths_hook = ColumnarCreateUpperPathsHook;
+
 	/* register customscan specific GUC's */
 	DefineCustomBoolVariable(
 		"columnar.enable_custom_scan",
@@ -210,6 +386,30 @@ columnar_customscan_init()
 		PGC_USERSET,
 		GUC_NO_SHOW_ALL,
 		NULL, NULL, NULL);
+	DefineCustomBoolVariable(
+		"columnar.enable_parallel_scan",
+		gettext_noop("Enables parallel columnar custom scans, which divide the "
+					 "stripes of a table between parallel workers. This has no "
+					 "effect unless columnar.enable_custom_scan is true."),
+		NULL,
+		&EnableColumnarParallelScan,
+		true,
+		PGC_USERSET,
+		GUC_NO_SHOW_ALL,
+		NULL, NULL, NULL);
+	DefineCustomBoolVariable(
+		"columnar.enable_aggregate_pushdown",
+		gettext_noop("Enables computing count(), min(), max(), and integer sum() "
+					 "and avg() aggregates over a columnar table while scanning "
+					 "it, answering count(*), min() and max() from the chunk group "
+					 "metadata where the quals cover whole chunk groups. This has "
+					 "no effect unless columnar.enable_custom_scan is true."),
+		NULL,
+		&EnableColumnarAggregatePushdown,
+		true,
+		PGC_USERSET,
+		GUC_NO_SHOW_ALL,
+		NULL, NULL, NULL);
 	DefineCustomRealVariable(
 		"columnar.qual_pushdown_correlation_threshold",
 		gettext_noop("Correlation threshold to attempt to push a qual "
@@ -250,6 +450,7 @@ columnar_customscan_init()
 		NULL);
 
 	RegisterCustomScanMethods(&ColumnarScanScanMethods);
+	RegisterCustomScanMethods(&ColumnarAggregateScanMethods);
 }
 
 
@@ -362,6 +563,301 @@ ColumnarGetRelationInfoHook(PlannerInfo *root, Oid relationObjectId,
 }
 
 
+/*
+ * ColumnarCreateUpperPathsHook adds a ColumnarAggregate path for the queries
+ * that compute aggregates over a single columnar table without grouping.
+ */
+static void
+ColumnarCreateUpperPathsHook(PlannerInfo *root, UpperRelationKind stage,
+							 RelOptInfo *input_rel, RelOptInfo *output_rel,
+							 void *extra)
+{
+	if (PreviousCreateUpperPathsHook)
+	{
+		PreviousCreateUpperPathsHook(root, stage, input_rel, output_rel, extra);
+	}
+
+	if (!EnableColumnarCustomScan || !EnableColumnarAggregatePushdown)
+	{
+		return;
+	}
+
+	if (stage != UPPERREL_GROUP_AGG || output_rel->reloptkind != RELOPT_UPPER_REL)
+	{
+		return;
+	}
+
+	GroupPathExtraData *groupPathExtraData = (GroupPathExtraData *) extra;
+	if (groupPathExtraData == NULL ||
+		groupPathExtraData->patype != PARTITIONWISE_AGGREGATE_NONE)
+	{
+		return;
+	}
+
+	AddColumnarAggregatePath(root, input_rel, output_rel);
+}
+
+
+/*
+ * AddColumnarAggregatePath adds a path that computes the aggregates of the
+ * query while scanning the columnar table of input_rel, if the query has no
+ * grouping and only consists of aggregates that ColumnarAggregateSupported
+ * accepts. If those are only count(*), min() and max(), such a path answers
+ * the chunk groups whose rows all satisfy the quals from their row counts and
+ * min/max values, without reading them.
+ */
+static void
+AddColumnarAggregatePath(PlannerInfo *root, RelOptInfo *input_rel,
+						 RelOptInfo *output_rel)
+{
+	Query *parse = root->parse;
+	if (parse->groupClause != NIL || parse->groupingSets != NIL ||
+		parse->havingQual != NULL || parse->hasTargetSRFs)
+	{
+		return;
+	}
+
+	if (input_rel->reloptkind != RELOPT_BASEREL || IS_DUMMY_REL(input_rel))
+	{
+		return;
+	}
+
+	RangeTblEntry *rte = planner_rt_fetch(input_rel->relid, root);
+	if (rte->rtekind != RTE_RELATION || rte->inh || rte->tablesample != NULL ||
+		!IsColumnarTableAmTable(rte->relid))
+	{
+		return;
+	}
+
+	/*
+	 * The quals are evaluated by the aggregate scan itself, so they all need
+	 * to be safe to be checked against the chunk group metadata.
+	 */
+	RestrictInfo *rinfo = NULL;
+	foreach_ptr(rinfo, input_rel->baserestrictinfo)
+	{
+		Node *clause = (Node *) rinfo->clause;
+		if (rinfo->pseudoconstant || rinfo->security_level > 0 ||
+			contain_volatile_functions(clause) || contain_subplans(clause))
+		{
+			return;
+		}
+
+		Var *var = NULL;
+		foreach_ptr(var, pull_var_clause(clause, 0))
+		{
+			if (var->varattno <= 0)
+			{
+				return;
+			}
+		}
+	}
+
+	PathTarget *target = output_rel->reltarget;
+	List *targetNodeList = pull_var_clause((Node *) target->exprs,
+										   PVC_INCLUDE_AGGREGATES |
+										   PVC_INCLUDE_PLACEHOLDERS);
+	if (targetNodeList == NIL)
+	{
+		return;
+	}
+
+	bool answerFromMetadata = true;
+
+	Node *targetNode = NULL;
+	foreach_ptr(targetNode, targetNodeList)
+	{
+		ColumnarAggregateKind aggregateKind;
+		AttrNumber aggregateAttr = InvalidAttrNumber;
+
+		if (!IsA(targetNode, Aggref) ||
+			!ColumnarAggregateSupported((Aggref *) targetNode, input_rel->relid,
+										&aggregateKind, &aggregateAttr))
+		{
+			return;
+		}
+
+		if (!ColumnarAggregateUsesMetadata(aggregateKind))
+		{
+			answerFromMetadata = false;
+		}
+	}
+
+	/*
+	 * Must return a CustomPath, not a larger structure containing a
+	 * CustomPath as the first field, see AddColumnarScanPath.
+	 */
+	CustomPath *cpath = makeNode(CustomPath);
+	cpath->methods = &ColumnarAggregatePathMethods;
+
+	Path *path = &cpath->path;
+	path->pathtype = T_CustomScan;
+	path->parent = output_rel;
+	path->pathtarget = target;
+	path->parallel_safe = false;
+	path->parallel_aware = false;
+	path->parallel_workers = 0;
+
+	cpath->custom_private = list_make3(list_make1_oid(rte->relid),
+									   list_make1_int(input_rel->relid),
+									   copyObject(input_rel->baserestrictinfo));
+
+	CostColumnarAggregatePath(root, input_rel, rte->relid, cpath, answerFromMetadata);
+
+	ereport(ColumnarPlannerDebugLevel,
+			(errmsg("columnar planner: adding ColumnarAggregate path for %s",
+					rte->eref->aliasname),
+			 errdetail("%d clauses pushed down",
+					   list_length(input_rel->baserestrictinfo))));
+
+	add_path(output_rel, path);
+}
+
+
+/*
+ * ColumnarAggregateSupported returns true if the given aggregate can be
+ * computed by a ColumnarAggregate over the relation with range table index
+ * relid, and sets the kind of the aggregate and the attribute that it
+ * aggregates, if any.
+ *
+ * count(*) and count() of a column are identified by their names, and so are
+ * sum() and avg() of int2 and int4 columns, whose transition functions
+ * accumulate the values into int64's, like we do. sum() and avg() of int8
+ * columns are not supported since their transition functions accumulate
+ * into numeric or int128.
+ *
+ * Like planagg.c does for the min/max optimization, we identify min() and
+ * max() aggregates by their sort operators. The sort operator needs to
+ * belong to the default btree opclass of the column type and the aggregate
+ * has to use the collation of the column, since that's what the min/max
+ * values of the chunk groups are computed with.
+ */
+static bool
+ColumnarAggregateSupported(Aggref *aggref, Index relid,
+						   ColumnarAggregateKind *aggregateKind,
+						   AttrNumber *aggregateAttr)
+{
+	if (aggref->aggsplit != AGGSPLIT_SIMPLE || aggref->aggkind != AGGKIND_NORMAL ||
+		aggref->agglevelsup != 0 || aggref->aggfilter != NULL ||
+		aggref->aggdistinct != NIL || aggref->aggorder != NIL)
+	{
+		return false;
+	}
+
+	if (aggref->aggstar)
+	{
+		if (get_func_namespace(aggref->aggfnoid) != PG_CATALOG_NAMESPACE ||
+			strcmp(get_func_name(aggref->aggfnoid), "count") != 0)
+		{
+			return false;
+		}
+
+		*aggregateKind = COLUMNAR_AGGREGATE_COUNT_STAR;
+		*aggregateAttr = InvalidAttrNumber;
+		return true;
+	}
+
+	if (list_length(aggref->args) != 1)
+	{
+		return false;
+	}
+
+	TargetEntry *argument = linitial_node(TargetEntry, aggref->args);
+	if (!IsA(argument->expr, Var))
+	{
+		return false;
+	}
+
+	Var *var = (Var *) argument->expr;
+	if (var->varno != relid || var->varlevelsup != 0 || var->varattno <= 0)
+	{
+		return false;
+	}
+
+	if (get_func_namespace(aggref->aggfnoid) == PG_CATALOG_NAMESPACE)
+	{
+		char *aggregateName = get_func_name(aggref->aggfnoid);
+		bool integerArgument = var->vartype == INT2OID || var->vartype == INT4OID;
+
+		if (strcmp(aggregateName, "count") == 0)
+		{
+			*aggregateKind = COLUMNAR_AGGREGATE_COUNT;
+			*aggregateAttr = var->varattno;
+			return true;
+		}
+		else if (strcmp(aggregateName, "sum") == 0 && integerArgument &&
+				 aggref->aggtype == INT8OID)
+		{
+			*aggregateKind = COLUMNAR_AGGREGATE_SUM;
+			*aggregateAttr = var->varattno;
+			return true;
+		}
+		else if (strcmp(aggregateName, "avg") == 0 && integerArgument &&
+				 aggref->aggtype == NUMERICOID)
+		{
+			*aggregateKind = COLUMNAR_AGGREGATE_AVG;
+			*aggregateAttr = var->varattno;
+			return true;
+		}
+	}
+
+	if (var->vartype != aggref->aggtype || var->varcollid != aggref->inputcollid)
+	{
+		return false;
+	}
+
+	HeapTuple aggregateTuple = SearchSysCache1(AGGFNOID,
+											   ObjectIdGetDatum(aggref->aggfnoid));
+	if (!HeapTupleIsValid(aggregateTuple))
+	{
+		return false;
+	}
+
+	Oid aggregateSortOperator =
+		((Form_pg_aggregate) GETSTRUCT(aggregateTuple))->aggsortop;
+	ReleaseSysCache(aggregateTuple);
+
+	if (!OidIsValid(aggregateSortOperator))
+	{
+		return false;
+	}
+
+	Oid lessThanOperator = InvalidOid;
+	Oid greaterThanOperator = InvalidOid;
+	get_sort_group_operators(var->vartype, false, false, false,
+							 &lessThanOperator, NULL, &greaterThanOperator, NULL);
+
+	if (aggregateSortOperator == lessThanOperator)
+	{
+		*aggregateKind = COLUMNAR_AGGREGATE_MIN;
+	}
+	else if (aggregateSortOperator == greaterThanOperator)
+	{
+		*aggregateKind = COLUMNAR_AGGREGATE_MAX;
+	}
+	else
+	{
+		return false;
+	}
+
+	*aggregateAttr = var->varattno;
+	return true;
+}
+
+
+/*
+ * ColumnarAggregateUsesMetadata returns true if aggregates of the given kind
+ * can be answered from the chunk group metadata.
+ */
+static bool
+ColumnarAggregateUsesMetadata(ColumnarAggregateKind aggregateKind)
+{
+	return aggregateKind == COLUMNAR_AGGREGATE_COUNT_STAR ||
+		   aggregateKind == COLUMNAR_AGGREGATE_MIN ||
+		   aggregateKind == COLUMNAR_AGGREGATE_MAX;
+}
+
+
 /*
  * RemovePathsByPredicate removes the paths that removePathPredicate
  * evaluates to true from pathlist of given rel.
@@ -671,6 +1167,38 @@ CheckVarStats(PlannerInfo *root, Var *var, Oid sortop, float4 *absVarCorrelation
 }
 
 
+/*
+ * ColumnHasBloomFilter returns true if the given Var references a column that
+ * is listed in the bloom_filter_columns option of its columnar table.
+ */
+static bool
+ColumnHasBloomFilter(PlannerInfo *root, Var *var)
+{
+	RangeTblEntry *rte = planner_rt_fetch(var->varno, root);
+	ColumnarOptions options = { 0 };
+
+	if (!ReadColumnarOptions(rte->relid, &options) ||
+		options.bloomFilterColumns == NULL)
+	{
+		return false;
+	}
+
+	char *attributeName = get_attname(rte->relid, var->varattno, false);
+	List *columnNameList = ColumnarOptionColumnNameList(options.bloomFilterColumns);
+
+	char *columnName = NULL;
+	foreach_ptr(columnName, columnNameList)
+	{
+		if (strcmp(columnName, attributeName) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
 /*
  * ExprReferencesRelid returns true if any of the Expr's Vars refer to the
  * given relid; false otherwise.
@@ -906,6 +1434,16 @@ ExtractPushdownClause(PlannerInfo *root, RelOptInfo *rel, Node *node)
 									 varOpcInType, BTLessStrategyNumber);
 	Assert(OidIsValid(sortop));
 
+	/*
+	 * Equality clauses on columns with bloom filters can skip chunk groups
+	 * regardless of how the column values are ordered.
+	 */
+	if (get_op_opfamily_strategy(opExpr->opno, varOpFamily) == BTEqualStrategyNumber &&
+		ColumnHasBloomFilter(root, varSide))
+	{
+		return (Expr *) node;
+	}
+
 	/*
 	 * Check that statistics on the Var support the utility of this
 	 * clause.
@@ -1132,6 +1670,21 @@ AddColumnarScanPaths(PlannerInfo *root, RelOptInfo *rel, RangeTblEntry *rte)
 
 	AddColumnarScanPathsRec(root, rel, rte, paramRelids, candidateRelids,
 							depthLimit);
+
+	/*
+	 * Partial paths cannot be parameterized at all, so we only consider a
+	 * parallel scan when there are no lateral references, like
+	 * create_plain_partial_paths() via set_plain_rel_pathlist().
+	 */
+	if (EnableColumnarParallelScan && rel->consider_parallel &&
+		bms_is_empty(rel->lateral_relids))
+	{
+		int parallelWorkers = ColumnarScanParallelWorkers(rel, rte->relid);
+		if (parallelWorkers > 0)
+		{
+			AddColumnarScanPath(root, rel, rte, NULL, parallelWorkers);
+		}
+	}
 }
 
 
@@ -1174,7 +1727,7 @@ AddColumnarScanPathsRec(PlannerInfo *root, RelOptInfo *rel, RangeTblEntry *rte,
 	check_stack_depth();
 
 	Assert(!bms_overlap(paramRelids, candidateRelids));
-	AddColumnarScanPath(root, rel, rte, paramRelids);
+	AddColumnarScanPath(root, rel, rte, paramRelids, 0);
 
 	/* recurse for all candidateRelids, unless we hit the depth limit */
 	Assert(depthLimit >= 0);
@@ -1273,14 +1826,16 @@ ContainsExecParams(Node *node, void *notUsed)
 
 
 /*
- * Create and add a path with the given parameterization paramRelids.
+ * Create and add a path with the given parameterization paramRelids. If
+ * parallelWorkers is greater than zero, a partial path for a parallel scan
+ * with that many workers is added instead.
  *
  * XXX: Consider refactoring to be more like postgresGetForeignPaths(). The
  * only differences are param_info and custom_private.
  */
 static void
 AddColumnarScanPath(PlannerInfo *root, RelOptInfo *rel, RangeTblEntry *rte,
-					Relids paramRelids)
+					Relids paramRelids, int parallelWorkers)
 {
 	/*
 	 * Must return a CustomPath, not a larger structure containing a
@@ -1299,8 +1854,10 @@ AddColumnarScanPath(PlannerInfo *root, RelOptInfo *rel, RangeTblEntry *rte,
 	path->parent = rel;
 	path->pathtarget = rel->reltarget;
 
-	/* columnar scans are not parallel-aware, but they are parallel-safe */
+	/* columnar scans are parallel-safe, and parallel-aware if partial */
 	path->parallel_safe = rel->consider_parallel;
+	path->parallel_aware = parallelWorkers > 0;
+	path->parallel_workers = parallelWorkers;
 
 	path->param_info = get_baserel_parampathinfo(root, rel, paramRelids);
 
@@ -1363,13 +1920,21 @@ AddColumnarScanPath(PlannerInfo *root, RelOptInfo *rel, RangeTblEntry *rte,
 	StringInfoData buf;
 	initStringInfo(&buf);
 	ereport(ColumnarPlannerDebugLevel,
-			(errmsg("columnar planner: adding CustomScan path for %s",
+			(errmsg("columnar planner: adding %sCustomScan path for %s",
+					path->parallel_aware ? "partial " : "",
 					rte->eref->aliasname),
 			 errdetail("%s; %d clauses pushed down",
 					   ParameterizationAsString(root, paramRelids, &buf),
 					   numberOfClausesPushed)));
 
-	add_path(rel, path);
+	if (path->parallel_aware)
+	{
+		add_partial_path(rel, path);
+	}
+	else
+	{
+		add_path(rel, path);
+	}
 }
 
 
@@ -1400,24 +1965,99 @@ CostColumnarScan(PlannerInfo *root, RelOptInfo *rel, Oid relationId,
 	path->startup_cost = 0;
 	path->total_cost = stripesToRead *
 					   ColumnarPerStripeScanCost(rel, relationId, numberOfColumnsRead);
+
+	if (path->parallel_workers > 0)
+	{
+		/* stripes and rows are divided between the participants */
+		double parallelDivisor = ColumnarParallelDivisor(path);
+
+		path->rows = clamp_row_est(path->rows / parallelDivisor);
+		path->total_cost /= parallelDivisor;
+	}
 }
 
 
 /*
- * ColumnarPerStripeScanCost calculates the cost to scan a single stripe
- * of given columnar table based on number of columns that needs to be
- * read during scan operation.
+ * CostColumnarAggregatePath calculates the cost of a ColumnarAggregate path.
+ * The metadata of all stripes is read in any case. If the quals reference
+ * columns that are not correlated with the physical order of the rows, we
+ * assume that we need to read all stripes. If some aggregates cannot be
+ * answered from the metadata, we read the stripes that the quals select,
+ * like CostColumnarScan estimates. Otherwise, without quals, all chunk groups
+ * are answered from the metadata, and each qual is expected to only partially
+ * cover the chunk groups of a single stripe. Like CostColumnarScan, we only
+ * account for the cost of reading the stripes.
  */
-static Cost
-ColumnarPerStripeScanCost(RelOptInfo *rel, Oid relationId, int numberOfColumnsRead)
+static void
+CostColumnarAggregatePath(PlannerInfo *root, RelOptInfo *rel, Oid relationId,
+						  CustomPath *cpath, bool answerFromMetadata)
 {
-	Relation relation = RelationIdGetRelation(relationId);
-	if (!RelationIsValid(relation))
-	{
-		ereport(ERROR, (errmsg("could not open relation with OID %u", relationId)));
-	}
+	Path *path = &cpath->path;
 
-	List *stripeList = StripesForRelfilenode(relation->rd_node);
+	List *clauses = extract_actual_clauses(lthird(cpath->custom_private),
+										   false /* no pseudoconstants */);
+	uint64 stripeCount = ColumnarTableStripeCount(relationId);
+
+	bool clausesCorrelated = true;
+
+	Var *var = NULL;
+	foreach_ptr(var, pull_var_clause((Node *) clauses, 0))
+	{
+		Oid lessThanOperator = InvalidOid;
+		get_sort_group_operators(var->vartype, false, false, false,
+								 &lessThanOperator, NULL, NULL, NULL);
+		if (!OidIsValid(lessThanOperator) ||
+			!CheckVarStats(root, var, lessThanOperator, NULL))
+		{
+			clausesCorrelated = false;
+			break;
+		}
+	}
+
+	double stripesToRead = 0;
+	if (!clausesCorrelated)
+	{
+		stripesToRead = stripeCount;
+	}
+	else if (!answerFromMetadata)
+	{
+		Selectivity clauseSel = clauselist_selectivity(root, clauses, rel->relid,
+													   JOIN_INNER, NULL);
+		stripesToRead = Max(clauseSel * stripeCount, 1.0);
+	}
+	else if (clauses != NIL)
+	{
+		stripesToRead = Min((double) stripeCount, (double) list_length(clauses));
+	}
+
+	Bitmapset *attrsRead = NULL;
+	pull_varattnos((Node *) clauses, rel->relid, &attrsRead);
+	pull_varattnos((Node *) path->pathtarget->exprs, rel->relid, &attrsRead);
+	int numberOfColumnsRead = bms_num_members(attrsRead);
+
+	path->rows = 1;
+	path->startup_cost = stripeCount * cpu_tuple_cost +
+						 stripesToRead * ColumnarPerStripeScanCost(rel, relationId,
+																   numberOfColumnsRead);
+	path->total_cost = path->startup_cost;
+}
+
+
+/*
+ * ColumnarPerStripeScanCost calculates the cost to scan a single stripe
+ * of given columnar table based on number of columns that needs to be
+ * read during scan operation.
+ */
+static Cost
+ColumnarPerStripeScanCost(RelOptInfo *rel, Oid relationId, int numberOfColumnsRead)
+{
+	Relation relation = RelationIdGetRelation(relationId);
+	if (!RelationIsValid(relation))
+	{
+		ereport(ERROR, (errmsg("could not open relation with OID %u", relationId)));
+	}
+
+	List *stripeList = StripesForRelfilenode(relation->rd_node);
 	RelationClose(relation);
 
 	uint32 maxColumnCount = 0;
@@ -1482,6 +2122,78 @@ ColumnarTableStripeCount(Oid relationId)
 }
 
 
+/*
+ * ColumnarScanParallelWorkers returns the number of workers to plan for a
+ * parallel scan of the columnar table with relationId, or 0 if the table is
+ * not worth scanning in parallel. The number is chosen by
+ * compute_parallel_worker(), which honors the parallel_workers reloption and
+ * max_parallel_workers_per_gather. Since stripes are the unit of work in a
+ * parallel scan, we never plan for more participants than stripes.
+ */
+static int
+ColumnarScanParallelWorkers(RelOptInfo *rel, Oid relationId)
+{
+	Relation relation = RelationIdGetRelation(relationId);
+	if (!RelationIsValid(relation))
+	{
+		ereport(ERROR, (errmsg("could not open relation with OID %u", relationId)));
+	}
+
+	int reloptionParallelWorkers = RelationGetParallelWorkers(relation, -1);
+	RelationClose(relation);
+
+	/*
+	 * ColumnarGetRelationInfoHook sets rel_parallel_workers to 0 to prevent
+	 * Postgres from planning parallel heap scans, so pass the reloption to
+	 * compute_parallel_worker() via the rel temporarily.
+	 */
+	int relParallelWorkers = rel->rel_parallel_workers;
+	rel->rel_parallel_workers = reloptionParallelWorkers;
+
+	int parallelWorkers = compute_parallel_worker(rel, rel->pages, -1,
+												  max_parallel_workers_per_gather);
+
+	rel->rel_parallel_workers = relParallelWorkers;
+
+	if (parallelWorkers <= 0)
+	{
+		return 0;
+	}
+
+	uint64 stripeCount = ColumnarTableStripeCount(relationId);
+	if (stripeCount < 2)
+	{
+		return 0;
+	}
+
+	/* the leader scans stripes as well */
+	return (int) Min(stripeCount - 1, (uint64) parallelWorkers);
+}
+
+
+/*
+ * ColumnarParallelDivisor estimates the fraction of the work that each
+ * participant of a parallel scan does, like get_parallel_divisor() in
+ * costsize.c.
+ */
+static double
+ColumnarParallelDivisor(Path *path)
+{
+	double parallelDivisor = path->parallel_workers;
+
+	if (parallel_leader_participation)
+	{
+		double leaderContribution = 1.0 - (0.3 * path->parallel_workers);
+		if (leaderContribution > 0)
+		{
+			parallelDivisor += leaderContribution;
+		}
+	}
+
+	return parallelDivisor;
+}
+
+
 static Plan *
 ColumnarScanPath_PlanCustomPath(PlannerInfo *root,
 								RelOptInfo *rel,
@@ -1669,6 +2381,24 @@ ColumnarScan_BeginCustomScan(CustomScanState *cscanstate, EState *estate, int ef
 	columnarScanState->qual = (List *) EvalParamsMutator(
 		(Node *) plainClauses, columnarScanState->css_RuntimeContext);
 
+	columnarScanState->parallelScan = NULL;
+	columnarScanState->parallelSnapshot = estate->es_snapshot;
+	columnarScanState->parallelSnapshotRegistered = false;
+
+	if (cscan->scan.plan.parallel_aware && !IsParallelWorker() &&
+		!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+	{
+		/*
+		 * Parallel workers cannot see our pending writes, and we cannot flush
+		 * them once the parallel operation starts. So flush them now and
+		 * share a snapshot that can see them with the workers.
+		 */
+		columnarScanState->parallelSnapshot =
+			ColumnarFlushPendingWritesForSnapshot(
+				cscanstate->ss.ss_currentRelation, estate->es_snapshot,
+				&columnarScanState->parallelSnapshotRegistered);
+	}
+
 	/* scan slot is already initialized */
 }
 
@@ -1738,14 +2468,25 @@ ColumnarScanNext(ColumnarScanState *columnarScanState)
 		/* the columnar access method does not use the flags, they are specific to heap */
 		uint32 flags = 0;
 		Bitmapset *attr_needed = ColumnarAttrNeeded(&node->ss);
+		Snapshot snapshot = estate->es_snapshot;
 
 		/*
-		 * We reach here if the scan is not parallel, or if we're serially
-		 * executing a scan that was planned to be parallel.
+		 * parallelScan is NULL if the scan is not parallel, or if we're
+		 * serially executing a scan that was planned to be parallel.
 		 */
+		ParallelTableScanDesc parallelScan = columnarScanState->parallelScan;
+		if (parallelScan != NULL && !parallelScan->phs_snapshot_any)
+		{
+			/* use the snapshot shared by the leader, as table_beginscan_parallel does */
+			snapshot = RestoreSnapshot((char *) parallelScan +
+									   parallelScan->phs_snapshot_off);
+			RegisterSnapshot(snapshot);
+			flags |= SO_TEMP_SNAPSHOT;
+		}
+
 		scandesc = columnar_beginscan_extended(node->ss.ss_currentRelation,
-											   estate->es_snapshot,
-											   0, NULL, NULL, flags, attr_needed,
+											   snapshot, 0, NULL, parallelScan,
+											   flags, attr_needed,
 											   columnarScanState->qual);
 		bms_free(attr_needed);
 
@@ -1785,6 +2526,8 @@ ColumnarScan_ExecCustomScan(CustomScanState *node)
 static void
 ColumnarScan_EndCustomScan(CustomScanState *node)
 {
+	ColumnarScanState *columnarScanState = (ColumnarScanState *) node;
+
 	/*
 	 * get information from node
 	 */
@@ -1811,6 +2554,11 @@ ColumnarScan_EndCustomScan(CustomScanState *node)
 	{
 		table_endscan(scanDesc);
 	}
+
+	if (columnarScanState->parallelSnapshotRegistered)
+	{
+		UnregisterSnapshot(columnarScanState->parallelSnapshot);
+	}
 }
 
 
@@ -1837,6 +2585,66 @@ ColumnarScan_ReScanCustomScan(CustomScanState *node)
 }
 
 
+/*
+ * ColumnarScan_EstimateDSMCustomScan returns the size of the shared state
+ * needed for a parallel columnar scan.
+ */
+static Size
+ColumnarScan_EstimateDSMCustomScan(CustomScanState *node, ParallelContext *pcxt)
+{
+	ColumnarScanState *columnarScanState = (ColumnarScanState *) node;
+
+	return table_parallelscan_estimate(node->ss.ss_currentRelation,
+									   columnarScanState->parallelSnapshot);
+}
+
+
+/*
+ * ColumnarScan_InitializeDSMCustomScan initializes the shared state of a
+ * parallel columnar scan in the leader.
+ */
+static void
+ColumnarScan_InitializeDSMCustomScan(CustomScanState *node, ParallelContext *pcxt,
+									 void *coordinate)
+{
+	ColumnarScanState *columnarScanState = (ColumnarScanState *) node;
+	ParallelTableScanDesc parallelScan = (ParallelTableScanDesc) coordinate;
+
+	table_parallelscan_initialize(node->ss.ss_currentRelation, parallelScan,
+								  columnarScanState->parallelSnapshot);
+
+	columnarScanState->parallelScan = parallelScan;
+}
+
+
+/*
+ * ColumnarScan_ReInitializeDSMCustomScan resets the shared state of a
+ * parallel columnar scan before a rescan.
+ */
+static void
+ColumnarScan_ReInitializeDSMCustomScan(CustomScanState *node, ParallelContext *pcxt,
+									   void *coordinate)
+{
+	ParallelTableScanDesc parallelScan = (ParallelTableScanDesc) coordinate;
+
+	table_parallelscan_reinitialize(node->ss.ss_currentRelation, parallelScan);
+}
+
+
+/*
+ * ColumnarScan_InitializeWorkerCustomScan attaches a parallel worker to the
+ * shared state of a parallel columnar scan.
+ */
+static void
+ColumnarScan_InitializeWorkerCustomScan(CustomScanState *node, shm_toc *toc,
+										void *coordinate)
+{
+	ColumnarScanState *columnarScanState = (ColumnarScanState *) node;
+
+	columnarScanState->parallelScan = (ParallelTableScanDesc) coordinate;
+}
+
+
 static void
 ColumnarScan_ExplainCustomScan(CustomScanState *node, List *ancestors,
 							   ExplainState *es)
@@ -1873,6 +2681,907 @@ ColumnarScan_ExplainCustomScan(CustomScanState *node, List *ancestors,
 }
 
 
+/*
+ * ColumnarAggregatePath_PlanCustomPath creates the plan for a ColumnarAggregate
+ * path. Since there is no relation to scan from the point of view of the
+ * executor, the scan tuple consists of the aggregates, followed by the Vars of
+ * the quals. The latter are never filled in, but allow setrefs.c to process
+ * the quals like the other expressions of the plan.
+ */
+static Plan *
+ColumnarAggregatePath_PlanCustomPath(PlannerInfo *root,
+									 RelOptInfo *rel,
+									 struct CustomPath *best_path,
+									 List *tlist,
+									 List *clauses,
+									 List *custom_plans)
+{
+	/*
+	 * Must return a CustomScan, not a larger structure containing a
+	 * CustomScan as the first field, see ColumnarScanPath_PlanCustomPath.
+	 */
+	CustomScan *cscan = makeNode(CustomScan);
+
+	cscan->methods = &ColumnarAggregateScanMethods;
+
+	Oid relationId = linitial_oid(linitial(best_path->custom_private));
+	Index relid = linitial_int(lsecond(best_path->custom_private));
+	List *quals = extract_actual_clauses(lthird(best_path->custom_private),
+										 false /* no pseudoconstants */);
+
+	List *scanTargetList = NIL;
+	List *aggregateKindList = NIL;
+	List *aggregateAttrList = NIL;
+	AttrNumber resno = 1;
+
+	Node *targetNode = NULL;
+	foreach_ptr(targetNode, pull_var_clause((Node *) tlist,
+											PVC_INCLUDE_AGGREGATES |
+											PVC_INCLUDE_PLACEHOLDERS))
+	{
+		Aggref *aggref = castNode(Aggref, targetNode);
+		if (tlist_member((Expr *) aggref, scanTargetList) != NULL)
+		{
+			continue;
+		}
+
+		ColumnarAggregateKind aggregateKind;
+		AttrNumber aggregateAttr = InvalidAttrNumber;
+		if (!ColumnarAggregateSupported(aggref, relid, &aggregateKind,
+										&aggregateAttr))
+		{
+			elog(ERROR, "unexpected aggregate in columnar aggregate scan");
+		}
+
+		scanTargetList = lappend(scanTargetList,
+								 makeTargetEntry((Expr *) aggref, resno++, NULL,
+												 false));
+		aggregateKindList = lappend_int(aggregateKindList, aggregateKind);
+		aggregateAttrList = lappend_int(aggregateAttrList, aggregateAttr);
+	}
+
+	Var *var = NULL;
+	foreach_ptr(var, pull_var_clause((Node *) quals, 0))
+	{
+		if (tlist_member((Expr *) var, scanTargetList) == NULL)
+		{
+			scanTargetList = lappend(scanTargetList,
+									 makeTargetEntry((Expr *) var, resno++, NULL,
+													 true));
+		}
+	}
+
+	cscan->custom_scan_tlist = scanTargetList;
+	cscan->custom_exprs = copyObject(quals);
+	cscan->custom_private = list_make3(list_make1_oid(relationId),
+									   aggregateKindList, aggregateAttrList);
+	cscan->scan.plan.targetlist = list_copy(tlist);
+	cscan->scan.plan.qual = NIL;
+	cscan->scan.scanrelid = 0;
+
+	return (Plan *) cscan;
+}
+
+
+static Node *
+ColumnarAggregate_CreateCustomScanState(CustomScan *cscan)
+{
+	ColumnarAggregateState *aggregateState = (ColumnarAggregateState *) newNode(
+		sizeof(ColumnarAggregateState), T_CustomScanState);
+
+	CustomScanState *cscanstate = &aggregateState->custom_scanstate;
+	cscanstate->methods = &ColumnarAggregateExecuteMethods;
+
+	return (Node *) cscanstate;
+}
+
+
+/*
+ * ColumnarAggregateQualMutator replaces the Vars that reference the scan tuple
+ * of a ColumnarAggregate with the Vars of the relation that they stand for.
+ */
+static Node *
+ColumnarAggregateQualMutator(Node *node, List *scanTargetList)
+{
+	if (node == NULL)
+	{
+		return NULL;
+	}
+
+	if (IsA(node, Var) && ((Var *) node)->varno == INDEX_VAR)
+	{
+		TargetEntry *targetEntry = list_nth(scanTargetList,
+											((Var *) node)->varattno - 1);
+		return (Node *) copyObject(targetEntry->expr);
+	}
+
+	return expression_tree_mutator(node, ColumnarAggregateQualMutator,
+								   (void *) scanTargetList);
+}
+
+
+static void
+ColumnarAggregate_BeginCustomScan(CustomScanState *cscanstate, EState *estate,
+								  int eflags)
+{
+	CustomScan *cscan = (CustomScan *) cscanstate->ss.ps.plan;
+	ColumnarAggregateState *aggregateState = (ColumnarAggregateState *) cscanstate;
+
+	Oid relationId = linitial_oid(linitial(cscan->custom_private));
+	List *aggregateKindList = lsecond(cscan->custom_private);
+	List *aggregateAttrList = lthird(cscan->custom_private);
+
+	/* the relation is in the range table, so we already hold a lock on it */
+	Relation relation = table_open(relationId, NoLock);
+	TupleDesc tupleDescriptor = RelationGetDescr(relation);
+
+	aggregateState->relation = relation;
+	aggregateState->scanDesc = NULL;
+	aggregateState->rowSlot = ExecInitExtraTupleSlot(estate, tupleDescriptor,
+													 table_slot_callbacks(relation));
+	aggregateState->css_RuntimeContext = CreateExprContext(estate);
+	aggregateState->rowContext = CreateExprContext(estate);
+
+	aggregateState->qual = (List *) ColumnarAggregateQualMutator(
+		(Node *) cscan->custom_exprs, cscan->custom_scan_tlist);
+	aggregateState->qualState = ExecInitQual(aggregateState->qual,
+											 &cscanstate->ss.ps);
+
+	int aggregateCount = list_length(aggregateKindList);
+	aggregateState->aggregateCount = aggregateCount;
+	aggregateState->aggregateKinds = palloc0(aggregateCount *
+											 sizeof(ColumnarAggregateKind));
+	aggregateState->aggregateAttrs = palloc0(aggregateCount * sizeof(AttrNumber));
+	aggregateState->comparisonFunctions = palloc0(aggregateCount * sizeof(FmgrInfo *));
+	aggregateState->aggregateValues = palloc0(aggregateCount * sizeof(Datum));
+	aggregateState->aggregateNulls = palloc0(aggregateCount * sizeof(bool));
+	aggregateState->aggregateCounts = palloc0(aggregateCount * sizeof(int64));
+	aggregateState->aggregateSums = palloc0(aggregateCount * sizeof(int64));
+	aggregateState->answerFromMetadata = true;
+
+	for (int aggregateIndex = 0; aggregateIndex < aggregateCount; aggregateIndex++)
+	{
+		ColumnarAggregateKind aggregateKind = list_nth_int(aggregateKindList,
+														   aggregateIndex);
+		AttrNumber aggregateAttr = list_nth_int(aggregateAttrList, aggregateIndex);
+
+		aggregateState->aggregateKinds[aggregateIndex] = aggregateKind;
+		aggregateState->aggregateAttrs[aggregateIndex] = aggregateAttr;
+
+		if (!ColumnarAggregateUsesMetadata(aggregateKind))
+		{
+			aggregateState->answerFromMetadata = false;
+		}
+
+		if (aggregateKind == COLUMNAR_AGGREGATE_MIN ||
+			aggregateKind == COLUMNAR_AGGREGATE_MAX)
+		{
+			Form_pg_attribute attributeForm =
+				TupleDescAttr(tupleDescriptor, aggregateAttr - 1);
+			aggregateState->comparisonFunctions[aggregateIndex] =
+				GetFunctionInfoOrNull(attributeForm->atttypid, BTREE_AM_OID,
+									  BTORDER_PROC);
+		}
+	}
+
+	ColumnarAggregateReset(aggregateState);
+}
+
+
+/*
+ * ColumnarAggregateReset forgets about the aggregate values accumulated so far.
+ */
+static void
+ColumnarAggregateReset(ColumnarAggregateState *aggregateState)
+{
+	aggregateState->rowCount = 0;
+
+	for (int aggregateIndex = 0; aggregateIndex < aggregateState->aggregateCount;
+		 aggregateIndex++)
+	{
+		aggregateState->aggregateValues[aggregateIndex] = (Datum) 0;
+		aggregateState->aggregateNulls[aggregateIndex] = true;
+		aggregateState->aggregateCounts[aggregateIndex] = 0;
+		aggregateState->aggregateSums[aggregateIndex] = 0;
+	}
+
+	aggregateState->aggregatesReturned = false;
+	aggregateState->chunkGroupsAnswered = 0;
+	aggregateState->chunkGroupsBatched = 0;
+}
+
+
+/*
+ * ColumnarAggregateAccumulate accumulates the given non-NULL value of a row
+ * that satisfies the quals into the aggregate with given index.
+ */
+static void
+ColumnarAggregateAccumulate(ColumnarAggregateState *aggregateState, int aggregateIndex,
+							Datum value)
+{
+	switch (aggregateState->aggregateKinds[aggregateIndex])
+	{
+		case COLUMNAR_AGGREGATE_COUNT:
+		{
+			aggregateState->aggregateCounts[aggregateIndex]++;
+			break;
+		}
+
+		case COLUMNAR_AGGREGATE_SUM:
+		case COLUMNAR_AGGREGATE_AVG:
+		{
+			AttrNumber aggregateAttr = aggregateState->aggregateAttrs[aggregateIndex];
+			Form_pg_attribute attributeForm =
+				TupleDescAttr(RelationGetDescr(aggregateState->relation),
+							  aggregateAttr - 1);
+
+			aggregateState->aggregateSums[aggregateIndex] +=
+				attributeForm->atttypid == INT2OID ? DatumGetInt16(value) :
+				DatumGetInt32(value);
+			aggregateState->aggregateCounts[aggregateIndex]++;
+			break;
+		}
+
+		default:
+		{
+			ColumnarAggregateAdvance(aggregateState, aggregateIndex, value);
+			break;
+		}
+	}
+}
+
+
+/*
+ * ColumnarAggregateAdvance accumulates the given non-NULL value into the
+ * min() or max() aggregate with given index.
+ */
+static void
+ColumnarAggregateAdvance(ColumnarAggregateState *aggregateState, int aggregateIndex,
+						 Datum value)
+{
+	AttrNumber aggregateAttr = aggregateState->aggregateAttrs[aggregateIndex];
+	Form_pg_attribute attributeForm =
+		TupleDescAttr(RelationGetDescr(aggregateState->relation), aggregateAttr - 1);
+	Datum currentValue = aggregateState->aggregateValues[aggregateIndex];
+
+	if (!aggregateState->aggregateNulls[aggregateIndex])
+	{
+		FmgrInfo *comparisonFunction =
+			aggregateState->comparisonFunctions[aggregateIndex];
+		int32 comparisonResult =
+			DatumGetInt32(FunctionCall2Coll(comparisonFunction,
+											attributeForm->attcollation,
+											value, currentValue));
+
+		if (aggregateState->aggregateKinds[aggregateIndex] == COLUMNAR_AGGREGATE_MIN ?
+			comparisonResult >= 0 : comparisonResult <= 0)
+		{
+			return;
+		}
+
+		if (!attributeForm->attbyval)
+		{
+			pfree(DatumGetPointer(currentValue));
+		}
+	}
+
+	/* values of the rows and the skip list go away with the stripe */
+	MemoryContext oldContext =
+		MemoryContextSwitchTo(aggregateState->custom_scanstate.ss.ps.state->es_query_cxt);
+
+	aggregateState->aggregateValues[aggregateIndex] =
+		datumCopy(value, attributeForm->attbyval, attributeForm->attlen);
+	aggregateState->aggregateNulls[aggregateIndex] = false;
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * ColumnarAggregateCoveredChunkGroup is the ColumnarCoveredChunkGroupCallback
+ * of ColumnarAggregate. It accumulates the aggregates of a chunk group whose
+ * rows all satisfy the quals from the row count and the min/max values of the
+ * chunk group, so that the columnar reader can skip the chunk group.
+ */
+static bool
+ColumnarAggregateCoveredChunkGroup(StripeMetadata *stripeMetadata,
+								   StripeSkipList *stripeSkipList, uint32 chunkIndex,
+								   void *arg)
+{
+	ColumnarAggregateState *aggregateState = (ColumnarAggregateState *) arg;
+
+	for (int aggregateIndex = 0; aggregateIndex < aggregateState->aggregateCount;
+		 aggregateIndex++)
+	{
+		/* columns added after writing the stripe have no min/max values */
+		AttrNumber aggregateAttr = aggregateState->aggregateAttrs[aggregateIndex];
+		if (aggregateAttr > (AttrNumber) stripeMetadata->columnCount)
+		{
+			return false;
+		}
+	}
+
+	aggregateState->rowCount += stripeSkipList->chunkGroupRowCounts[chunkIndex];
+
+	for (int aggregateIndex = 0; aggregateIndex < aggregateState->aggregateCount;
+		 aggregateIndex++)
+	{
+		AttrNumber aggregateAttr = aggregateState->aggregateAttrs[aggregateIndex];
+		if (aggregateAttr == InvalidAttrNumber)
+		{
+			continue;
+		}
+
+		ColumnChunkSkipNode *chunkSkipNode =
+			&stripeSkipList->chunkSkipNodeArray[aggregateAttr - 1][chunkIndex];
+
+		/* a chunk doesn't have min/max values if all of its values are NULL */
+		if (!chunkSkipNode->hasMinMax)
+		{
+			continue;
+		}
+
+		if (aggregateState->aggregateKinds[aggregateIndex] == COLUMNAR_AGGREGATE_MIN)
+		{
+			ColumnarAggregateAdvance(aggregateState, aggregateIndex,
+									 chunkSkipNode->minimumValue);
+		}
+		else
+		{
+			ColumnarAggregateAdvance(aggregateState, aggregateIndex,
+									 chunkSkipNode->maximumValue);
+		}
+	}
+
+	aggregateState->chunkGroupsAnswered++;
+
+	return true;
+}
+
+
+/*
+ * ColumnarAggregateChunkGroupBatch is the ColumnarChunkGroupBatchCallback of
+ * ColumnarAggregate. It accumulates the aggregates over the rows of a chunk
+ * group that satisfy the quals in loops over the column arrays of the chunk
+ * group. The values of integer-like columns are aggregated as int64 arrays
+ * in branch-free loops that compilers can vectorize, while min() and max()
+ * of other columns call the comparison function of the column per value.
+ */
+static void
+ColumnarAggregateChunkGroupBatch(ChunkData *chunkData, const bool *selectionMask,
+								 void *arg)
+{
+	ColumnarAggregateState *aggregateState = (ColumnarAggregateState *) arg;
+	TupleDesc tupleDescriptor = RelationGetDescr(aggregateState->relation);
+	uint32 rowCount = chunkData->rowCount;
+	uint32 rowIndex = 0;
+
+	int64 selectedRowCount = rowCount;
+	if (selectionMask != NULL)
+	{
+		selectedRowCount = 0;
+		for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+		{
+			selectedRowCount += selectionMask[rowIndex];
+		}
+	}
+
+	aggregateState->rowCount += selectedRowCount;
+	aggregateState->chunkGroupsBatched++;
+
+	/* columns that the quals don't reference are not deserialized in that case */
+	if (selectedRowCount == 0)
+	{
+		return;
+	}
+
+	bool *valueSelected = palloc(rowCount * sizeof(bool));
+	int64 *integerValues = palloc(rowCount * sizeof(int64));
+
+	for (int aggregateIndex = 0; aggregateIndex < aggregateState->aggregateCount;
+		 aggregateIndex++)
+	{
+		AttrNumber aggregateAttr = aggregateState->aggregateAttrs[aggregateIndex];
+		if (aggregateAttr == InvalidAttrNumber)
+		{
+			continue;
+		}
+
+		Form_pg_attribute attributeForm = TupleDescAttr(tupleDescriptor,
+														aggregateAttr - 1);
+		bool *existsArray = chunkData->existsArray[aggregateAttr - 1];
+		Datum *valueArray = chunkData->valueArray[aggregateAttr - 1];
+
+		/* the non-NULL values of the rows that satisfy the quals */
+		int64 valueCount = 0;
+		for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+		{
+			valueSelected[rowIndex] = existsArray[rowIndex] &&
+									  (selectionMask == NULL || selectionMask[rowIndex]);
+			valueCount += valueSelected[rowIndex];
+		}
+
+		if (valueCount == 0)
+		{
+			continue;
+		}
+
+		ColumnarAggregateKind aggregateKind =
+			aggregateState->aggregateKinds[aggregateIndex];
+
+		if (aggregateKind == COLUMNAR_AGGREGATE_COUNT)
+		{
+			aggregateState->aggregateCounts[aggregateIndex] += valueCount;
+			continue;
+		}
+
+		if (!ColumnarAggregateIntegerValues(attributeForm, valueArray, rowCount,
+											integerValues))
+		{
+			/* sum() and avg() are only supported for integer columns */
+			Assert(aggregateKind == COLUMNAR_AGGREGATE_MIN ||
+				   aggregateKind == COLUMNAR_AGGREGATE_MAX);
+
+			for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+			{
+				if (valueSelected[rowIndex])
+				{
+					ColumnarAggregateAdvance(aggregateState, aggregateIndex,
+											 valueArray[rowIndex]);
+				}
+			}
+
+			continue;
+		}
+
+		switch (aggregateKind)
+		{
+			case COLUMNAR_AGGREGATE_SUM:
+			case COLUMNAR_AGGREGATE_AVG:
+			{
+				int64 sum = 0;
+				for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+				{
+					sum += valueSelected[rowIndex] ? integerValues[rowIndex] : 0;
+				}
+
+				aggregateState->aggregateSums[aggregateIndex] += sum;
+				aggregateState->aggregateCounts[aggregateIndex] += valueCount;
+				break;
+			}
+
+			case COLUMNAR_AGGREGATE_MIN:
+			{
+				int64 minimum = PG_INT64_MAX;
+				for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+				{
+					int64 value = valueSelected[rowIndex] ? integerValues[rowIndex] :
+								  PG_INT64_MAX;
+					minimum = Min(minimum, value);
+				}
+
+				ColumnarAggregateAdvance(aggregateState, aggregateIndex,
+										 ColumnarAggregateIntegerDatum(
+											 attributeForm->atttypid, minimum));
+				break;
+			}
+
+			case COLUMNAR_AGGREGATE_MAX:
+			{
+				int64 maximum = PG_INT64_MIN;
+				for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+				{
+					int64 value = valueSelected[rowIndex] ? integerValues[rowIndex] :
+								  PG_INT64_MIN;
+					maximum = Max(maximum, value);
+				}
+
+				ColumnarAggregateAdvance(aggregateState, aggregateIndex,
+										 ColumnarAggregateIntegerDatum(
+											 attributeForm->atttypid, maximum));
+				break;
+			}
+
+			default:
+			{
+				ereport(ERROR, (errmsg("unexpected columnar aggregate kind %d",
+									   aggregateKind)));
+			}
+		}
+	}
+
+	pfree(integerValues);
+	pfree(valueSelected);
+}
+
+
+/*
+ * ColumnarAggregateIntegerValues converts the given values of a column to
+ * int64's in integerValues and returns true, if the values of the column are
+ * stored as plain integers that sort like int64's. Otherwise, returns false.
+ */
+static bool
+ColumnarAggregateIntegerValues(Form_pg_attribute attributeForm, Datum *valueArray,
+							   uint32 rowCount, int64 *integerValues)
+{
+	uint32 rowIndex = 0;
+
+	/* int8 and timestamps are passed by reference on some platforms */
+	if (!attributeForm->attbyval)
+	{
+		return false;
+	}
+
+	switch (attributeForm->atttypid)
+	{
+		case INT2OID:
+		{
+			for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+			{
+				integerValues[rowIndex] = DatumGetInt16(valueArray[rowIndex]);
+			}
+			return true;
+		}
+
+		case INT4OID:
+		case DATEOID:
+		{
+			for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+			{
+				integerValues[rowIndex] = DatumGetInt32(valueArray[rowIndex]);
+			}
+			return true;
+		}
+
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+		{
+			for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+			{
+				integerValues[rowIndex] = DatumGetInt64(valueArray[rowIndex]);
+			}
+			return true;
+		}
+
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+
+/*
+ * ColumnarAggregateIntegerDatum converts an int64 produced by
+ * ColumnarAggregateIntegerValues back to a Datum of the given type.
+ */
+static Datum
+ColumnarAggregateIntegerDatum(Oid typeId, int64 value)
+{
+	switch (typeId)
+	{
+		case INT2OID:
+		{
+			return Int16GetDatum((int16) value);
+		}
+
+		case INT4OID:
+		case DATEOID:
+		{
+			return Int32GetDatum((int32) value);
+		}
+
+		default:
+		{
+			return Int64GetDatum(value);
+		}
+	}
+}
+
+
+/*
+ * ColumnarAggregateFinalValue returns the final value of the aggregate with
+ * given index, and sets isNull if it is NULL.
+ */
+static Datum
+ColumnarAggregateFinalValue(ColumnarAggregateState *aggregateState, int aggregateIndex,
+							bool *isNull)
+{
+	int64 valueCount = aggregateState->aggregateCounts[aggregateIndex];
+	int64 valueSum = aggregateState->aggregateSums[aggregateIndex];
+
+	*isNull = false;
+
+	switch (aggregateState->aggregateKinds[aggregateIndex])
+	{
+		case COLUMNAR_AGGREGATE_COUNT_STAR:
+		{
+			return Int64GetDatum(aggregateState->rowCount);
+		}
+
+		case COLUMNAR_AGGREGATE_COUNT:
+		{
+			return Int64GetDatum(valueCount);
+		}
+
+		case COLUMNAR_AGGREGATE_SUM:
+		{
+			*isNull = valueCount == 0;
+			return *isNull ? (Datum) 0 : Int64GetDatum(valueSum);
+		}
+
+		case COLUMNAR_AGGREGATE_AVG:
+		{
+			if (valueCount == 0)
+			{
+				*isNull = true;
+				return (Datum) 0;
+			}
+
+			/* same as int8_avg */
+			Datum countDatum = DirectFunctionCall1(int8_numeric,
+												   Int64GetDatum(valueCount));
+			Datum sumDatum = DirectFunctionCall1(int8_numeric,
+												 Int64GetDatum(valueSum));
+
+			return DirectFunctionCall2(numeric_div, sumDatum, countDatum);
+		}
+
+		default:
+		{
+			*isNull = aggregateState->aggregateNulls[aggregateIndex];
+			return aggregateState->aggregateValues[aggregateIndex];
+		}
+	}
+}
+
+
+/*
+ * ColumnarAggregateBeginScan starts the scan of the columnar table, which
+ * passes the chunk groups that are covered by the quals to
+ * ColumnarAggregateCoveredChunkGroup if all aggregates can be answered from
+ * the chunk group metadata, and the rest of the chunk groups to
+ * ColumnarAggregateChunkGroupBatch. If the columnar reader cannot evaluate
+ * the quals over the column arrays of the chunk groups, the scan returns
+ * the rows of the latter instead.
+ */
+static void
+ColumnarAggregateBeginScan(ColumnarAggregateState *aggregateState)
+{
+	EState *estate = aggregateState->custom_scanstate.ss.ps.state;
+
+	/* attr_needed represents 0-indexed attribute numbers */
+	Bitmapset *attr_needed = NULL;
+	for (int aggregateIndex = 0; aggregateIndex < aggregateState->aggregateCount;
+		 aggregateIndex++)
+	{
+		AttrNumber aggregateAttr = aggregateState->aggregateAttrs[aggregateIndex];
+		if (aggregateAttr != InvalidAttrNumber)
+		{
+			attr_needed = bms_add_member(attr_needed, aggregateAttr - 1);
+		}
+	}
+
+	Var *var = NULL;
+	foreach_ptr(var, pull_var_clause((Node *) aggregateState->qual, 0))
+	{
+		attr_needed = bms_add_member(attr_needed, var->varattno - 1);
+	}
+
+	ResetExprContext(aggregateState->css_RuntimeContext);
+	List *scanQual = (List *) EvalParamsMutator(
+		(Node *) aggregateState->qual, aggregateState->css_RuntimeContext);
+
+	/* the columnar access method does not use the flags */
+	uint32 flags = 0;
+	TableScanDesc scanDesc = columnar_beginscan_extended(aggregateState->relation,
+														 estate->es_snapshot, 0, NULL,
+														 NULL, flags, attr_needed,
+														 scanQual);
+	bms_free(attr_needed);
+
+	if (aggregateState->answerFromMetadata)
+	{
+		ColumnarScanSetCoveredChunkGroupCallback((ColumnarScanDesc) scanDesc,
+												 ColumnarAggregateCoveredChunkGroup,
+												 aggregateState);
+	}
+
+	ColumnarScanSetChunkGroupBatchCallback((ColumnarScanDesc) scanDesc,
+										   ColumnarAggregateChunkGroupBatch,
+										   aggregateState);
+
+	aggregateState->scanDesc = scanDesc;
+}
+
+
+/*
+ * ColumnarAggregateNext returns a scan tuple with the aggregates over all the
+ * rows that satisfy the quals when called for the first time, and NULL
+ * afterwards.
+ */
+static TupleTableSlot *
+ColumnarAggregateNext(ColumnarAggregateState *aggregateState)
+{
+	CustomScanState *node = &aggregateState->custom_scanstate;
+	TupleTableSlot *scanSlot = node->ss.ss_ScanTupleSlot;
+
+	if (aggregateState->aggregatesReturned)
+	{
+		return NULL;
+	}
+
+	if (aggregateState->scanDesc == NULL)
+	{
+		ColumnarAggregateBeginScan(aggregateState);
+	}
+
+	TupleTableSlot *rowSlot = aggregateState->rowSlot;
+	ExprContext *rowContext = aggregateState->rowContext;
+
+	while (table_scan_getnextslot(aggregateState->scanDesc, ForwardScanDirection,
+								  rowSlot))
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		ResetExprContext(rowContext);
+		rowContext->ecxt_scantuple = rowSlot;
+
+		if (!ExecQual(aggregateState->qualState, rowContext))
+		{
+			continue;
+		}
+
+		aggregateState->rowCount++;
+
+		for (int aggregateIndex = 0; aggregateIndex < aggregateState->aggregateCount;
+			 aggregateIndex++)
+		{
+			AttrNumber aggregateAttr = aggregateState->aggregateAttrs[aggregateIndex];
+			if (aggregateAttr == InvalidAttrNumber)
+			{
+				continue;
+			}
+
+			bool isNull = false;
+			Datum value = slot_getattr(rowSlot, aggregateAttr, &isNull);
+			if (!isNull)
+			{
+				ColumnarAggregateAccumulate(aggregateState, aggregateIndex, value);
+			}
+		}
+	}
+
+	ExecClearTuple(scanSlot);
+
+	/* Vars of the quals come after the aggregates in the scan tuple */
+	int scanAttrCount = scanSlot->tts_tupleDescriptor->natts;
+	memset(scanSlot->tts_isnull, true, scanAttrCount * sizeof(bool));
+
+	for (int aggregateIndex = 0; aggregateIndex < aggregateState->aggregateCount;
+		 aggregateIndex++)
+	{
+		scanSlot->tts_values[aggregateIndex] =
+			ColumnarAggregateFinalValue(aggregateState, aggregateIndex,
+										&scanSlot->tts_isnull[aggregateIndex]);
+	}
+
+	ExecStoreVirtualTuple(scanSlot);
+
+	aggregateState->aggregatesReturned = true;
+
+	return scanSlot;
+}
+
+
+/*
+ * ColumnarAggregateRecheck -- access method routine to recheck a tuple in
+ * EvalPlanQual
+ */
+static bool
+ColumnarAggregateRecheck(ColumnarAggregateState *node, TupleTableSlot *slot)
+{
+	return true;
+}
+
+
+static TupleTableSlot *
+ColumnarAggregate_ExecCustomScan(CustomScanState *node)
+{
+	return ExecScan(&node->ss,
+					(ExecScanAccessMtd) ColumnarAggregateNext,
+					(ExecScanRecheckMtd) ColumnarAggregateRecheck);
+}
+
+
+static void
+ColumnarAggregate_EndCustomScan(CustomScanState *node)
+{
+	ColumnarAggregateState *aggregateState = (ColumnarAggregateState *) node;
+
+	/*
+	 * Free the exprcontext
+	 */
+	ExecFreeExprContext(&node->ss.ps);
+
+	/*
+	 * clean out the tuple table
+	 */
+	if (node->ss.ps.ps_ResultTupleSlot)
+	{
+		ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	}
+	ExecClearTuple(node->ss.ss_ScanTupleSlot);
+
+	if (aggregateState->scanDesc != NULL)
+	{
+		table_endscan(aggregateState->scanDesc);
+	}
+
+	table_close(aggregateState->relation, NoLock);
+}
+
+
+static void
+ColumnarAggregate_ReScanCustomScan(CustomScanState *node)
+{
+	ColumnarAggregateState *aggregateState = (ColumnarAggregateState *) node;
+
+	ColumnarAggregateReset(aggregateState);
+
+	if (aggregateState->scanDesc != NULL)
+	{
+		ResetExprContext(aggregateState->css_RuntimeContext);
+		List *scanQual = (List *) EvalParamsMutator(
+			(Node *) aggregateState->qual, aggregateState->css_RuntimeContext);
+
+		/* XXX: hack to pass quals as scan keys, see columnar_rescan */
+		table_rescan(aggregateState->scanDesc, (ScanKey) scanQual);
+	}
+}
+
+
+static void
+ColumnarAggregate_ExplainCustomScan(CustomScanState *node, List *ancestors,
+									ExplainState *es)
+{
+	ColumnarAggregateState *aggregateState = (ColumnarAggregateState *) node;
+	CustomScan *cscan = castNode(CustomScan, node->ss.ps.plan);
+
+	ExplainPropertyText("Columnar Table",
+						RelationGetRelationName(aggregateState->relation), es);
+
+	List *chunkGroupFilter = cscan->custom_exprs;
+	if (chunkGroupFilter != NIL)
+	{
+		List *context = set_deparse_context_planstate(
+			es->deparse_cxt, (Node *) &node->ss.ps, ancestors);
+
+		const char *pushdownClausesStr = ColumnarPushdownClausesStr(
+			context, chunkGroupFilter);
+		ExplainPropertyText("Columnar Chunk Group Filters",
+							pushdownClausesStr, es);
+	}
+
+	ColumnarScanDesc columnarScanDesc = (ColumnarScanDesc) aggregateState->scanDesc;
+	if (columnarScanDesc != NULL)
+	{
+		if (chunkGroupFilter != NIL)
+		{
+			ExplainPropertyInteger(
+				"Columnar Chunk Groups Removed by Filter",
+				NULL, ColumnarScanChunkGroupsFiltered(columnarScanDesc), es);
+		}
+
+		ExplainPropertyInteger("Columnar Chunk Groups Answered from Metadata",
+							   NULL, aggregateState->chunkGroupsAnswered, es);
+		ExplainPropertyInteger("Columnar Chunk Groups Aggregated in Batches",
+							   NULL, aggregateState->chunkGroupsBatched, es);
+	}
+}
+
+
 /*
  * ColumnarPushdownClausesStr represents the clauses to push down as a string.
  */
@@ -0,0 +1,933 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_encoding.c
+ *
+ * This file contains lightweight, type-aware encodings for the serialized
+ * value buffers of column chunks:
+ *
+ *   * run-length encoding for fixed-length values with long runs,
+ *   * frame-of-reference bit-packing for fixed-length values in a narrow
+ *     range (e.g. status codes),
+ *   * delta bit-packing for slowly increasing values (e.g. timestamps),
+ *   * dictionary encoding for variable-length values with few distinct
+ *     values (e.g. text labels).
+ *
+ * Encodings are applied before compression and the encoding of each chunk
+ * is recorded in the chunk metadata. Decoding reproduces the serialized
+ * buffer byte by byte, so the rest of the reader is unaware of encodings.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/tupmacs.h"
+#include "common/hashfn.h"
+#include "lib/stringinfo.h"
+#include "port/pg_bitutils.h"
+
+#include "columnar/columnar_encoding.h"
+
+/* header at the start of every encoded buffer */
+typedef struct ColumnarEncodingHeader
+{
+	uint32 valueCount;
+	uint32 decodedSize;
+} ColumnarEncodingHeader;
+
+#define COLUMNAR_ENCODING_HDRSZ ((uint32) sizeof(ColumnarEncodingHeader))
+
+/* dictionary codes are stored as 1 or 2 bytes */
+#define DICTIONARY_MAX_ENTRIES (PG_UINT16_MAX + 1)
+
+static bool IsFixedLengthEncodable(StringInfo buffer, Form_pg_attribute attributeForm);
+static int64 * ReadFixedLengthValues(StringInfo buffer, Form_pg_attribute attributeForm,
+									 uint32 *valueCount);
+static int64 FetchFixedLengthValue(const char *pointer, int length);
+static void StoreFixedLengthValue(char *pointer, int64 value, int length);
+static uint32 RunCount(int64 *values, uint32 valueCount);
+static int BitWidth(uint64 range);
+static uint32 PackedSize(uint32 valueCount, int bitWidth);
+static void AppendHeader(StringInfo buffer, uint32 valueCount, uint32 decodedSize);
+static void AppendPackedBits(StringInfo buffer, uint64 *values, uint32 valueCount,
+							 int bitWidth);
+static void UnpackBits(const char *packedData, uint64 *values, uint32 valueCount,
+					   int bitWidth);
+static void EncodeRunLength(StringInfo outputBuffer, int64 *values, uint32 valueCount,
+							uint32 decodedSize, int length);
+static void EncodeFrameOfReference(StringInfo outputBuffer, int64 *values,
+								   uint32 valueCount, uint32 decodedSize);
+static void EncodeDelta(StringInfo outputBuffer, int64 *values, uint32 valueCount,
+						uint32 decodedSize);
+static bool EncodeDictionary(StringInfo inputBuffer, StringInfo outputBuffer,
+							 Form_pg_attribute attributeForm);
+static StringInfo DecodeFixedLength(StringInfo buffer, ColumnarEncodingType encodingType,
+									Form_pg_attribute attributeForm);
+static StringInfo DecodeDictionary(StringInfo buffer);
+
+
+/*
+ * EncodeBuffer tries to encode the given serialized chunk values with the
+ * lightweight encoding that yields the smallest result for the column type.
+ * If an encoding is smaller than the input, the encoded data is written to
+ * outputBuffer and the chosen encoding is returned. Otherwise, the function
+ * returns ENCODING_NONE and outputBuffer is not valid.
+ */
+ColumnarEncodingType
+EncodeBuffer(StringInfo inputBuffer, StringInfo outputBuffer,
+			 Form_pg_attribute attributeForm)
+{
+	resetStringInfo(outputBuffer);
+
+	if (inputBuffer->len == 0)
+	{
+		return ENCODING_NONE;
+	}
+
+	if (attributeForm->attlen == -1)
+	{
+		bool encoded = EncodeDictionary(inputBuffer, outputBuffer, attributeForm);
+		return encoded ? ENCODING_DICTIONARY : ENCODING_NONE;
+	}
+
+	if (!IsFixedLengthEncodable(inputBuffer, attributeForm))
+	{
+		return ENCODING_NONE;
+	}
+
+	uint32 valueCount = 0;
+	int64 *values = ReadFixedLengthValues(inputBuffer, attributeForm, &valueCount);
+
+	/* compute the size of each encoding to pick the smallest one */
+	uint32 runLengthSize = COLUMNAR_ENCODING_HDRSZ +
+						   RunCount(values, valueCount) *
+						   (sizeof(uint32) + attributeForm->attlen);
+
+	int64 minimumValue = values[0];
+	int64 maximumValue = values[0];
+	int64 minimumDelta = 0;
+	int64 maximumDelta = 0;
+
+	for (uint32 valueIndex = 1; valueIndex < valueCount; valueIndex++)
+	{
+		int64 value = values[valueIndex];
+		int64 delta = (int64) ((uint64) value - (uint64) values[valueIndex - 1]);
+
+		minimumValue = Min(minimumValue, value);
+		maximumValue = Max(maximumValue, value);
+
+		if (valueIndex == 1)
+		{
+			minimumDelta = delta;
+			maximumDelta = delta;
+		}
+		else
+		{
+			minimumDelta = Min(minimumDelta, delta);
+			maximumDelta = Max(maximumDelta, delta);
+		}
+	}
+
+	int valueBitWidth = BitWidth((uint64) maximumValue - (uint64) minimumValue);
+	uint32 frameOfReferenceSize = COLUMNAR_ENCODING_HDRSZ + sizeof(int64) +
+								  sizeof(uint8) +
+								  PackedSize(valueCount, valueBitWidth);
+
+	int deltaBitWidth = BitWidth((uint64) maximumDelta - (uint64) minimumDelta);
+	uint32 deltaSize = COLUMNAR_ENCODING_HDRSZ + 2 * sizeof(int64) + sizeof(uint8) +
+					   PackedSize(valueCount - 1, deltaBitWidth);
+
+	ColumnarEncodingType encodingType = ENCODING_NONE;
+	uint32 encodedSize = inputBuffer->len;
+
+	if (runLengthSize < encodedSize)
+	{
+		encodingType = ENCODING_RLE;
+		encodedSize = runLengthSize;
+	}
+
+	if (frameOfReferenceSize < encodedSize)
+	{
+		encodingType = ENCODING_FOR;
+		encodedSize = frameOfReferenceSize;
+	}
+
+	if (deltaSize < encodedSize)
+	{
+		encodingType = ENCODING_DELTA;
+		encodedSize = deltaSize;
+	}
+
+	switch (encodingType)
+	{
+		case ENCODING_RLE:
+		{
+			EncodeRunLength(outputBuffer, values, valueCount, inputBuffer->len,
+							attributeForm->attlen);
+			break;
+		}
+
+		case ENCODING_FOR:
+		{
+			EncodeFrameOfReference(outputBuffer, values, valueCount, inputBuffer->len);
+			break;
+		}
+
+		case ENCODING_DELTA:
+		{
+			EncodeDelta(outputBuffer, values, valueCount, inputBuffer->len);
+			break;
+		}
+
+		default:
+		{
+			break;
+		}
+	}
+
+	Assert(encodingType == ENCODING_NONE || outputBuffer->len == encodedSize);
+
+	pfree(values);
+
+	return encodingType;
+}
+
+
+/*
+ * DecodeBuffer decodes the given encoded buffer and returns the serialized
+ * chunk values it was built from.
+ */
+StringInfo
+DecodeBuffer(StringInfo buffer, ColumnarEncodingType encodingType,
+			 Form_pg_attribute attributeForm)
+{
+	switch (encodingType)
+	{
+		case ENCODING_NONE:
+		{
+			return buffer;
+		}
+
+		case ENCODING_RLE:
+		case ENCODING_FOR:
+		case ENCODING_DELTA:
+		{
+			return DecodeFixedLength(buffer, encodingType, attributeForm);
+		}
+
+		case ENCODING_DICTIONARY:
+		{
+			return DecodeDictionary(buffer);
+		}
+
+		default:
+		{
+			ereport(ERROR, (errmsg("unexpected encoding type: %d", encodingType)));
+		}
+	}
+
+	return NULL;
+}
+
+
+/*
+ * IsFixedLengthEncodable returns true if the serialized values in the given
+ * buffer are pass-by-value integers of a size we can encode, laid out
+ * without gaps other than the alignment padding.
+ */
+static bool
+IsFixedLengthEncodable(StringInfo buffer, Form_pg_attribute attributeForm)
+{
+	int length = attributeForm->attlen;
+
+	if (!attributeForm->attbyval ||
+		(length != 1 && length != 2 && length != 4 && length != 8))
+	{
+		return false;
+	}
+
+	uint32 stride = att_align_nominal(length, attributeForm->attalign);
+
+	return buffer->len % stride == 0;
+}
+
+
+/*
+ * ReadFixedLengthValues reads the serialized pass-by-value values in the
+ * given buffer as int64's.
+ */
+static int64 *
+ReadFixedLengthValues(StringInfo buffer, Form_pg_attribute attributeForm,
+					  uint32 *valueCount)
+{
+	uint32 stride = att_align_nominal(attributeForm->attlen, attributeForm->attalign);
+	uint32 count = buffer->len / stride;
+	int64 *values = palloc(count * sizeof(int64));
+
+	for (uint32 valueIndex = 0; valueIndex < count; valueIndex++)
+	{
+		values[valueIndex] = FetchFixedLengthValue(buffer->data + valueIndex * stride,
+												   attributeForm->attlen);
+	}
+
+	*valueCount = count;
+	return values;
+}
+
+
+/*
+ * FetchFixedLengthValue reads a signed integer of given length.
+ */
+static int64
+FetchFixedLengthValue(const char *pointer, int length)
+{
+	switch (length)
+	{
+		case 1:
+		{
+			return *((int8 *) pointer);
+		}
+
+		case 2:
+		{
+			int16 value = 0;
+			memcpy(&value, pointer, sizeof(int16));
+			return value;
+		}
+
+		case 4:
+		{
+			int32 value = 0;
+			memcpy(&value, pointer, sizeof(int32));
+			return value;
+		}
+
+		default:
+		{
+			int64 value = 0;
+			memcpy(&value, pointer, sizeof(int64));
+			return value;
+		}
+	}
+}
+
+
+/*
+ * StoreFixedLengthValue writes the given value as an integer of given length.
+ */
+static void
+StoreFixedLengthValue(char *pointer, int64 value, int length)
+{
+	switch (length)
+	{
+		case 1:
+		{
+			*((int8 *) pointer) = (int8) value;
+			break;
+		}
+
+		case 2:
+		{
+			int16 shortValue = (int16) value;
+			memcpy(pointer, &shortValue, sizeof(int16));
+			break;
+		}
+
+		case 4:
+		{
+			int32 intValue = (int32) value;
+			memcpy(pointer, &intValue, sizeof(int32));
+			break;
+		}
+
+		default:
+		{
+			memcpy(pointer, &value, sizeof(int64));
+			break;
+		}
+	}
+}
+
+
+/*
+ * RunCount returns the number of runs of equal values in the given array.
+ */
+static uint32
+RunCount(int64 *values, uint32 valueCount)
+{
+	uint32 runCount = (valueCount > 0) ? 1 : 0;
+
+	for (uint32 valueIndex = 1; valueIndex < valueCount; valueIndex++)
+	{
+		if (values[valueIndex] != values[valueIndex - 1])
+		{
+			runCount++;
+		}
+	}
+
+	return runCount;
+}
+
+
+/*
+ * BitWidth returns the number of bits needed to represent values in
+ * [0, range].
+ */
+static int
+BitWidth(uint64 range)
+{
+	if (range == 0)
+	{
+		return 0;
+	}
+
+	return pg_leftmost_one_pos64(range) + 1;
+}
+
+
+/*
+ * PackedSize returns the number of bytes needed to bit-pack valueCount values
+ * of bitWidth bits each.
+ */
+static uint32
+PackedSize(uint32 valueCount, int bitWidth)
+{
+	return (uint32) (((uint64) valueCount * bitWidth + 7) / 8);
+}
+
+
+/*
+ * AppendHeader appends the header of an encoded buffer.
+ */
+static void
+AppendHeader(StringInfo buffer, uint32 valueCount, uint32 decodedSize)
+{
+	ColumnarEncodingHeader header = {
+		.valueCount = valueCount,
+		.decodedSize = decodedSize
+	};
+
+	appendBinaryStringInfo(buffer, (char *) &header, sizeof(header));
+}
+
+
+/*
+ * AppendPackedBits appends the lowest bitWidth bits of each of the given
+ * values to the buffer, packed without any padding between values.
+ */
+static void
+AppendPackedBits(StringInfo buffer, uint64 *values, uint32 valueCount, int bitWidth)
+{
+	uint32 packedSize = PackedSize(valueCount, bitWidth);
+
+	enlargeStringInfo(buffer, packedSize);
+
+	uint8 *packedData = (uint8 *) (buffer->data + buffer->len);
+	memset(packedData, 0, packedSize);
+
+	uint64 byteIndex = 0;
+	int bitOffset = 0;
+
+	for (uint32 valueIndex = 0; valueIndex < valueCount; valueIndex++)
+	{
+		uint64 value = values[valueIndex];
+		int remainingBits = bitWidth;
+
+		while (remainingBits > 0)
+		{
+			int bitCount = Min(8 - bitOffset, remainingBits);
+			uint8 mask = (uint8) ((1 << bitCount) - 1);
+
+			packedData[byteIndex] |= (uint8) ((value & mask) << bitOffset);
+
+			value >>= bitCount;
+			remainingBits -= bitCount;
+			bitOffset += bitCount;
+
+			if (bitOffset == 8)
+			{
+				byteIndex++;
+				bitOffset = 0;
+			}
+		}
+	}
+
+	buffer->len += packedSize;
+}
+
+
+/*
+ * UnpackBits reverses AppendPackedBits.
+ */
+static void
+UnpackBits(const char *packedData, uint64 *values, uint32 valueCount, int bitWidth)
+{
+	const uint8 *packedBytes = (const uint8 *) packedData;
+	uint64 byteIndex = 0;
+	int bitOffset = 0;
+
+	for (uint32 valueIndex = 0; valueIndex < valueCount; valueIndex++)
+	{
+		uint64 value = 0;
+		int valueBitOffset = 0;
+
+		while (valueBitOffset < bitWidth)
+		{
+			int bitCount = Min(8 - bitOffset, bitWidth - valueBitOffset);
+			uint8 mask = (uint8) ((1 << bitCount) - 1);
+			uint64 bits = (packedBytes[byteIndex] >> bitOffset) & mask;
+
+			value |= bits << valueBitOffset;
+
+			valueBitOffset += bitCount;
+			bitOffset += bitCount;
+
+			if (bitOffset == 8)
+			{
+				byteIndex++;
+				bitOffset = 0;
+			}
+		}
+
+		values[valueIndex] = value;
+	}
+}
+
+
+/*
+ * EncodeRunLength writes the given values as (run length, value) pairs.
+ */
+static void
+EncodeRunLength(StringInfo outputBuffer, int64 *values, uint32 valueCount,
+				uint32 decodedSize, int length)
+{
+	char valueData[sizeof(int64)];
+
+	AppendHeader(outputBuffer, valueCount, decodedSize);
+
+	uint32 runStart = 0;
+	for (uint32 valueIndex = 1; valueIndex <= valueCount; valueIndex++)
+	{
+		if (valueIndex < valueCount && values[valueIndex] == values[runStart])
+		{
+			continue;
+		}
+
+		uint32 runLength = valueIndex - runStart;
+		appendBinaryStringInfo(outputBuffer, (char *) &runLength, sizeof(uint32));
+
+		StoreFixedLengthValue(valueData, values[runStart], length);
+		appendBinaryStringInfo(outputBuffer, valueData, length);
+
+		runStart = valueIndex;
+	}
+}
+
+
+/*
+ * EncodeFrameOfReference writes the minimum of the given values followed by
+ * the bit-packed offsets of all values from the minimum.
+ */
+static void
+EncodeFrameOfReference(StringInfo outputBuffer, int64 *values, uint32 valueCount,
+					   uint32 decodedSize)
+{
+	int64 minimumValue = values[0];
+	int64 maximumValue = values[0];
+
+	for (uint32 valueIndex = 1; valueIndex < valueCount; valueIndex++)
+	{
+		minimumValue = Min(minimumValue, values[valueIndex]);
+		maximumValue = Max(maximumValue, values[valueIndex]);
+	}
+
+	uint8 bitWidth = BitWidth((uint64) maximumValue - (uint64) minimumValue);
+	uint64 *offsets = palloc(valueCount * sizeof(uint64));
+
+	for (uint32 valueIndex = 0; valueIndex < valueCount; valueIndex++)
+	{
+		offsets[valueIndex] = (uint64) values[valueIndex] - (uint64) minimumValue;
+	}
+
+	AppendHeader(outputBuffer, valueCount, decodedSize);
+	appendBinaryStringInfo(outputBuffer, (char *) &minimumValue, sizeof(int64));
+	appendBinaryStringInfo(outputBuffer, (char *) &bitWidth, sizeof(uint8));
+	AppendPackedBits(outputBuffer, offsets, valueCount, bitWidth);
+
+	pfree(offsets);
+}
+
+
+/*
+ * EncodeDelta writes the first of the given values, followed by the
+ * frame-of-reference encoded differences between consecutive values.
+ */
+static void
+EncodeDelta(StringInfo outputBuffer, int64 *values, uint32 valueCount,
+			uint32 decodedSize)
+{
+	uint32 deltaCount = valueCount - 1;
+	int64 *deltas = palloc((deltaCount + 1) * sizeof(int64));
+	int64 minimumDelta = 0;
+	int64 maximumDelta = 0;
+
+	for (uint32 deltaIndex = 0; deltaIndex < deltaCount; deltaIndex++)
+	{
+		deltas[deltaIndex] = (int64) ((uint64) values[deltaIndex + 1] -
+									  (uint64) values[deltaIndex]);
+
+		if (deltaIndex == 0)
+		{
+			minimumDelta = deltas[deltaIndex];
+			maximumDelta = deltas[deltaIndex];
+		}
+		else
+		{
+			minimumDelta = Min(minimumDelta, deltas[deltaIndex]);
+			maximumDelta = Max(maximumDelta, deltas[deltaIndex]);
+		}
+	}
+
+	uint8 bitWidth = BitWidth((uint64) maximumDelta - (uint64) minimumDelta);
+	uint64 *offsets = palloc((deltaCount + 1) * sizeof(uint64));
+
+	for (uint32 deltaIndex = 0; deltaIndex < deltaCount; deltaIndex++)
+	{
+		offsets[deltaIndex] = (uint64) deltas[deltaIndex] - (uint64) minimumDelta;
+	}
+
+	AppendHeader(outputBuffer, valueCount, decodedSize);
+	appendBinaryStringInfo(outputBuffer, (char *) &values[0], sizeof(int64));
+	appendBinaryStringInfo(outputBuffer, (char *) &minimumDelta, sizeof(int64));
+	appendBinaryStringInfo(outputBuffer, (char *) &bitWidth, sizeof(uint8));
+	AppendPackedBits(outputBuffer, offsets, deltaCount, bitWidth);
+
+	pfree(offsets);
+	pfree(deltas);
+}
+
+
+/*
+ * EncodeDictionary encodes the given serialized variable-length values as a
+ * dictionary of distinct values followed by one code per value. Returns false
+ * if there are too many distinct values for the dictionary to pay off.
+ *
+ * The dictionary entries keep the alignment padding of the serialized values,
+ * so concatenating the entries of the codes reproduces the input buffer.
+ */
+static bool
+EncodeDictionary(StringInfo inputBuffer, StringInfo outputBuffer,
+				 Form_pg_attribute attributeForm)
+{
+	/* each serialized value takes at least one byte */
+	uint32 maximumValueCount = inputBuffer->len;
+	uint32 *codes = palloc(maximumValueCount * sizeof(uint32));
+	uint32 valueCount = 0;
+
+	/* open addressing hash table from value hash to dictionary entry */
+	uint32 slotCount = 16;
+	while (slotCount < 2 * Min(maximumValueCount, DICTIONARY_MAX_ENTRIES))
+	{
+		slotCount *= 2;
+	}
+
+	int32 *slots = palloc(slotCount * sizeof(int32));
+	memset(slots, -1, slotCount * sizeof(int32));
+
+	uint32 *entryOffsets = palloc(DICTIONARY_MAX_ENTRIES * sizeof(uint32));
+	uint32 *entryLengths = palloc(DICTIONARY_MAX_ENTRIES * sizeof(uint32));
+	uint32 entryCount = 0;
+	uint32 entryDataSize = 0;
+	bool encodable = true;
+
+	uint32 offset = 0;
+	while (offset < inputBuffer->len)
+	{
+		char *valuePointer = inputBuffer->data + offset;
+		uint32 valueLength = att_addlength_pointer(0, attributeForm->attlen,
+												   valuePointer);
+		valueLength = att_align_nominal(valueLength, attributeForm->attalign);
+
+		if (offset + valueLength > inputBuffer->len)
+		{
+			ereport(ERROR, (errmsg("insufficient data left in datum buffer")));
+		}
+
+		uint32 slot = hash_bytes((unsigned char *) valuePointer, valueLength) &
+					  (slotCount - 1);
+		int32 entryIndex = -1;
+
+		while (slots[slot] != -1)
+		{
+			int32 candidate = slots[slot];
+			if (entryLengths[candidate] == valueLength &&
+				memcmp(inputBuffer->data + entryOffsets[candidate], valuePointer,
+					   valueLength) == 0)
+			{
+				entryIndex = candidate;
+				break;
+			}
+
+			slot = (slot + 1) & (slotCount - 1);
+		}
+
+		if (entryIndex == -1)
+		{
+			if (entryCount == DICTIONARY_MAX_ENTRIES ||
+				entryDataSize + valueLength >= inputBuffer->len / 2)
+			{
+				/* dictionary would be too large to pay off */
+				encodable = false;
+				break;
+			}
+
+			entryIndex = entryCount++;
+			entryOffsets[entryIndex] = offset;
+			entryLengths[entryIndex] = valueLength;
+			entryDataSize += valueLength;
+			slots[slot] = entryIndex;
+		}
+
+		codes[valueCount++] = entryIndex;
+		offset += valueLength;
+	}
+
+	uint32 codeWidth = (entryCount <= PG_UINT8_MAX + 1) ? 1 : 2;
+	uint32 encodedSize = COLUMNAR_ENCODING_HDRSZ + 2 * sizeof(uint32) +
+						 entryCount * sizeof(uint32) + entryDataSize +
+						 valueCount * codeWidth;
+
+	if (encodable && encodedSize < inputBuffer->len)
+	{
+		AppendHeader(outputBuffer, valueCount, inputBuffer->len);
+		appendBinaryStringInfo(outputBuffer, (char *) &entryCount, sizeof(uint32));
+		appendBinaryStringInfo(outputBuffer, (char *) &codeWidth, sizeof(uint32));
+
+		/* end offsets of the entries within the entry data */
+		uint32 entryEnd = 0;
+		for (uint32 entryIndex = 0; entryIndex < entryCount; entryIndex++)
+		{
+			entryEnd += entryLengths[entryIndex];
+			appendBinaryStringInfo(outputBuffer, (char *) &entryEnd, sizeof(uint32));
+		}
+
+		for (uint32 entryIndex = 0; entryIndex < entryCount; entryIndex++)
+		{
+			appendBinaryStringInfo(outputBuffer,
+								   inputBuffer->data + entryOffsets[entryIndex],
+								   entryLengths[entryIndex]);
+		}
+
+		for (uint32 valueIndex = 0; valueIndex < valueCount; valueIndex++)
+		{
+			if (codeWidth == 1)
+			{
+				uint8 code = (uint8) codes[valueIndex];
+				appendBinaryStringInfo(outputBuffer, (char *) &code, sizeof(uint8));
+			}
+			else
+			{
+				uint16 code = (uint16) codes[valueIndex];
+				appendBinaryStringInfo(outputBuffer, (char *) &code, sizeof(uint16));
+			}
+		}
+
+		Assert(outputBuffer->len == encodedSize);
+	}
+	else
+	{
+		encodable = false;
+	}
+
+	pfree(codes);
+	pfree(slots);
+	pfree(entryOffsets);
+	pfree(entryLengths);
+
+	return encodable;
+}
+
+
+/*
+ * DecodeFixedLength decodes a run-length, frame-of-reference or delta
+ * encoded buffer of pass-by-value values.
+ */
+static StringInfo
+DecodeFixedLength(StringInfo buffer, ColumnarEncodingType encodingType,
+				  Form_pg_attribute attributeForm)
+{
+	ColumnarEncodingHeader header;
+	memcpy(&header, buffer->data, sizeof(header));
+
+	int length = attributeForm->attlen;
+	uint32 stride = att_align_nominal(length, attributeForm->attalign);
+	uint32 valueCount = header.valueCount;
+	const char *encodedData = buffer->data + COLUMNAR_ENCODING_HDRSZ;
+
+	if ((uint64) valueCount * stride != header.decodedSize)
+	{
+		ereport(ERROR, (errmsg("cannot decode column chunk"),
+						errdetail("Expected %u bytes, but got %u values of %u "
+								  "bytes.", header.decodedSize, valueCount,
+								  stride)));
+	}
+
+	StringInfo decodedBuffer = makeStringInfo();
+	enlargeStringInfo(decodedBuffer, header.decodedSize);
+	memset(decodedBuffer->data, 0, header.decodedSize);
+	decodedBuffer->len = header.decodedSize;
+
+	switch (encodingType)
+	{
+		case ENCODING_RLE:
+		{
+			uint32 valueIndex = 0;
+			while (valueIndex < valueCount)
+			{
+				uint32 runLength = 0;
+				memcpy(&runLength, encodedData, sizeof(uint32));
+				int64 value = FetchFixedLengthValue(encodedData + sizeof(uint32), length);
+				encodedData += sizeof(uint32) + length;
+
+				if (runLength == 0 || runLength > valueCount - valueIndex)
+				{
+					ereport(ERROR, (errmsg("cannot decode column chunk"),
+									errdetail("Invalid run length: %u", runLength)));
+				}
+
+				for (uint32 runIndex = 0; runIndex < runLength; runIndex++)
+				{
+					StoreFixedLengthValue(decodedBuffer->data + valueIndex * stride,
+										  value, length);
+					valueIndex++;
+				}
+			}
+
+			break;
+		}
+
+		case ENCODING_FOR:
+		{
+			int64 minimumValue = 0;
+			memcpy(&minimumValue, encodedData, sizeof(int64));
+			uint8 bitWidth = *((uint8 *) (encodedData + sizeof(int64)));
+			encodedData += sizeof(int64) + sizeof(uint8);
+
+			uint64 *offsets = palloc(valueCount * sizeof(uint64));
+			UnpackBits(encodedData, offsets, valueCount, bitWidth);
+
+			for (uint32 valueIndex = 0; valueIndex < valueCount; valueIndex++)
+			{
+				int64 value = (int64) ((uint64) minimumValue + offsets[valueIndex]);
+				StoreFixedLengthValue(decodedBuffer->data + valueIndex * stride,
+									  value, length);
+			}
+
+			pfree(offsets);
+			break;
+		}
+
+		case ENCODING_DELTA:
+		{
+			int64 value = 0;
+			int64 minimumDelta = 0;
+			memcpy(&value, encodedData, sizeof(int64));
+			memcpy(&minimumDelta, encodedData + sizeof(int64), sizeof(int64));
+			uint8 bitWidth = *((uint8 *) (encodedData + 2 * sizeof(int64)));
+			encodedData += 2 * sizeof(int64) + sizeof(uint8);
+
+			uint32 deltaCount = (valueCount > 0) ? valueCount - 1 : 0;
+			uint64 *offsets = palloc((deltaCount + 1) * sizeof(uint64));
+			UnpackBits(encodedData, offsets, deltaCount, bitWidth);
+
+			for (uint32 valueIndex = 0; valueIndex < valueCount; valueIndex++)
+			{
+				if (valueIndex > 0)
+				{
+					uint64 delta = (uint64) minimumDelta + offsets[valueIndex - 1];
+					value = (int64) ((uint64) value + delta);
+				}
+
+				StoreFixedLengthValue(decodedBuffer->data + valueIndex * stride,
+									  value, length);
+			}
+
+			pfree(offsets);
+			break;
+		}
+
+		default:
+		{
+			ereport(ERROR, (errmsg("unexpected encoding type: %d", encodingType)));
+		}
+	}
+
+	return decodedBuffer;
+}
+
+
+/*
+ * DecodeDictionary decodes a dictionary encoded buffer.
+ */
+static StringInfo
+DecodeDictionary(StringInfo buffer)
+{
+	ColumnarEncodingHeader header;
+	memcpy(&header, buffer->data, sizeof(header));
+
+	const char *encodedData = buffer->data + COLUMNAR_ENCODING_HDRSZ;
+	uint32 entryCount = 0;
+	uint32 codeWidth = 0;
+
+	memcpy(&entryCount, encodedData, sizeof(uint32));
+	memcpy(&codeWidth, encodedData + sizeof(uint32), sizeof(uint32));
+	encodedData += 2 * sizeof(uint32);
+
+	uint32 *entryEnds = palloc((entryCount + 1) * sizeof(uint32));
+	memcpy(entryEnds, encodedData, entryCount * sizeof(uint32));
+	encodedData += entryCount * sizeof(uint32);
+
+	const char *entryData = encodedData;
+	uint32 entryDataSize = (entryCount > 0) ? entryEnds[entryCount - 1] : 0;
+	const char *codeData = entryData + entryDataSize;
+
+	StringInfo decodedBuffer = makeStringInfo();
+	enlargeStringInfo(decodedBuffer, header.decodedSize);
+
+	for (uint32 valueIndex = 0; valueIndex < header.valueCount; valueIndex++)
+	{
+		uint32 code = 0;
+		if (codeWidth == 1)
+		{
+			code = *((uint8 *) (codeData + valueIndex));
+		}
+		else
+		{
+			uint16 shortCode = 0;
+			memcpy(&shortCode, codeData + valueIndex * sizeof(uint16), sizeof(uint16));
+			code = shortCode;
+		}
+
+		if (code >= entryCount)
+		{
+			ereport(ERROR, (errmsg("cannot decode column chunk"),
+							errdetail("Invalid dictionary code: %u", code)));
+		}
+
+		uint32 entryStart = (code == 0) ? 0 : entryEnds[code - 1];
+		appendBinaryStringInfo(decodedBuffer, entryData + entryStart,
+							   entryEnds[code] - entryStart);
+	}
+
+	if (decodedBuffer->len != header.decodedSize)
+	{
+		ereport(ERROR, (errmsg("cannot decode column chunk"),
+						errdetail("Expected %u bytes, but decoded %d bytes.",
+								  header.decodedSize, decodedBuffer->len)));
+	}
+
+	pfree(entryEnds);
+
+	return decodedBuffer;
+}
@@ -47,11 +47,13 @@
 #include "miscadmin.h"
 #include "nodes/execnodes.h"
 #include "lib/stringinfo.h"
+#include "parser/parse_oper.h"
 #include "port.h"
 #include "storage/fd.h"
 #include "storage/lmgr.h"
 #include "storage/procarray.h"
 #include "storage/smgr.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
 #include "utils/memutils.h"
@@ -114,6 +116,11 @@ static void DeleteStorageFromColumnarMetadataTable(Oid metadataTableId,
 												   AttrNumber storageIdAtrrNumber,
 												   Oid storageIdIndexId,
 												   uint64 storageId);
+static void DeleteStripeFromColumnarMetadataTable(Oid metadataTableId,
+												  AttrNumber storageIdAtrrNumber,
+												  AttrNumber stripeIdAttrNumber,
+												  Oid stripeIdIndexId,
+												  uint64 storageId, uint64 stripeId);
 static ModifyState * StartModifyRelation(Relation rel);
 static void InsertTupleAndEnforceConstraints(ModifyState *state, Datum *values,
 											 bool *nulls);
@@ -122,6 +129,12 @@ static void FinishModifyRelation(ModifyState *state);
 static EState * create_estate_for_relation(Relation rel);
 static bytea * DatumToBytea(Datum value, Form_pg_attribute attrForm);
 static Datum ByteaToDatum(bytea *bytes, Form_pg_attribute attrForm);
+static bytea * DistinctValuesToBytea(Datum *values, uint32 valueCount,
+									 Form_pg_attribute attrForm);
+static Datum * ByteaToDistinctValues(Datum byteaDatum, Form_pg_attribute attrForm,
+									 uint32 *valueCount);
+static void CheckColumnarOptionColumnNames(Relation rel, const char *columnNames);
+static void CheckColumnarSortKey(Relation rel, const char *sortKey);
 static bool WriteColumnarOptions(Oid regclass, ColumnarOptions *options, bool overwrite);
 static StripeMetadata * StripeMetadataLookupRowNumber(Relation relation, uint64 rowNumber,
 													  Snapshot snapshot,
@@ -131,12 +144,14 @@ static void CheckStripeMetadataConsistency(StripeMetadata *stripeMetadata);
 PG_FUNCTION_INFO_V1(columnar_relation_storageid);
 
 /* constants for columnar.options */
-#define Natts_columnar_options 5
+#define Natts_columnar_options 7
 #define Anum_columnar_options_regclass 1
 #define Anum_columnar_options_chunk_group_row_limit 2
 #define Anum_columnar_options_stripe_row_limit 3
 #define Anum_columnar_options_compression_level 4
 #define Anum_columnar_options_compression 5
+#define Anum_columnar_options_bloom_filter_columns 6
+#define Anum_columnar_options_sort_key 7
 
 /* ----------------
  *		columnar.options definition.
@@ -151,6 +166,8 @@ typedef struct FormData_columnar_options
 	NameData compression;
 
 #ifdef CATALOG_VARLEN           /* variable-length fields start here */
+	text bloom_filter_columns;
+	text sort_key;
 #endif
 } FormData_columnar_options;
 typedef FormData_columnar_options *Form_columnar_options;
@@ -176,7 +193,7 @@ typedef FormData_columnar_options *Form_columnar_options;
 #define Anum_columnar_chunkgroup_row_count 4
 
 /* constants for columnar.chunk */
-#define Natts_columnar_chunk 14
+#define Natts_columnar_chunk 17
 #define Anum_columnar_chunk_storageid 1
 #define Anum_columnar_chunk_stripe 2
 #define Anum_columnar_chunk_attr 3
@@ -191,6 +208,9 @@ typedef FormData_columnar_options *Form_columnar_options;
 #define Anum_columnar_chunk_value_compression_level 12
 #define Anum_columnar_chunk_value_decompressed_size 13
 #define Anum_columnar_chunk_value_count 14
+#define Anum_columnar_chunk_bloom_filter 15
+#define Anum_columnar_chunk_distinct_values 16
+#define Anum_columnar_chunk_value_encoding_type 17
 
 
 /*
@@ -213,7 +233,9 @@ InitColumnarOptions(Oid regclass)
 		.chunkRowCount = columnar_chunk_group_row_limit,
 		.stripeRowCount = columnar_stripe_row_limit,
 		.compressionType = columnar_compression,
-		.compressionLevel = columnar_compression_level
+		.compressionLevel = columnar_compression_level,
+		.bloomFilterColumns = NULL,
+		.sortKey = NULL
 	};
 
 	WriteColumnarOptions(regclass, &defaultOptions, false);
@@ -281,6 +303,27 @@ ParseColumnarRelOptions(List *reloptions, ColumnarOptions *options)
 									   quote_identifier(defGetString(elem)))));
 			}
 		}
+		else if (strcmp(elem->defname, "bloom_filter_columns") == 0)
+		{
+			options->bloomFilterColumns = (elem->arg == NULL) ?
+										  NULL : defGetString(elem);
+
+			/* validate the list syntax, an empty list resets the option */
+			if (ColumnarOptionColumnNameList(options->bloomFilterColumns) == NIL)
+			{
+				options->bloomFilterColumns = NULL;
+			}
+		}
+		else if (strcmp(elem->defname, "sort_key") == 0)
+		{
+			options->sortKey = (elem->arg == NULL) ? NULL : defGetString(elem);
+
+			/* validate the list syntax, an empty list resets the option */
+			if (ColumnarOptionColumnNameList(options->sortKey) == NIL)
+			{
+				options->sortKey = NULL;
+			}
+		}
 		else if (strcmp(elem->defname, "compression_level") == 0)
 		{
 			options->compressionLevel = (elem->arg == NULL) ?
@@ -353,21 +396,95 @@ SetColumnarRelOptions(RangeVar *rv, List *reloptions)
 
 	Relation rel = relation_openrv(rv, AccessShareLock);
 	Oid relid = RelationGetRelid(rel);
-	relation_close(rel, NoLock);
 
 	/* get existing or default options */
 	if (!ReadColumnarOptions(relid, &options))
 	{
+		relation_close(rel, NoLock);
+
 		/* if extension doesn't exist, just return */
 		return;
 	}
 
 	ParseColumnarRelOptions(reloptions, &options);
+	CheckColumnarOptionColumnNames(rel, options.bloomFilterColumns);
+	CheckColumnarOptionColumnNames(rel, options.sortKey);
+	CheckColumnarSortKey(rel, options.sortKey);
+
+	relation_close(rel, NoLock);
 
 	SetColumnarOptions(relid, &options);
 }
 
 
+/*
+ * CheckColumnarOptionColumnNames errors out if the given comma separated list
+ * of column names refers to a column that does not exist in the relation.
+ */
+static void
+CheckColumnarOptionColumnNames(Relation rel, const char *columnNames)
+{
+	List *columnNameList = ColumnarOptionColumnNameList(columnNames);
+
+	char *columnName = NULL;
+	foreach_ptr(columnName, columnNameList)
+	{
+		AttrNumber attrNumber = get_attnum(RelationGetRelid(rel), columnName);
+		if (attrNumber == InvalidAttrNumber)
+		{
+			ereport(ERROR, (errcode(ERRCODE_UNDEFINED_COLUMN),
+							errmsg("column \"%s\" of relation \"%s\" does not exist",
+								   columnName, RelationGetRelationName(rel))));
+		}
+	}
+}
+
+
+/*
+ * CheckColumnarSortKey errors out if a column in the given sort key cannot be
+ * ordered, or if the relation has indexes. Sorting a stripe moves its rows
+ * after their row numbers were handed out, which would leave index entries
+ * pointing to the wrong rows.
+ */
+static void
+CheckColumnarSortKey(Relation rel, const char *sortKey)
+{
+	List *columnNameList = ColumnarOptionColumnNameList(sortKey);
+	if (columnNameList == NIL)
+	{
+		return;
+	}
+
+	if (RelationGetIndexList(rel) != NIL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("cannot set sort_key on columnar table %s because "
+							   "it has indexes", RelationGetRelationName(rel))));
+	}
+
+	char *columnName = NULL;
+	foreach_ptr(columnName, columnNameList)
+	{
+		AttrNumber attrNumber = get_attnum(RelationGetRelid(rel), columnName);
+		Form_pg_attribute attributeForm =
+			TupleDescAttr(RelationGetDescr(rel), attrNumber - 1);
+
+		Oid sortOperator = InvalidOid;
+		get_sort_group_operators(attributeForm->atttypid, false, false, false,
+								 &sortOperator, NULL, NULL, NULL);
+		if (!OidIsValid(sortOperator))
+		{
+			ereport(ERROR, (errcode(ERRCODE_UNDEFINED_FUNCTION),
+							errmsg("column \"%s\" of relation \"%s\" cannot be used "
+								   "in sort_key", columnName,
+								   RelationGetRelationName(rel)),
+							errdetail("Type %s has no default btree operator class.",
+									  format_type_be(attributeForm->atttypid))));
+		}
+	}
+}
+
+
 /*
  * SetColumnarOptions writes the passed table options as the authoritive options to the
  * table irregardless of the optiones already existing or not. This can be used to put a
@@ -412,6 +529,26 @@ WriteColumnarOptions(Oid regclass, ColumnarOptions *options, bool overwrite)
 	namestrcpy(&compressionName, CompressionTypeStr(options->compressionType));
 	values[Anum_columnar_options_compression - 1] = NameGetDatum(&compressionName);
 
+	if (options->bloomFilterColumns != NULL)
+	{
+		values[Anum_columnar_options_bloom_filter_columns - 1] =
+			CStringGetTextDatum(options->bloomFilterColumns);
+	}
+	else
+	{
+		nulls[Anum_columnar_options_bloom_filter_columns - 1] = true;
+	}
+
+	if (options->sortKey != NULL)
+	{
+		values[Anum_columnar_options_sort_key - 1] =
+			CStringGetTextDatum(options->sortKey);
+	}
+	else
+	{
+		nulls[Anum_columnar_options_sort_key - 1] = true;
+	}
+
 	/* create heap tuple and insert into catalog table */
 	Relation columnarOptions = relation_open(ColumnarOptionsRelationId(),
 											 RowExclusiveLock);
@@ -439,6 +576,8 @@ WriteColumnarOptions(Oid regclass, ColumnarOptions *options, bool overwrite)
 			update[Anum_columnar_options_stripe_row_limit - 1] = true;
 			update[Anum_columnar_options_compression_level - 1] = true;
 			update[Anum_columnar_options_compression - 1] = true;
+			update[Anum_columnar_options_bloom_filter_columns - 1] = true;
+			update[Anum_columnar_options_sort_key - 1] = true;
 
 			HeapTuple tuple = heap_modify_tuple(heapTuple, tupleDescriptor,
 												values, nulls, update);
@@ -564,6 +703,17 @@ ReadColumnarOptions(Oid regclass, ColumnarOptions *options)
 		options->stripeRowCount = tupOptions->stripe_row_limit;
 		options->compressionLevel = tupOptions->compressionLevel;
 		options->compressionType = ParseCompressionType(NameStr(tupOptions->compression));
+
+		bool isNull = false;
+		Datum bloomFilterColumns =
+			heap_getattr(heapTuple, Anum_columnar_options_bloom_filter_columns,
+						 RelationGetDescr(columnarOptions), &isNull);
+		options->bloomFilterColumns =
+			isNull ? NULL : TextDatumGetCString(bloomFilterColumns);
+
+		Datum sortKey = heap_getattr(heapTuple, Anum_columnar_options_sort_key,
+									 RelationGetDescr(columnarOptions), &isNull);
+		options->sortKey = isNull ? NULL : TextDatumGetCString(sortKey);
 	}
 	else
 	{
@@ -572,6 +722,8 @@ ReadColumnarOptions(Oid regclass, ColumnarOptions *options)
 		options->stripeRowCount = columnar_stripe_row_limit;
 		options->chunkRowCount = columnar_chunk_group_row_limit;
 		options->compressionLevel = columnar_compression_level;
+		options->bloomFilterColumns = NULL;
+		options->sortKey = NULL;
 	}
 
 	systable_endscan_ordered(scanDescriptor);
@@ -620,7 +772,10 @@ SaveStripeSkipList(RelFileNode relfilenode, uint64 stripe, StripeSkipList *chunk
 				Int32GetDatum(chunk->valueCompressionType),
 				Int32GetDatum(chunk->valueCompressionLevel),
 				Int64GetDatum(chunk->decompressedValueSize),
-				Int64GetDatum(chunk->rowCount)
+				Int64GetDatum(chunk->rowCount),
+				0, /* to be filled below */
+				0, /* to be filled below */
+				Int32GetDatum(chunk->valueEncodingType)
 			};
 
 			bool nulls[Natts_columnar_chunk] = { false };
@@ -640,6 +795,26 @@ SaveStripeSkipList(RelFileNode relfilenode, uint64 stripe, StripeSkipList *chunk
 				nulls[Anum_columnar_chunk_maximum_value - 1] = true;
 			}
 
+			/* prefer the exact value set over the bloom filter when we have it */
+			nulls[Anum_columnar_chunk_bloom_filter - 1] = true;
+			nulls[Anum_columnar_chunk_distinct_values - 1] = true;
+
+			if (chunk->hasDistinctValues)
+			{
+				values[Anum_columnar_chunk_distinct_values - 1] =
+					PointerGetDatum(DistinctValuesToBytea(chunk->distinctValues,
+														  chunk->distinctValueCount,
+														  &tupleDescriptor->attrs[
+															  columnIndex]));
+				nulls[Anum_columnar_chunk_distinct_values - 1] = false;
+			}
+			else if (chunk->bloomFilter != NULL)
+			{
+				values[Anum_columnar_chunk_bloom_filter - 1] =
+					PointerGetDatum(chunk->bloomFilter);
+				nulls[Anum_columnar_chunk_bloom_filter - 1] = false;
+			}
+
 			InsertTupleAndEnforceConstraints(modifyState, values, nulls);
 		}
 	}
@@ -727,6 +902,9 @@ ReadStripeSkipList(RelFileNode relfilenode, uint64 stripe, TupleDesc tupleDescri
 		Datum datumArray[Natts_columnar_chunk];
 		bool isNullArray[Natts_columnar_chunk];
 
+		/* catalog tables created before bloom filters might have fewer columns */
+		memset(isNullArray, true, sizeof(isNullArray));
+
 		heap_deform_tuple(heapTuple, RelationGetDescr(columnarChunk), datumArray,
 						  isNullArray);
 
@@ -766,6 +944,14 @@ ReadStripeSkipList(RelFileNode relfilenode, uint64 stripe, TupleDesc tupleDescri
 		chunk->decompressedValueSize =
 			DatumGetInt64(datumArray[Anum_columnar_chunk_value_decompressed_size - 1]);
 
+		/* chunks written before encodings existed are not encoded */
+		chunk->valueEncodingType = ENCODING_NONE;
+		if (!isNullArray[Anum_columnar_chunk_value_encoding_type - 1])
+		{
+			chunk->valueEncodingType =
+				DatumGetInt32(datumArray[Anum_columnar_chunk_value_encoding_type - 1]);
+		}
+
 		if (isNullArray[Anum_columnar_chunk_minimum_value - 1] ||
 			isNullArray[Anum_columnar_chunk_maximum_value - 1])
 		{
@@ -785,6 +971,21 @@ ReadStripeSkipList(RelFileNode relfilenode, uint64 stripe, TupleDesc tupleDescri
 
 			chunk->hasMinMax = true;
 		}
+
+		if (!isNullArray[Anum_columnar_chunk_distinct_values - 1])
+		{
+			chunk->distinctValues =
+				ByteaToDistinctValues(datumArray[Anum_columnar_chunk_distinct_values - 1],
+									  &tupleDescriptor->attrs[columnIndex],
+									  &chunk->distinctValueCount);
+			chunk->hasDistinctValues = true;
+		}
+
+		if (!isNullArray[Anum_columnar_chunk_bloom_filter - 1])
+		{
+			chunk->bloomFilter =
+				DatumGetByteaPCopy(datumArray[Anum_columnar_chunk_bloom_filter - 1]);
+		}
 	}
 
 	systable_endscan_ordered(scanDescriptor);
@@ -1479,6 +1680,75 @@ DeleteMetadataRows(RelFileNode relfilenode)
 }
 
 
+/*
+ * DeleteStripeMetadataRows removes the rows for the stripe with given id
+ * from columnar metadata tables.
+ */
+void
+DeleteStripeMetadataRows(RelFileNode relfilenode, uint64 stripeId)
+{
+	uint64 storageId = LookupStorageId(relfilenode);
+
+	DeleteStripeFromColumnarMetadataTable(ColumnarStripeRelationId(),
+										  Anum_columnar_stripe_storageid,
+										  Anum_columnar_stripe_stripe,
+										  ColumnarStripePKeyIndexRelationId(),
+										  storageId, stripeId);
+	DeleteStripeFromColumnarMetadataTable(ColumnarChunkGroupRelationId(),
+										  Anum_columnar_chunkgroup_storageid,
+										  Anum_columnar_chunkgroup_stripe,
+										  ColumnarChunkGroupIndexRelationId(),
+										  storageId, stripeId);
+	DeleteStripeFromColumnarMetadataTable(ColumnarChunkRelationId(),
+										  Anum_columnar_chunk_storageid,
+										  Anum_columnar_chunk_stripe,
+										  ColumnarChunkIndexRelationId(),
+										  storageId, stripeId);
+}
+
+
+/*
+ * DeleteStripeFromColumnarMetadataTable removes the rows with given storageId
+ * and stripeId from given columnar metadata table. stripeIdIndexId should be
+ * an index that has storage id and stripe id as its leading columns.
+ */
+static void
+DeleteStripeFromColumnarMetadataTable(Oid metadataTableId,
+									  AttrNumber storageIdAtrrNumber,
+									  AttrNumber stripeIdAttrNumber,
+									  Oid stripeIdIndexId,
+									  uint64 storageId, uint64 stripeId)
+{
+	ScanKeyData scanKey[2];
+	ScanKeyInit(&scanKey[0], storageIdAtrrNumber, BTEqualStrategyNumber,
+				F_INT8EQ, UInt64GetDatum(storageId));
+	ScanKeyInit(&scanKey[1], stripeIdAttrNumber, BTEqualStrategyNumber,
+				F_INT8EQ, UInt64GetDatum(stripeId));
+
+	Relation metadataTable = table_open(metadataTableId, RowExclusiveLock);
+	Relation index = index_open(stripeIdIndexId, AccessShareLock);
+
+	SysScanDesc scanDescriptor = systable_beginscan_ordered(metadataTable, index, NULL,
+															2, scanKey);
+
+	ModifyState *modifyState = StartModifyRelation(metadataTable);
+
+	HeapTuple heapTuple;
+	while (HeapTupleIsValid(heapTuple = systable_getnext_ordered(scanDescriptor,
+																 ForwardScanDirection)))
+	{
+		DeleteTupleAndEnforceConstraints(modifyState, heapTuple);
+	}
+
+	systable_endscan_ordered(scanDescriptor);
+
+	FinishModifyRelation(modifyState);
+
+	index_close(index, AccessShareLock);
+	table_close(metadataTable, RowExclusiveLock);
+}
+
+
 /*
  * DeleteStorageFromColumnarMetadataTable removes the rows with given
  * storageId from given columnar metadata table.
@@ -1704,6 +1974,42 @@ ByteaToDatum(bytea *bytes, Form_pg_attribute attrForm)
 }
 
 
+/*
+ * DistinctValuesToBytea serializes the distinct values of a chunk into a
+ * bytea value, using the array representation of the column type.
+ */
+static bytea *
+DistinctValuesToBytea(Datum *values, uint32 valueCount, Form_pg_attribute attrForm)
+{
+	ArrayType *valueArray = construct_array(values, valueCount, attrForm->atttypid,
+											attrForm->attlen, attrForm->attbyval,
+											attrForm->attalign);
+
+	return (bytea *) valueArray;
+}
+
+
+/*
+ * ByteaToDistinctValues deserializes a value set which was previously
+ * serialized using DistinctValuesToBytea.
+ */
+static Datum *
+ByteaToDistinctValues(Datum byteaDatum, Form_pg_attribute attrForm, uint32 *valueCount)
+{
+	/* copy, so the values live even after the catalog tuple is released */
+	ArrayType *valueArray = DatumGetArrayTypePCopy(byteaDatum);
+	Datum *values = NULL;
+	int elementCount = 0;
+
+	deconstruct_array(valueArray, attrForm->atttypid, attrForm->attlen,
+					  attrForm->attbyval, attrForm->attalign, &values, NULL,
+					  &elementCount);
+
+	*valueCount = elementCount;
+	return values;
+}
+
+
 /*
  * ColumnarStorageIdSequenceRelationId returns relation id of columnar.stripe.
  * TODO: should we cache this similar to citus?
@@ -18,9 +18,11 @@
 
 #include "safe_lib.h"
 
+#include "access/hash.h"
 #include "access/nbtree.h"
 #include "access/xact.h"
 #include "catalog/pg_am.h"
+#include "catalog/pg_type.h"
 #include "commands/defrem.h"
 #include "distributed/listutils.h"
 #include "nodes/makefuncs.h"
@@ -33,6 +35,7 @@
 #include "utils/memutils.h"
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
+#include "utils/spccache.h"
 
 #include "columnar/columnar.h"
 #include "columnar/columnar_storage.h"
@@ -43,6 +46,53 @@
 	"attempted to read an unexpected stripe while reading columnar " \
 	"table %s, stripe with id=" UINT64_FORMAT " is not flushed"
 
+/*
+ * VectorizedQual represents a pushed down "Var <op> Const" qual that can be
+ * evaluated over the value arrays of a whole chunk group at once.
+ */
+typedef struct VectorizedQual
+{
+	/* 0-indexed column that the qual references */
+	uint32 columnIndex;
+
+	/* btree strategy of the operator, normalized to "Var <op> Const" form */
+	int16 strategyNumber;
+
+	/*
+	 * If both sides of the qual are integer-like types, we compare them as
+	 * int64's in a tight loop. Otherwise, we call the operator function for
+	 * each row.
+	 */
+	bool useIntegerComparison;
+	bool columnIsInt64;
+	int64 integerConstValue;
+
+	FmgrInfo operatorFunction;
+	Oid collationId;
+	bool varOnLeft;
+	Datum constValue;
+} VectorizedQual;
+
+/*
+ * CoveredChunkGroupConsumer is the callback set by
+ * ColumnarReadSetCoveredChunkGroupCallback, along with its argument.
+ */
+typedef struct CoveredChunkGroupConsumer
+{
+	ColumnarCoveredChunkGroupCallback callback;
+	void *arg;
+} CoveredChunkGroupConsumer;
+
+/*
+ * ChunkGroupBatchConsumer is the callback set by
+ * ColumnarReadSetChunkGroupBatchCallback, along with its argument.
+ */
+typedef struct ChunkGroupBatchConsumer
+{
+	ColumnarChunkGroupBatchCallback callback;
+	void *arg;
+} ChunkGroupBatchConsumer;
+
 typedef struct ChunkGroupReadState
 {
 	int64 currentRow;
@@ -50,6 +100,12 @@ typedef struct ChunkGroupReadState
 	int columnCount;
 	List *projectedColumnList;  /* borrowed reference */
 	ChunkData *chunkGroupData;
+
+	/*
+	 * If not NULL, only the rows that are marked as true in selectionMask
+	 * are returned by ReadChunkGroupNextRow.
+	 */
+	bool *selectionMask;
 } ChunkGroupReadState;
 
 typedef struct StripeReadState
@@ -64,6 +120,8 @@ typedef struct StripeReadState
 	MemoryContext stripeReadContext;
 	StripeBuffers *stripeBuffers;   /* allocated in stripeReadContext */
 	List *projectedColumnList;      /* borrowed reference */
+	List *vectorizedQualList;       /* borrowed reference */
+	ChunkGroupBatchConsumer *chunkGroupBatchConsumer; /* borrowed reference */
 	ChunkGroupReadState *chunkGroupReadState; /* owned */
 } StripeReadState;
 
@@ -84,9 +142,66 @@ struct ColumnarReadState
 	List *whereClauseList;
 	List *whereClauseVars;
 
+	/*
+	 * List of VectorizedQual's built from whereClauseList when
+	 * columnar.enable_vectorized_filter is set, or when chunk groups are
+	 * passed to chunkGroupBatchConsumer.
+	 */
+	List *vectorizedQualList;
+
 	MemoryContext stripeReadContext;
 	int64 chunkGroupsFiltered;
 
+	/*
+	 * If not NULL, chunk groups whose rows are all known to satisfy
+	 * whereClauseList are passed to this consumer, which may choose to
+	 * skip reading them.
+	 */
+	CoveredChunkGroupConsumer *coveredChunkGroupConsumer;
+
+	/*
+	 * If not NULL, chunk groups that are read are passed to this consumer
+	 * instead of returning their rows, but only if chunkGroupBatchesEnabled
+	 * is set, see SetupChunkGroupBatches.
+	 */
+	ChunkGroupBatchConsumer *chunkGroupBatchConsumer;
+	bool chunkGroupBatchesEnabled;
+
+	/*
+	 * If not NULL, chunks to read from the current stripe were already
+	 * selected by PrefetchNextStripe. Allocated in stripeReadContext.
+	 */
+	StripeSkipList *currentStripeSkipList;
+
+	/*
+	 * When prefetching is enabled, we pick the stripe to read after the
+	 * current one as soon as we load the current stripe, select the chunks
+	 * to read from it and prefetch them while the current stripe is being
+	 * processed. The selected chunks are allocated in nextStripeReadContext,
+	 * which becomes the stripeReadContext once we advance to that stripe.
+	 *
+	 * nextStripeSelected is set when nextStripe* fields are valid, note
+	 * that nextStripeMetadata might still be NULL if there are no more
+	 * stripes to read.
+	 */
+	bool nextStripeSelected;
+	StripeMetadata *nextStripeMetadata;
+	StripeSkipList *nextStripeSkipList;
+	int64 nextStripeChunkGroupsFiltered;
+	MemoryContext nextStripeReadContext;
+
+	/*
+	 * Shared state if this is a parallel scan. parallelStripeIndex is the
+	 * number of stripes we have walked through so far, and
+	 * parallelLastRowNumber is the highest row number of the last of them.
+	 * We claim the first stripe lazily, since the shared state might be
+	 * reinitialized after a rescan.
+	 */
+	ParallelColumnarScanDesc parallelScan;
+	bool parallelClaimPending;
+	uint64 parallelStripeIndex;
+	uint64 parallelLastRowNumber;
+
 	/*
 	 * Memory context guaranteed to be not freed during scan so we can
 	 * safely use for any memory allocations regarding ColumnarReadState
@@ -117,18 +232,35 @@ static bool HasUnreadStripe(ColumnarReadState *readState);
 static StripeReadState * BeginStripeRead(StripeMetadata *stripeMetadata, Relation rel,
 										 TupleDesc tupleDesc, List *projectedColumnList,
 										 List *whereClauseList, List *whereClauseVars,
+										 List *vectorizedQualList,
+										 StripeSkipList *selectedChunkSkipList,
+										 CoveredChunkGroupConsumer *
+										 coveredChunkGroupConsumer,
+										 ChunkGroupBatchConsumer *
+										 chunkGroupBatchConsumer,
 										 MemoryContext stripeReadContext,
 										 Snapshot snapshot);
 static void AdvanceStripeRead(ColumnarReadState *readState);
+static void PrefetchNextStripe(ColumnarReadState *readState);
+static void DiscardNextStripe(ColumnarReadState *readState);
+static bool ColumnarPrefetchEnabled(Relation relation);
+static StripeMetadata * FindNextFlushedStripe(ColumnarReadState *readState,
+											  uint64 lastReadRowNumber);
+static void ResetParallelStripeClaim(ColumnarReadState *readState);
+static StripeMetadata * ClaimNextParallelStripe(ColumnarReadState *readState);
 static bool SnapshotMightSeeUnflushedStripes(Snapshot snapshot);
+static void SetupChunkGroupBatches(ColumnarReadState *readState);
 static bool ReadStripeNextRow(StripeReadState *stripeReadState, Datum *columnValues,
 							  bool *columnNulls);
 static ChunkGroupReadState * BeginChunkGroupRead(StripeBuffers *stripeBuffers, int
 												 chunkIndex,
 												 TupleDesc tupleDesc,
 												 List *projectedColumnList,
+												 List *vectorizedQualList,
 												 MemoryContext cxt);
 static void EndChunkGroupRead(ChunkGroupReadState *chunkGroupReadState);
+static void ConsumeChunkGroupBatch(ChunkGroupReadState *chunkGroupReadState,
+								   ChunkGroupBatchConsumer *chunkGroupBatchConsumer);
 static bool ReadChunkGroupNextRow(ChunkGroupReadState *chunkGroupReadState,
 								  Datum *columnValues,
 								  bool *columnNulls);
@@ -138,8 +270,29 @@ static StripeBuffers * LoadFilteredStripeBuffers(Relation relation,
 												 List *projectedColumnList,
 												 List *whereClauseList,
 												 List *whereClauseVars,
+												 StripeSkipList *selectedChunkSkipList,
+												 CoveredChunkGroupConsumer *
+												 coveredChunkGroupConsumer,
 												 int64 *chunkGroupsFiltered,
 												 Snapshot snapshot);
+static StripeSkipList * SelectStripeChunks(Relation relation,
+										   StripeMetadata *stripeMetadata,
+										   TupleDesc tupleDescriptor,
+										   bool *projectedColumnMask,
+										   List *whereClauseList,
+										   List *whereClauseVars,
+										   CoveredChunkGroupConsumer *
+										   coveredChunkGroupConsumer,
+										   int64 *chunkGroupsFiltered,
+										   Snapshot snapshot);
+static bool ChunkGroupCoveredByQuals(Relation relation, StripeMetadata *stripeMetadata,
+									 StripeSkipList *stripeSkipList, uint32 chunkIndex,
+									 List *whereClauseList, List *whereClauseVars);
+static bool ChunkContainsNulls(Relation relation, StripeMetadata *stripeMetadata,
+							   ColumnChunkSkipNode *chunkSkipNode, uint32 rowCount);
+static void PrefetchStripeChunks(Relation relation, StripeMetadata *stripeMetadata,
+								 StripeSkipList *selectedChunkSkipList,
+								 bool *projectedColumnMask);
 static ColumnBuffers * LoadColumnBuffers(Relation relation,
 										 ColumnChunkSkipNode *chunkSkipNodeArray,
 										 uint32 chunkCount, uint64 stripeOffset,
@@ -147,6 +300,12 @@ static ColumnBuffers * LoadColumnBuffers(Relation relation,
 static bool * SelectedChunkMask(StripeSkipList *stripeSkipList,
 								List *whereClauseList, List *whereClauseVars,
 								int64 *chunkGroupsFiltered);
+static void FilterChunksByMembership(StripeSkipList *stripeSkipList,
+									List *whereClauseList, bool *selectedChunkMask,
+									int64 *chunkGroupsFiltered);
+static bool ChunkMightContainValue(ColumnChunkSkipNode *chunkSkipNode, Datum value,
+								   FmgrInfo *equalityFunction, FmgrInfo *hashFunction,
+								   Oid collationId);
 static Node * BuildBaseConstraint(Var *variable);
 static List * GetClauseVars(List *clauses, int natts);
 static OpExpr * MakeOpExpression(Var *variable, int16 strategyNumber);
@@ -166,20 +325,41 @@ static void DeserializeDatumArray(StringInfo datumBuffer, bool *existsArray,
 static ChunkData * DeserializeChunkData(StripeBuffers *stripeBuffers, uint64 chunkIndex,
 										uint32 rowCount, TupleDesc tupleDescriptor,
 										List *projectedColumnList);
+static void DeserializeChunkColumns(StripeBuffers *stripeBuffers, uint64 chunkIndex,
+									uint32 rowCount, TupleDesc tupleDescriptor,
+									bool *columnMask, ChunkData *chunkData);
+static ChunkData * DeserializeChunkDataLate(StripeBuffers *stripeBuffers,
+											uint64 chunkIndex, uint32 rowCount,
+											TupleDesc tupleDescriptor,
+											List *projectedColumnList,
+											List *vectorizedQualList,
+											bool **selectionMask);
 static Datum ColumnDefaultValue(TupleConstr *tupleConstraints,
 								Form_pg_attribute attributeForm);
+static List * BuildVectorizedQualList(List *whereClauseList);
+static VectorizedQual * BuildVectorizedQual(Expr *clause);
+static bool IsVectorizableIntegerType(Oid typeId);
+static int64 IntegerDatumGetInt64(Datum datum, Oid typeId);
+static bool * EvaluateVectorizedQuals(ChunkData *chunkData, List *vectorizedQualList);
+static void ApplyIntegerQual(VectorizedQual *vectorizedQual, bool *selectionMask,
+							 bool *existsArray, Datum *valueArray, uint32 rowCount);
+static void ApplyGenericQual(VectorizedQual *vectorizedQual, bool *selectionMask,
+							 bool *existsArray, Datum *valueArray, uint32 rowCount);
 
 /*
  * ColumnarBeginRead initializes a columnar read operation. This function returns a
  * read handle that's used during reading rows and finishing the read operation.
  *
  * projectedColumnList is an integer list of attribute numbers (1-indexed).
+ *
+ * If parallelScan is given, the stripes of the table are divided between
+ * the participants of the parallel scan that share it.
  */
 ColumnarReadState *
 ColumnarBeginRead(Relation relation, TupleDesc tupleDescriptor,
 				  List *projectedColumnList, List *whereClauseList,
 				  MemoryContext scanContext, Snapshot snapshot,
-				  bool randomAccess)
+				  bool randomAccess, ParallelColumnarScanDesc parallelScan)
 {
 	/*
 	 * We allocate all stripe specific data in the stripeReadContext, and reset
@@ -187,17 +367,21 @@ ColumnarBeginRead(Relation relation, TupleDesc tupleDescriptor,
 	 * leaks.
 	 */
 	MemoryContext stripeReadContext = CreateStripeReadMemoryContext();
+	MemoryContext nextStripeReadContext = CreateStripeReadMemoryContext();
 
 	ColumnarReadState *readState = palloc0(sizeof(ColumnarReadState));
 	readState->relation = relation;
 	readState->projectedColumnList = projectedColumnList;
 	readState->whereClauseList = whereClauseList;
 	readState->whereClauseVars = GetClauseVars(whereClauseList, tupleDescriptor->natts);
+	readState->vectorizedQualList = BuildVectorizedQualList(whereClauseList);
 	readState->chunkGroupsFiltered = 0;
 	readState->tupleDescriptor = tupleDescriptor;
 	readState->stripeReadContext = stripeReadContext;
+	readState->nextStripeReadContext = nextStripeReadContext;
 	readState->stripeReadState = NULL;
 	readState->scanContext = scanContext;
+	readState->parallelScan = parallelScan;
 
 	/*
 	 * Note that ColumnarReadFlushPendingWrites might update those two by
@@ -206,7 +390,17 @@ ColumnarBeginRead(Relation relation, TupleDesc tupleDescriptor,
 	readState->snapshot = snapshot;
 	readState->snapshotRegisteredByUs = false;
 
-	if (!randomAccess)
+	if (parallelScan != NULL)
+	{
+		/*
+		 * We cannot flush pending writes during a parallel operation, so the
+		 * leader already flushed them before the parallel scan started and
+		 * all participants use a snapshot that can see them.
+		 */
+		Assert(!randomAccess);
+		ResetParallelStripeClaim(readState);
+	}
+	else if (!randomAccess)
 	{
 		/*
 		 * When doing random access (i.e.: index scan), we don't need to flush
@@ -254,12 +448,31 @@ ColumnarReadFlushPendingWrites(ColumnarReadState *readState)
 {
 	Assert(!readState->snapshotRegisteredByUs);
 
-	Oid relfilenode = readState->relation->rd_node.relNode;
+	readState->snapshot =
+		ColumnarFlushPendingWritesForSnapshot(readState->relation, readState->snapshot,
+											  &readState->snapshotRegisteredByUs);
+}
+
+
+/*
+ * ColumnarFlushPendingWritesForSnapshot flushes pending writes of given
+ * relation and returns a snapshot that can see them.
+ *
+ * If it returns a new snapshot, then sets snapshotRegisteredByUs to true to
+ * indicate that caller should unregister the snapshot when done with it.
+ */
+Snapshot
+ColumnarFlushPendingWritesForSnapshot(Relation relation, Snapshot snapshot,
+									  bool *snapshotRegisteredByUs)
+{
+	*snapshotRegisteredByUs = false;
+
+	Oid relfilenode = relation->rd_node.relNode;
 	FlushWriteStateForRelfilenode(relfilenode, GetCurrentSubTransactionId());
 
-	if (readState->snapshot == InvalidSnapshot || !IsMVCCSnapshot(readState->snapshot))
+	if (snapshot == InvalidSnapshot || !IsMVCCSnapshot(snapshot))
 	{
-		return;
+		return snapshot;
 	}
 
 	/*
@@ -276,7 +489,7 @@ ColumnarReadFlushPendingWrites(ColumnarReadState *readState)
 	 * pending writes, see the discussion in
 	 * https://github.com/citusdata/citus/issues/5231.
 	 */
-	PushCopiedSnapshot(readState->snapshot);
+	PushCopiedSnapshot(snapshot);
 
 	/* now our snapshot is the active one */
 	UpdateActiveSnapshotCommandId();
@@ -286,18 +499,17 @@ ColumnarReadFlushPendingWrites(ColumnarReadState *readState)
 	/*
 	 * To be able to use UpdateActiveSnapshotCommandId, we pushed the
 	 * copied snapshot to the stack. However, we don't need to keep it
-	 * there since we will anyway rely on ColumnarReadState->snapshot
-	 * during read operation.
+	 * there since the caller will anyway rely on the returned snapshot.
 	 *
 	 * Note that since we registered the snapshot already, we guarantee
 	 * that PopActiveSnapshot won't free it.
 	 */
 	PopActiveSnapshot();
 
-	readState->snapshot = newSnapshot;
+	/* not forget to unregister it when done with the snapshot */
+	*snapshotRegisteredByUs = true;
 
-	/* not forget to unregister it when finishing read operation */
-	readState->snapshotRegisteredByUs = true;
+	return newSnapshot;
 }
 
 
@@ -326,19 +538,51 @@ ColumnarReadNextRow(ColumnarReadState *readState, Datum *columnValues, bool *col
 	{
 		if (!StripeReadInProgress(readState))
 		{
+			if (readState->parallelClaimPending)
+			{
+				readState->parallelClaimPending = false;
+				AdvanceStripeRead(readState);
+			}
+
 			if (!HasUnreadStripe(readState))
 			{
 				return false;
 			}
 
+			ChunkGroupBatchConsumer *chunkGroupBatchConsumer =
+				readState->chunkGroupBatchesEnabled ?
+				readState->chunkGroupBatchConsumer : NULL;
+
 			readState->stripeReadState = BeginStripeRead(readState->currentStripeMetadata,
 														 readState->relation,
 														 readState->tupleDescriptor,
 														 readState->projectedColumnList,
 														 readState->whereClauseList,
 														 readState->whereClauseVars,
+														 readState->vectorizedQualList,
+														 readState->currentStripeSkipList,
+														 readState->
+														 coveredChunkGroupConsumer,
+														 chunkGroupBatchConsumer,
 														 readState->stripeReadContext,
 														 readState->snapshot);
+
+			/*
+			 * Start reading the next stripe from disk while we process the
+			 * current one. We don't do that for snapshots that might see
+			 * un-flushed stripes since such a stripe might get flushed until
+			 * we are done with the current stripe.
+			 *
+			 * Neither do we for parallel scans, since picking the next stripe
+			 * would claim it from the other participants, and a claimed
+			 * stripe that we discard would not be read by anyone.
+			 */
+			if (ColumnarPrefetchEnabled(readState->relation) &&
+				readState->parallelScan == NULL &&
+				!SnapshotMightSeeUnflushedStripes(readState->snapshot))
+			{
+				PrefetchNextStripe(readState);
+			}
 		}
 
 		if (!ReadStripeNextRow(readState->stripeReadState, columnValues, columnNulls))
@@ -421,6 +665,7 @@ ColumnarReadRowByRowNumber(ColumnarReadState *readState,
 		TupleDesc relationTupleDesc = RelationGetDescr(columnarRelation);
 		List *whereClauseList = NIL;
 		List *whereClauseVars = NIL;
+		List *vectorizedQualList = NIL;
 		MemoryContext stripeReadContext = readState->stripeReadContext;
 		readState->stripeReadState = BeginStripeRead(stripeMetadata,
 													 columnarRelation,
@@ -428,6 +673,10 @@ ColumnarReadRowByRowNumber(ColumnarReadState *readState,
 													 readState->projectedColumnList,
 													 whereClauseList,
 													 whereClauseVars,
+													 vectorizedQualList,
+													 NULL,
+													 NULL,
+													 NULL,
 													 stripeReadContext,
 													 snapshot);
 
@@ -509,6 +758,7 @@ ReadStripeRowByRowNumber(ColumnarReadState *readState,
 			stripeReadState->chunkGroupIndex,
 			stripeReadState->tupleDescriptor,
 			stripeReadState->projectedColumnList,
+			stripeReadState->vectorizedQualList,
 			stripeReadState->stripeReadContext);
 	}
 
@@ -588,16 +838,120 @@ ColumnarRescan(ColumnarReadState *readState, List *scanQual)
 
 	ColumnarResetRead(readState);
 
-	/* set currentStripeMetadata for the first stripe to read */
-	AdvanceStripeRead(readState);
+	if (readState->parallelScan != NULL)
+	{
+		/* shared state is reinitialized separately, claim a stripe when reading */
+		ResetParallelStripeClaim(readState);
+	}
+	else
+	{
+		/* set currentStripeMetadata for the first stripe to read */
+		AdvanceStripeRead(readState);
+	}
 
 	readState->chunkGroupsFiltered = 0;
 
 	readState->whereClauseList = copyObject(scanQual);
+	readState->vectorizedQualList = BuildVectorizedQualList(readState->whereClauseList);
+	SetupChunkGroupBatches(readState);
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * ColumnarReadSetCoveredChunkGroupCallback makes the scan pass the chunk groups
+ * whose rows are all known to satisfy the scan quals to the given callback
+ * before reading them, which allows answering some queries from the skip list
+ * alone, see ColumnarCoveredChunkGroupCallback.
+ *
+ * Rows of the chunk groups that the callback consumes are not returned by the
+ * scan. This must be called before reading the first row.
+ */
+void
+ColumnarReadSetCoveredChunkGroupCallback(ColumnarReadState *readState,
+										 ColumnarCoveredChunkGroupCallback callback,
+										 void *arg)
+{
+	CoveredChunkGroupConsumer *consumer =
+		MemoryContextAllocZero(readState->scanContext,
+							   sizeof(CoveredChunkGroupConsumer));
+	consumer->callback = callback;
+	consumer->arg = arg;
+
+	readState->coveredChunkGroupConsumer = consumer;
+}
+
+
+/*
+ * ColumnarReadSetChunkGroupBatchCallback makes the scan pass each chunk group
+ * that it reads to the given callback as a whole, along with the rows of it
+ * that satisfy the scan quals, instead of returning the rows one by one. That
+ * allows the caller to process the column arrays of the chunk group in tight
+ * loops, see ColumnarChunkGroupBatchCallback.
+ *
+ * This only has an effect if all scan quals can be evaluated over the column
+ * arrays, otherwise the rows are returned as usual and the callback is never
+ * called. This must be called before reading the first row.
+ */
+void
+ColumnarReadSetChunkGroupBatchCallback(ColumnarReadState *readState,
+									   ColumnarChunkGroupBatchCallback callback,
+									   void *arg)
+{
+	MemoryContext oldContext = MemoryContextSwitchTo(readState->scanContext);
+
+	ChunkGroupBatchConsumer *consumer = palloc0(sizeof(ChunkGroupBatchConsumer));
+	consumer->callback = callback;
+	consumer->arg = arg;
+
+	readState->chunkGroupBatchConsumer = consumer;
+	SetupChunkGroupBatches(readState);
+
 	MemoryContextSwitchTo(oldContext);
 }
 
 
+/*
+ * SetupChunkGroupBatches enables passing chunk groups to the chunk group
+ * batch consumer if all of the where clauses can be evaluated as vectorized
+ * quals over projected columns, in which case the selection mask of a chunk
+ * group marks exactly the rows that satisfy the where clauses. We then use
+ * the vectorized quals regardless of columnar.enable_vectorized_filter, since
+ * the rows are not passed to the executor to evaluate the quals.
+ */
+static void
+SetupChunkGroupBatches(ColumnarReadState *readState)
+{
+	readState->chunkGroupBatchesEnabled = false;
+
+	if (readState->chunkGroupBatchConsumer == NULL)
+	{
+		return;
+	}
+
+	List *vectorizedQualList = NIL;
+
+	Expr *clause = NULL;
+	foreach_ptr(clause, readState->whereClauseList)
+	{
+		VectorizedQual *vectorizedQual = BuildVectorizedQual(clause);
+
+		/* EvaluateVectorizedQuals skips the quals on columns not projected */
+		if (vectorizedQual == NULL ||
+			!list_member_int(readState->projectedColumnList,
+							 vectorizedQual->columnIndex + 1))
+		{
+			return;
+		}
+
+		vectorizedQualList = lappend(vectorizedQualList, vectorizedQual);
+	}
+
+	readState->vectorizedQualList = vectorizedQualList;
+	readState->chunkGroupBatchesEnabled = true;
+}
+
+
 /*
  * Finishes a columnar read operation.
  */
@@ -613,7 +967,10 @@ ColumnarEndRead(ColumnarReadState *readState)
 		UnregisterSnapshot(readState->snapshot);
 	}
 
+	DiscardNextStripe(readState);
+
 	MemoryContextDelete(readState->stripeReadContext);
+	MemoryContextDelete(readState->nextStripeReadContext);
 	if (readState->currentStripeMetadata)
 	{
 		pfree(readState->currentStripeMetadata);
@@ -625,7 +982,8 @@ ColumnarEndRead(ColumnarReadState *readState)
 
 /*
  * ColumnarResetRead resets the stripe and the chunk group that is
- * being read currently (if any).
+ * being read currently (if any), and forgets about the next stripe if
+ * we already started prefetching it.
  */
 void
 ColumnarResetRead(ColumnarReadState *readState)
@@ -636,17 +994,26 @@ ColumnarResetRead(ColumnarReadState *readState)
 		readState->currentStripeMetadata = NULL;
 
 		readState->stripeReadState = NULL;
+		readState->currentStripeSkipList = NULL;
 		MemoryContextReset(readState->stripeReadContext);
 	}
+
+	DiscardNextStripe(readState);
 }
 
 
 /*
  * BeginStripeRead allocates state for reading a stripe.
+ *
+ * If selectedChunkSkipList is not NULL, then the chunks to read from the
+ * stripe were already selected, see LoadFilteredStripeBuffers.
  */
 static StripeReadState *
 BeginStripeRead(StripeMetadata *stripeMetadata, Relation rel, TupleDesc tupleDesc,
 				List *projectedColumnList, List *whereClauseList, List *whereClauseVars,
+				List *vectorizedQualList, StripeSkipList *selectedChunkSkipList,
+				CoveredChunkGroupConsumer *coveredChunkGroupConsumer,
+				ChunkGroupBatchConsumer *chunkGroupBatchConsumer,
 				MemoryContext stripeReadContext, Snapshot snapshot)
 {
 	MemoryContext oldContext = MemoryContextSwitchTo(stripeReadContext);
@@ -658,6 +1025,8 @@ BeginStripeRead(StripeMetadata *stripeMetadata, Relation rel, TupleDesc tupleDes
 	stripeReadState->columnCount = tupleDesc->natts;
 	stripeReadState->chunkGroupReadState = NULL;
 	stripeReadState->projectedColumnList = projectedColumnList;
+	stripeReadState->vectorizedQualList = vectorizedQualList;
+	stripeReadState->chunkGroupBatchConsumer = chunkGroupBatchConsumer;
 	stripeReadState->stripeReadContext = stripeReadContext;
 
 	stripeReadState->stripeBuffers = LoadFilteredStripeBuffers(rel,
@@ -666,6 +1035,8 @@ BeginStripeRead(StripeMetadata *stripeMetadata, Relation rel, TupleDesc tupleDes
 															   projectedColumnList,
 															   whereClauseList,
 															   whereClauseVars,
+															   selectedChunkSkipList,
+															   coveredChunkGroupConsumer,
 															   &stripeReadState->
 															   chunkGroupsFiltered,
 															   snapshot);
@@ -681,7 +1052,8 @@ BeginStripeRead(StripeMetadata *stripeMetadata, Relation rel, TupleDesc tupleDes
 
 /*
  * AdvanceStripeRead updates chunkGroupsFiltered and sets
- * currentStripeMetadata for next stripe read.
+ * currentStripeMetadata for next stripe read. If PrefetchNextStripe already
+ * picked the next stripe, we continue with that one.
  */
 static void
 AdvanceStripeRead(ColumnarReadState *readState)
@@ -699,12 +1071,148 @@ AdvanceStripeRead(ColumnarReadState *readState)
 			readState->stripeReadState->chunkGroupsFiltered;
 	}
 
-	readState->currentStripeMetadata = FindNextStripeByRowNumber(readState->relation,
-																 lastReadRowNumber,
-																 readState->snapshot);
+	readState->stripeReadState = NULL;
+	readState->currentStripeSkipList = NULL;
+	MemoryContextReset(readState->stripeReadContext);
+
+	if (readState->nextStripeSelected)
+	{
+		/*
+		 * Selected chunks of the next stripe live in nextStripeReadContext,
+		 * so make it the stripeReadContext and reuse the one that we just
+		 * reset for the stripe that comes after.
+		 */
+		MemoryContext stripeReadContext = readState->stripeReadContext;
+		readState->stripeReadContext = readState->nextStripeReadContext;
+		readState->nextStripeReadContext = stripeReadContext;
+
+		readState->currentStripeMetadata = readState->nextStripeMetadata;
+		readState->currentStripeSkipList = readState->nextStripeSkipList;
+		readState->chunkGroupsFiltered += readState->nextStripeChunkGroupsFiltered;
+
+		readState->nextStripeSelected = false;
+		readState->nextStripeMetadata = NULL;
+		readState->nextStripeSkipList = NULL;
+		readState->nextStripeChunkGroupsFiltered = 0;
+	}
+	else if (readState->parallelScan != NULL)
+	{
+		readState->currentStripeMetadata = ClaimNextParallelStripe(readState);
+	}
+	else
+	{
+		readState->currentStripeMetadata = FindNextFlushedStripe(readState,
+																 lastReadRowNumber);
+	}
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * PrefetchNextStripe picks the stripe to read after the current one, selects
+ * the chunks to read from it and issues prefetch requests for them, so that
+ * the I/O for the next stripe overlaps with processing the current one.
+ *
+ * Parallel scans do not prefetch, since the next stripe is not known before
+ * it is claimed from the shared counter.
+ */
+static void
+PrefetchNextStripe(ColumnarReadState *readState)
+{
+	Assert(StripeReadInProgress(readState));
+	Assert(!readState->nextStripeSelected);
+	Assert(readState->parallelScan == NULL);
+
+	MemoryContext oldContext = MemoryContextSwitchTo(readState->scanContext);
+
+	uint64 lastReadRowNumber =
+		StripeGetHighestRowNumber(readState->currentStripeMetadata);
+	StripeMetadata *nextStripeMetadata = FindNextFlushedStripe(readState,
+															   lastReadRowNumber);
+
+	readState->nextStripeSelected = true;
+	readState->nextStripeMetadata = nextStripeMetadata;
+	readState->nextStripeSkipList = NULL;
+	readState->nextStripeChunkGroupsFiltered = 0;
+
+	if (nextStripeMetadata != NULL)
+	{
+		MemoryContextSwitchTo(readState->nextStripeReadContext);
+
+		TupleDesc tupleDescriptor = readState->tupleDescriptor;
+		bool *projectedColumnMask = ProjectedColumnMask(tupleDescriptor->natts,
+														readState->projectedColumnList);
+
+		StripeSkipList *selectedChunkSkipList =
+			SelectStripeChunks(readState->relation, nextStripeMetadata,
+							   tupleDescriptor, projectedColumnMask,
+							   readState->whereClauseList, readState->whereClauseVars,
+							   readState->coveredChunkGroupConsumer,
+							   &readState->nextStripeChunkGroupsFiltered,
+							   readState->snapshot);
+
+		PrefetchStripeChunks(readState->relation, nextStripeMetadata,
+							 selectedChunkSkipList, projectedColumnMask);
+
+		readState->nextStripeSkipList = selectedChunkSkipList;
+	}
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * DiscardNextStripe forgets about the next stripe picked by
+ * PrefetchNextStripe, if any.
+ */
+static void
+DiscardNextStripe(ColumnarReadState *readState)
+{
+	if (!readState->nextStripeSelected)
+	{
+		return;
+	}
+
+	if (readState->nextStripeMetadata != NULL)
+	{
+		pfree(readState->nextStripeMetadata);
+	}
+
+	readState->nextStripeSelected = false;
+	readState->nextStripeMetadata = NULL;
+	readState->nextStripeSkipList = NULL;
+	readState->nextStripeChunkGroupsFiltered = 0;
+	MemoryContextReset(readState->nextStripeReadContext);
+}
+
+
+/*
+ * ColumnarPrefetchEnabled returns true if we should issue prefetch requests
+ * when reading given relation. Similar to bitmap heap scans, we don't do so
+ * if asynchronous I/O is disabled for the tablespace of the relation.
+ */
+static bool
+ColumnarPrefetchEnabled(Relation relation)
+{
+	return columnar_enable_prefetch &&
+		   get_tablespace_io_concurrency(relation->rd_rel->reltablespace) > 0;
+}
+
+
+/*
+ * FindNextFlushedStripe returns the first flushed stripe that comes after
+ * the row with given row number, or NULL if there is no such stripe.
+ */
+static StripeMetadata *
+FindNextFlushedStripe(ColumnarReadState *readState, uint64 lastReadRowNumber)
+{
+	StripeMetadata *stripeMetadata = FindNextStripeByRowNumber(readState->relation,
+															   lastReadRowNumber,
+															   readState->snapshot);
 
-	if (readState->currentStripeMetadata &&
-		StripeWriteState(readState->currentStripeMetadata) != STRIPE_WRITE_FLUSHED &&
+	if (stripeMetadata &&
+		StripeWriteState(stripeMetadata) != STRIPE_WRITE_FLUSHED &&
 		!SnapshotMightSeeUnflushedStripes(readState->snapshot))
 	{
 		/*
@@ -714,22 +1222,78 @@ AdvanceStripeRead(ColumnarReadState *readState)
 		 */
 		ereport(ERROR, (errmsg(UNEXPECTED_STRIPE_READ_ERR_MSG,
 							   RelationGetRelationName(readState->relation),
-							   readState->currentStripeMetadata->id)));
+							   stripeMetadata->id)));
 	}
 
-	while (readState->currentStripeMetadata &&
-		   StripeWriteState(readState->currentStripeMetadata) != STRIPE_WRITE_FLUSHED)
+	while (stripeMetadata &&
+		   StripeWriteState(stripeMetadata) != STRIPE_WRITE_FLUSHED)
 	{
-		readState->currentStripeMetadata =
-			FindNextStripeByRowNumber(readState->relation,
-									  readState->currentStripeMetadata->firstRowNumber,
-									  readState->snapshot);
+		stripeMetadata = FindNextStripeByRowNumber(readState->relation,
+												   stripeMetadata->firstRowNumber,
+												   readState->snapshot);
 	}
 
-	readState->stripeReadState = NULL;
-	MemoryContextReset(readState->stripeReadContext);
+	return stripeMetadata;
+}
 
-	MemoryContextSwitchTo(oldContext);
+
+/*
+ * ResetParallelStripeClaim makes a parallel read start over from the first
+ * stripe, and defers claiming a stripe from the shared state until we start
+ * reading.
+ */
+static void
+ResetParallelStripeClaim(ColumnarReadState *readState)
+{
+	if (readState->currentStripeMetadata != NULL)
+	{
+		pfree(readState->currentStripeMetadata);
+		readState->currentStripeMetadata = NULL;
+	}
+
+	readState->parallelClaimPending = true;
+	readState->parallelStripeIndex = 0;
+	readState->parallelLastRowNumber = COLUMNAR_INVALID_ROW_NUMBER;
+}
+
+
+/*
+ * ClaimNextParallelStripe claims the next stripe to read from the shared
+ * state of a parallel scan and returns it, or returns NULL if all stripes
+ * have already been claimed.
+ *
+ * All participants use the same snapshot, so they see the same row number
+ * ordered list of stripes and a stripe can be identified by its position in
+ * that list. Each participant walks through the list on its own, which only
+ * requires reading stripe metadata for the stripes claimed by others.
+ */
+static StripeMetadata *
+ClaimNextParallelStripe(ColumnarReadState *readState)
+{
+	uint64 claimedStripeIndex =
+		pg_atomic_fetch_add_u64(&readState->parallelScan->nextStripeIndex, 1);
+
+	while (true)
+	{
+		StripeMetadata *stripeMetadata =
+			FindNextFlushedStripe(readState, readState->parallelLastRowNumber);
+		if (stripeMetadata == NULL)
+		{
+			return NULL;
+		}
+
+		uint64 stripeIndex = readState->parallelStripeIndex++;
+		readState->parallelLastRowNumber = StripeGetHighestRowNumber(stripeMetadata);
+
+		if (stripeIndex == claimedStripeIndex)
+		{
+			return stripeMetadata;
+		}
+
+		/* stripe was claimed by another participant */
+		Assert(stripeIndex < claimedStripeIndex);
+		pfree(stripeMetadata);
+	}
 }
 
 
@@ -768,19 +1332,24 @@ SnapshotMightSeeUnflushedStripes(Snapshot snapshot)
  * On entry, all entries in columnNulls should be true; this function only
  * sets non-NULL entries.
  *
+ * Note that currentRow also accounts for the rows skipped by vectorized
+ * quals, so it always points to the row after the one returned last.
+ *
+ * If a chunk group batch consumer is given, whole chunk groups are passed to
+ * it instead and no rows are returned.
  */
 static bool
 ReadStripeNextRow(StripeReadState *stripeReadState, Datum *columnValues,
 				  bool *columnNulls)
 {
-	if (stripeReadState->currentRow >= stripeReadState->rowCount)
-	{
-		Assert(stripeReadState->currentRow == stripeReadState->rowCount);
-		return false;
-	}
-
 	while (true)
 	{
+		if (stripeReadState->currentRow >= stripeReadState->rowCount)
+		{
+			Assert(stripeReadState->currentRow == stripeReadState->rowCount);
+			return false;
+		}
+
 		if (stripeReadState->chunkGroupReadState == NULL)
 		{
 			stripeReadState->chunkGroupReadState = BeginChunkGroupRead(
@@ -792,11 +1361,30 @@ ReadStripeNextRow(StripeReadState *stripeReadState, Datum *columnValues,
 				stripeReadState->
 				projectedColumnList,
 				stripeReadState->
+				vectorizedQualList,
+				stripeReadState->
 				stripeReadContext);
 		}
 
-		if (!ReadChunkGroupNextRow(stripeReadState->chunkGroupReadState, columnValues,
-								   columnNulls))
+		ChunkGroupReadState *chunkGroupReadState = stripeReadState->chunkGroupReadState;
+		int64 chunkGroupRowBefore = chunkGroupReadState->currentRow;
+
+		bool rowFound = false;
+		if (stripeReadState->chunkGroupBatchConsumer != NULL)
+		{
+			ConsumeChunkGroupBatch(chunkGroupReadState,
+								   stripeReadState->chunkGroupBatchConsumer);
+		}
+		else
+		{
+			rowFound = ReadChunkGroupNextRow(chunkGroupReadState, columnValues,
+											 columnNulls);
+		}
+
+		stripeReadState->currentRow +=
+			chunkGroupReadState->currentRow - chunkGroupRowBefore;
+
+		if (!rowFound)
 		{
 			/* if this chunk group is exhausted, fetch the next one and loop */
 			EndChunkGroupRead(stripeReadState->chunkGroupReadState);
@@ -805,7 +1393,6 @@ ReadStripeNextRow(StripeReadState *stripeReadState, Datum *columnValues,
 			continue;
 		}
 
-		stripeReadState->currentRow++;
 		return true;
 	}
 
@@ -819,7 +1406,8 @@ ReadStripeNextRow(StripeReadState *stripeReadState, Datum *columnValues,
  */
 static ChunkGroupReadState *
 BeginChunkGroupRead(StripeBuffers *stripeBuffers, int chunkIndex, TupleDesc tupleDesc,
-					List *projectedColumnList, MemoryContext cxt)
+					List *projectedColumnList, List *vectorizedQualList,
+					MemoryContext cxt)
 {
 	uint32 chunkGroupRowCount =
 		stripeBuffers->selectedChunkGroupRowCounts[chunkIndex];
@@ -833,10 +1421,21 @@ BeginChunkGroupRead(StripeBuffers *stripeBuffers, int chunkIndex, TupleDesc tupl
 	chunkGroupReadState->columnCount = tupleDesc->natts;
 	chunkGroupReadState->projectedColumnList = projectedColumnList;
 
-	chunkGroupReadState->chunkGroupData = DeserializeChunkData(stripeBuffers, chunkIndex,
-															   chunkGroupRowCount,
-															   tupleDesc,
-															   projectedColumnList);
+	if (vectorizedQualList == NIL)
+	{
+		chunkGroupReadState->chunkGroupData =
+			DeserializeChunkData(stripeBuffers, chunkIndex, chunkGroupRowCount,
+								 tupleDesc, projectedColumnList);
+	}
+	else
+	{
+		chunkGroupReadState->chunkGroupData =
+			DeserializeChunkDataLate(stripeBuffers, chunkIndex, chunkGroupRowCount,
+									 tupleDesc, projectedColumnList,
+									 vectorizedQualList,
+									 &chunkGroupReadState->selectionMask);
+	}
+
 	MemoryContextSwitchTo(oldContext);
 
 	return chunkGroupReadState;
@@ -850,10 +1449,31 @@ static void
 EndChunkGroupRead(ChunkGroupReadState *chunkGroupReadState)
 {
 	FreeChunkData(chunkGroupReadState->chunkGroupData);
+	if (chunkGroupReadState->selectionMask != NULL)
+	{
+		pfree(chunkGroupReadState->selectionMask);
+	}
 	pfree(chunkGroupReadState);
 }
 
 
+/*
+ * ConsumeChunkGroupBatch passes the column arrays of the chunk group and the
+ * rows of it that satisfy the vectorized quals to given consumer, and marks
+ * all rows of the chunk group as read.
+ */
+static void
+ConsumeChunkGroupBatch(ChunkGroupReadState *chunkGroupReadState,
+					   ChunkGroupBatchConsumer *chunkGroupBatchConsumer)
+{
+	chunkGroupBatchConsumer->callback(chunkGroupReadState->chunkGroupData,
+									  chunkGroupReadState->selectionMask,
+									  chunkGroupBatchConsumer->arg);
+
+	chunkGroupReadState->currentRow = chunkGroupReadState->rowCount;
+}
+
+
 /*
  * ReadChunkGroupNextRow: if more rows can be read from the current chunk
  * group, fill in non-NULL columnValues and return true. Otherwise, return
@@ -861,11 +1481,23 @@ EndChunkGroupRead(ChunkGroupReadState *chunkGroupReadState)
  *
  * On entry, all entries in columnNulls should be true; this function only
  * sets non-NULL entries.
+ *
+ * Rows that are filtered out by vectorized quals are skipped.
  */
 static bool
 ReadChunkGroupNextRow(ChunkGroupReadState *chunkGroupReadState, Datum *columnValues,
 					  bool *columnNulls)
 {
+	const bool *selectionMask = chunkGroupReadState->selectionMask;
+	if (selectionMask != NULL)
+	{
+		while (chunkGroupReadState->currentRow < chunkGroupReadState->rowCount &&
+			   !selectionMask[chunkGroupReadState->currentRow])
+		{
+			chunkGroupReadState->currentRow++;
+		}
+	}
+
 	if (chunkGroupReadState->currentRow >= chunkGroupReadState->rowCount)
 	{
 		Assert(chunkGroupReadState->currentRow == chunkGroupReadState->rowCount);
@@ -1000,11 +1632,17 @@ ColumnarTableRowCount(Relation relation)
  * LoadFilteredStripeBuffers reads serialized stripe data from the given file.
  * The function skips over chunks whose rows are refuted by restriction qualifiers,
  * and only loads columns that are projected in the query.
+ *
+ * If selectedChunkSkipList is not NULL, then PrefetchNextStripe already
+ * selected and prefetched the chunks to read, and accounted for the chunk
+ * groups that it filtered. Otherwise, we select the chunks here.
  */
 static StripeBuffers *
 LoadFilteredStripeBuffers(Relation relation, StripeMetadata *stripeMetadata,
 						  TupleDesc tupleDescriptor, List *projectedColumnList,
 						  List *whereClauseList, List *whereClauseVars,
+						  StripeSkipList *selectedChunkSkipList,
+						  CoveredChunkGroupConsumer *coveredChunkGroupConsumer,
 						  int64 *chunkGroupsFiltered, Snapshot snapshot)
 {
 	uint32 columnIndex = 0;
@@ -1012,18 +1650,24 @@ LoadFilteredStripeBuffers(Relation relation, StripeMetadata *stripeMetadata,
 
 	bool *projectedColumnMask = ProjectedColumnMask(columnCount, projectedColumnList);
 
-	StripeSkipList *stripeSkipList = ReadStripeSkipList(relation->rd_node,
-														stripeMetadata->id,
-														tupleDescriptor,
-														stripeMetadata->chunkCount,
-														snapshot);
-
-	bool *selectedChunkMask = SelectedChunkMask(stripeSkipList, whereClauseList,
-												whereClauseVars, chunkGroupsFiltered);
+	if (selectedChunkSkipList == NULL)
+	{
+		selectedChunkSkipList = SelectStripeChunks(relation, stripeMetadata,
+												   tupleDescriptor, projectedColumnMask,
+												   whereClauseList, whereClauseVars,
+												   coveredChunkGroupConsumer,
+												   chunkGroupsFiltered, snapshot);
 
-	StripeSkipList *selectedChunkSkipList =
-		SelectedChunkSkipList(stripeSkipList, projectedColumnMask,
-							  selectedChunkMask);
+		/*
+		 * We read the projected columns one by one below, so let the kernel
+		 * fetch all of them at once.
+		 */
+		if (ColumnarPrefetchEnabled(relation))
+		{
+			PrefetchStripeChunks(relation, stripeMetadata, selectedChunkSkipList,
+								 projectedColumnMask);
+		}
+	}
 
 	/* load column data for projected columns */
 	ColumnBuffers **columnBuffersArray = palloc0(columnCount * sizeof(ColumnBuffers *));
@@ -1057,6 +1701,192 @@ LoadFilteredStripeBuffers(Relation relation, StripeMetadata *stripeMetadata,
 }
 
 
+/*
+ * SelectStripeChunks returns the skip list for the chunks that we need to read
+ * from given stripe, i.e., chunks of the projected columns in the chunk groups
+ * that are not refuted by the restriction qualifiers.
+ *
+ * If coveredChunkGroupConsumer is given, the chunk groups that are fully
+ * covered by the restriction qualifiers are passed to it and are not read
+ * if it consumes them.
+ */
+static StripeSkipList *
+SelectStripeChunks(Relation relation, StripeMetadata *stripeMetadata,
+				   TupleDesc tupleDescriptor, bool *projectedColumnMask,
+				   List *whereClauseList, List *whereClauseVars,
+				   CoveredChunkGroupConsumer *coveredChunkGroupConsumer,
+				   int64 *chunkGroupsFiltered, Snapshot snapshot)
+{
+	StripeSkipList *stripeSkipList = ReadStripeSkipList(relation->rd_node,
+														stripeMetadata->id,
+														tupleDescriptor,
+														stripeMetadata->chunkCount,
+														snapshot);
+
+	bool *selectedChunkMask = SelectedChunkMask(stripeSkipList, whereClauseList,
+												whereClauseVars, chunkGroupsFiltered);
+
+	if (coveredChunkGroupConsumer != NULL)
+	{
+		for (uint32 chunkIndex = 0; chunkIndex < stripeSkipList->chunkCount;
+			 chunkIndex++)
+		{
+			if (selectedChunkMask[chunkIndex] &&
+				ChunkGroupCoveredByQuals(relation, stripeMetadata, stripeSkipList,
+										 chunkIndex, whereClauseList,
+										 whereClauseVars) &&
+				coveredChunkGroupConsumer->callback(stripeMetadata, stripeSkipList,
+													chunkIndex,
+													coveredChunkGroupConsumer->arg))
+			{
+				selectedChunkMask[chunkIndex] = false;
+			}
+		}
+	}
+
+	return SelectedChunkSkipList(stripeSkipList, projectedColumnMask,
+								 selectedChunkMask);
+}
+
+
+/*
+ * ChunkGroupCoveredByQuals returns true if the skip list of given chunk group
+ * proves that all of its rows satisfy the restriction qualifiers. For that,
+ * the min/max ranges of the filtered columns need to imply the qualifiers,
+ * and none of those columns can have NULLs in the chunk group since the
+ * ranges only describe the non-NULL values.
+ */
+static bool
+ChunkGroupCoveredByQuals(Relation relation, StripeMetadata *stripeMetadata,
+						 StripeSkipList *stripeSkipList, uint32 chunkIndex,
+						 List *whereClauseList, List *whereClauseVars)
+{
+	List *constraintList = NIL;
+
+	ListCell *columnCell = NULL;
+	foreach(columnCell, whereClauseVars)
+	{
+		Var *column = lfirst(columnCell);
+		uint32 columnIndex = column->varattno - 1;
+
+		/* columns added after writing the stripe only have the default value */
+		if (columnIndex >= stripeMetadata->columnCount)
+		{
+			return false;
+		}
+
+		ColumnChunkSkipNode *chunkSkipNode =
+			&stripeSkipList->chunkSkipNodeArray[columnIndex][chunkIndex];
+		if (!chunkSkipNode->hasMinMax)
+		{
+			return false;
+		}
+
+		Node *baseConstraint = BuildBaseConstraint(column);
+		UpdateConstraint(baseConstraint, chunkSkipNode->minimumValue,
+						 chunkSkipNode->maximumValue);
+
+		constraintList = lappend(constraintList, baseConstraint);
+	}
+
+	if (!predicate_implied_by(whereClauseList, constraintList, false))
+	{
+		return false;
+	}
+
+	/* only read the "exists" chunks once we know that they matter */
+	uint32 rowCount = stripeSkipList->chunkGroupRowCounts[chunkIndex];
+	foreach(columnCell, whereClauseVars)
+	{
+		Var *column = lfirst(columnCell);
+		uint32 columnIndex = column->varattno - 1;
+
+		ColumnChunkSkipNode *chunkSkipNode =
+			&stripeSkipList->chunkSkipNodeArray[columnIndex][chunkIndex];
+		if (ChunkContainsNulls(relation, stripeMetadata, chunkSkipNode, rowCount))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * ChunkContainsNulls reads the "exists" chunk described by given skip node
+ * and returns true if any of its rows is NULL.
+ */
+static bool
+ChunkContainsNulls(Relation relation, StripeMetadata *stripeMetadata,
+				   ColumnChunkSkipNode *chunkSkipNode, uint32 rowCount)
+{
+	StringInfo existsBuffer = makeStringInfo();
+	enlargeStringInfo(existsBuffer, chunkSkipNode->existsLength);
+	existsBuffer->len = chunkSkipNode->existsLength;
+	ColumnarStorageRead(relation,
+						stripeMetadata->fileOffset + chunkSkipNode->existsChunkOffset,
+						existsBuffer->data, chunkSkipNode->existsLength);
+
+	bool *existsArray = palloc0(rowCount * sizeof(bool));
+	DeserializeBoolArray(existsBuffer, existsArray, rowCount);
+
+	bool containsNulls = false;
+	for (uint32 rowIndex = 0; rowIndex < rowCount; rowIndex++)
+	{
+		if (!existsArray[rowIndex])
+		{
+			containsNulls = true;
+			break;
+		}
+	}
+
+	pfree(existsArray);
+	pfree(existsBuffer->data);
+	pfree(existsBuffer);
+
+	return containsNulls;
+}
+
+
+/*
+ * PrefetchStripeChunks issues prefetch requests for the "exists" and "values"
+ * chunks that LoadColumnBuffers would read for the projected columns in
+ * selectedChunkSkipList.
+ */
+static void
+PrefetchStripeChunks(Relation relation, StripeMetadata *stripeMetadata,
+					 StripeSkipList *selectedChunkSkipList, bool *projectedColumnMask)
+{
+	for (uint32 columnIndex = 0; columnIndex < stripeMetadata->columnCount;
+		 columnIndex++)
+	{
+		if (!projectedColumnMask[columnIndex])
+		{
+			continue;
+		}
+
+		ColumnChunkSkipNode *chunkSkipNodeArray =
+			selectedChunkSkipList->chunkSkipNodeArray[columnIndex];
+
+		for (uint32 chunkIndex = 0; chunkIndex < selectedChunkSkipList->chunkCount;
+			 chunkIndex++)
+		{
+			ColumnChunkSkipNode *chunkSkipNode = &chunkSkipNodeArray[chunkIndex];
+
+			ColumnarStoragePrefetch(relation,
+									stripeMetadata->fileOffset +
+									chunkSkipNode->existsChunkOffset,
+									chunkSkipNode->existsLength);
+			ColumnarStoragePrefetch(relation,
+									stripeMetadata->fileOffset +
+									chunkSkipNode->valueChunkOffset,
+									chunkSkipNode->valueLength);
+		}
+	}
+}
+
+
 /*
  * LoadColumnBuffers reads serialized column data from the given file. These
  * column data are laid out as sequential chunks in the file; and chunk positions
@@ -1110,6 +1940,8 @@ LoadColumnBuffers(Relation relation, ColumnChunkSkipNode *chunkSkipNodeArray,
 
 		chunkBuffersArray[chunkIndex]->valueBuffer = rawValueBuffer;
 		chunkBuffersArray[chunkIndex]->valueCompressionType = compressionType;
+		chunkBuffersArray[chunkIndex]->valueEncodingType =
+			chunkSkipNode->valueEncodingType;
 		chunkBuffersArray[chunkIndex]->decompressedValueSize =
 			chunkSkipNode->decompressedValueSize;
 	}
@@ -1180,10 +2012,145 @@ SelectedChunkMask(StripeSkipList *stripeSkipList, List *whereClauseList,
 		}
 	}
 
+	FilterChunksByMembership(stripeSkipList, whereClauseList, selectedChunkMask,
+							 chunkGroupsFiltered);
+
 	return selectedChunkMask;
 }
 
 
+/*
+ * FilterChunksByMembership deselects the chunks that certainly don't contain
+ * the constant of a "Var = Const" qual, based on the distinct value sets and
+ * bloom filters built for the columns in the bloom_filter_columns option.
+ * This complements min/max filtering for high cardinality columns that are
+ * not sorted, where min/max ranges of chunks overlap heavily.
+ */
+static void
+FilterChunksByMembership(StripeSkipList *stripeSkipList, List *whereClauseList,
+						 bool *selectedChunkMask, int64 *chunkGroupsFiltered)
+{
+	Expr *clause = NULL;
+	foreach_ptr(clause, whereClauseList)
+	{
+		if (!IsA(clause, OpExpr) || list_length(((OpExpr *) clause)->args) != 2)
+		{
+			continue;
+		}
+
+		OpExpr *opExpr = (OpExpr *) clause;
+		Node *leftOperand = linitial(opExpr->args);
+		Node *rightOperand = lsecond(opExpr->args);
+		Var *column = NULL;
+		Const *constant = NULL;
+
+		if (IsA(leftOperand, Var) && IsA(rightOperand, Const))
+		{
+			column = (Var *) leftOperand;
+			constant = (Const *) rightOperand;
+		}
+		else if (IsA(leftOperand, Const) && IsA(rightOperand, Var))
+		{
+			column = (Var *) rightOperand;
+			constant = (Const *) leftOperand;
+		}
+		else
+		{
+			continue;
+		}
+
+		/* hashes of values of different types are not comparable */
+		if (constant->constisnull || constant->consttype != column->vartype ||
+			column->varattno <= 0 || column->varattno > stripeSkipList->columnCount)
+		{
+			continue;
+		}
+
+		Oid operatorClassId = GetDefaultOpClass(column->vartype, BTREE_AM_OID);
+		if (!OidIsValid(operatorClassId) ||
+			get_op_opfamily_strategy(opExpr->opno,
+									 get_opclass_family(operatorClassId)) !=
+			BTEqualStrategyNumber)
+		{
+			continue;
+		}
+
+		FmgrInfo equalityFunction;
+		fmgr_info(get_opcode(opExpr->opno), &equalityFunction);
+
+		/*
+		 * Bloom filters were built using the column's collation, so they can
+		 * only be used when the qual compares using the same collation.
+		 */
+		FmgrInfo *hashFunction = NULL;
+		if (opExpr->inputcollid == column->varcollid)
+		{
+			hashFunction = GetFunctionInfoOrNull(column->vartype, HASH_AM_OID,
+												 HASHSTANDARD_PROC);
+		}
+
+		ColumnChunkSkipNode *chunkSkipNodeArray =
+			stripeSkipList->chunkSkipNodeArray[column->varattno - 1];
+
+		for (uint32 chunkIndex = 0; chunkIndex < stripeSkipList->chunkCount;
+			 chunkIndex++)
+		{
+			if (!selectedChunkMask[chunkIndex])
+			{
+				continue;
+			}
+
+			if (!ChunkMightContainValue(&chunkSkipNodeArray[chunkIndex],
+										constant->constvalue, &equalityFunction,
+										hashFunction, opExpr->inputcollid))
+			{
+				selectedChunkMask[chunkIndex] = false;
+				*chunkGroupsFiltered += 1;
+			}
+		}
+	}
+}
+
+
+/*
+ * ChunkMightContainValue returns false if the membership information of the
+ * given column chunk proves that no value in the chunk equals the given value.
+ * hashFunction is NULL when the bloom filter cannot be used.
+ */
+static bool
+ChunkMightContainValue(ColumnChunkSkipNode *chunkSkipNode, Datum value,
+					   FmgrInfo *equalityFunction, FmgrInfo *hashFunction,
+					   Oid collationId)
+{
+	if (chunkSkipNode->hasDistinctValues)
+	{
+		for (uint32 valueIndex = 0; valueIndex < chunkSkipNode->distinctValueCount;
+			 valueIndex++)
+		{
+			Datum equalityDatum =
+				FunctionCall2Coll(equalityFunction, collationId,
+								  chunkSkipNode->distinctValues[valueIndex], value);
+			if (DatumGetBool(equalityDatum))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	if (chunkSkipNode->bloomFilter != NULL && hashFunction != NULL)
+	{
+		uint32 hashValue = DatumGetUInt32(FunctionCall1Coll(hashFunction, collationId,
+															 value));
+
+		return ColumnarBloomFilterMightContain(chunkSkipNode->bloomFilter, hashValue);
+	}
+
+	return true;
+}
+
+
 /*
  * GetFunctionInfoOrNull first resolves the operator for the given data type,
  * access method, and support procedure. The function then uses the resolved
@@ -1582,18 +2549,107 @@ DeserializeChunkData(StripeBuffers *stripeBuffers, uint64 chunkIndex,
 					 uint32 rowCount, TupleDesc tupleDescriptor,
 					 List *projectedColumnList)
 {
-	int columnIndex = 0;
 	bool *columnMask = ProjectedColumnMask(tupleDescriptor->natts, projectedColumnList);
 	ChunkData *chunkData = CreateEmptyChunkData(tupleDescriptor->natts, columnMask,
 												rowCount);
 
+	DeserializeChunkColumns(stripeBuffers, chunkIndex, rowCount, tupleDescriptor,
+							columnMask, chunkData);
+
+	return chunkData;
+}
+
+
+/*
+ * DeserializeChunkDataLate is the late materialization variant of
+ * DeserializeChunkData. It first deserializes only the columns referenced by
+ * the vectorized quals and evaluates the quals over them. The remaining
+ * projected columns are decompressed and deserialized only if some rows of
+ * the chunk group satisfy the quals, which saves decompressing wide payload
+ * columns for chunk groups whose rows are all thrown away.
+ *
+ * The rows satisfying the quals are returned in selectionMask.
+ */
+static ChunkData *
+DeserializeChunkDataLate(StripeBuffers *stripeBuffers, uint64 chunkIndex,
+						 uint32 rowCount, TupleDesc tupleDescriptor,
+						 List *projectedColumnList, List *vectorizedQualList,
+						 bool **selectionMask)
+{
+	uint32 columnCount = tupleDescriptor->natts;
+	bool *columnMask = ProjectedColumnMask(columnCount, projectedColumnList);
+	ChunkData *chunkData = CreateEmptyChunkData(columnCount, columnMask, rowCount);
+
+	bool *qualColumnMask = palloc0(columnCount * sizeof(bool));
+
+	VectorizedQual *vectorizedQual = NULL;
+	foreach_ptr(vectorizedQual, vectorizedQualList)
+	{
+		uint32 columnIndex = vectorizedQual->columnIndex;
+		if (columnIndex < columnCount && columnMask[columnIndex])
+		{
+			qualColumnMask[columnIndex] = true;
+		}
+	}
+
+	DeserializeChunkColumns(stripeBuffers, chunkIndex, rowCount, tupleDescriptor,
+							qualColumnMask, chunkData);
+
+	*selectionMask = EvaluateVectorizedQuals(chunkData, vectorizedQualList);
+
+	bool anyRowSelected = false;
+	for (uint32 rowIndex = 0; rowIndex < rowCount; rowIndex++)
+	{
+		if ((*selectionMask)[rowIndex])
+		{
+			anyRowSelected = true;
+			break;
+		}
+	}
+
+	if (anyRowSelected)
+	{
+		/* materialize the rest of the projected columns */
+		for (uint32 columnIndex = 0; columnIndex < columnCount; columnIndex++)
+		{
+			columnMask[columnIndex] = columnMask[columnIndex] &&
+									  !qualColumnMask[columnIndex];
+		}
+
+		DeserializeChunkColumns(stripeBuffers, chunkIndex, rowCount, tupleDescriptor,
+								columnMask, chunkData);
+	}
+
+	pfree(qualColumnMask);
+	pfree(columnMask);
+
+	return chunkData;
+}
+
+
+/*
+ * DeserializeChunkColumns fills in the value and exists arrays of chunkData
+ * for the columns marked in columnMask, decompressing their data if needed.
+ */
+static void
+DeserializeChunkColumns(StripeBuffers *stripeBuffers, uint64 chunkIndex,
+						uint32 rowCount, TupleDesc tupleDescriptor,
+						bool *columnMask, ChunkData *chunkData)
+{
+	int columnIndex = 0;
+
 	for (columnIndex = 0; columnIndex < stripeBuffers->columnCount; columnIndex++)
 	{
 		Form_pg_attribute attributeForm = TupleDescAttr(tupleDescriptor, columnIndex);
 		ColumnBuffers *columnBuffers = stripeBuffers->columnBuffersArray[columnIndex];
 		bool columnAdded = false;
 
-		if (columnBuffers == NULL && columnMask[columnIndex])
+		if (!columnMask[columnIndex])
+		{
+			continue;
+		}
+
+		if (columnBuffers == NULL)
 		{
 			columnAdded = true;
 		}
@@ -1603,12 +2659,19 @@ DeserializeChunkData(StripeBuffers *stripeBuffers, uint64 chunkIndex,
 			ColumnChunkBuffers *chunkBuffers =
 				columnBuffers->chunkBuffersArray[chunkIndex];
 
-			/* decompress and deserialize current chunk's data */
+			/* decompress, decode and deserialize current chunk's data */
 			StringInfo valueBuffer =
 				DecompressBuffer(chunkBuffers->valueBuffer,
 								 chunkBuffers->valueCompressionType,
 								 chunkBuffers->decompressedValueSize);
 
+			if (chunkBuffers->valueEncodingType != ENCODING_NONE)
+			{
+				valueBuffer = DecodeBuffer(valueBuffer,
+										   chunkBuffers->valueEncodingType,
+										   attributeForm);
+			}
+
 			DeserializeBoolArray(chunkBuffers->existsBuffer,
 								 chunkData->existsArray[columnIndex],
 								 rowCount);
@@ -1646,8 +2709,6 @@ DeserializeChunkData(StripeBuffers *stripeBuffers, uint64 chunkIndex,
 			}
 		}
 	}
-
-	return chunkData;
 }
 
 
@@ -1688,3 +2749,357 @@ ColumnDefaultValue(TupleConstr *tupleConstraints, Form_pg_attribute attributeFor
 								"does not evaluate to constant value")));
 	}
 }
+
+
+/*
+ * BuildVectorizedQualList returns a list of VectorizedQual's for the clauses
+ * in whereClauseList that are in the form of "Var <op> Const" (or
+ * "Const <op> Var"), so that they can be evaluated over the value arrays of
+ * whole chunk groups. Other clauses are simply ignored since they are
+ * anyway evaluated by the executor for the rows that we return.
+ *
+ * Returns NIL if columnar.enable_vectorized_filter is not set.
+ */
+static List *
+BuildVectorizedQualList(List *whereClauseList)
+{
+	if (!columnar_enable_vectorized_filter)
+	{
+		return NIL;
+	}
+
+	List *vectorizedQualList = NIL;
+
+	Expr *clause = NULL;
+	foreach_ptr(clause, whereClauseList)
+	{
+		VectorizedQual *vectorizedQual = BuildVectorizedQual(clause);
+		if (vectorizedQual != NULL)
+		{
+			vectorizedQualList = lappend(vectorizedQualList, vectorizedQual);
+		}
+	}
+
+	return vectorizedQualList;
+}
+
+
+/*
+ * BuildVectorizedQual returns a VectorizedQual for given clause if it can be
+ * evaluated over a whole chunk group at once, or NULL otherwise.
+ */
+static VectorizedQual *
+BuildVectorizedQual(Expr *clause)
+{
+	if (!IsA(clause, OpExpr) || list_length(((OpExpr *) clause)->args) != 2)
+	{
+		return NULL;
+	}
+
+	OpExpr *opExpr = (OpExpr *) clause;
+	Node *leftOperand = linitial(opExpr->args);
+	Node *rightOperand = lsecond(opExpr->args);
+
+	Var *var = NULL;
+	Const *constant = NULL;
+	bool varOnLeft = false;
+
+	if (IsA(leftOperand, Var) && IsA(rightOperand, Const))
+	{
+		var = (Var *) leftOperand;
+		constant = (Const *) rightOperand;
+		varOnLeft = true;
+	}
+	else if (IsA(leftOperand, Const) && IsA(rightOperand, Var))
+	{
+		var = (Var *) rightOperand;
+		constant = (Const *) leftOperand;
+		varOnLeft = false;
+	}
+	else
+	{
+		return NULL;
+	}
+
+	/*
+	 * Filtering rows based on a NULL constant would be correct for strict
+	 * operators, but let the executor deal with such rare cases.
+	 */
+	if (var->varattno <= 0 || constant->constisnull)
+	{
+		return NULL;
+	}
+
+	Oid operatorClassId = GetDefaultOpClass(var->vartype, BTREE_AM_OID);
+	if (operatorClassId == InvalidOid)
+	{
+		return NULL;
+	}
+
+	Oid operatorFamilyId = get_opclass_family(operatorClassId);
+	int16 strategyNumber = get_op_opfamily_strategy(opExpr->opno, operatorFamilyId);
+	if (strategyNumber == InvalidStrategy)
+	{
+		return NULL;
+	}
+
+	/* normalize the strategy to "Var <op> Const" form */
+	if (!varOnLeft)
+	{
+		strategyNumber = BTCommuteStrategyNumber(strategyNumber);
+	}
+
+	VectorizedQual *vectorizedQual = palloc0(sizeof(VectorizedQual));
+	vectorizedQual->columnIndex = var->varattno - 1;
+	vectorizedQual->strategyNumber = strategyNumber;
+	vectorizedQual->varOnLeft = varOnLeft;
+	vectorizedQual->constValue = constant->constvalue;
+	vectorizedQual->collationId = opExpr->inputcollid;
+
+	bool integerTypes = IsVectorizableIntegerType(var->vartype) &&
+						IsVectorizableIntegerType(constant->consttype);
+	bool sameDateTimeType = var->vartype == constant->consttype &&
+							(var->vartype == DATEOID ||
+							 var->vartype == TIMESTAMPOID ||
+							 var->vartype == TIMESTAMPTZOID);
+
+	if (integerTypes || sameDateTimeType)
+	{
+		vectorizedQual->useIntegerComparison = true;
+		vectorizedQual->columnIsInt64 = var->vartype == INT8OID ||
+										var->vartype == TIMESTAMPOID ||
+										var->vartype == TIMESTAMPTZOID;
+		vectorizedQual->integerConstValue =
+			IntegerDatumGetInt64(constant->constvalue, constant->consttype);
+	}
+	else
+	{
+		fmgr_info(opExpr->opfuncid, &vectorizedQual->operatorFunction);
+	}
+
+	return vectorizedQual;
+}
+
+
+/*
+ * IsVectorizableIntegerType returns true if values of given type are stored
+ * as plain integers that can be compared with each other as int64's.
+ */
+static bool
+IsVectorizableIntegerType(Oid typeId)
+{
+	return typeId == INT2OID || typeId == INT4OID || typeId == INT8OID;
+}
+
+
+/*
+ * IntegerDatumGetInt64 converts given datum to int64 based on its type.
+ * Caller should make sure that the type is an integer-like type that is
+ * supported by vectorized quals.
+ */
+static int64
+IntegerDatumGetInt64(Datum datum, Oid typeId)
+{
+	switch (typeId)
+	{
+		case INT2OID:
+		{
+			return DatumGetInt16(datum);
+		}
+
+		case INT4OID:
+		case DATEOID:
+		{
+			return DatumGetInt32(datum);
+		}
+
+		case INT8OID:
+		case TIMESTAMPOID:
+		case TIMESTAMPTZOID:
+		{
+			return DatumGetInt64(datum);
+		}
+
+		default:
+		{
+			ereport(ERROR, (errmsg("unexpected type %u for vectorized qual", typeId)));
+		}
+	}
+}
+
+
+/*
+ * EvaluateVectorizedQuals evaluates given vectorized quals over the value
+ * arrays of given chunk group and returns a boolean array marking the rows
+ * that satisfy all of them. Returns NULL if there are no quals to evaluate.
+ */
+static bool *
+EvaluateVectorizedQuals(ChunkData *chunkData, List *vectorizedQualList)
+{
+	if (vectorizedQualList == NIL)
+	{
+		return NULL;
+	}
+
+	uint32 rowCount = chunkData->rowCount;
+	bool *selectionMask = palloc(rowCount * sizeof(bool));
+	memset(selectionMask, true, rowCount * sizeof(bool));
+
+	VectorizedQual *vectorizedQual = NULL;
+	foreach_ptr(vectorizedQual, vectorizedQualList)
+	{
+		uint32 columnIndex = vectorizedQual->columnIndex;
+		if (columnIndex >= chunkData->columnCount ||
+			chunkData->valueArray[columnIndex] == NULL)
+		{
+			/* column is not projected, let the executor evaluate the qual */
+			continue;
+		}
+
+		bool *existsArray = chunkData->existsArray[columnIndex];
+		Datum *valueArray = chunkData->valueArray[columnIndex];
+
+		if (vectorizedQual->useIntegerComparison)
+		{
+			ApplyIntegerQual(vectorizedQual, selectionMask, existsArray, valueArray,
+							 rowCount);
+		}
+		else
+		{
+			ApplyGenericQual(vectorizedQual, selectionMask, existsArray, valueArray,
+							 rowCount);
+		}
+	}
+
+	return selectionMask;
+}
+
+
+/*
+ * ApplyIntegerQual unsets the entries of selectionMask for the rows that
+ * don't satisfy given integer comparison. The comparison is done in
+ * branch-free loops over a flat int64 array so that compilers can vectorize
+ * them.
+ */
+static void
+ApplyIntegerQual(VectorizedQual *vectorizedQual, bool *selectionMask,
+				 bool *existsArray, Datum *valueArray, uint32 rowCount)
+{
+	int64 constValue = vectorizedQual->integerConstValue;
+	int64 *integerValues = palloc(rowCount * sizeof(int64));
+	uint32 rowIndex = 0;
+
+	/* NULL values are stored as 0 in valueArray, existsArray masks them below */
+	if (vectorizedQual->columnIsInt64)
+	{
+		for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+		{
+			integerValues[rowIndex] = DatumGetInt64(valueArray[rowIndex]);
+		}
+	}
+	else
+	{
+		for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+		{
+			integerValues[rowIndex] = DatumGetInt32(valueArray[rowIndex]);
+		}
+	}
+
+	switch (vectorizedQual->strategyNumber)
+	{
+		case BTLessStrategyNumber:
+		{
+			for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+			{
+				selectionMask[rowIndex] &= existsArray[rowIndex] &
+										   (integerValues[rowIndex] < constValue);
+			}
+			break;
+		}
+
+		case BTLessEqualStrategyNumber:
+		{
+			for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+			{
+				selectionMask[rowIndex] &= existsArray[rowIndex] &
+										   (integerValues[rowIndex] <= constValue);
+			}
+			break;
+		}
+
+		case BTEqualStrategyNumber:
+		{
+			for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+			{
+				selectionMask[rowIndex] &= existsArray[rowIndex] &
+										   (integerValues[rowIndex] == constValue);
+			}
+			break;
+		}
+
+		case BTGreaterEqualStrategyNumber:
+		{
+			for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+			{
+				selectionMask[rowIndex] &= existsArray[rowIndex] &
+										   (integerValues[rowIndex] >= constValue);
+			}
+			break;
+		}
+
+		case BTGreaterStrategyNumber:
+		{
+			for (rowIndex = 0; rowIndex < rowCount; rowIndex++)
+			{
+				selectionMask[rowIndex] &= existsArray[rowIndex] &
+										   (integerValues[rowIndex] > constValue);
+			}
+			break;
+		}
+
+		default:
+		{
+			/* not expected, but be on the safe side and don't filter anything */
+			break;
+		}
+	}
+
+	pfree(integerValues);
+}
+
+
+/*
+ * ApplyGenericQual unsets the entries of selectionMask for the rows that
+ * don't satisfy given qual by calling the operator function for each
+ * non-NULL value that is still selected.
+ */
+static void
+ApplyGenericQual(VectorizedQual *vectorizedQual, bool *selectionMask,
+				 bool *existsArray, Datum *valueArray, uint32 rowCount)
+{
+	FmgrInfo *operatorFunction = &vectorizedQual->operatorFunction;
+	Oid collationId = vectorizedQual->collationId;
+	Datum constValue = vectorizedQual->constValue;
+
+	for (uint32 rowIndex = 0; rowIndex < rowCount; rowIndex++)
+	{
+		if (!selectionMask[rowIndex])
+		{
+			continue;
+		}
+
+		if (!existsArray[rowIndex])
+		{
+			/* btree operators are strict, so qual can't be true for NULLs */
+			selectionMask[rowIndex] = false;
+			continue;
+		}
+
+		Datum leftValue = vectorizedQual->varOnLeft ? valueArray[rowIndex] : constValue;
+		Datum rightValue = vectorizedQual->varOnLeft ? constValue : valueArray[rowIndex];
+
+		Datum result = FunctionCall2Coll(operatorFunction, collationId,
+										 leftValue, rightValue);
+		selectionMask[rowIndex] = DatumGetBool(result);
+	}
+}
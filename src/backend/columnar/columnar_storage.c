@@ -492,6 +492,32 @@ ColumnarStorageRead(Relation rel, uint64 logicalOffset, char *data, uint32 amoun
 }
 
 
+/*
+ * ColumnarStoragePrefetch - map the given logical range to blocks and issue
+ * prefetch requests for them, so that a later ColumnarStorageRead of the same
+ * range can find them in shared buffers or in the OS cache.
+ *
+ * This is only a hint, so we don't complain about invalid offsets here and
+ * leave it to ColumnarStorageRead.
+ */
+void
+ColumnarStoragePrefetch(Relation rel, uint64 logicalOffset, uint64 amount)
+{
+	if (amount == 0 || !ColumnarLogicalOffsetIsValid(logicalOffset))
+	{
+		return;
+	}
+
+	PhysicalAddr first = LogicalToPhysical(logicalOffset);
+	PhysicalAddr last = LogicalToPhysical(logicalOffset + amount - 1);
+
+	for (BlockNumber blockno = first.blockno; blockno <= last.blockno; blockno++)
+	{
+		PrefetchBuffer(rel, MAIN_FORKNUM, blockno);
+	}
+}
+
+
 /*
  * ColumnarStorageWrite - map the logical offset to a block and offset, then
  * write the buffer across multiple blocks if necessary.
@@ -41,6 +41,7 @@
 #include "storage/procarray.h"
 #include "storage/smgr.h"
 #include "tcop/utility.h"
+#include "utils/acl.h"
 #include "utils/builtins.h"
 #include "utils/fmgroids.h"
 #include "utils/memutils.h"
@@ -80,6 +81,14 @@ typedef struct ColumnarScanDescData
 	MemoryContext scanContext;
 	Bitmapset *attr_needed;
 	List *scanQual;
+
+	/* set by ColumnarScanSetCoveredChunkGroupCallback, if any */
+	ColumnarCoveredChunkGroupCallback coveredChunkGroupCallback;
+	void *coveredChunkGroupCallbackArg;
+
+	/* set by ColumnarScanSetChunkGroupBatchCallback, if any */
+	ColumnarChunkGroupBatchCallback chunkGroupBatchCallback;
+	void *chunkGroupBatchCallbackArg;
 } ColumnarScanDescData;
 
 
@@ -128,6 +137,10 @@ static bool ConditionalLockRelationWithTimeout(Relation rel, LOCKMODE lockMode,
 static List * NeededColumnsList(TupleDesc tupdesc, Bitmapset *attr_needed);
 static void LogRelationStats(Relation rel, int elevel);
 static void TruncateColumnar(Relation rel, int elevel);
+static int CompactColumnarStripes(Relation rel);
+static bool StripeRunWorthMerging(List *stripeRun, uint64 stripeRowLimit);
+static void MergeStripeRun(Relation rel, List *stripeRun, ColumnarOptions options,
+						   ColumnarReadState *readState);
 static HeapTuple ColumnarSlotCopyHeapTuple(TupleTableSlot *slot);
 static void ColumnarCheckLogicalReplication(Relation rel);
 static Datum * detoast_values(TupleDesc tupleDesc, Datum *orig_values, bool *isnull);
@@ -269,14 +282,16 @@ CreateColumnarScanMemoryContext(void)
 static ColumnarReadState *
 init_columnar_read_state(Relation relation, TupleDesc tupdesc, Bitmapset *attr_needed,
 						 List *scanQual, MemoryContext scanContext, Snapshot snapshot,
-						 bool randomAccess)
+						 bool randomAccess, ParallelTableScanDesc parallelScan)
 {
 	MemoryContext oldContext = MemoryContextSwitchTo(scanContext);
 
 	List *neededColumnList = NeededColumnsList(tupdesc, attr_needed);
 	ColumnarReadState *readState = ColumnarBeginRead(relation, tupdesc, neededColumnList,
 													 scanQual, scanContext, snapshot,
-													 randomAccess);
+													 randomAccess,
+													 (ParallelColumnarScanDesc)
+													 parallelScan);
 
 	MemoryContextSwitchTo(oldContext);
 
@@ -332,7 +347,21 @@ columnar_getnextslot(TableScanDesc sscan, ScanDirection direction, TupleTableSlo
 			init_columnar_read_state(scan->cs_base.rs_rd, slot->tts_tupleDescriptor,
 									 scan->attr_needed, scan->scanQual,
 									 scan->scanContext, scan->cs_base.rs_snapshot,
-									 randomAccess);
+									 randomAccess, scan->cs_base.rs_parallel);
+
+		if (scan->coveredChunkGroupCallback != NULL)
+		{
+			ColumnarReadSetCoveredChunkGroupCallback(scan->cs_readState,
+													 scan->coveredChunkGroupCallback,
+													 scan->coveredChunkGroupCallbackArg);
+		}
+
+		if (scan->chunkGroupBatchCallback != NULL)
+		{
+			ColumnarReadSetChunkGroupBatchCallback(scan->cs_readState,
+												   scan->chunkGroupBatchCallback,
+												   scan->chunkGroupBatchCallbackArg);
+		}
 	}
 
 	ExecClearTuple(slot);
@@ -408,24 +437,45 @@ ErrorIfInvalidRowNumber(uint64 rowNumber)
 }
 
 
+/*
+ * columnar_parallelscan_estimate returns the size of the shared state of a
+ * parallel columnar scan.
+ */
 static Size
 columnar_parallelscan_estimate(Relation rel)
 {
-	elog(ERROR, "columnar_parallelscan_estimate not implemented");
+	return sizeof(ParallelColumnarScanDescData);
 }
 
 
+/*
+ * columnar_parallelscan_initialize initializes the shared state of a
+ * parallel columnar scan, see ClaimNextParallelStripe for how participants
+ * divide the stripes between themselves.
+ */
 static Size
 columnar_parallelscan_initialize(Relation rel, ParallelTableScanDesc pscan)
 {
-	elog(ERROR, "columnar_parallelscan_initialize not implemented");
+	ParallelColumnarScanDesc columnarScan = (ParallelColumnarScanDesc) pscan;
+
+	columnarScan->base.phs_relid = RelationGetRelid(rel);
+	columnarScan->base.phs_syncscan = false;
+	pg_atomic_init_u64(&columnarScan->nextStripeIndex, 0);
+
+	return sizeof(ParallelColumnarScanDescData);
 }
 
 
+/*
+ * columnar_parallelscan_reinitialize resets the shared state of a parallel
+ * columnar scan so that the scan starts over from the first stripe.
+ */
 static void
 columnar_parallelscan_reinitialize(Relation rel, ParallelTableScanDesc pscan)
 {
-	elog(ERROR, "columnar_parallelscan_reinitialize not implemented");
+	ParallelColumnarScanDesc columnarScan = (ParallelColumnarScanDesc) pscan;
+
+	pg_atomic_write_u64(&columnarScan->nextStripeIndex, 0);
 }
 
 
@@ -519,7 +569,7 @@ columnar_index_fetch_tuple(struct IndexFetchTableData *sscan,
 													  slot->tts_tupleDescriptor,
 													  attr_needed, scanQual,
 													  scan->scanContext,
-													  snapshot, randomAccess);
+													  snapshot, randomAccess, NULL);
 	}
 
 	uint64 rowNumber = tid_to_row_number(*tid);
@@ -980,7 +1030,7 @@ columnar_relation_copy_for_cluster(Relation OldHeap, Relation NewHeap,
 	ColumnarReadState *readState = init_columnar_read_state(OldHeap, sourceDesc,
 															attr_needed, scanQual,
 															scanContext, snapshot,
-															randomAccess);
+															randomAccess, NULL);
 
 	Datum *values = palloc0(sourceDesc->natts * sizeof(Datum));
 	bool *nulls = palloc0(sourceDesc->natts * sizeof(bool));
@@ -1458,6 +1508,21 @@ columnar_index_build_range_scan(Relation columnarRelation,
 		ereport(ERROR, (errmsg("BRIN indexes on columnar tables are not supported")));
 	}
 
+	/*
+	 * Stripes of tables with a sort key get sorted when they are flushed,
+	 * so row numbers handed out for index entries would not stay valid.
+	 */
+	ColumnarOptions columnarOptions = { 0 };
+	if (ReadColumnarOptions(RelationGetRelid(columnarRelation), &columnarOptions) &&
+		columnarOptions.sortKey != NULL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("cannot create index on columnar table %s because "
+							   "it has a sort_key",
+							   RelationGetRelationName(columnarRelation)),
+						errhint("Reset columnar.sort_key on the table first.")));
+	}
+
 	if (scan)
 	{
 		/*
@@ -2035,6 +2100,42 @@ ColumnarScanChunkGroupsFiltered(ColumnarScanDesc columnarScanDesc)
 }
 
 
+/*
+ * ColumnarScanSetCoveredChunkGroupCallback sets the callback to pass the chunk
+ * groups that are fully covered by the scan quals to, see
+ * ColumnarReadSetCoveredChunkGroupCallback. Must be called before fetching
+ * the first tuple.
+ */
+void
+ColumnarScanSetCoveredChunkGroupCallback(ColumnarScanDesc columnarScanDesc,
+										 ColumnarCoveredChunkGroupCallback callback,
+										 void *arg)
+{
+	Assert(columnarScanDesc->cs_readState == NULL);
+
+	columnarScanDesc->coveredChunkGroupCallback = callback;
+	columnarScanDesc->coveredChunkGroupCallbackArg = arg;
+}
+
+
+/*
+ * ColumnarScanSetChunkGroupBatchCallback sets the callback to pass the chunk
+ * groups that are read to as a whole, see
+ * ColumnarReadSetChunkGroupBatchCallback. Must be called before fetching the
+ * first tuple.
+ */
+void
+ColumnarScanSetChunkGroupBatchCallback(ColumnarScanDesc columnarScanDesc,
+									   ColumnarChunkGroupBatchCallback callback,
+									   void *arg)
+{
+	Assert(columnarScanDesc->cs_readState == NULL);
+
+	columnarScanDesc->chunkGroupBatchCallback = callback;
+	columnarScanDesc->chunkGroupBatchCallbackArg = arg;
+}
+
+
 /*
  * Implementation of TupleTableSlotOps.copy_heap_tuple for TTSOpsColumnar.
  */
@@ -2731,6 +2832,210 @@ downgrade_columnar_storage(PG_FUNCTION_ARGS)
 }
 
 
+/*
+ * columnar_compact_stripes merges runs of adjacent stripes that have less rows
+ * than stripe_row_limit of the table into full stripes, and returns the
+ * number of stripes that were merged.
+ *
+ * DDL:
+ *   CREATE FUNCTION columnar.compact_stripes(rel regclass)
+ *     RETURNS integer
+ *     STRICT
+ *     LANGUAGE c AS 'MODULE_PATHNAME', 'columnar_compact_stripes';
+ */
+PG_FUNCTION_INFO_V1(columnar_compact_stripes);
+Datum
+columnar_compact_stripes(PG_FUNCTION_ARGS)
+{
+	Oid relid = PG_GETARG_OID(0);
+
+	CheckCitusColumnarVersion(ERROR);
+
+	/*
+	 * SHARE UPDATE EXCLUSIVE LOCK conflicts with VACUUM and with concurrent
+	 * compactions, but neither with reads nor with writes. Since we replace
+	 * the stripes within a regular transaction, concurrent readers keep
+	 * seeing the old stripes until we commit.
+	 */
+	Relation rel = table_open(relid, ShareUpdateExclusiveLock);
+
+	if (!pg_class_ownercheck(relid, GetUserId()))
+	{
+		aclcheck_error(ACLCHECK_NOT_OWNER, OBJECT_TABLE,
+					   RelationGetRelationName(rel));
+	}
+
+	if (!IsColumnarTableAmTable(relid))
+	{
+		ereport(ERROR, (errmsg("table %s is not a columnar table",
+							   quote_identifier(RelationGetRelationName(rel)))));
+	}
+
+	/* merged rows get new row numbers, which would invalidate index entries */
+	if (RelationGetIndexList(rel) != NIL)
+	{
+		ereport(ERROR, (errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+						errmsg("cannot compact stripes of columnar table %s "
+							   "because it has indexes",
+							   quote_identifier(RelationGetRelationName(rel))),
+						errhint("Use VACUUM FULL to rewrite the table instead.")));
+	}
+
+	int mergedStripeCount = CompactColumnarStripes(rel);
+
+	table_close(rel, NoLock);
+
+	PG_RETURN_INT32(mergedStripeCount);
+}
+
+
+/*
+ * CompactColumnarStripes rewrites each run of adjacent stripes that have less
+ * rows than stripe_row_limit into as few stripes as possible, and removes the
+ * metadata of the stripes that it rewrote. Returns the number of stripes that
+ * were merged.
+ *
+ * Merged rows get new row numbers and are written to the end of the storage,
+ * so this doesn't reclaim the space used by the old stripes.
+ */
+static int
+CompactColumnarStripes(Relation rel)
+{
+	bool snapshotRegisteredByUs = false;
+	Snapshot snapshot = ColumnarFlushPendingWritesForSnapshot(rel, GetActiveSnapshot(),
+															  &snapshotRegisteredByUs);
+
+	/* new stripes are written using the current options of the table */
+	ColumnarOptions columnarOptions = { 0 };
+	ReadColumnarOptions(RelationGetRelid(rel), &columnarOptions);
+	uint64 stripeRowLimit = columnarOptions.stripeRowCount;
+
+	/* split stripes into runs of adjacent undersized stripes */
+	List *stripeRunList = NIL;
+	List *stripeRun = NIL;
+	uint64 lastRowNumber = COLUMNAR_INVALID_ROW_NUMBER;
+	StripeMetadata *stripeMetadata = NULL;
+	while ((stripeMetadata = FindNextStripeByRowNumber(rel, lastRowNumber,
+													   snapshot)) != NULL)
+	{
+		lastRowNumber = StripeGetHighestRowNumber(stripeMetadata);
+
+		if (StripeWriteState(stripeMetadata) == STRIPE_WRITE_FLUSHED &&
+			stripeMetadata->rowCount < stripeRowLimit)
+		{
+			stripeRun = lappend(stripeRun, stripeMetadata);
+			continue;
+		}
+
+		stripeRunList = lappend(stripeRunList, stripeRun);
+		stripeRun = NIL;
+	}
+
+	stripeRunList = lappend(stripeRunList, stripeRun);
+
+	/* we need all columns */
+	TupleDesc tupleDesc = RelationGetDescr(rel);
+	Bitmapset *attr_needed = bms_add_range(NULL, 0, tupleDesc->natts - 1);
+
+	/* no quals for stripe compaction */
+	List *scanQual = NIL;
+
+	/* we read the rows of each stripe by their row numbers */
+	bool randomAccess = true;
+
+	MemoryContext scanContext = CreateColumnarScanMemoryContext();
+	ColumnarReadState *readState = init_columnar_read_state(rel, tupleDesc,
+															attr_needed, scanQual,
+															scanContext, snapshot,
+															randomAccess, NULL);
+
+	int mergedStripeCount = 0;
+	foreach_ptr(stripeRun, stripeRunList)
+	{
+		if (!StripeRunWorthMerging(stripeRun, stripeRowLimit))
+		{
+			continue;
+		}
+
+		MergeStripeRun(rel, stripeRun, columnarOptions, readState);
+		mergedStripeCount += list_length(stripeRun);
+	}
+
+	ColumnarEndRead(readState);
+	MemoryContextDelete(scanContext);
+
+	if (snapshotRegisteredByUs)
+	{
+		UnregisterSnapshot(snapshot);
+	}
+
+	return mergedStripeCount;
+}
+
+
+/*
+ * StripeRunWorthMerging returns true if rows of given stripes would fit into
+ * less stripes when merged.
+ */
+static bool
+StripeRunWorthMerging(List *stripeRun, uint64 stripeRowLimit)
+{
+	uint64 totalRowCount = 0;
+
+	StripeMetadata *stripeMetadata = NULL;
+	foreach_ptr(stripeMetadata, stripeRun)
+	{
+		totalRowCount += stripeMetadata->rowCount;
+	}
+
+	uint64 mergedStripeCount = (totalRowCount + stripeRowLimit - 1) / stripeRowLimit;
+
+	return mergedStripeCount < list_length(stripeRun);
+}
+
+
+/*
+ * MergeStripeRun writes the rows of given stripes into new stripes in row
+ * number order, and then removes the metadata of the given stripes.
+ */
+static void
+MergeStripeRun(Relation rel, List *stripeRun, ColumnarOptions options,
+			   ColumnarReadState *readState)
+{
+	TupleDesc tupleDesc = RelationGetDescr(rel);
+	ColumnarWriteState *writeState = ColumnarBeginWrite(rel->rd_node, options,
+														tupleDesc);
+
+	Datum *values = palloc0(tupleDesc->natts * sizeof(Datum));
+	bool *nulls = palloc0(tupleDesc->natts * sizeof(bool));
+
+	StripeMetadata *stripeMetadata = NULL;
+	foreach_ptr(stripeMetadata, stripeRun)
+	{
+		uint64 highestRowNumber = StripeGetHighestRowNumber(stripeMetadata);
+		for (uint64 rowNumber = stripeMetadata->firstRowNumber;
+			 rowNumber <= highestRowNumber; rowNumber++)
+		{
+			CHECK_FOR_INTERRUPTS();
+
+			memset(nulls, true, tupleDesc->natts * sizeof(bool));
+			ColumnarReadRowByRowNumberOrError(readState, rowNumber, values, nulls);
+			ColumnarWriteRow(writeState, values, nulls);
+		}
+	}
+
+	ColumnarEndWrite(writeState);
+
+	foreach_ptr(stripeMetadata, stripeRun)
+	{
+		DeleteStripeMetadataRows(rel->rd_node, stripeMetadata->id);
+	}
+
+	pfree(values);
+	pfree(nulls);
+}
+
+
 /*
  * Code to check the Citus Version, helps remove dependency from Citus
  */
@@ -18,25 +18,42 @@
 
 #include "safe_lib.h"
 
+#include "access/hash.h"
 #include "access/heapam.h"
 #include "access/nbtree.h"
 #include "catalog/pg_am.h"
 #include "miscadmin.h"
+#include "parser/parse_oper.h"
 #include "storage/fd.h"
 #include "storage/smgr.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/relfilenodemap.h"
+#include "utils/sortsupport.h"
 
 #include "columnar/columnar.h"
 #include "columnar/columnar_storage.h"
 #include "columnar/columnar_version_compat.h"
+#include "distributed/listutils.h"
+
+/* BufferedRow is a row of a stripe that waits to be sorted */
+typedef struct BufferedRow
+{
+	Datum *values;
+	bool *nulls;
+
+	/* position among buffered rows, used to keep the sort stable */
+	uint32 rowIndex;
+} BufferedRow;
 
 struct ColumnarWriteState
 {
 	TupleDesc tupleDescriptor;
 	FmgrInfo **comparisonFunctionArray;
+
+	/* hash functions of columns we build bloom filters for, NULL otherwise */
+	FmgrInfo **hashFunctionArray;
 	RelFileNode relfilenode;
 
 	MemoryContext stripeWriteContext;
@@ -56,6 +73,36 @@ struct ColumnarWriteState
 	 * deallocated when memory context is reset.
 	 */
 	StringInfo compressionBuffer;
+
+	/* encodingBuffer is used the same way during value encoding */
+	StringInfo encodingBuffer;
+
+	/*
+	 * Number of parallel workers used to compress the value buffers of a
+	 * stripe when it gets flushed. If zero, value buffers are compressed as
+	 * soon as their chunk is full.
+	 */
+	int parallelCompressionWorkers;
+
+	/*
+	 * Set when pending writes are flushed from a transaction callback, where
+	 * parallel workers cannot be started.
+	 */
+	bool flushingAtTransactionEnd;
+
+	/*
+	 * Sort support for the columns in the sort_key option, NULL if the option
+	 * is not set. If set, rows of the current stripe are buffered in
+	 * bufferedRowArray (in stripeWriteContext) and serialized in sort order
+	 * when the stripe gets flushed. bufferedRowSize is the memory taken by the
+	 * buffered rows, the stripe is flushed early once it exceeds work_mem.
+	 */
+	SortSupport sortKeyArray;
+	int sortKeyCount;
+	BufferedRow **bufferedRowArray;
+	uint32 bufferedRowCount;
+	uint32 bufferedRowCapacity;
+	Size bufferedRowSize;
 };
 
 static StripeBuffers * CreateEmptyStripeBuffers(uint32 stripeMaxRowCount,
@@ -65,6 +112,16 @@ static StripeSkipList * CreateEmptyStripeSkipList(uint32 stripeMaxRowCount,
 												  uint32 chunkRowCount,
 												  uint32 columnCount);
 static void FlushStripe(ColumnarWriteState *writeState);
+static void CompressStripeBuffers(ColumnarWriteState *writeState);
+static void AppendStripeRow(ColumnarWriteState *writeState, Datum *columnValues,
+							bool *columnNulls);
+static void BufferStripeRow(ColumnarWriteState *writeState, Datum *columnValues,
+							bool *columnNulls);
+static void AppendSortedStripeRows(ColumnarWriteState *writeState);
+static int CompareBufferedRows(const void *leftPointer, const void *rightPointer,
+							   void *arg);
+static SortSupport SortKeySupportArray(TupleDesc tupleDescriptor, char *sortKey,
+									   int *sortKeyCount);
 static StringInfo SerializeBoolArray(bool *boolArray, uint32 boolArrayLength);
 static void SerializeSingleDatum(StringInfo datumBuffer, Datum datum,
 								 bool datumTypeByValue, int datumTypeLength,
@@ -75,6 +132,14 @@ static void UpdateChunkSkipNodeMinMax(ColumnChunkSkipNode *chunkSkipNode,
 									  Datum columnValue, bool columnTypeByValue,
 									  int columnTypeLength, Oid columnCollation,
 									  FmgrInfo *comparisonFunction);
+static void UpdateChunkSkipNodeMembership(ColumnChunkSkipNode *chunkSkipNode,
+										  Datum columnValue, bool columnTypeByValue,
+										  int columnTypeLength, Oid columnCollation,
+										  FmgrInfo *comparisonFunction,
+										  FmgrInfo *hashFunction, uint32 chunkRowCount);
+static FmgrInfo ** BloomFilterHashFunctionArray(TupleDesc tupleDescriptor,
+												FmgrInfo **comparisonFunctionArray,
+												char *bloomFilterColumns);
 static Datum DatumCopy(Datum datum, bool datumTypeByValue, int datumTypeLength);
 static StringInfo CopyStringInfo(StringInfo sourceString);
 
@@ -128,12 +193,26 @@ ColumnarBeginWrite(RelFileNode relfilenode,
 	writeState->options = options;
 	writeState->tupleDescriptor = CreateTupleDescCopy(tupleDescriptor);
 	writeState->comparisonFunctionArray = comparisonFunctionArray;
+	writeState->hashFunctionArray =
+		BloomFilterHashFunctionArray(tupleDescriptor, comparisonFunctionArray,
+									 options.bloomFilterColumns);
 	writeState->stripeBuffers = NULL;
 	writeState->stripeSkipList = NULL;
 	writeState->emptyStripeReservation = NULL;
 	writeState->stripeWriteContext = stripeWriteContext;
 	writeState->chunkData = chunkData;
 	writeState->compressionBuffer = NULL;
+	writeState->encodingBuffer = NULL;
+	writeState->parallelCompressionWorkers =
+		(options.compressionType != COMPRESSION_NONE) ?
+		columnar_max_parallel_compression_workers : 0;
+	writeState->flushingAtTransactionEnd = false;
+	writeState->sortKeyArray = SortKeySupportArray(tupleDescriptor, options.sortKey,
+												   &writeState->sortKeyCount);
+	writeState->bufferedRowArray = NULL;
+	writeState->bufferedRowCount = 0;
+	writeState->bufferedRowCapacity = 0;
+	writeState->bufferedRowSize = 0;
 	writeState->perTupleContext = AllocSetContextCreate(CurrentMemoryContext,
 														"Columnar per tuple context",
 														ALLOCSET_DEFAULT_SIZES);
@@ -150,6 +229,13 @@ ColumnarBeginWrite(RelFileNode relfilenode,
  * rowChunkCount insertion. Then, if row count exceeds stripeMaxRowCount, we flush
  * the stripe, and add its metadata to the table footer.
  *
+ * If the table has a sort key, the row is only buffered and gets serialized
+ * when the stripe is flushed, after the stripe's rows are sorted. Since the
+ * buffered rows are kept in memory, such stripes are also flushed once the
+ * buffered rows take more than work_mem. The row number returned for a
+ * buffered row is its insertion position within the stripe, which does not
+ * point to the same row anymore after the stripe is sorted.
+ *
  * Returns the "row number" assigned to written row.
  */
 uint64
@@ -173,6 +259,7 @@ ColumnarWriteRow(ColumnarWriteState *writeState, Datum *columnValues, bool *colu
 		writeState->stripeBuffers = stripeBuffers;
 		writeState->stripeSkipList = stripeSkipList;
 		writeState->compressionBuffer = makeStringInfo();
+		writeState->encodingBuffer = makeStringInfo();
 
 		Oid relationId = RelidByRelfilenode(writeState->relfilenode.spcNode,
 											writeState->relfilenode.relNode);
@@ -192,6 +279,50 @@ ColumnarWriteRow(ColumnarWriteState *writeState, Datum *columnValues, bool *colu
 		}
 	}
 
+	uint64 stripeFirstRowNumber =
+		writeState->emptyStripeReservation->stripeFirstRowNumber;
+	uint64 writtenRowNumber = 0;
+	bool stripeFull = false;
+
+	if (writeState->sortKeyArray != NULL)
+	{
+		writtenRowNumber = stripeFirstRowNumber + writeState->bufferedRowCount;
+		BufferStripeRow(writeState, columnValues, columnNulls);
+		stripeFull = writeState->bufferedRowCount >= options->stripeRowCount ||
+					 writeState->bufferedRowSize >= (Size) work_mem * 1024L;
+	}
+	else
+	{
+		writtenRowNumber = stripeFirstRowNumber + stripeBuffers->rowCount;
+		AppendStripeRow(writeState, columnValues, columnNulls);
+		stripeFull = stripeBuffers->rowCount >= options->stripeRowCount;
+	}
+
+	if (stripeFull)
+	{
+		ColumnarFlushPendingWrites(writeState);
+	}
+
+	MemoryContextSwitchTo(oldContext);
+
+	return writtenRowNumber;
+}
+
+
+/*
+ * AppendStripeRow serializes the given row into the current stripe, updates
+ * the corresponding skip nodes and serializes the chunk once it is full.
+ */
+static void
+AppendStripeRow(ColumnarWriteState *writeState, Datum *columnValues, bool *columnNulls)
+{
+	uint32 columnIndex = 0;
+	StripeBuffers *stripeBuffers = writeState->stripeBuffers;
+	StripeSkipList *stripeSkipList = writeState->stripeSkipList;
+	uint32 columnCount = writeState->tupleDescriptor->natts;
+	const uint32 chunkRowCount = writeState->options.chunkRowCount;
+	ChunkData *chunkData = writeState->chunkData;
+
 	uint32 chunkIndex = stripeBuffers->rowCount / chunkRowCount;
 	uint32 chunkRowIndex = stripeBuffers->rowCount % chunkRowCount;
 
@@ -225,6 +356,15 @@ ColumnarWriteRow(ColumnarWriteState *writeState, Datum *columnValues, bool *colu
 			UpdateChunkSkipNodeMinMax(chunkSkipNode, columnValues[columnIndex],
 									  columnTypeByValue, columnTypeLength,
 									  columnCollation, comparisonFunction);
+
+			FmgrInfo *hashFunction = writeState->hashFunctionArray[columnIndex];
+			if (hashFunction != NULL)
+			{
+				UpdateChunkSkipNodeMembership(chunkSkipNode, columnValues[columnIndex],
+											  columnTypeByValue, columnTypeLength,
+											  columnCollation, comparisonFunction,
+											  hashFunction, chunkRowCount);
+			}
 		}
 
 		chunkSkipNode->rowCount++;
@@ -238,17 +378,138 @@ ColumnarWriteRow(ColumnarWriteState *writeState, Datum *columnValues, bool *colu
 		SerializeChunkData(writeState, chunkIndex, chunkRowCount);
 	}
 
-	uint64 writtenRowNumber = writeState->emptyStripeReservation->stripeFirstRowNumber +
-							  stripeBuffers->rowCount;
 	stripeBuffers->rowCount++;
-	if (stripeBuffers->rowCount >= options->stripeRowCount)
+}
+
+
+/*
+ * BufferStripeRow copies the given row into the buffered rows of the current
+ * stripe, which live in the stripe write context, and accounts for the memory
+ * they take in bufferedRowSize.
+ */
+static void
+BufferStripeRow(ColumnarWriteState *writeState, Datum *columnValues, bool *columnNulls)
+{
+	TupleDesc tupleDescriptor = writeState->tupleDescriptor;
+	uint32 columnCount = tupleDescriptor->natts;
+
+	if (writeState->bufferedRowCount == writeState->bufferedRowCapacity)
 	{
-		ColumnarFlushPendingWrites(writeState);
+		uint32 newCapacity = Max(1024, writeState->bufferedRowCapacity * 2);
+		Size newSize = newCapacity * sizeof(BufferedRow *);
+
+		writeState->bufferedRowArray = (writeState->bufferedRowArray == NULL) ?
+									   palloc(newSize) :
+									   repalloc(writeState->bufferedRowArray, newSize);
+		writeState->bufferedRowSize += (newCapacity - writeState->bufferedRowCapacity) *
+									   sizeof(BufferedRow *);
+		writeState->bufferedRowCapacity = newCapacity;
 	}
 
-	MemoryContextSwitchTo(oldContext);
+	BufferedRow *bufferedRow = palloc(sizeof(BufferedRow));
+	bufferedRow->values = palloc0(columnCount * sizeof(Datum));
+	bufferedRow->nulls = palloc(columnCount * sizeof(bool));
+	bufferedRow->rowIndex = writeState->bufferedRowCount;
 
-	return writtenRowNumber;
+	Size bufferedRowSize = GetMemoryChunkSpace(bufferedRow) +
+						   GetMemoryChunkSpace(bufferedRow->values) +
+						   GetMemoryChunkSpace(bufferedRow->nulls);
+
+	memcpy(bufferedRow->nulls, columnNulls, columnCount * sizeof(bool));
+	for (uint32 columnIndex = 0; columnIndex < columnCount; columnIndex++)
+	{
+		if (!columnNulls[columnIndex])
+		{
+			Form_pg_attribute attributeForm = TupleDescAttr(tupleDescriptor,
+															columnIndex);
+			bufferedRow->values[columnIndex] =
+				DatumCopy(columnValues[columnIndex], attributeForm->attbyval,
+						  attributeForm->attlen);
+
+			if (!attributeForm->attbyval)
+			{
+				bufferedRowSize += GetMemoryChunkSpace(
+					DatumGetPointer(bufferedRow->values[columnIndex]));
+			}
+		}
+	}
+
+	writeState->bufferedRowSize += bufferedRowSize;
+
+	writeState->bufferedRowArray[writeState->bufferedRowCount++] = bufferedRow;
+}
+
+
+/*
+ * AppendSortedStripeRows sorts the buffered rows of the current stripe by the
+ * sort key and appends them to the stripe in that order. Since the min/max
+ * ranges of the chunk groups are computed while appending, sorted stripes let
+ * range quals on the leading sort key column skip most chunk groups.
+ */
+static void
+AppendSortedStripeRows(ColumnarWriteState *writeState)
+{
+	uint32 bufferedRowCount = writeState->bufferedRowCount;
+	BufferedRow **bufferedRowArray = writeState->bufferedRowArray;
+
+	if (bufferedRowCount == 0)
+	{
+		return;
+	}
+
+	qsort_arg(bufferedRowArray, bufferedRowCount, sizeof(BufferedRow *),
+			  CompareBufferedRows, writeState);
+
+	for (uint32 rowIndex = 0; rowIndex < bufferedRowCount; rowIndex++)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		BufferedRow *bufferedRow = bufferedRowArray[rowIndex];
+		AppendStripeRow(writeState, bufferedRow->values, bufferedRow->nulls);
+	}
+
+	/* the rows themselves are freed with the stripe write context */
+	writeState->bufferedRowArray = NULL;
+	writeState->bufferedRowCount = 0;
+	writeState->bufferedRowCapacity = 0;
+	writeState->bufferedRowSize = 0;
+}
+
+
+/*
+ * CompareBufferedRows is a qsort_arg comparator that orders buffered rows by
+ * the sort key of the write state given in arg, and then by their insertion
+ * order.
+ */
+static int
+CompareBufferedRows(const void *leftPointer, const void *rightPointer, void *arg)
+{
+	ColumnarWriteState *writeState = (ColumnarWriteState *) arg;
+	BufferedRow *leftRow = *((BufferedRow **) leftPointer);
+	BufferedRow *rightRow = *((BufferedRow **) rightPointer);
+
+	for (int sortKeyIndex = 0; sortKeyIndex < writeState->sortKeyCount; sortKeyIndex++)
+	{
+		SortSupport sortKey = &writeState->sortKeyArray[sortKeyIndex];
+		int columnIndex = sortKey->ssup_attno - 1;
+
+		int compare = ApplySortComparator(leftRow->values[columnIndex],
+										  leftRow->nulls[columnIndex],
+										  rightRow->values[columnIndex],
+										  rightRow->nulls[columnIndex],
+										  sortKey);
+		if (compare != 0)
+		{
+			return compare;
+		}
+	}
+
+	if (leftRow->rowIndex < rightRow->rowIndex)
+	{
+		return -1;
+	}
+
+	return (leftRow->rowIndex > rightRow->rowIndex) ? 1 : 0;
 }
 
 
@@ -263,11 +524,31 @@ ColumnarEndWrite(ColumnarWriteState *writeState)
 
 	MemoryContextDelete(writeState->stripeWriteContext);
 	pfree(writeState->comparisonFunctionArray);
+	pfree(writeState->hashFunctionArray);
+	if (writeState->sortKeyArray != NULL)
+	{
+		pfree(writeState->sortKeyArray);
+	}
 	FreeChunkData(writeState->chunkData);
 	pfree(writeState);
 }
 
 
+/*
+ * ColumnarEndWriteAtTransactionEnd is like ColumnarEndWrite, but is used when
+ * pending writes are flushed from the (sub)transaction commit callbacks. The
+ * pending stripe is then compressed in the current backend, since parallel
+ * workers cannot be started at that point.
+ */
+void
+ColumnarEndWriteAtTransactionEnd(ColumnarWriteState *writeState)
+{
+	writeState->flushingAtTransactionEnd = true;
+
+	ColumnarEndWrite(writeState);
+}
+
+
 void
 ColumnarFlushPendingWrites(ColumnarWriteState *writeState)
 {
@@ -276,6 +557,11 @@ ColumnarFlushPendingWrites(ColumnarWriteState *writeState)
 	{
 		MemoryContext oldContext = MemoryContextSwitchTo(writeState->stripeWriteContext);
 
+		if (writeState->sortKeyArray != NULL)
+		{
+			AppendSortedStripeRows(writeState);
+		}
+
 		FlushStripe(writeState);
 		MemoryContextReset(writeState->stripeWriteContext);
 
@@ -324,6 +610,7 @@ CreateEmptyStripeBuffers(uint32 stripeMaxRowCount, uint32 chunkRowCount,
 			chunkBuffersArray[chunkIndex]->existsBuffer = NULL;
 			chunkBuffersArray[chunkIndex]->valueBuffer = NULL;
 			chunkBuffersArray[chunkIndex]->valueCompressionType = COMPRESSION_NONE;
+			chunkBuffersArray[chunkIndex]->valueEncodingType = ENCODING_NONE;
 		}
 
 		columnBuffersArray[columnIndex] = palloc0(sizeof(ColumnBuffers));
@@ -406,6 +693,11 @@ FlushStripe(ColumnarWriteState *writeState)
 		SerializeChunkData(writeState, lastChunkIndex, lastChunkRowCount);
 	}
 
+	if (writeState->parallelCompressionWorkers > 0)
+	{
+		CompressStripeBuffers(writeState);
+	}
+
 	/* update buffer sizes in stripe skip list */
 	for (columnIndex = 0; columnIndex < columnCount; columnIndex++)
 	{
@@ -437,6 +729,7 @@ FlushStripe(ColumnarWriteState *writeState)
 			chunkSkipNode->valueCompressionType = valueCompressionType;
 			chunkSkipNode->valueCompressionLevel = writeState->options.compressionLevel;
 			chunkSkipNode->decompressedValueSize = chunkBuffers->decompressedValueSize;
+			chunkSkipNode->valueEncodingType = chunkBuffers->valueEncodingType;
 
 			stripeSize += valueBufferSize;
 		}
@@ -499,6 +792,69 @@ FlushStripe(ColumnarWriteState *writeState)
 }
 
 
+/*
+ * CompressStripeBuffers compresses the value buffers of all chunks of the
+ * current stripe using parallel workers. It is used instead of compressing
+ * each chunk in SerializeChunkData when parallel compression is enabled.
+ */
+static void
+CompressStripeBuffers(ColumnarWriteState *writeState)
+{
+	StripeBuffers *stripeBuffers = writeState->stripeBuffers;
+	uint32 columnCount = stripeBuffers->columnCount;
+	uint32 chunkCount = writeState->stripeSkipList->chunkCount;
+	CompressionType compressionType = writeState->options.compressionType;
+	int bufferCount = 0;
+
+	ColumnChunkBuffers **chunkBuffersArray =
+		palloc0(columnCount * chunkCount * sizeof(ColumnChunkBuffers *));
+	StringInfo *bufferArray = palloc0(columnCount * chunkCount * sizeof(StringInfo));
+	bool *compressedArray = palloc0(columnCount * chunkCount * sizeof(bool));
+
+	for (uint32 columnIndex = 0; columnIndex < columnCount; columnIndex++)
+	{
+		ColumnBuffers *columnBuffers = stripeBuffers->columnBuffersArray[columnIndex];
+
+		for (uint32 chunkIndex = 0; chunkIndex < chunkCount; chunkIndex++)
+		{
+			ColumnChunkBuffers *chunkBuffers =
+				columnBuffers->chunkBuffersArray[chunkIndex];
+
+			/* chunks with only NULLs have nothing to compress */
+			if (chunkBuffers->valueBuffer->len == 0)
+			{
+				continue;
+			}
+
+			chunkBuffersArray[bufferCount] = chunkBuffers;
+			bufferArray[bufferCount] = chunkBuffers->valueBuffer;
+			bufferCount++;
+		}
+	}
+
+	int parallelWorkerCount = writeState->parallelCompressionWorkers;
+	if (writeState->flushingAtTransactionEnd)
+	{
+		parallelWorkerCount = 0;
+	}
+
+	CompressBuffersInParallel(bufferArray, compressedArray, bufferCount,
+							  compressionType, writeState->options.compressionLevel,
+							  parallelWorkerCount);
+
+	for (int bufferIndex = 0; bufferIndex < bufferCount; bufferIndex++)
+	{
+		ColumnChunkBuffers *chunkBuffers = chunkBuffersArray[bufferIndex];
+
+		if (compressedArray[bufferIndex])
+		{
+			chunkBuffers->valueBuffer = bufferArray[bufferIndex];
+			chunkBuffers->valueCompressionType = compressionType;
+		}
+	}
+}
+
+
 /*
  * SerializeBoolArray serializes the given boolean array and returns the result
  * as a StringInfo. This function packs every 8 boolean values into one byte.
@@ -581,6 +937,7 @@ SerializeChunkData(ColumnarWriteState *writeState, uint32 chunkIndex, uint32 row
 	int compressionLevel = writeState->options.compressionLevel;
 	const uint32 columnCount = stripeBuffers->columnCount;
 	StringInfo compressionBuffer = writeState->compressionBuffer;
+	StringInfo encodingBuffer = writeState->encodingBuffer;
 
 	writeState->chunkGroupRowCounts =
 		lappend_int(writeState->chunkGroupRowCounts, rowCount);
@@ -604,22 +961,46 @@ SerializeChunkData(ColumnarWriteState *writeState, uint32 chunkIndex, uint32 row
 		ColumnBuffers *columnBuffers = stripeBuffers->columnBuffersArray[columnIndex];
 		ColumnChunkBuffers *chunkBuffers = columnBuffers->chunkBuffersArray[chunkIndex];
 		CompressionType actualCompressionType = COMPRESSION_NONE;
+		ColumnarEncodingType encodingType = ENCODING_NONE;
 
 		StringInfo serializedValueBuffer = chunkData->valueBufferArray[columnIndex];
 
 		Assert(requestedCompressionType >= 0 &&
 			   requestedCompressionType < COMPRESSION_COUNT);
 
-		chunkBuffers->decompressedValueSize =
-			chunkData->valueBufferArray[columnIndex]->len;
+		/*
+		 * Encode the values first if that makes them smaller, compression is
+		 * applied on top of the encoded values.
+		 */
+		if (columnar_enable_column_encoding)
+		{
+			Form_pg_attribute attributeForm =
+				TupleDescAttr(writeState->tupleDescriptor, columnIndex);
+
+			encodingType = EncodeBuffer(serializedValueBuffer, encodingBuffer,
+										attributeForm);
+			if (encodingType != ENCODING_NONE)
+			{
+				serializedValueBuffer = encodingBuffer;
+			}
+		}
+
+		chunkBuffers->valueEncodingType = encodingType;
+		chunkBuffers->decompressedValueSize = serializedValueBuffer->len;
 
 		/*
 		 * if serializedValueBuffer is be compressed, update serializedValueBuffer
-		 * with compressed data and store compression type.
+		 * with compressed data and store compression type. With parallel
+		 * compression, value buffers are compressed when the stripe is flushed.
 		 */
-		bool compressed = CompressBuffer(serializedValueBuffer, compressionBuffer,
-										 requestedCompressionType,
-										 compressionLevel);
+		bool compressed = false;
+		if (writeState->parallelCompressionWorkers == 0)
+		{
+			compressed = CompressBuffer(serializedValueBuffer, compressionBuffer,
+										requestedCompressionType,
+										compressionLevel);
+		}
+
 		if (compressed)
 		{
 			serializedValueBuffer = compressionBuffer;
@@ -700,6 +1081,182 @@ UpdateChunkSkipNodeMinMax(ColumnChunkSkipNode *chunkSkipNode, Datum columnValue,
 }
 
 
+/*
+ * UpdateChunkSkipNodeMembership adds the given column value to the membership
+ * information of the given column chunk skip node. We keep the exact set of
+ * distinct values while the chunk has at most COLUMNAR_DISTINCT_VALUES_MAX of
+ * them, and always maintain a bloom filter to fall back to once the set gets
+ * too large.
+ */
+static void
+UpdateChunkSkipNodeMembership(ColumnChunkSkipNode *chunkSkipNode, Datum columnValue,
+							  bool columnTypeByValue, int columnTypeLength,
+							  Oid columnCollation, FmgrInfo *comparisonFunction,
+							  FmgrInfo *hashFunction, uint32 chunkRowCount)
+{
+	if (chunkSkipNode->bloomFilter == NULL)
+	{
+		/* first non-NULL value of the chunk, start with an exact value set */
+		uint32 bitCount = chunkRowCount * COLUMNAR_BLOOM_FILTER_BITS_PER_ROW;
+		uint32 byteCount = (bitCount + 7) / 8;
+
+		chunkSkipNode->bloomFilter = palloc0(byteCount + VARHDRSZ);
+		SET_VARSIZE(chunkSkipNode->bloomFilter, byteCount + VARHDRSZ);
+
+		chunkSkipNode->distinctValues =
+			palloc0(COLUMNAR_DISTINCT_VALUES_MAX * sizeof(Datum));
+		chunkSkipNode->distinctValueCount = 0;
+		chunkSkipNode->hasDistinctValues = true;
+	}
+
+	uint32 hashValue = DatumGetUInt32(FunctionCall1Coll(hashFunction, columnCollation,
+														 columnValue));
+	uint8 *bits = (uint8 *) VARDATA(chunkSkipNode->bloomFilter);
+	uint32 bitCount = (VARSIZE(chunkSkipNode->bloomFilter) - VARHDRSZ) * 8;
+
+	for (int hashIndex = 0; hashIndex < COLUMNAR_BLOOM_FILTER_HASH_COUNT; hashIndex++)
+	{
+		uint32 bit = ColumnarBloomFilterBit(hashValue, hashIndex, bitCount);
+		bits[bit / 8] |= (1 << (bit % 8));
+	}
+
+	if (!chunkSkipNode->hasDistinctValues)
+	{
+		return;
+	}
+
+	for (uint32 valueIndex = 0; valueIndex < chunkSkipNode->distinctValueCount;
+		 valueIndex++)
+	{
+		Datum comparisonDatum = FunctionCall2Coll(comparisonFunction, columnCollation,
+												  columnValue,
+												  chunkSkipNode->distinctValues[
+													  valueIndex]);
+		if (DatumGetInt32(comparisonDatum) == 0)
+		{
+			return;
+		}
+	}
+
+	if (chunkSkipNode->distinctValueCount == COLUMNAR_DISTINCT_VALUES_MAX)
+	{
+		/* too many distinct values, only keep the bloom filter */
+		chunkSkipNode->hasDistinctValues = false;
+		return;
+	}
+
+	chunkSkipNode->distinctValues[chunkSkipNode->distinctValueCount++] =
+		DatumCopy(columnValue, columnTypeByValue, columnTypeLength);
+}
+
+
+/*
+ * BloomFilterHashFunctionArray returns an array of hash functions for the
+ * columns listed in bloomFilterColumns. Array entries for other columns, and
+ * for columns whose type lacks a default hash or btree opclass, are NULL.
+ */
+static FmgrInfo **
+BloomFilterHashFunctionArray(TupleDesc tupleDescriptor,
+							 FmgrInfo **comparisonFunctionArray,
+							 char *bloomFilterColumns)
+{
+	uint32 columnCount = tupleDescriptor->natts;
+	FmgrInfo **hashFunctionArray = palloc0(columnCount * sizeof(FmgrInfo *));
+
+	List *columnNameList = ColumnarOptionColumnNameList(bloomFilterColumns);
+
+	char *columnName = NULL;
+	foreach_ptr(columnName, columnNameList)
+	{
+		for (uint32 columnIndex = 0; columnIndex < columnCount; columnIndex++)
+		{
+			Form_pg_attribute attributeForm = TupleDescAttr(tupleDescriptor,
+															columnIndex);
+
+			if (attributeForm->attisdropped ||
+				strcmp(NameStr(attributeForm->attname), columnName) != 0)
+			{
+				continue;
+			}
+
+			/* distinct value sets need the comparison function as well */
+			if (comparisonFunctionArray[columnIndex] != NULL)
+			{
+				hashFunctionArray[columnIndex] =
+					GetFunctionInfoOrNull(attributeForm->atttypid, HASH_AM_OID,
+										  HASHSTANDARD_PROC);
+			}
+
+			break;
+		}
+	}
+
+	return hashFunctionArray;
+}
+
+
+/*
+ * SortKeySupportArray returns an array of sort support structs for the columns
+ * listed in sortKey, in the order they are listed, and sets sortKeyCount to
+ * its length. Columns that no longer exist or whose type cannot be ordered are
+ * skipped. Returns NULL if no column is left.
+ */
+static SortSupport
+SortKeySupportArray(TupleDesc tupleDescriptor, char *sortKey, int *sortKeyCount)
+{
+	List *columnNameList = ColumnarOptionColumnNameList(sortKey);
+
+	*sortKeyCount = 0;
+	if (columnNameList == NIL)
+	{
+		return NULL;
+	}
+
+	SortSupport sortKeyArray =
+		palloc0(list_length(columnNameList) * sizeof(SortSupportData));
+
+	char *columnName = NULL;
+	foreach_ptr(columnName, columnNameList)
+	{
+		for (int columnIndex = 0; columnIndex < tupleDescriptor->natts; columnIndex++)
+		{
+			Form_pg_attribute attributeForm = TupleDescAttr(tupleDescriptor,
+															columnIndex);
+
+			if (attributeForm->attisdropped ||
+				strcmp(NameStr(attributeForm->attname), columnName) != 0)
+			{
+				continue;
+			}
+
+			Oid sortOperator = InvalidOid;
+			get_sort_group_operators(attributeForm->atttypid, false, false, false,
+									 &sortOperator, NULL, NULL, NULL);
+			if (OidIsValid(sortOperator))
+			{
+				SortSupport sortSupport = &sortKeyArray[(*sortKeyCount)++];
+				sortSupport->ssup_cxt = CurrentMemoryContext;
+				sortSupport->ssup_collation = attributeForm->attcollation;
+				sortSupport->ssup_nulls_first = false;
+				sortSupport->ssup_attno = attributeForm->attnum;
+
+				PrepareSortSupportFromOrderingOp(sortOperator, sortSupport);
+			}
+
+			break;
+		}
+	}
+
+	if (*sortKeyCount == 0)
+	{
+		pfree(sortKeyArray);
+		return NULL;
+	}
+
+	return sortKeyArray;
+}
+
+
 /* Creates a copy of the given datum. */
 static Datum
 DatumCopy(Datum datum, bool datumTypeByValue, int datumTypeLength)
@@ -17,6 +17,7 @@ ALTER EXTENSION citus_columnar ADD FUNCTION citus_internal.downgrade_columnar_st
 ALTER EXTENSION citus_columnar ADD FUNCTION citus_internal.columnar_ensure_am_depends_catalog;
 
 ALTER EXTENSION citus_columnar ADD FUNCTION columnar.get_storage_id;
+ALTER EXTENSION citus_columnar ADD FUNCTION columnar.compact_stripes;
 ALTER EXTENSION citus_columnar ADD VIEW columnar.storage;
 ALTER EXTENSION citus_columnar ADD VIEW columnar.options;
 ALTER EXTENSION citus_columnar ADD VIEW columnar.stripe;
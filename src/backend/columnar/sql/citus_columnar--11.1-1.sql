@@ -197,12 +197,17 @@ REVOKE SELECT ON columnar.chunk FROM PUBLIC;
 
 -- columnar--11.0-2--11.1-1.sql
 
+-- the previous signature would otherwise remain as an overload
+DROP FUNCTION IF EXISTS pg_catalog.alter_columnar_table_set(regclass, int, int, name, int);
+
 CREATE OR REPLACE FUNCTION pg_catalog.alter_columnar_table_set(
     table_name regclass,
     chunk_group_row_limit int DEFAULT NULL,
     stripe_row_limit int DEFAULT NULL,
     compression name DEFAULT null,
-    compression_level int DEFAULT NULL)
+    compression_level int DEFAULT NULL,
+    bloom_filter_columns text DEFAULT NULL,
+    sort_key text DEFAULT NULL)
     RETURNS void
     LANGUAGE plpgsql AS
 $alter_columnar_table_set$
@@ -230,6 +235,16 @@ begin
     cmd := cmd || 'columnar.compression_level=' || compression_level;
     noop := false;
   end if;
+  if (bloom_filter_columns is not null) then
+    if (not noop) then cmd := cmd || ', '; end if;
+    cmd := cmd || 'columnar.bloom_filter_columns=' || quote_literal(bloom_filter_columns);
+    noop := false;
+  end if;
+  if (sort_key is not null) then
+    if (not noop) then cmd := cmd || ', '; end if;
+    cmd := cmd || 'columnar.sort_key=' || quote_literal(sort_key);
+    noop := false;
+  end if;
   cmd := cmd || ')';
   if (not noop) then
     execute cmd;
@@ -243,15 +258,22 @@ COMMENT ON FUNCTION pg_catalog.alter_columnar_table_set(
     chunk_group_row_limit int,
     stripe_row_limit int,
     compression name,
-    compression_level int)
+    compression_level int,
+    bloom_filter_columns text,
+    sort_key text)
 IS 'set one or more options on a columnar table, when set to NULL no change is made';
 
+-- the previous signature would otherwise remain as an overload
+DROP FUNCTION IF EXISTS pg_catalog.alter_columnar_table_reset(regclass, bool, bool, bool, bool);
+
 CREATE OR REPLACE FUNCTION pg_catalog.alter_columnar_table_reset(
     table_name regclass,
     chunk_group_row_limit bool DEFAULT false,
     stripe_row_limit bool DEFAULT false,
     compression bool DEFAULT false,
-    compression_level bool DEFAULT false)
+    compression_level bool DEFAULT false,
+    bloom_filter_columns bool DEFAULT false,
+    sort_key bool DEFAULT false)
     RETURNS void
     LANGUAGE plpgsql AS
 $alter_columnar_table_reset$
@@ -279,6 +301,16 @@ begin
     cmd := cmd || 'columnar.compression_level';
     noop := false;
   end if;
+  if (bloom_filter_columns) then
+    if (not noop) then cmd := cmd || ', '; end if;
+    cmd := cmd || 'columnar.bloom_filter_columns';
+    noop := false;
+  end if;
+  if (sort_key) then
+    if (not noop) then cmd := cmd || ', '; end if;
+    cmd := cmd || 'columnar.sort_key';
+    noop := false;
+  end if;
   cmd := cmd || ')';
   if (not noop) then
     execute cmd;
@@ -292,7 +324,9 @@ COMMENT ON FUNCTION pg_catalog.alter_columnar_table_reset(
     chunk_group_row_limit bool,
     stripe_row_limit bool,
     compression bool,
-    compression_level bool)
+    compression_level bool,
+    bloom_filter_columns bool,
+    sort_key bool)
 IS 'reset on or more options on a columnar table to the system defaults';
 
 -- rename columnar schema to columnar_internal and tighten security
@@ -301,6 +335,15 @@ REVOKE ALL PRIVILEGES ON ALL TABLES IN SCHEMA columnar FROM PUBLIC;
 ALTER SCHEMA columnar RENAME TO columnar_internal;
 REVOKE ALL PRIVILEGES ON SCHEMA columnar_internal FROM PUBLIC;
 
+-- add columns for the per chunk bloom filters, distinct value sets, value encodings
+-- and stripe sort keys
+
+ALTER TABLE columnar_internal.options ADD COLUMN bloom_filter_columns text;
+ALTER TABLE columnar_internal.options ADD COLUMN sort_key text;
+ALTER TABLE columnar_internal.chunk ADD COLUMN bloom_filter bytea;
+ALTER TABLE columnar_internal.chunk ADD COLUMN distinct_values bytea;
+ALTER TABLE columnar_internal.chunk ADD COLUMN value_encoding_type int NOT NULL DEFAULT 0;
+
 -- create columnar schema with public usage privileges
 
 CREATE SCHEMA columnar;
@@ -384,6 +427,12 @@ CREATE FUNCTION columnar.get_storage_id(regclass) RETURNS bigint
     LANGUAGE C STRICT
     AS 'citus_columnar', $$columnar_relation_storageid$$;
 
+CREATE FUNCTION columnar.compact_stripes(rel regclass) RETURNS integer
+    LANGUAGE C STRICT
+    AS 'citus_columnar', $$columnar_compact_stripes$$;
+COMMENT ON FUNCTION columnar.compact_stripes(regclass)
+  IS 'merges adjacent undersized stripes of a columnar table into full stripes';
+
 -- create views for columnar table information
 
 CREATE VIEW columnar.storage WITH (security_barrier) AS
@@ -397,7 +446,8 @@ GRANT SELECT ON columnar.storage TO PUBLIC;
 
 CREATE VIEW columnar.options WITH (security_barrier) AS
   SELECT regclass AS relation, chunk_group_row_limit,
-         stripe_row_limit, compression, compression_level
+         stripe_row_limit, compression, compression_level,
+         bloom_filter_columns, sort_key
     FROM columnar_internal.options o, pg_class c
     WHERE o.regclass = c.oid
       AND pg_has_role(c.relowner, 'USAGE');
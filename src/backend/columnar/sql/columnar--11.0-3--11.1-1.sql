@@ -7,6 +7,15 @@ REVOKE ALL PRIVILEGES ON ALL TABLES IN SCHEMA columnar FROM PUBLIC;
 ALTER SCHEMA columnar RENAME TO columnar_internal;
 REVOKE ALL PRIVILEGES ON SCHEMA columnar_internal FROM PUBLIC;
 
+-- add columns for the per chunk bloom filters, distinct value sets, value encodings
+-- and stripe sort keys
+
+ALTER TABLE columnar_internal.options ADD COLUMN bloom_filter_columns text;
+ALTER TABLE columnar_internal.options ADD COLUMN sort_key text;
+ALTER TABLE columnar_internal.chunk ADD COLUMN bloom_filter bytea;
+ALTER TABLE columnar_internal.chunk ADD COLUMN distinct_values bytea;
+ALTER TABLE columnar_internal.chunk ADD COLUMN value_encoding_type int NOT NULL DEFAULT 0;
+
 -- create columnar schema with public usage privileges
 
 CREATE SCHEMA columnar;
@@ -21,6 +30,12 @@ CREATE FUNCTION columnar.get_storage_id(regclass) RETURNS bigint
     LANGUAGE C STRICT
     AS 'citus_columnar', $$columnar_relation_storageid$$;
 
+CREATE FUNCTION columnar.compact_stripes(rel regclass) RETURNS integer
+    LANGUAGE C STRICT
+    AS 'citus_columnar', $$columnar_compact_stripes$$;
+COMMENT ON FUNCTION columnar.compact_stripes(regclass)
+  IS 'merges adjacent undersized stripes of a columnar table into full stripes';
+
 -- create views for columnar table information
 
 CREATE VIEW columnar.storage WITH (security_barrier) AS
@@ -34,7 +49,8 @@ GRANT SELECT ON columnar.storage TO PUBLIC;
 
 CREATE VIEW columnar.options WITH (security_barrier) AS
   SELECT regclass AS relation, chunk_group_row_limit,
-         stripe_row_limit, compression, compression_level
+         stripe_row_limit, compression, compression_level,
+         bloom_filter_columns, sort_key
     FROM columnar_internal.options o, pg_class c
     WHERE o.regclass = c.oid
       AND pg_has_role(c.relowner, 'USAGE');
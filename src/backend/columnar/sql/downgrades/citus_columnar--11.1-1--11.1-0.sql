@@ -1,3 +1,6 @@
+DROP FUNCTION pg_catalog.alter_columnar_table_set(regclass, int, int, name, int, text, text);
+DROP FUNCTION pg_catalog.alter_columnar_table_reset(regclass, bool, bool, bool, bool, bool, bool);
+
 CREATE OR REPLACE FUNCTION pg_catalog.alter_columnar_table_set(
     table_name regclass,
     chunk_group_row_limit int DEFAULT NULL,
@@ -80,6 +83,7 @@ DROP VIEW columnar.chunk_group;
 DROP VIEW columnar.chunk;
 DROP VIEW columnar.storage;
 DROP FUNCTION columnar.get_storage_id(regclass);
+DROP FUNCTION columnar.compact_stripes(regclass);
 
 DROP SCHEMA columnar;
 
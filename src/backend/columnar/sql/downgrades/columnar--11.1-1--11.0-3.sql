@@ -1,3 +1,6 @@
+DROP FUNCTION pg_catalog.alter_columnar_table_set(regclass, int, int, name, int, text, text);
+DROP FUNCTION pg_catalog.alter_columnar_table_reset(regclass, bool, bool, bool, bool, bool, bool);
+
 #include "../udfs/alter_columnar_table_set/10.0-1.sql"
 #include "../udfs/alter_columnar_table_reset/10.0-1.sql"
 
@@ -9,10 +12,18 @@ DROP VIEW columnar.chunk_group;
 DROP VIEW columnar.chunk;
 DROP VIEW columnar.storage;
 DROP FUNCTION columnar.get_storage_id(regclass);
+DROP FUNCTION columnar.compact_stripes(regclass);
 
 DROP SCHEMA columnar;
 
 ALTER SCHEMA columnar_internal RENAME TO columnar;
+
+ALTER TABLE columnar.options DROP COLUMN bloom_filter_columns;
+ALTER TABLE columnar.options DROP COLUMN sort_key;
+ALTER TABLE columnar.chunk DROP COLUMN bloom_filter;
+ALTER TABLE columnar.chunk DROP COLUMN distinct_values;
+ALTER TABLE columnar.chunk DROP COLUMN value_encoding_type;
+
 GRANT USAGE ON SCHEMA columnar TO PUBLIC;
 GRANT SELECT ON columnar.options TO PUBLIC;
 GRANT SELECT ON columnar.stripe TO PUBLIC;
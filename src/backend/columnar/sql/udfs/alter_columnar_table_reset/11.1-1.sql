@@ -1,9 +1,14 @@
+-- the previous signature would otherwise remain as an overload
+DROP FUNCTION IF EXISTS pg_catalog.alter_columnar_table_reset(regclass, bool, bool, bool, bool);
+
 CREATE OR REPLACE FUNCTION pg_catalog.alter_columnar_table_reset(
     table_name regclass,
     chunk_group_row_limit bool DEFAULT false,
     stripe_row_limit bool DEFAULT false,
     compression bool DEFAULT false,
-    compression_level bool DEFAULT false)
+    compression_level bool DEFAULT false,
+    bloom_filter_columns bool DEFAULT false,
+    sort_key bool DEFAULT false)
     RETURNS void
     LANGUAGE plpgsql AS
 $alter_columnar_table_reset$
@@ -31,6 +36,16 @@ begin
     cmd := cmd || 'columnar.compression_level';
     noop := false;
   end if;
+  if (bloom_filter_columns) then
+    if (not noop) then cmd := cmd || ', '; end if;
+    cmd := cmd || 'columnar.bloom_filter_columns';
+    noop := false;
+  end if;
+  if (sort_key) then
+    if (not noop) then cmd := cmd || ', '; end if;
+    cmd := cmd || 'columnar.sort_key';
+    noop := false;
+  end if;
   cmd := cmd || ')';
   if (not noop) then
     execute cmd;
@@ -44,5 +59,7 @@ COMMENT ON FUNCTION pg_catalog.alter_columnar_table_reset(
     chunk_group_row_limit bool,
     stripe_row_limit bool,
     compression bool,
-    compression_level bool)
+    compression_level bool,
+    bloom_filter_columns bool,
+    sort_key bool)
 IS 'reset on or more options on a columnar table to the system defaults';
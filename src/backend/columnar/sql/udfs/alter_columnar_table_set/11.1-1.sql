@@ -1,9 +1,14 @@
+-- the previous signature would otherwise remain as an overload
+DROP FUNCTION IF EXISTS pg_catalog.alter_columnar_table_set(regclass, int, int, name, int);
+
 CREATE OR REPLACE FUNCTION pg_catalog.alter_columnar_table_set(
     table_name regclass,
     chunk_group_row_limit int DEFAULT NULL,
     stripe_row_limit int DEFAULT NULL,
     compression name DEFAULT null,
-    compression_level int DEFAULT NULL)
+    compression_level int DEFAULT NULL,
+    bloom_filter_columns text DEFAULT NULL,
+    sort_key text DEFAULT NULL)
     RETURNS void
     LANGUAGE plpgsql AS
 $alter_columnar_table_set$
@@ -31,6 +36,16 @@ begin
     cmd := cmd || 'columnar.compression_level=' || compression_level;
     noop := false;
   end if;
+  if (bloom_filter_columns is not null) then
+    if (not noop) then cmd := cmd || ', '; end if;
+    cmd := cmd || 'columnar.bloom_filter_columns=' || quote_literal(bloom_filter_columns);
+    noop := false;
+  end if;
+  if (sort_key is not null) then
+    if (not noop) then cmd := cmd || ', '; end if;
+    cmd := cmd || 'columnar.sort_key=' || quote_literal(sort_key);
+    noop := false;
+  end if;
   cmd := cmd || ')';
   if (not noop) then
     execute cmd;
@@ -44,5 +59,7 @@ COMMENT ON FUNCTION pg_catalog.alter_columnar_table_set(
     chunk_group_row_limit int,
     stripe_row_limit int,
     compression name,
-    compression_level int)
+    compression_level int,
+    bloom_filter_columns text,
+    sort_key text)
 IS 'set one or more options on a columnar table, when set to NULL no change is made';
@@ -276,7 +276,7 @@ PopWriteStateForAllRels(SubTransactionId currentSubXid, SubTransactionId parentS
 			{
 				if (commit)
 				{
-					ColumnarEndWrite(stackHead->writeState);
+					ColumnarEndWriteAtTransactionEnd(stackHead->writeState);
 				}
 
 				entry->writeStateStack = stackHead->next;
@@ -286,6 +286,47 @@ PopWriteStateForAllRels(SubTransactionId currentSubXid, SubTransactionId parentS
 }
 
 
+/*
+ * ColumnarHasPendingWrites returns whether the current backend buffers rows
+ * of any columnar table that are not flushed yet. Other processes, such as
+ * parallel workers, cannot see these rows.
+ */
+bool
+ColumnarHasPendingWrites(void)
+{
+	HASH_SEQ_STATUS status;
+	WriteStateMapEntry *entry;
+
+	if (WriteStateMap == NULL)
+	{
+		return false;
+	}
+
+	hash_seq_init(&status, WriteStateMap);
+	while ((entry = hash_seq_search(&status)) != 0)
+	{
+		if (entry->dropped)
+		{
+			continue;
+		}
+
+		SubXidWriteState *stackEntry = entry->writeStateStack;
+		while (stackEntry != NULL)
+		{
+			if (ContainsPendingWrites(stackEntry->writeState))
+			{
+				hash_seq_term(&status);
+				return true;
+			}
+
+			stackEntry = stackEntry->next;
+		}
+	}
+
+	return false;
+}
+
+
 /*
  * Called when current subtransaction is committed.
  */
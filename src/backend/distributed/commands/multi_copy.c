@@ -86,6 +86,7 @@
 #include "distributed/listutils.h"
 #include "distributed/locally_reserved_shared_connections.h"
 #include "distributed/placement_connection.h"
+#include "distributed/reference_table_result_cache.h"
 #include "distributed/relation_access_tracking.h"
 #include "distributed/remote_commands.h"
 #include "distributed/remote_transaction.h"
@@ -2113,6 +2114,12 @@ CitusCopyDestReceiverStartup(DestReceiver *dest, int operation,
 	 */
 	SerializeNonCommutativeWrites(shardIntervalList, RowExclusiveLock);
 
+	/* cached results of queries on the reference table become stale */
+	if (IsCitusTableTypeCacheEntry(cacheEntry, REFERENCE_TABLE))
+	{
+		InvalidateReferenceTableResults(tableId);
+	}
+
 	UseCoordinatedTransaction();
 
 	/* all modifications use 2PC */
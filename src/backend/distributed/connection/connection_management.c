@@ -1154,6 +1154,15 @@ CitusPQFinish(MultiConnection *connection)
 		connection->pgConn = NULL;
 	}
 
+	/* prepared statements do not outlive the connection */
+	if (connection->preparedStatementContext != NULL)
+	{
+		MemoryContextDelete(connection->preparedStatementContext);
+		connection->preparedStatementContext = NULL;
+		connection->preparedStatementHash = NULL;
+		connection->deallocatePreparedStatementList = NIL;
+	}
+
 	/* behave idempotently, there is no gurantee that CitusPQFinish() is called once */
 	if (connection->initilizationState >= POOL_STATE_COUNTER_INCREMENTED)
 	{
@@ -1444,6 +1453,7 @@ AfterXactHostConnectionHandling(ConnectionHashEntry *entry, bool isCommit)
  * - Connection is not in OK state
  * - A transaction is still in progress (usually because we are cancelling a distributed transaction)
  * - A connection reached its maximum lifetime
+ * - The shared pool of the node is under pressure and leasing is enabled
  */
 static bool
 ShouldShutdownConnection(MultiConnection *connection, const int cachedConnectionCount)
@@ -1462,7 +1472,8 @@ ShouldShutdownConnection(MultiConnection *connection, const int cachedConnection
 		   !RemoteTransactionIdle(connection) ||
 		   (MaxCachedConnectionLifetime >= 0 &&
 			MillisecondsToTimeout(connection->connectionEstablishmentStart,
-								  MaxCachedConnectionLifetime) <= 0);
+								  MaxCachedConnectionLifetime) <= 0) ||
+		   SharedConnectionPoolUnderPressure(connection->hostname, connection->port);
 }
 
 
@@ -11,6 +11,8 @@
 #include "postgres.h"
 #include "pgstat.h"
 
+#include "distributed/pg_version_constants.h"
+
 #include "libpq-fe.h"
 
 #include "distributed/connection_management.h"
@@ -20,12 +22,16 @@
 #include "distributed/remote_commands.h"
 #include "distributed/errormessage.h"
 #include "distributed/cancel_utils.h"
+#include "common/hashfn.h"
 #include "lib/stringinfo.h"
 #include "miscadmin.h"
 #include "storage/latch.h"
 #include "utils/builtins.h"
 #include "utils/fmgrprotos.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
 #include "utils/palloc.h"
+#include "utils/syscache.h"
 
 
 /*
@@ -39,13 +45,43 @@ int RemoteCopyFlushThreshold = 8 * 1024 * 1024;
 bool LogRemoteCommands = false;
 char *GrepRemoteCommands = "";
 
+/* GUC, maximum number of prepared statements cached on a single connection */
+int MaxCachedPreparedStatements = 0;
+
+/* counter used to generate unique prepared statement names */
+static uint64 PreparedStatementCounter = 0;
+
+/*
+ * Counter that is incremented whenever cached prepared statements might have
+ * become stale, and the set of relations whose changes increment it.
+ */
+static uint64 PreparedStatementInvalidationCount = 0;
+static HTAB *PreparedStatementRelationHash = NULL;
+
 
 static bool ClearResultsInternal(MultiConnection *connection, bool raiseErrors,
 								 bool discardWarnings);
 static bool FinishConnectionIO(MultiConnection *connection, bool raiseInterrupts);
+static void FinishConnectionListIO(List *connectionList, bool raiseInterrupts);
 static WaitEventSet * BuildWaitEventSet(MultiConnection **allConnections,
 										int totalConnectionCount,
 										int pendingConnectionsStartIndex);
+static uint32 PreparedStatementHash(const char *command, int parameterCount,
+									const Oid *parameterTypes);
+static bool PreparedStatementMatches(PreparedStatementCacheEntry *entry,
+									 const char *command, int parameterCount,
+									 const Oid *parameterTypes);
+static void AssignPreparedStatementName(MultiConnection *connection,
+										PreparedStatementCacheEntry *entry);
+static void EvictPreparedStatement(MultiConnection *connection,
+								   PreparedStatementCacheEntry *entry);
+static void QueuePreparedStatementDeallocation(MultiConnection *connection,
+											   PreparedStatementCacheEntry *entry);
+static void RememberPreparedStatementRelations(List *relationIdList);
+static void InvalidatePreparedStatementsForRelation(Datum argument, Oid relationId);
+static void InvalidateAllPreparedStatements(Datum argument, int cacheId,
+											uint32 hashValue);
+static void InvalidatePreparedStatementCache(void);
 
 
 /* simple helpers */
@@ -68,6 +104,32 @@ IsResponseOK(PGresult *result)
 }
 
 
+/*
+ * IsPreparedStatementResultTypeError returns whether the result is the error
+ * that Postgres raises when the result type of a prepared statement changed
+ * since it was prepared. The error message is compared as well, since the
+ * SQLSTATE is shared with many other errors.
+ */
+bool
+IsPreparedStatementResultTypeError(PGresult *result)
+{
+	char *sqlStateString = PQresultErrorField(result, PG_DIAG_SQLSTATE);
+	char *messagePrimary = PQresultErrorField(result, PG_DIAG_MESSAGE_PRIMARY);
+
+	if (sqlStateString == NULL || messagePrimary == NULL)
+	{
+		return false;
+	}
+
+	int sqlState = MAKE_SQLSTATE(sqlStateString[0], sqlStateString[1],
+								 sqlStateString[2], sqlStateString[3],
+								 sqlStateString[4]);
+
+	return sqlState == ERRCODE_FEATURE_NOT_SUPPORTED &&
+		   strcmp(messagePrimary, "cached plan must not change result type") == 0;
+}
+
+
 /*
  * ForgetResults clears a connection from pending activity.
  *
@@ -209,6 +271,20 @@ ClearResultsIfReady(MultiConnection *connection)
 		PGresult *result = PQgetResult(pgConn);
 		if (result == NULL)
 		{
+#if PG_VERSION_NUM >= PG_VERSION_14
+
+			/*
+			 * In pipeline mode, NULL separates the results of the commands in
+			 * the pipeline. We can only leave pipeline mode once all of them
+			 * are consumed.
+			 */
+			if (PQpipelineStatus(pgConn) != PQ_PIPELINE_OFF &&
+				PQexitPipelineMode(pgConn) == 0)
+			{
+				continue;
+			}
+#endif
+
 			/* no more results available */
 			return true;
 		}
@@ -218,6 +294,15 @@ ClearResultsIfReady(MultiConnection *connection)
 		/* only care about the status, can clear now */
 		PQclear(result);
 
+#if PG_VERSION_NUM >= PG_VERSION_14
+		if (resultStatus == PGRES_PIPELINE_SYNC ||
+			resultStatus == PGRES_PIPELINE_ABORTED)
+		{
+			/* end of the pipeline, or a command skipped due to an earlier error */
+			continue;
+		}
+#endif
+
 		if (resultStatus == PGRES_COPY_IN || resultStatus == PGRES_COPY_OUT)
 		{
 			/* in copy, can't reliably recover without blocking */
@@ -504,6 +589,443 @@ SendRemoteCommandParams(MultiConnection *connection, const char *command,
 }
 
 
+/*
+ * GetCachedPreparedStatement returns the prepared statement cache entry for
+ * the given command and parameter types on the connection, creating it if it
+ * does not exist yet. Callers should check the prepared field of the entry to
+ * find out whether the statement still needs to be prepared on the remote
+ * node via SendRemotePrepare, after sending the deallocations that are due
+ * via SendRemoteDeallocations.
+ *
+ * The relations that the command accesses are remembered, such that changes
+ * to them invalidate the statements on all connections. Otherwise, a change
+ * to the type of a column in the result of a statement would make its next
+ * execution fail with "cached plan must not change result type". Statements
+ * that were invalidated get prepared again under a new name, and the least
+ * recently used statement is evicted when the cache of the connection is full.
+ * The names of the replaced statements are queued to be deallocated.
+ *
+ * The function returns NULL when prepared statement caching is disabled or
+ * another command is already cached under the same hash. The command should
+ * then be sent without a prepared statement.
+ */
+PreparedStatementCacheEntry *
+GetCachedPreparedStatement(MultiConnection *connection, const char *command,
+						   int parameterCount, const Oid *parameterTypes,
+						   List *relationIdList)
+{
+	static bool registeredInvalidationCallbacks = false;
+
+	if (MaxCachedPreparedStatements <= 0)
+	{
+		return NULL;
+	}
+
+	if (!registeredInvalidationCallbacks)
+	{
+		CacheRegisterRelcacheCallback(InvalidatePreparedStatementsForRelation,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(TYPEOID, InvalidateAllPreparedStatements,
+									  (Datum) 0);
+		registeredInvalidationCallbacks = true;
+	}
+
+	if (connection->preparedStatementHash == NULL)
+	{
+		HASHCTL info;
+
+		connection->preparedStatementContext =
+			AllocSetContextCreate(ConnectionContext, "Prepared Statement Context",
+								  ALLOCSET_SMALL_SIZES);
+
+		memset(&info, 0, sizeof(info));
+		info.keysize = sizeof(uint32);
+		info.entrysize = sizeof(PreparedStatementCacheEntry);
+		info.hcxt = connection->preparedStatementContext;
+		int hashFlags = (HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+		connection->preparedStatementHash =
+			hash_create("Prepared Statement Hash", 32, &info, hashFlags);
+		dlist_init(&connection->preparedStatementLRUList);
+		connection->deallocatePreparedStatementList = NIL;
+	}
+
+	uint32 queryHash = PreparedStatementHash(command, parameterCount, parameterTypes);
+	bool found = false;
+
+	PreparedStatementCacheEntry *entry =
+		hash_search(connection->preparedStatementHash, &queryHash, HASH_FIND, &found);
+	if (found)
+	{
+		if (!PreparedStatementMatches(entry, command, parameterCount, parameterTypes))
+		{
+			/* hash collision, do not replace the statement that is in use */
+			return NULL;
+		}
+
+		if (!entry->prepared || entry->invalidated ||
+			entry->invalidationCount != PreparedStatementInvalidationCount)
+		{
+			/*
+			 * Either an earlier attempt to prepare the statement did not
+			 * complete, in which case we cannot tell whether the name is in use
+			 * on the remote node, or the statement is stale. Use a new name for
+			 * the next attempt.
+			 */
+			AssignPreparedStatementName(connection, entry);
+			RememberPreparedStatementRelations(relationIdList);
+		}
+
+		dlist_move_head(&connection->preparedStatementLRUList, &entry->lruNode);
+
+		return entry;
+	}
+
+	while (hash_get_num_entries(connection->preparedStatementHash) >=
+		   MaxCachedPreparedStatements)
+	{
+		dlist_node *lruNode = dlist_tail_node(&connection->preparedStatementLRUList);
+		PreparedStatementCacheEntry *lruEntry =
+			dlist_container(PreparedStatementCacheEntry, lruNode, lruNode);
+
+		EvictPreparedStatement(connection, lruEntry);
+	}
+
+	entry = hash_search(connection->preparedStatementHash, &queryHash, HASH_ENTER,
+						&found);
+
+	MemoryContext oldContext =
+		MemoryContextSwitchTo(connection->preparedStatementContext);
+
+	entry->command = pstrdup(command);
+	entry->parameterCount = parameterCount;
+	entry->parameterTypes = NULL;
+
+	if (parameterCount > 0)
+	{
+		entry->parameterTypes = palloc(parameterCount * sizeof(Oid));
+		memcpy(entry->parameterTypes, parameterTypes, parameterCount * sizeof(Oid));
+	}
+
+	MemoryContextSwitchTo(oldContext);
+
+	entry->prepared = false;
+	AssignPreparedStatementName(connection, entry);
+	RememberPreparedStatementRelations(relationIdList);
+
+	dlist_push_head(&connection->preparedStatementLRUList, &entry->lruNode);
+
+	return entry;
+}
+
+
+/*
+ * AssignPreparedStatementName gives the statement of the cache entry a new
+ * name, under which it should be prepared. If the statement is prepared under
+ * its current name, that name is queued to be deallocated.
+ */
+static void
+AssignPreparedStatementName(MultiConnection *connection,
+							PreparedStatementCacheEntry *entry)
+{
+	if (entry->prepared)
+	{
+		QueuePreparedStatementDeallocation(connection, entry);
+	}
+
+	snprintf(entry->statementName, NAMEDATALEN, "citus_prepared_" UINT64_FORMAT,
+			 ++PreparedStatementCounter);
+	entry->prepared = false;
+	entry->invalidated = false;
+	entry->invalidationCount = PreparedStatementInvalidationCount;
+}
+
+
+/*
+ * EvictPreparedStatement removes the statement from the cache of the
+ * connection and queues it to be deallocated if it is prepared.
+ */
+static void
+EvictPreparedStatement(MultiConnection *connection, PreparedStatementCacheEntry *entry)
+{
+	if (entry->prepared)
+	{
+		QueuePreparedStatementDeallocation(connection, entry);
+	}
+
+	dlist_delete(&entry->lruNode);
+
+	pfree(entry->command);
+	if (entry->parameterTypes != NULL)
+	{
+		pfree(entry->parameterTypes);
+	}
+
+	hash_search(connection->preparedStatementHash, &entry->queryHash, HASH_REMOVE,
+				NULL);
+}
+
+
+/*
+ * QueuePreparedStatementDeallocation queues the current name of the prepared
+ * statement to be deallocated by the next call to SendRemoteDeallocations.
+ */
+static void
+QueuePreparedStatementDeallocation(MultiConnection *connection,
+								   PreparedStatementCacheEntry *entry)
+{
+	MemoryContext oldContext =
+		MemoryContextSwitchTo(connection->preparedStatementContext);
+
+	connection->deallocatePreparedStatementList =
+		lappend(connection->deallocatePreparedStatementList,
+				pstrdup(entry->statementName));
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * InvalidatePreparedStatement makes the next use of the statement prepare it
+ * again under a new name. It is used when the remote node reports that the
+ * statement became stale in a way the invalidation callbacks did not observe,
+ * for instance because the shard was changed directly on the worker.
+ */
+void
+InvalidatePreparedStatement(PreparedStatementCacheEntry *entry)
+{
+	entry->invalidated = true;
+}
+
+
+/*
+ * SendRemoteDeallocations sends a DEALLOCATE command for every statement
+ * that was evicted from the cache of the connection or became stale. It
+ * returns the number of commands that were sent, or -1 if sending failed.
+ * Callers should consume the results of the commands.
+ */
+int
+SendRemoteDeallocations(MultiConnection *connection)
+{
+	int deallocationCount = 0;
+
+	while (connection->deallocatePreparedStatementList != NIL)
+	{
+		char *statementName = linitial(connection->deallocatePreparedStatementList);
+		StringInfo deallocateCommand = makeStringInfo();
+
+		appendStringInfo(deallocateCommand, "DEALLOCATE %s",
+						 quote_identifier(statementName));
+
+		if (SendRemoteCommandParams(connection, deallocateCommand->data, 0, NULL,
+									NULL, false) == 0)
+		{
+			return -1;
+		}
+
+		connection->deallocatePreparedStatementList =
+			list_delete_first(connection->deallocatePreparedStatementList);
+		pfree(statementName);
+		deallocationCount++;
+	}
+
+	return deallocationCount;
+}
+
+
+/*
+ * RememberPreparedStatementRelations adds the given relations to the set of
+ * relations whose changes invalidate the cached prepared statements.
+ */
+static void
+RememberPreparedStatementRelations(List *relationIdList)
+{
+	if (PreparedStatementRelationHash == NULL)
+	{
+		HASHCTL info;
+
+		memset(&info, 0, sizeof(info));
+		info.keysize = sizeof(Oid);
+		info.entrysize = sizeof(Oid);
+		info.hcxt = CacheMemoryContext;
+		int hashFlags = (HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+		PreparedStatementRelationHash =
+			hash_create("Prepared Statement Relation Hash", 32, &info, hashFlags);
+	}
+
+	Oid relationId = InvalidOid;
+	foreach_oid(relationId, relationIdList)
+	{
+		hash_search(PreparedStatementRelationHash, &relationId, HASH_ENTER, NULL);
+	}
+}
+
+
+/*
+ * InvalidatePreparedStatementsForRelation is a relcache callback that
+ * invalidates the cached prepared statements when a relation that they
+ * access changes. Changes to the Citus metadata of a table also invalidate
+ * its relcache entry, and therefore the statements.
+ */
+static void
+InvalidatePreparedStatementsForRelation(Datum argument, Oid relationId)
+{
+	if (PreparedStatementRelationHash == NULL)
+	{
+		return;
+	}
+
+	if (relationId != InvalidOid)
+	{
+		bool found = false;
+
+		hash_search(PreparedStatementRelationHash, &relationId, HASH_FIND, &found);
+		if (!found)
+		{
+			return;
+		}
+	}
+
+	InvalidatePreparedStatementCache();
+}
+
+
+/*
+ * InvalidateAllPreparedStatements is a syscache callback that invalidates all
+ * cached prepared statements, since a changed type might appear in the result
+ * of any of them.
+ */
+static void
+InvalidateAllPreparedStatements(Datum argument, int cacheId, uint32 hashValue)
+{
+	if (PreparedStatementRelationHash == NULL)
+	{
+		return;
+	}
+
+	InvalidatePreparedStatementCache();
+}
+
+
+/*
+ * InvalidatePreparedStatementCache marks the statements that are cached on
+ * all connections as stale. The set of relations is rebuilt as the statements
+ * are prepared again.
+ */
+static void
+InvalidatePreparedStatementCache(void)
+{
+	PreparedStatementInvalidationCount++;
+
+	hash_destroy(PreparedStatementRelationHash);
+	PreparedStatementRelationHash = NULL;
+}
+
+
+/*
+ * PreparedStatementHash computes the hash of a command and its parameter
+ * types, which is used as the key of the prepared statement cache.
+ */
+static uint32
+PreparedStatementHash(const char *command, int parameterCount,
+					  const Oid *parameterTypes)
+{
+	uint32 queryHash = hash_bytes((const unsigned char *) command, strlen(command));
+
+	if (parameterCount > 0)
+	{
+		uint32 typesHash = hash_bytes((const unsigned char *) parameterTypes,
+									  parameterCount * sizeof(Oid));
+		queryHash = hash_combine(queryHash, typesHash);
+	}
+
+	return queryHash;
+}
+
+
+/*
+ * PreparedStatementMatches returns whether the cache entry was created for
+ * the given command and parameter types.
+ */
+static bool
+PreparedStatementMatches(PreparedStatementCacheEntry *entry, const char *command,
+						 int parameterCount, const Oid *parameterTypes)
+{
+	if (entry->parameterCount != parameterCount ||
+		strcmp(entry->command, command) != 0)
+	{
+		return false;
+	}
+
+	return parameterCount == 0 ||
+		   memcmp(entry->parameterTypes, parameterTypes,
+				  parameterCount * sizeof(Oid)) == 0;
+}
+
+
+/*
+ * SendRemotePrepare is a PQsendPrepare wrapper that prepares the statement of
+ * the given cache entry on the connection. The statement is not logged, since
+ * the command is logged when the prepared statement is executed via
+ * SendRemotePreparedCommandParams.
+ */
+int
+SendRemotePrepare(MultiConnection *connection, PreparedStatementCacheEntry *entry)
+{
+	PGconn *pgConn = connection->pgConn;
+
+	/*
+	 * Don't try to send command if connection is entirely gone
+	 * (PQisnonblocking() would crash).
+	 */
+	if (!pgConn || PQstatus(pgConn) != CONNECTION_OK)
+	{
+		return 0;
+	}
+
+	Assert(PQisnonblocking(pgConn));
+
+	int rc = PQsendPrepare(pgConn, entry->statementName, entry->command,
+						   entry->parameterCount, entry->parameterTypes);
+
+	return rc;
+}
+
+
+/*
+ * SendRemotePreparedCommandParams is a PQsendQueryPrepared wrapper that logs
+ * the command of the prepared statement and executes the statement with the
+ * given parameter values.
+ */
+int
+SendRemotePreparedCommandParams(MultiConnection *connection,
+								PreparedStatementCacheEntry *entry,
+								const char *const *parameterValues,
+								bool binaryResults)
+{
+	PGconn *pgConn = connection->pgConn;
+
+	LogRemoteCommand(connection, entry->command);
+
+	/*
+	 * Don't try to send command if connection is entirely gone
+	 * (PQisnonblocking() would crash).
+	 */
+	if (!pgConn || PQstatus(pgConn) != CONNECTION_OK)
+	{
+		return 0;
+	}
+
+	Assert(PQisnonblocking(pgConn));
+
+	int rc = PQsendQueryPrepared(pgConn, entry->statementName, entry->parameterCount,
+								 parameterValues, NULL, NULL, binaryResults ? 1 : 0);
+
+	return rc;
+}
+
+
 /*
  * SendRemoteCommand is a PQsendQuery wrapper that logs remote commands, and
  * accepts a MultiConnection instead of a plain PGconn. It makes sure it can
@@ -665,6 +1187,59 @@ PutRemoteCopyData(MultiConnection *connection, const char *buffer, int nbytes)
 }
 
 
+/*
+ * BroadcastRemoteCopyData sends the same copy data to all connections in the
+ * given list and errors out if that fails for any of them.
+ *
+ * Unlike calling PutRemoteCopyData() for each connection, which waits until
+ * each connection in turn flushed its buffered data, we provide back pressure
+ * by flushing all the connections concurrently. That way, sending the data
+ * takes as long as sending it to the slowest node rather than as long as
+ * sending it to all nodes one after the other.
+ */
+void
+BroadcastRemoteCopyData(List *connectionList, const char *buffer, int nbytes)
+{
+	bool flushRequired = false;
+
+	MultiConnection *connection = NULL;
+	foreach_ptr(connection, connectionList)
+	{
+		PGconn *pgConn = connection->pgConn;
+
+		if (PQstatus(pgConn) != CONNECTION_OK)
+		{
+			ReportConnectionError(connection, ERROR);
+		}
+
+		Assert(PQisnonblocking(pgConn));
+
+		if (PQputCopyData(pgConn, buffer, nbytes) == -1)
+		{
+			ReportConnectionError(connection, ERROR);
+		}
+
+		/* see PutRemoteCopyData() */
+		connection->copyBytesWrittenSinceLastFlush += nbytes;
+		if (connection->copyBytesWrittenSinceLastFlush > RemoteCopyFlushThreshold)
+		{
+			flushRequired = true;
+		}
+	}
+
+	if (flushRequired)
+	{
+		foreach_ptr(connection, connectionList)
+		{
+			connection->copyBytesWrittenSinceLastFlush = 0;
+		}
+
+		bool raiseInterrupts = true;
+		FinishConnectionListIO(connectionList, raiseInterrupts);
+	}
+}
+
+
 /*
  * PutRemoteCopyEnd is a wrapper around PQputCopyEnd() that handles
  * interrupts.
@@ -788,6 +1363,157 @@ FinishConnectionIO(MultiConnection *connection, bool raiseInterrupts)
 }
 
 
+/*
+ * FinishConnectionListIO is similar to FinishConnectionIO(), but sends the
+ * pending data of all the given connections concurrently through a single
+ * WaitEventSet. Unlike FinishConnectionIO(), it does not wait for results,
+ * and errors out when sending data fails on any of the connections or is
+ * interrupted by a cancellation.
+ */
+static void
+FinishConnectionListIO(List *connectionList, bool raiseInterrupts)
+{
+	List *pendingConnectionList = NIL;
+
+	if (raiseInterrupts)
+	{
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	MultiConnection *connection = NULL;
+	foreach_ptr(connection, connectionList)
+	{
+		int sendStatus = PQflush(connection->pgConn);
+		if (sendStatus == -1)
+		{
+			ReportConnectionError(connection, ERROR);
+		}
+		else if (sendStatus == 1)
+		{
+			pendingConnectionList = lappend(pendingConnectionList, connection);
+		}
+	}
+
+	int totalConnectionCount = list_length(pendingConnectionList);
+	if (totalConnectionCount == 0)
+	{
+		return;
+	}
+
+	MultiConnection **allConnections =
+		palloc(totalConnectionCount * sizeof(MultiConnection *));
+	WaitEvent *events = palloc(totalConnectionCount * sizeof(WaitEvent));
+	WaitEventSet *waitEventSet = NULL;
+
+	PG_TRY();
+	{
+		bool cancellationReceived = false;
+
+		while (pendingConnectionList != NIL && !cancellationReceived)
+		{
+			int pendingConnectionCount = 0;
+
+			foreach_ptr(connection, pendingConnectionList)
+			{
+				allConnections[pendingConnectionCount++] = connection;
+			}
+
+			waitEventSet = BuildWaitEventSet(allConnections, pendingConnectionCount, 0);
+
+			int eventCount = WaitEventSetWait(waitEventSet, -1, events,
+											  pendingConnectionCount,
+											  PG_WAIT_EXTENSION);
+
+			for (int eventIndex = 0; eventIndex < eventCount; eventIndex++)
+			{
+				WaitEvent *event = &events[eventIndex];
+
+				if (event->events & WL_POSTMASTER_DEATH)
+				{
+					ereport(ERROR, (errmsg("postmaster was shut down, exiting")));
+				}
+
+				if (event->events & WL_LATCH_SET)
+				{
+					ResetLatch(MyLatch);
+
+					if (raiseInterrupts)
+					{
+						CHECK_FOR_INTERRUPTS();
+					}
+
+					if (IsHoldOffCancellationReceived())
+					{
+						/* see FinishConnectionIO() */
+						foreach_ptr(connection, pendingConnectionList)
+						{
+							connection->remoteTransaction.transactionFailed = true;
+						}
+
+						cancellationReceived = true;
+						break;
+					}
+
+					continue;
+				}
+
+				connection = (MultiConnection *) event->user_data;
+
+				/* consume any input, such that the node does not block on sending */
+				if ((event->events & WL_SOCKET_READABLE) &&
+					PQconsumeInput(connection->pgConn) == 0)
+				{
+					ReportConnectionError(connection, ERROR);
+				}
+
+				int sendStatus = PQflush(connection->pgConn);
+				if (sendStatus == -1)
+				{
+					ReportConnectionError(connection, ERROR);
+				}
+				else if (sendStatus == 0)
+				{
+					/* done writing, the remaining connections are waited on again */
+					pendingConnectionList = list_delete_ptr(pendingConnectionList,
+															connection);
+				}
+			}
+
+			FreeWaitEventSet(waitEventSet);
+			waitEventSet = NULL;
+		}
+
+		if (cancellationReceived)
+		{
+			/*
+			 * The data is not fully sent, so we cannot let the caller proceed
+			 * as if it was. Like PutRemoteCopyData() callers, error out.
+			 */
+			ReportConnectionError((MultiConnection *) linitial(pendingConnectionList),
+								  ERROR);
+		}
+
+		pfree(allConnections);
+		pfree(events);
+	}
+	PG_CATCH();
+	{
+		/* make sure the epoll file descriptor is always closed */
+		if (waitEventSet != NULL)
+		{
+			FreeWaitEventSet(waitEventSet);
+			waitEventSet = NULL;
+		}
+
+		pfree(allConnections);
+		pfree(events);
+
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+}
+
+
 /*
  * WaitForAllConnections blocks until all connections in the list are no
  * longer busy, meaning the pending command has either finished or failed.
@@ -82,6 +82,9 @@ typedef struct SharedConnStatsHashEntry
 	SharedConnStatsHashKey key;
 
 	int connectionCount;
+
+	/* number of backends waiting for a connection slot to the node */
+	int waitingBackendCount;
 } SharedConnStatsHashEntry;
 
 
@@ -104,6 +107,13 @@ int LocalSharedPoolSize = 0;
 /* number of connections reserved for Citus */
 int MaxClientConnections = ALLOW_ALL_EXTERNAL_CONNECTIONS;
 
+/*
+ * Controlled via a GUC, when enabled backends only cache their connections
+ * to a node across transactions while the shared pool of the node is not
+ * under pressure, see SharedConnectionPoolUnderPressure().
+ */
+bool EnableSharedPoolLeasing = false;
+
 
 /* the following two structs are used for accessing shared memory */
 static HTAB *SharedConnStatsHash = NULL;
@@ -119,6 +129,9 @@ static void StoreAllRemoteConnectionStats(Tuplestorestate *tupleStore, TupleDesc
 static void LockConnectionSharedMemory(LWLockMode lockMode);
 static void UnLockConnectionSharedMemory(void);
 static bool ShouldWaitForConnection(int currentConnectionCount);
+static void SharedConnStatsHashKeyForNode(const char *hostname, int port,
+										  SharedConnStatsHashKey *connKey);
+static void ChangeWaitingBackendCount(const char *hostname, int port, int change);
 static uint32 SharedConnectionHashHash(const void *key, Size keysize);
 static int SharedConnectionHashCompare(const void *a, const void *b, Size keysize);
 
@@ -255,17 +268,142 @@ GetLocalSharedPoolSize(void)
 void
 WaitLoopForSharedConnection(const char *hostname, int port)
 {
-	while (!TryToIncrementSharedConnectionCounter(hostname, port))
+	if (TryToIncrementSharedConnectionCounter(hostname, port))
 	{
-		CHECK_FOR_INTERRUPTS();
+		return;
+	}
 
-		WaitForSharedConnection();
+	/*
+	 * Let the backends that hold connections to the node know that we are
+	 * waiting, such that they can release their connections when their
+	 * transactions end (see SharedConnectionPoolUnderPressure()).
+	 */
+	ChangeWaitingBackendCount(hostname, port, 1);
+
+	PG_TRY();
+	{
+		do {
+			CHECK_FOR_INTERRUPTS();
+
+			WaitForSharedConnection();
+		} while (!TryToIncrementSharedConnectionCounter(hostname, port));
 	}
+	PG_CATCH();
+	{
+		ChangeWaitingBackendCount(hostname, port, -1);
+
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	ChangeWaitingBackendCount(hostname, port, -1);
 
 	ConditionVariableCancelSleep();
 }
 
 
+/*
+ * SharedConnectionPoolUnderPressure returns true if citus.enable_shared_pool_leasing
+ * is enabled and the shared pool of the given node is either full or there
+ * are backends waiting for a connection slot to the node.
+ *
+ * In that case, backends do not keep their connections to the node open at
+ * the end of the transaction, but release the connection slots to the other
+ * backends. Under high concurrency, connections are therefore leased to
+ * backends per transaction rather than being cached per backend.
+ */
+bool
+SharedConnectionPoolUnderPressure(const char *hostname, int port)
+{
+	if (!EnableSharedPoolLeasing ||
+		GetMaxSharedPoolSize() == DISABLE_CONNECTION_THROTTLING)
+	{
+		return false;
+	}
+
+	SharedConnStatsHashKey connKey;
+	SharedConnStatsHashKeyForNode(hostname, port, &connKey);
+
+	LockConnectionSharedMemory(LW_SHARED);
+
+	bool entryFound = false;
+	SharedConnStatsHashEntry *connectionEntry =
+		hash_search(SharedConnStatsHash, &connKey, HASH_FIND, &entryFound);
+
+	bool underPressure = entryFound &&
+						 (connectionEntry->waitingBackendCount > 0 ||
+						  connectionEntry->connectionCount >= GetMaxSharedPoolSize());
+
+	UnLockConnectionSharedMemory();
+
+	return underPressure;
+}
+
+
+/*
+ * ChangeWaitingBackendCount adds the given change to the number of backends
+ * that wait for a connection slot to the given node.
+ */
+static void
+ChangeWaitingBackendCount(const char *hostname, int port, int change)
+{
+	SharedConnStatsHashKey connKey;
+	SharedConnStatsHashKeyForNode(hostname, port, &connKey);
+
+	LockConnectionSharedMemory(LW_EXCLUSIVE);
+
+	/* similar to the connection counters, we do not error out on no memory */
+	bool entryFound = false;
+	SharedConnStatsHashEntry *connectionEntry =
+		hash_search(SharedConnStatsHash, &connKey,
+					change > 0 ? HASH_ENTER_NULL : HASH_FIND, &entryFound);
+
+	if (connectionEntry != NULL)
+	{
+		if (!entryFound)
+		{
+			connectionEntry->connectionCount = 0;
+			connectionEntry->waitingBackendCount = 0;
+		}
+
+		connectionEntry->waitingBackendCount += change;
+
+		/* we should never go below 0 */
+		Assert(connectionEntry->waitingBackendCount >= 0);
+
+		if (connectionEntry->connectionCount == 0 &&
+			connectionEntry->waitingBackendCount == 0)
+		{
+			hash_search(SharedConnStatsHash, &connKey, HASH_REMOVE, &entryFound);
+		}
+	}
+
+	UnLockConnectionSharedMemory();
+}
+
+
+/*
+ * SharedConnStatsHashKeyForNode fills the hash key of the given node in the
+ * current database.
+ */
+static void
+SharedConnStatsHashKeyForNode(const char *hostname, int port,
+							  SharedConnStatsHashKey *connKey)
+{
+	if (strlen(hostname) > MAX_NODE_LENGTH)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("hostname exceeds the maximum length of %d",
+							   MAX_NODE_LENGTH)));
+	}
+
+	memset(connKey, 0, sizeof(SharedConnStatsHashKey));
+	strlcpy(connKey->hostname, hostname, MAX_NODE_LENGTH);
+	connKey->port = port;
+	connKey->databaseOid = MyDatabaseId;
+}
+
+
 /*
  * TryToIncrementSharedConnectionCounter tries to increment the shared
  * connection counter for the given nodeId and the current database in
@@ -363,6 +501,7 @@ TryToIncrementSharedConnectionCounter(const char *hostname, int port)
 	{
 		/* we successfully allocated the entry for the first time, so initialize it */
 		connectionEntry->connectionCount = 1;
+		connectionEntry->waitingBackendCount = 0;
 
 		counterIncremented = true;
 	}
@@ -467,6 +606,7 @@ IncrementSharedConnectionCounter(const char *hostname, int port)
 	{
 		/* we successfully allocated the entry for the first time, so initialize it */
 		connectionEntry->connectionCount = 0;
+		connectionEntry->waitingBackendCount = 0;
 	}
 
 	connectionEntry->connectionCount += 1;
@@ -526,7 +666,8 @@ DecrementSharedConnectionCounter(const char *hostname, int port)
 
 	connectionEntry->connectionCount -= 1;
 
-	if (connectionEntry->connectionCount == 0)
+	if (connectionEntry->connectionCount == 0 &&
+		connectionEntry->waitingBackendCount == 0)
 	{
 		/*
 		 * We don't have to remove at this point as the node might be still active
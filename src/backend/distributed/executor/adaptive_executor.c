@@ -115,6 +115,13 @@
  * Execution finishes when all tasks are done, the query errors out, or
  * the user cancels the query.
  *
+ * For SELECT queries that scan forward only, the results can be streamed
+ * to the client (see citus.executor_streaming_buffer_size). In that case,
+ * the main loop pauses once the received tuples fill the buffer, and only
+ * continues when the scan read all of them. While the loop is paused we do
+ * not read from the sockets, such that the workers slow down to the pace
+ * of the client.
+ *
  *-------------------------------------------------------------------------
  */
 
@@ -152,14 +159,17 @@
 #include "distributed/multi_partitioning_utils.h"
 #include "distributed/multi_physical_planner.h"
 #include "distributed/multi_server_executor.h"
+#include "distributed/node_execution_stats.h"
 #include "distributed/param_utils.h"
 #include "distributed/placement_access.h"
 #include "distributed/placement_connection.h"
+#include "distributed/reference_table_result_cache.h"
 #include "distributed/relation_access_tracking.h"
 #include "distributed/remote_commands.h"
 #include "distributed/repartition_join_execution.h"
 #include "distributed/resource_lock.h"
 #include "distributed/shared_connection_stats.h"
+#include "distributed/sorted_merge.h"
 #include "distributed/subplan_execution.h"
 #include "distributed/transaction_management.h"
 #include "distributed/transaction_identifier.h"
@@ -167,6 +177,7 @@
 #include "distributed/version_compat.h"
 #include "distributed/worker_protocol.h"
 #include "distributed/backend_data.h"
+#include "executor/executor.h"
 #include "lib/ilist.h"
 #include "portability/instr_time.h"
 #include "storage/fd.h"
@@ -179,6 +190,12 @@
 
 #define SLOW_START_DISABLED 0
 
+/*
+ * Above this (moving average) fraction of failed connection attempts, we do
+ * not trust a node enough to open connections based on earlier executions.
+ */
+#define NODE_STATS_MAX_CONNECTION_FAILURE_RATE 0.05
+
 
 /*
  * DistributedExecution represents the execution of a distributed query
@@ -307,9 +324,72 @@ typedef struct DistributedExecution
 	 * fail, such as CREATE INDEX CONCURRENTLY.
 	 */
 	bool localExecutionSupported;
+
+	/* state of the streaming of results, NULL if the results are not streamed */
+	struct StreamingExecution *streamingExecution;
 } DistributedExecution;
 
 
+/*
+ * StreamingExecution represents a distributed execution whose results are
+ * returned by the scan while the remaining results are still arriving.
+ *
+ * Tuples are written to the tuple store of the scan and read from it as
+ * usual. Since the scan only reads the tuples that we counted as buffered,
+ * it never reaches the end of the tuple store before the execution is done.
+ */
+typedef struct StreamingExecution
+{
+	DistributedExecution *execution;
+
+	/* scan that returns the results */
+	CitusScanState *scanState;
+
+	/* memory context in which the execution was created */
+	MemoryContext executionContext;
+
+	/* number of tuples in the tuple store that the scan did not read yet */
+	uint64 bufferedTupleCount;
+
+	/* size of the tuples that were received since the buffer was empty */
+	uint64 bufferedTupleSize;
+
+	/* set when the scan ended before all results were received */
+	bool discardTuples;
+
+	/* merge of the sorted task results, NULL if the results are not merged */
+	TupleDestination *sortedMergeTupleDest;
+} StreamingExecution;
+
+
+/*
+ * StreamingConnectionClaim records the connections that a paused streaming
+ * execution keeps claimed while the scan returns tuples, such that they can
+ * be released if the subtransaction that runs the execution aborts before the
+ * scan ends. Claims are allocated in TopMemoryContext, since the executor
+ * state might be gone by then.
+ */
+typedef struct StreamingConnectionClaim
+{
+	StreamingExecution *streamingExecution;
+	SubTransactionId subTransactionId;
+	List *connectionList;
+} StreamingConnectionClaim;
+
+
+/*
+ * StreamingTupleDestination is the TupleDestination of a streaming execution,
+ * which keeps track of the tuples that are buffered in the tuple store.
+ */
+typedef struct StreamingTupleDestination
+{
+	TupleDestination pub;
+
+	StreamingExecution *streamingExecution;
+	TupleDestination *tupleStoreDest;
+} StreamingTupleDestination;
+
+
 /*
  * WorkerPoolFailureState indicates the current state of the
  * pool.
@@ -429,6 +509,12 @@ typedef struct WorkerPool
 	/* execution statistics per pool, in microseconds */
 	uint64 totalTaskExecutionTime;
 	int totalExecutedTasks;
+	uint64 totalConnectionEstablishmentTime;
+	int totalEstablishedConnections;
+
+	/* statistics of earlier executions on the node, if any */
+	bool hasNodeExecutionStats;
+	NodeExecutionStats nodeExecutionStats;
 } WorkerPool;
 
 struct TaskPlacementExecution;
@@ -476,6 +562,20 @@ typedef struct WorkerSession
 
 	/* events reported by the latest call to WaitEventSetWait */
 	int latestUnconsumedWaitEvents;
+
+	/*
+	 * Number of commands whose results still need to be consumed before the
+	 * results of the current task, when they are pipelined with the task. These
+	 * are the commands that start the remote transaction and the preparation of
+	 * the statement of the task.
+	 */
+	int pipelinedCommandCount;
+
+	/* prepared statement that is pipelined with the current task, if any */
+	PreparedStatementCacheEntry *pendingPreparedStatement;
+
+	/* prepared statement that executes the current task, if any */
+	PreparedStatementCacheEntry *currentPreparedStatement;
 } WorkerSession;
 
 
@@ -490,8 +590,20 @@ bool EnableBinaryProtocol = true;
 bool EnableBinaryProtocol = false;
 #endif
 
+/* GUC, whether to pipeline BEGIN with the first task sent over a connection */
+bool EnablePipelining = false;
+
+/* GUC, whether worker pools without ready tasks take over tasks of other pools */
+bool EnableTaskStealing = false;
+
 /* GUC, number of ms to wait between opening connections to the same worker */
 int ExecutorSlowStartInterval = 10;
+
+/* GUC, size of the buffer for streaming results in kilobytes, 0 disables streaming */
+int ExecutorStreamingBufferSize = 0;
+
+/* connections claimed by paused streaming executions */
+static List *StreamingConnectionClaimList = NIL;
 bool EnableCostBasedConnectionEstablishment = true;
 bool PreventIncompleteConnectionEstablishment = true;
 
@@ -640,6 +752,19 @@ static TransactionProperties DecideTransactionPropertiesForTaskList(RowModifyLev
 static void StartDistributedExecution(DistributedExecution *execution);
 static void RunLocalExecution(CitusScanState *scanState, DistributedExecution *execution);
 static void RunDistributedExecution(DistributedExecution *execution);
+static bool ProcessDistributedExecution(DistributedExecution *execution);
+static bool ShouldStreamResults(CitusScanState *scanState);
+static bool ShouldPauseStreamingExecution(DistributedExecution *execution);
+static bool CancelStreamingExecution(DistributedExecution *execution);
+static void RememberStreamingConnectionClaim(StreamingExecution *streamingExecution);
+static void ForgetStreamingConnectionClaim(StreamingExecution *streamingExecution);
+static TupleDestination * CreateStreamingTupleDest(StreamingExecution *streamingExecution,
+												   TupleDestination *tupleStoreDest);
+static void StreamingTupleDestPutTuple(TupleDestination *self, Task *task,
+									   int placementIndex, int queryNumber,
+									   HeapTuple heapTuple, uint64 tupleLibpqSize);
+static TupleDesc StreamingTupleDestTupleDescForQuery(TupleDestination *self,
+													 int queryNumber);
 static void SequentialRunDistributedExecution(DistributedExecution *execution);
 static void FinishDistributedExecution(DistributedExecution *execution);
 static void CleanUpSessions(DistributedExecution *execution);
@@ -668,6 +793,11 @@ static bool UsingExistingSessionsCheaperThanEstablishingNewConnections(int
 																	   workerPool);
 static double AvgTaskExecutionTimeApproximation(WorkerPool *workerPool);
 static double AvgConnectionEstablishmentTime(WorkerPool *workerPool);
+static int NodeExecutionStatsConnectionCount(WorkerPool *workerPool);
+static void RecordNodeExecutionStats(DistributedExecution *execution);
+static void DeferNodeExecutionStats(DistributedExecution *execution);
+static void WorkerPoolExecutionSample(WorkerPool *workerPool,
+									  NodeExecutionSample *sample);
 static void OpenNewConnections(WorkerPool *workerPool, int newConnectionCount,
 							   TransactionProperties *transactionProperties);
 static void CheckConnectionTimeout(WorkerPool *workerPool);
@@ -677,12 +807,22 @@ static long NextEventTimeout(DistributedExecution *execution);
 static WaitEventSet * BuildWaitEventSet(List *sessionList);
 static void RebuildWaitEventSetFlags(WaitEventSet *waitEventSet, List *sessionList);
 static TaskPlacementExecution * PopPlacementExecution(WorkerSession *session);
+static TaskPlacementExecution * PeekPlacementExecution(WorkerSession *session);
+static bool CanPipelineTransactionBegin(WorkerSession *session);
+static bool StartPlacementExecutionInPipeline(WorkerSession *session);
 static TaskPlacementExecution * PopAssignedPlacementExecution(WorkerSession *session);
 static TaskPlacementExecution * PopUnassignedPlacementExecution(WorkerPool *workerPool);
+static bool StealPlacementExecution(WorkerPool *workerPool);
+static TaskPlacementExecution * StealablePlacementExecution(
+	TaskPlacementExecution *placementExecution);
 static bool StartPlacementExecutionOnSession(TaskPlacementExecution *placementExecution,
 											 WorkerSession *session);
 static bool SendNextQuery(TaskPlacementExecution *placementExecution,
 						  WorkerSession *session);
+static int SendParameterizedQuery(WorkerSession *session, Task *task,
+								  char *queryString, int parameterCount,
+								  Oid *parameterTypes, const char **parameterValues,
+								  bool binaryResults);
 static void ConnectionStateMachine(WorkerSession *session);
 static bool HasUnfinishedTaskForSession(WorkerSession *session);
 static void HandleMultiConnectionSuccess(WorkerSession *session);
@@ -693,6 +833,7 @@ static void TransactionStateMachine(WorkerSession *session);
 static void UpdateConnectionWaitFlags(WorkerSession *session, int waitFlags);
 static bool CheckConnectionReady(WorkerSession *session);
 static bool ReceiveResults(WorkerSession *session, bool storeRows);
+static bool ReceivePipelinedCommandResults(WorkerSession *session);
 static void WorkerSessionFailed(WorkerSession *session);
 static void WorkerPoolFailed(WorkerPool *workerPool);
 static void PlacementExecutionDone(TaskPlacementExecution *placementExecution,
@@ -792,13 +933,70 @@ AdaptiveExecutor(CitusScanState *scanState)
 	/* Reset Task fields that are only valid for a single execution */
 	ResetExplainAnalyzeData(taskList);
 
+	/* streamed tuples are read only once, which allows freeing them after reading */
+	bool streamResults = ShouldStreamResults(scanState);
+	if (streamResults)
+	{
+		randomAccess = false;
+	}
+
 	scanState->tuplestorestate =
 		tuplestore_begin_heap(randomAccess, interTransactions, work_mem);
 
+	if (streamResults)
+	{
+		tuplestore_set_eflags(scanState->tuplestorestate, 0);
+	}
+
 	TupleDesc tupleDescriptor = ScanStateGetTupleDescriptor(scanState);
 	TupleDestination *defaultTupleDest =
 		CreateTupleStoreTupleDest(scanState->tuplestorestate, tupleDescriptor);
 
+	StreamingExecution *streamingExecution = NULL;
+	if (streamResults)
+	{
+		streamingExecution = palloc0(sizeof(StreamingExecution));
+		defaultTupleDest = CreateStreamingTupleDest(streamingExecution,
+													defaultTupleDest);
+	}
+
+	/*
+	 * Serve router queries on reference tables from the result cache when
+	 * possible, otherwise collect their result to cache it.
+	 */
+	char *resultCacheKey = NULL;
+	if (!RequestedForExplainAnalyze(scanState) &&
+		IsReferenceTableResultCacheable(distributedPlan))
+	{
+		resultCacheKey = ReferenceTableResultCacheKey(linitial(taskList),
+													  paramListInfo);
+		if (ReadReferenceTableResultCache(resultCacheKey, scanState->tuplestorestate))
+		{
+			MemoryContextSwitchTo(oldContext);
+
+			return resultSlot;
+		}
+
+		defaultTupleDest = CreateResultCacheTupleDest(defaultTupleDest);
+	}
+
+	/*
+	 * For ORDER BY .. LIMIT queries, merge the sorted task results such that
+	 * the combine query only needs to sort the first limit + offset rows.
+	 */
+	TupleDestination *sortedMergeTupleDest = NULL;
+	if (EnableSortedMerge && resultCacheKey == NULL &&
+		!RequestedForExplainAnalyze(scanState))
+	{
+		sortedMergeTupleDest = CreateSortedMergeTupleDest(distributedPlan,
+														  defaultTupleDest,
+														  tupleDescriptor);
+		if (sortedMergeTupleDest != NULL)
+		{
+			defaultTupleDest = sortedMergeTupleDest;
+		}
+	}
+
 	if (RequestedForExplainAnalyze(scanState))
 	{
 		/*
@@ -860,6 +1058,25 @@ AdaptiveExecutor(CitusScanState *scanState)
 	 */
 	StartDistributedExecution(execution);
 
+	if (streamingExecution != NULL)
+	{
+		/* the tasks are executed while the scan reads the tuples */
+		streamingExecution->execution = execution;
+		streamingExecution->scanState = scanState;
+		streamingExecution->executionContext = localContext;
+		streamingExecution->sortedMergeTupleDest = sortedMergeTupleDest;
+
+		execution->streamingExecution = streamingExecution;
+		scanState->streamingExecution = streamingExecution;
+
+		AssignTasksToConnectionsOrWorkerPool(execution);
+		RememberStreamingConnectionClaim(streamingExecution);
+
+		MemoryContextSwitchTo(oldContext);
+
+		return resultSlot;
+	}
+
 	if (ShouldRunTasksSequentially(execution->remoteTaskList))
 	{
 		SequentialRunDistributedExecution(execution);
@@ -876,6 +1093,11 @@ AdaptiveExecutor(CitusScanState *scanState)
 		RunLocalExecution(scanState, execution);
 	}
 
+	if (sortedMergeTupleDest != NULL)
+	{
+		FinishSortedMerge(sortedMergeTupleDest);
+	}
+
 	CmdType commandType = job->jobQuery->commandType;
 	if (commandType != CMD_SELECT)
 	{
@@ -884,6 +1106,11 @@ AdaptiveExecutor(CitusScanState *scanState)
 
 	FinishDistributedExecution(execution);
 
+	if (resultCacheKey != NULL)
+	{
+		StoreReferenceTableResult(resultCacheKey, linitial(taskList), defaultTupleDest);
+	}
+
 	if (SortReturning && distributedPlan->expectResults && commandType != CMD_SELECT)
 	{
 		SortTupleStore(scanState);
@@ -927,6 +1154,404 @@ RunLocalExecution(CitusScanState *scanState, DistributedExecution *execution)
 }
 
 
+/*
+ * ShouldStreamResults returns whether the results of the distributed plan of
+ * the given scan should be returned while the remaining results are still
+ * arriving, instead of materializing all of them first.
+ *
+ * While the results are streamed, the connections of the execution stay
+ * claimed and other queries might run in between. We therefore only stream
+ * results of read-only queries that are not part of a multi-statement
+ * transaction and that are not executed from within a function.
+ */
+static bool
+ShouldStreamResults(CitusScanState *scanState)
+{
+	DistributedPlan *distributedPlan = scanState->distributedPlan;
+	Job *job = distributedPlan->workerJob;
+
+	if (ExecutorStreamingBufferSize == 0)
+	{
+		return false;
+	}
+
+	if (distributedPlan->modLevel != ROW_MODIFY_READONLY ||
+		job->jobQuery->commandType != CMD_SELECT)
+	{
+		return false;
+	}
+
+	/* we cannot go back to tuples that we already freed */
+	if (scanState->eflags & (EXEC_FLAG_BACKWARD | EXEC_FLAG_REWIND | EXEC_FLAG_MARK))
+	{
+		return false;
+	}
+
+	if (RequestedForExplainAnalyze(scanState) ||
+		IsReferenceTableResultCacheable(distributedPlan))
+	{
+		return false;
+	}
+
+	if (IsMultiStatementTransaction() || MaybeExecutingUDF())
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * AdvanceStreamingExecution is called before the scan reads the next tuple
+ * from the tuple store while the results are streamed. Once the scan read all
+ * the buffered tuples, it frees them and continues the execution until the
+ * buffer is full again or all tasks are done. In the latter case, the scan
+ * reads the remaining tuples from the tuple store as usual.
+ */
+void
+AdvanceStreamingExecution(CitusScanState *scanState)
+{
+	StreamingExecution *streamingExecution = scanState->streamingExecution;
+
+	if (streamingExecution->bufferedTupleCount > 0)
+	{
+		streamingExecution->bufferedTupleCount--;
+		return;
+	}
+
+	/* the scan read all the tuples in the buffer, free them */
+	tuplestore_trim(scanState->tuplestorestate);
+	streamingExecution->bufferedTupleSize = 0;
+
+	if (streamingExecution->sortedMergeTupleDest != NULL &&
+		SortedMergeReachedLimit(streamingExecution->sortedMergeTupleDest))
+	{
+		/* the combine query has all the tuples it needs, stop the tasks */
+		FinishStreamingExecution(scanState);
+		return;
+	}
+
+	MemoryContext oldContext =
+		MemoryContextSwitchTo(streamingExecution->executionContext);
+
+	/* while the execution runs, errors release the connections */
+	ForgetStreamingConnectionClaim(streamingExecution);
+
+	bool executionFinished = ProcessDistributedExecution(streamingExecution->execution);
+
+	MemoryContextSwitchTo(oldContext);
+
+	if (executionFinished)
+	{
+		FinishStreamingExecution(scanState);
+		return;
+	}
+
+	RememberStreamingConnectionClaim(streamingExecution);
+
+	/* the execution only pauses when there are buffered tuples */
+	Assert(streamingExecution->bufferedTupleCount > 0);
+	streamingExecution->bufferedTupleCount--;
+}
+
+
+/*
+ * FinishStreamingExecution finishes the execution whose results are streamed
+ * to the given scan. When the scan ends before all results arrived, we cancel
+ * the remaining tasks. If that is not possible, because the connections are
+ * part of a remote transaction, we run the remaining tasks to completion, but
+ * discard their results.
+ */
+void
+FinishStreamingExecution(CitusScanState *scanState)
+{
+	StreamingExecution *streamingExecution = scanState->streamingExecution;
+	DistributedExecution *execution = streamingExecution->execution;
+
+	MemoryContext oldContext =
+		MemoryContextSwitchTo(streamingExecution->executionContext);
+
+	ForgetStreamingConnectionClaim(streamingExecution);
+
+	if (execution->unfinishedTaskCount > 0)
+	{
+		streamingExecution->discardTuples = true;
+
+		if (!CancelStreamingExecution(execution))
+		{
+			ProcessDistributedExecution(execution);
+		}
+	}
+
+	/* execute tasks local to the node (if any) */
+	if (list_length(execution->localTaskList) > 0 && !streamingExecution->discardTuples)
+	{
+		RunLocalExecution(scanState, execution);
+	}
+
+	if (streamingExecution->sortedMergeTupleDest != NULL &&
+		!streamingExecution->discardTuples)
+	{
+		FinishSortedMerge(streamingExecution->sortedMergeTupleDest);
+	}
+
+	FinishDistributedExecution(execution);
+
+	execution->streamingExecution = NULL;
+	scanState->streamingExecution = NULL;
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * CancelStreamingExecution cancels the unfinished tasks of a streaming
+ * execution whose scan ended early, and releases its connections. Connections
+ * on which a task is still in progress are closed after cancelling the task,
+ * since the rest of its results are not needed.
+ *
+ * Cancelling a task would abort the remote transaction of its connection, so
+ * the function returns false without doing anything if any of the connections
+ * is part of a remote transaction.
+ */
+static bool
+CancelStreamingExecution(DistributedExecution *execution)
+{
+	WorkerSession *session = NULL;
+	foreach_ptr(session, execution->sessionList)
+	{
+		RemoteTransaction *transaction = &(session->connection->remoteTransaction);
+
+		if (transaction->transactionState != REMOTE_TRANS_NOT_STARTED)
+		{
+			return false;
+		}
+	}
+
+	foreach_ptr(session, execution->sessionList)
+	{
+		MultiConnection *connection = session->connection;
+
+		UnclaimConnection(connection);
+
+		if (connection->connectionState == MULTI_CONNECTION_CONNECTED &&
+			session->currentTask == NULL)
+		{
+			/* the connection is idle, get it ready for the next executions */
+			connection->waitFlags = WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE;
+			continue;
+		}
+
+		/* cancels the running command, if any, and closes the connection */
+		ShutdownConnection(connection);
+		CloseConnection(connection);
+	}
+
+	return true;
+}
+
+
+/*
+ * RememberStreamingConnectionClaim records the connections of the streaming
+ * execution while it is paused, see StreamingConnectionClaim.
+ */
+static void
+RememberStreamingConnectionClaim(StreamingExecution *streamingExecution)
+{
+	ForgetStreamingConnectionClaim(streamingExecution);
+
+	MemoryContext oldContext = MemoryContextSwitchTo(TopMemoryContext);
+
+	StreamingConnectionClaim *claim = palloc0(sizeof(StreamingConnectionClaim));
+	claim->streamingExecution = streamingExecution;
+	claim->subTransactionId = GetCurrentSubTransactionId();
+
+	WorkerSession *session = NULL;
+	foreach_ptr(session, streamingExecution->execution->sessionList)
+	{
+		claim->connectionList = lappend(claim->connectionList, session->connection);
+	}
+
+	StreamingConnectionClaimList = lappend(StreamingConnectionClaimList, claim);
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * ForgetStreamingConnectionClaim removes the record of the connections of the
+ * streaming execution, if any.
+ */
+static void
+ForgetStreamingConnectionClaim(StreamingExecution *streamingExecution)
+{
+	StreamingConnectionClaim *claim = NULL;
+	foreach_ptr(claim, StreamingConnectionClaimList)
+	{
+		if (claim->streamingExecution == streamingExecution)
+		{
+			StreamingConnectionClaimList =
+				list_delete_ptr(StreamingConnectionClaimList, claim);
+
+			list_free(claim->connectionList);
+			pfree(claim);
+			break;
+		}
+	}
+}
+
+
+/*
+ * ReleaseStreamingConnectionClaims unclaims the connections of the streaming
+ * executions that were paused in the given subtransaction or one of its
+ * children, which is called when the subtransaction aborts. Otherwise, an
+ * error while the scan returns tuples would keep the connections claimed
+ * until the end of the transaction.
+ */
+void
+ReleaseStreamingConnectionClaims(SubTransactionId subId)
+{
+	List *remainingClaimList = NIL;
+
+	StreamingConnectionClaim *claim = NULL;
+	foreach_ptr(claim, StreamingConnectionClaimList)
+	{
+		if (claim->subTransactionId < subId)
+		{
+			remainingClaimList = lappend(remainingClaimList, claim);
+			continue;
+		}
+
+		MultiConnection *connection = NULL;
+		foreach_ptr(connection, claim->connectionList)
+		{
+			UnclaimConnection(connection);
+		}
+
+		list_free(claim->connectionList);
+		pfree(claim);
+	}
+
+	MemoryContext oldContext = MemoryContextSwitchTo(TopMemoryContext);
+	List *claimList = list_copy(remainingClaimList);
+	MemoryContextSwitchTo(oldContext);
+
+	list_free(StreamingConnectionClaimList);
+	list_free(remainingClaimList);
+	StreamingConnectionClaimList = claimList;
+}
+
+
+/*
+ * ResetStreamingConnectionClaims forgets the connections of all streaming
+ * executions at the end of the transaction. The connections themselves are
+ * unclaimed by AfterXactConnectionHandling().
+ */
+void
+ResetStreamingConnectionClaims(void)
+{
+	StreamingConnectionClaim *claim = NULL;
+	foreach_ptr(claim, StreamingConnectionClaimList)
+	{
+		list_free(claim->connectionList);
+		pfree(claim);
+	}
+
+	list_free(StreamingConnectionClaimList);
+	StreamingConnectionClaimList = NIL;
+}
+
+
+/*
+ * ShouldPauseStreamingExecution returns whether the execution streams its
+ * results and either received enough tuples since the scan emptied the
+ * buffer, or merged all the tuples that the combine query needs.
+ */
+static bool
+ShouldPauseStreamingExecution(DistributedExecution *execution)
+{
+	StreamingExecution *streamingExecution = execution->streamingExecution;
+
+	if (streamingExecution == NULL || streamingExecution->discardTuples ||
+		streamingExecution->bufferedTupleCount == 0)
+	{
+		return false;
+	}
+
+	if (streamingExecution->sortedMergeTupleDest != NULL &&
+		SortedMergeReachedLimit(streamingExecution->sortedMergeTupleDest))
+	{
+		return true;
+	}
+
+	return streamingExecution->bufferedTupleSize >=
+		   (uint64) ExecutorStreamingBufferSize * 1024L;
+}
+
+
+/*
+ * CreateStreamingTupleDest creates a TupleDestination which forwards tuples
+ * to the tuple store destination of a streaming execution and keeps track of
+ * the tuples that the scan did not read yet.
+ */
+static TupleDestination *
+CreateStreamingTupleDest(StreamingExecution *streamingExecution,
+						 TupleDestination *tupleStoreDest)
+{
+	StreamingTupleDestination *streamingDest =
+		palloc0(sizeof(StreamingTupleDestination));
+
+	streamingDest->streamingExecution = streamingExecution;
+	streamingDest->tupleStoreDest = tupleStoreDest;
+	streamingDest->pub.putTuple = StreamingTupleDestPutTuple;
+	streamingDest->pub.tupleDescForQuery = StreamingTupleDestTupleDescForQuery;
+	streamingDest->pub.tupleDestinationStats = tupleStoreDest->tupleDestinationStats;
+
+	return (TupleDestination *) streamingDest;
+}
+
+
+/*
+ * StreamingTupleDestPutTuple implements TupleDestination->putTuple for
+ * StreamingTupleDestination.
+ */
+static void
+StreamingTupleDestPutTuple(TupleDestination *self, Task *task,
+						   int placementIndex, int queryNumber,
+						   HeapTuple heapTuple, uint64 tupleLibpqSize)
+{
+	StreamingTupleDestination *streamingDest = (StreamingTupleDestination *) self;
+	StreamingExecution *streamingExecution = streamingDest->streamingExecution;
+	TupleDestination *tupleStoreDest = streamingDest->tupleStoreDest;
+
+	if (streamingExecution->discardTuples)
+	{
+		return;
+	}
+
+	tupleStoreDest->putTuple(tupleStoreDest, task, placementIndex, queryNumber,
+							 heapTuple, tupleLibpqSize);
+
+	streamingExecution->bufferedTupleCount++;
+	streamingExecution->bufferedTupleSize += HEAPTUPLESIZE + heapTuple->t_len;
+}
+
+
+/*
+ * StreamingTupleDestTupleDescForQuery implements TupleDestination->tupleDescForQuery
+ * for StreamingTupleDestination.
+ */
+static TupleDesc
+StreamingTupleDestTupleDescForQuery(TupleDestination *self, int queryNumber)
+{
+	StreamingTupleDestination *streamingDest = (StreamingTupleDestination *) self;
+	TupleDestination *tupleStoreDest = streamingDest->tupleStoreDest;
+
+	return tupleStoreDest->tupleDescForQuery(tupleStoreDest, queryNumber);
+}
+
+
 /*
  * ExecuteUtilityTaskList is a wrapper around executing task
  * list for utility commands.
@@ -1311,6 +1936,18 @@ StartDistributedExecution(DistributedExecution *execution)
 	 */
 	AcquireExecutorShardLocksForExecution(execution);
 
+	/* cached results of queries on modified reference tables become stale */
+	if (execution->modLevel > ROW_MODIFY_READONLY)
+	{
+		InvalidateReferenceTableResultsForTaskList(execution->remoteAndLocalTaskList);
+	}
+
+	/* the worker pools of this execution should start from failed executions too */
+	if (EnableNodeExecutionStats)
+	{
+		RecordDeferredNodeExecutionSamples();
+	}
+
 	/*
 	 * We should not record parallel access if the target pool size is less than 2.
 	 * The reason is that we define parallel access as at least two connections
@@ -2382,6 +3019,12 @@ FindOrCreateWorkerPool(DistributedExecution *execution, char *nodeName, int node
 	int nodeConnectionCount = MaxCachedConnectionsPerWorker;
 	workerPool->maxNewConnectionsPerCycle = Max(1, nodeConnectionCount);
 
+	if (EnableNodeExecutionStats)
+	{
+		workerPool->hasNodeExecutionStats =
+			GetNodeExecutionStats(nodeName, nodePort, &workerPool->nodeExecutionStats);
+	}
+
 	dlist_init(&workerPool->pendingTaskQueue);
 	dlist_init(&workerPool->readyTaskQueue);
 
@@ -2536,13 +3179,36 @@ SequentialRunDistributedExecution(DistributedExecution *execution)
 void
 RunDistributedExecution(DistributedExecution *execution)
 {
-	WaitEvent *events = NULL;
-
 	AssignTasksToConnectionsOrWorkerPool(execution);
 
+	bool executionFinished PG_USED_FOR_ASSERTS_ONLY =
+		ProcessDistributedExecution(execution);
+
+	/* only executions that stream their results pause */
+	Assert(executionFinished);
+}
+
+
+/*
+ * ProcessDistributedExecution runs the main loop of the given distributed
+ * execution, after its tasks have been assigned, and returns true once the
+ * execution is finished.
+ *
+ * If the results of the execution are streamed, the function returns false
+ * when the streaming buffer is full, and the next call continues the loop.
+ */
+static bool
+ProcessDistributedExecution(DistributedExecution *execution)
+{
+	WaitEvent *events = NULL;
+	bool executionPaused = false;
+
 	PG_TRY();
 	{
-		/* Preemptively step state machines in case of immediate errors */
+		/*
+		 * Preemptively step state machines in case of immediate errors, or
+		 * results that arrived while a streaming execution was paused.
+		 */
 		WorkerSession *session = NULL;
 		foreach_ptr(session, execution->sessionList)
 		{
@@ -2577,6 +3243,18 @@ RunDistributedExecution(DistributedExecution *execution)
 			   (execution->unfinishedTaskCount > 0 ||
 				HasIncompleteConnectionEstablishment(execution)))
 		{
+			if (execution->unfinishedTaskCount > 0 &&
+				ShouldPauseStreamingExecution(execution))
+			{
+				/*
+				 * Let the scan return the buffered tuples first. Until we continue,
+				 * we do not read from the connections, which keeps the workers
+				 * from sending more results than we can buffer.
+				 */
+				executionPaused = true;
+				break;
+			}
+
 			WorkerPool *workerPool = NULL;
 			foreach_ptr(workerPool, execution->workerList)
 			{
@@ -2647,10 +3325,20 @@ RunDistributedExecution(DistributedExecution *execution)
 			execution->waitEventSet = NULL;
 		}
 
-		CleanUpSessions(execution);
+		if (!executionPaused)
+		{
+			CleanUpSessions(execution);
+		}
 	}
 	PG_CATCH();
 	{
+		/*
+		 * Let the next executions know about the failed connections. We do not
+		 * touch the shared memory while handling the error, the samples are
+		 * recorded when the next execution starts.
+		 */
+		DeferNodeExecutionStats(execution);
+
 		/*
 		 * We can still recover from error using ROLLBACK TO SAVEPOINT,
 		 * unclaim all connections to allow that.
@@ -2666,6 +3354,13 @@ RunDistributedExecution(DistributedExecution *execution)
 		PG_RE_THROW();
 	}
 	PG_END_TRY();
+
+	if (!executionPaused)
+	{
+		RecordNodeExecutionStats(execution);
+	}
+
+	return !executionPaused;
 }
 
 
@@ -3024,7 +3719,16 @@ CalculateNewConnectionCount(WorkerPool *workerPool)
 		/* If Slow start is enabled we need to update the maxNewConnection to the current cycle's maximum.*/
 		if (ExecutorSlowStartInterval != SLOW_START_DISABLED)
 		{
-			maxNewConnectionCount = Min(workerPool->maxNewConnectionsPerCycle,
+			/*
+			 * If earlier executions on the node tell us how many connections
+			 * the ready tasks need, skip ahead in the slow start.
+			 */
+			int nodeStatsNewConnectionCount =
+				NodeExecutionStatsConnectionCount(workerPool) - initiatedConnectionCount;
+			int maxNewConnectionsPerCycle =
+				Max(workerPool->maxNewConnectionsPerCycle, nodeStatsNewConnectionCount);
+
+			maxNewConnectionCount = Min(maxNewConnectionsPerCycle,
 										maxNewConnectionCount);
 		}
 
@@ -3074,14 +3778,16 @@ CalculateNewConnectionCount(WorkerPool *workerPool)
  * new connections based on the current execution's stats.
  *
  * The function returns false if the current execution has not established any connections
- * or finished any tasks (e.g., no stats to act on).
+ * or finished any tasks, and there are no statistics of earlier executions on the node
+ * (e.g., no stats to act on).
  */
 static bool
 UsingExistingSessionsCheaperThanEstablishingNewConnections(int readyTaskCount,
 														   WorkerPool *workerPool)
 {
 	int activeConnectionCount = workerPool->activeConnectionCount;
-	if (workerPool->totalExecutedTasks < 1 || activeConnectionCount < 1)
+	if ((workerPool->totalExecutedTasks < 1 && !workerPool->hasNodeExecutionStats) ||
+		activeConnectionCount < 1)
 	{
 		/*
 		 * The pool has not finished any connection establishment or
@@ -3162,6 +3868,12 @@ AvgTaskExecutionTimeApproximation(WorkerPool *workerPool)
 		}
 	}
 
+	if (taskCount == 0 && workerPool->hasNodeExecutionStats)
+	{
+		/* fall back to the average of earlier executions on the node */
+		return workerPool->nodeExecutionStats.avgTaskExecutionTime;
+	}
+
 	return taskCount == 0 ? 0 : ((double) totalTaskExecutionTime / taskCount);
 }
 
@@ -3199,10 +3911,121 @@ AvgConnectionEstablishmentTime(WorkerPool *workerPool)
 		}
 	}
 
+	if (sessionCount == 0 && workerPool->hasNodeExecutionStats)
+	{
+		/* fall back to the average of earlier executions on the node */
+		return workerPool->nodeExecutionStats.avgConnectionEstablishmentTime;
+	}
+
 	return (sessionCount == 0) ? 0 : (totalTimeMicrosec / sessionCount);
 }
 
 
+/*
+ * NodeExecutionStatsConnectionCount returns the number of connections that the
+ * statistics of earlier executions on the node suggest for the tasks of the
+ * worker pool, or 0 if there are no (trustworthy) statistics.
+ *
+ * A connection pays off when it runs tasks for longer than it takes to establish
+ * it, so we aim for connections that each run tasks for at least the duration of
+ * a task plus a connection establishment.
+ */
+static int
+NodeExecutionStatsConnectionCount(WorkerPool *workerPool)
+{
+	if (!workerPool->hasNodeExecutionStats)
+	{
+		return 0;
+	}
+
+	NodeExecutionStats *nodeExecutionStats = &(workerPool->nodeExecutionStats);
+	double avgTaskExecutionTime = nodeExecutionStats->avgTaskExecutionTime;
+	double avgConnectionEstablishmentTime =
+		nodeExecutionStats->avgConnectionEstablishmentTime;
+
+	/*
+	 * Opening many connections at once to a node that recently failed to accept
+	 * connections would only make things worse, so let slow start probe it.
+	 */
+	double connectionFailureRate = nodeExecutionStats->connectionFailureRate;
+	if (connectionFailureRate > NODE_STATS_MAX_CONNECTION_FAILURE_RATE ||
+		avgTaskExecutionTime <= 0)
+	{
+		return 0;
+	}
+
+	int runningTaskCount =
+		workerPool->activeConnectionCount - workerPool->idleConnectionCount;
+	int taskCount = workerPool->readyTaskCount + runningTaskCount;
+
+	return (int) ceil(taskCount * avgTaskExecutionTime /
+					  (avgTaskExecutionTime + avgConnectionEstablishmentTime));
+}
+
+
+/*
+ * RecordNodeExecutionStats records the statistics of the worker pools of the
+ * execution in shared memory, such that the next executions can use them.
+ */
+static void
+RecordNodeExecutionStats(DistributedExecution *execution)
+{
+	if (!EnableNodeExecutionStats)
+	{
+		return;
+	}
+
+	WorkerPool *workerPool = NULL;
+	foreach_ptr(workerPool, execution->workerList)
+	{
+		NodeExecutionSample sample;
+
+		WorkerPoolExecutionSample(workerPool, &sample);
+		RecordNodeExecutionSample(workerPool->nodeName, workerPool->nodePort, &sample);
+	}
+}
+
+
+/*
+ * DeferNodeExecutionStats is like RecordNodeExecutionStats, but is used for
+ * failed executions while the error is handled. The statistics are kept in
+ * backend-local memory and get recorded when the next execution starts.
+ */
+static void
+DeferNodeExecutionStats(DistributedExecution *execution)
+{
+	if (!EnableNodeExecutionStats)
+	{
+		return;
+	}
+
+	WorkerPool *workerPool = NULL;
+	foreach_ptr(workerPool, execution->workerList)
+	{
+		NodeExecutionSample sample;
+
+		WorkerPoolExecutionSample(workerPool, &sample);
+		DeferNodeExecutionSample(workerPool->nodeName, workerPool->nodePort, &sample);
+	}
+}
+
+
+/*
+ * WorkerPoolExecutionSample fills the given sample with the statistics that
+ * the given worker pool collected during the execution.
+ */
+static void
+WorkerPoolExecutionSample(WorkerPool *workerPool, NodeExecutionSample *sample)
+{
+	sample->executedTaskCount = workerPool->totalExecutedTasks;
+	sample->totalTaskExecutionTime = workerPool->totalTaskExecutionTime;
+	sample->establishedConnectionCount = workerPool->totalEstablishedConnections;
+	sample->totalConnectionEstablishmentTime =
+		workerPool->totalConnectionEstablishmentTime;
+	sample->failedConnectionCount = workerPool->failedConnectionCount;
+}
+
+
 /*
  * OpenNewConnections opens the given amount of connections for the given workerPool.
  */
@@ -3811,14 +4634,17 @@ HandleMultiConnectionSuccess(WorkerSession *session)
 
 	MarkConnectionConnected(connection);
 
+	long connectionEstablishmentTime =
+		MicrosecondsBetweenTimestamps(connection->connectionEstablishmentStart,
+									  connection->connectionEstablishmentEnd);
+
 	ereport(DEBUG4, (errmsg("established connection to %s:%d for "
 							"session %ld in %ld microseconds",
 							connection->hostname, connection->port,
-							session->sessionId,
-							MicrosecondsBetweenTimestamps(
-								connection->connectionEstablishmentStart,
-								connection->connectionEstablishmentEnd))));
+							session->sessionId, connectionEstablishmentTime)));
 
+	workerPool->totalConnectionEstablishmentTime += connectionEstablishmentTime;
+	workerPool->totalEstablishedConnections++;
 	workerPool->activeConnectionCount++;
 	workerPool->idleConnectionCount++;
 }
@@ -3923,7 +4749,31 @@ TransactionStateMachine(WorkerSession *session)
 		{
 			case REMOTE_TRANS_NOT_STARTED:
 			{
-				if (useRemoteTransactionBlocks == TRANSACTION_BLOCKS_REQUIRED)
+				if (useRemoteTransactionBlocks == TRANSACTION_BLOCKS_REQUIRED &&
+					CanPipelineTransactionBegin(session))
+				{
+					/* if we're expanding the nodes in a transaction, use 2PC */
+					Activate2PCIfModifyingTransactionExpandsToNewNode(session);
+
+					/*
+					 * Send the commands that open the transaction block and the
+					 * next task in a single pipeline, such that the task does not
+					 * wait for a round-trip to the worker.
+					 */
+					bool placementExecutionStarted =
+						StartPlacementExecutionInPipeline(session);
+					if (!placementExecutionStarted)
+					{
+						/* no need to continue, connection is lost */
+						Assert(session->connection->connectionState ==
+							   MULTI_CONNECTION_LOST);
+
+						return;
+					}
+
+					transaction->transactionState = REMOTE_TRANS_SENT_BEGIN;
+				}
+				else if (useRemoteTransactionBlocks == TRANSACTION_BLOCKS_REQUIRED)
 				{
 					/* if we're expanding the nodes in a transaction, use 2PC */
 					Activate2PCIfModifyingTransactionExpandsToNewNode(session);
@@ -3968,6 +4818,27 @@ TransactionStateMachine(WorkerSession *session)
 			}
 
 			case REMOTE_TRANS_SENT_BEGIN:
+			{
+				/* consume the results of the commands pipelined before the task */
+				bool pipelinedCommandsDone = ReceivePipelinedCommandResults(session);
+				if (connection->connectionState == MULTI_CONNECTION_LOST)
+				{
+					return;
+				}
+
+				if (!pipelinedCommandsDone)
+				{
+					/* wake up WaitEventSetWait */
+					UpdateConnectionWaitFlags(session,
+											  WL_SOCKET_READABLE | WL_SOCKET_WRITEABLE);
+
+					break;
+				}
+
+				transaction->transactionState = REMOTE_TRANS_SENT_COMMAND;
+				break;
+			}
+
 			case REMOTE_TRANS_CLEARING_RESULTS:
 			{
 				PGresult *result = PQgetResult(connection->pgConn);
@@ -4211,46 +5082,167 @@ CheckConnectionReady(WorkerSession *session)
 		}
 	}
 
-	if (!PQisBusy(connection->pgConn))
+	if (!PQisBusy(connection->pgConn))
+	{
+		connectionReady = true;
+	}
+
+	UpdateConnectionWaitFlags(session, waitFlags);
+
+	/* don't consume input redundantly if we cycle back into CheckConnectionReady */
+	session->latestUnconsumedWaitEvents = 0;
+
+	return connectionReady;
+}
+
+
+/*
+ * PopPlacementExecution returns the next available assigned or unassigned
+ * placement execution for the given session.
+ */
+static TaskPlacementExecution *
+PopPlacementExecution(WorkerSession *session)
+{
+	WorkerPool *workerPool = session->workerPool;
+
+	TaskPlacementExecution *placementExecution = PopAssignedPlacementExecution(session);
+	if (placementExecution == NULL)
+	{
+		if (session->commandsSent > 0 && UseConnectionPerPlacement())
+		{
+			/*
+			 * Only send one command per connection if force_max_query_parallelisation
+			 * is enabled, unless it's an assigned placement execution.
+			 */
+			return NULL;
+		}
+
+		/* no more assigned tasks, pick an unassigned task */
+		placementExecution = PopUnassignedPlacementExecution(workerPool);
+
+		if (placementExecution == NULL && EnableTaskStealing &&
+			StealPlacementExecution(workerPool))
+		{
+			/* we took over a task from another worker pool */
+			placementExecution = PopUnassignedPlacementExecution(workerPool);
+		}
+	}
+
+	return placementExecution;
+}
+
+
+/*
+ * PeekPlacementExecution returns the placement execution that the next call
+ * to PopPlacementExecution would return, without removing it from its queue.
+ */
+static TaskPlacementExecution *
+PeekPlacementExecution(WorkerSession *session)
+{
+	WorkerPool *workerPool = session->workerPool;
+
+	if (!dlist_is_empty(&session->readyTaskQueue))
+	{
+		return dlist_container(TaskPlacementExecution, sessionReadyQueueNode,
+							   dlist_head_node(&session->readyTaskQueue));
+	}
+
+	if (session->commandsSent > 0 && UseConnectionPerPlacement())
+	{
+		return NULL;
+	}
+
+	if (!dlist_is_empty(&workerPool->readyTaskQueue))
+	{
+		return dlist_container(TaskPlacementExecution, workerReadyQueueNode,
+							   dlist_head_node(&workerPool->readyTaskQueue));
+	}
+
+	return NULL;
+}
+
+
+/*
+ * CanPipelineTransactionBegin returns whether the remote transaction on the
+ * session can be started in the same libpq pipeline as the next task that is
+ * ready to be executed on it.
+ *
+ * Only a single command can be sent at a time in pipeline mode, and only
+ * using the extended query protocol. Hence, we only pipeline tasks that
+ * SendNextQuery sends with parameters or binary results, as those are
+ * guaranteed to consist of a single command. Other task queries may contain
+ * multiple commands, so they follow the BEGIN in a separate round-trip.
+ */
+static bool
+CanPipelineTransactionBegin(WorkerSession *session)
+{
+	DistributedExecution *execution = session->workerPool->distributedExecution;
+
+	if (!EnablePipelining || !CanPipelineRemoteTransactionBegin())
+	{
+		return false;
+	}
+
+	TaskPlacementExecution *placementExecution = PeekPlacementExecution(session);
+	if (placementExecution == NULL)
 	{
-		connectionReady = true;
+		return false;
 	}
 
-	UpdateConnectionWaitFlags(session, waitFlags);
+	ShardCommandExecution *shardCommandExecution =
+		placementExecution->shardCommandExecution;
+	Task *task = shardCommandExecution->task;
 
-	/* don't consume input redundantly if we cycle back into CheckConnectionReady */
-	session->latestUnconsumedWaitEvents = 0;
+	if (placementExecution->queryIndex != 0 || task->queryCount != 1)
+	{
+		return false;
+	}
 
-	return connectionReady;
+	return shardCommandExecution->binaryResults ||
+		   (execution->paramListInfo != NULL && !task->parametersInQueryStringResolved);
 }
 
 
 /*
- * PopPlacementExecution returns the next available assigned or unassigned
- * placement execution for the given session.
+ * StartPlacementExecutionInPipeline starts the remote transaction on the
+ * session and the next placement execution that is ready to be executed on
+ * it in a single libpq pipeline. The results of the commands that start the
+ * transaction are consumed in the REMOTE_TRANS_SENT_BEGIN state.
+ *
+ * The function returns true if the commands are successfully sent over the
+ * connection, otherwise false.
  */
-static TaskPlacementExecution *
-PopPlacementExecution(WorkerSession *session)
+static bool
+StartPlacementExecutionInPipeline(WorkerSession *session)
 {
-	WorkerPool *workerPool = session->workerPool;
+#if PG_VERSION_NUM >= PG_VERSION_14
+	MultiConnection *connection = session->connection;
 
-	TaskPlacementExecution *placementExecution = PopAssignedPlacementExecution(session);
-	if (placementExecution == NULL)
+	StartRemoteTransactionBeginInPipeline(connection);
+
+	/* BEGIN and assign_distributed_transaction_id() */
+	session->pipelinedCommandCount = 2;
+
+	TaskPlacementExecution *placementExecution = PopPlacementExecution(session);
+	Assert(placementExecution != NULL);
+
+	bool placementExecutionStarted =
+		StartPlacementExecutionOnSession(placementExecution, session);
+	if (!placementExecutionStarted)
 	{
-		if (session->commandsSent > 0 && UseConnectionPerPlacement())
-		{
-			/*
-			 * Only send one command per connection if force_max_query_parallelisation
-			 * is enabled, unless it's an assigned placement execution.
-			 */
-			return NULL;
-		}
+		return false;
+	}
 
-		/* no more assigned tasks, pick an unassigned task */
-		placementExecution = PopUnassignedPlacementExecution(workerPool);
+	if (PQpipelineSync(connection->pgConn) == 0)
+	{
+		connection->connectionState = MULTI_CONNECTION_LOST;
+		return false;
 	}
 
-	return placementExecution;
+	return true;
+#else
+	ereport(ERROR, (errmsg("pipeline mode requires PostgreSQL 14 or later")));
+#endif
 }
 
 
@@ -4300,6 +5292,138 @@ PopUnassignedPlacementExecution(WorkerPool *workerPool)
 }
 
 
+/*
+ * StealPlacementExecution is called when the given worker pool ran out of
+ * ready tasks. It looks for a task that has a not-yet-started placement
+ * execution in this pool while its ready placement execution still waits in
+ * the queue of another worker pool, for instance because that worker is slow
+ * and all of its connections are busy. If it finds one, it moves the waiting
+ * placement execution back to the pending queue of the other pool and makes
+ * the placement execution in this pool ready instead.
+ *
+ * The placement execution that we took the task from stays in the pending
+ * queue, such that ScheduleNextPlacementExecution can still fail over to it
+ * if the execution in this pool fails.
+ *
+ * The function returns true if a placement execution was moved to the ready
+ * queue of the given worker pool.
+ */
+static bool
+StealPlacementExecution(WorkerPool *workerPool)
+{
+	DistributedExecution *execution = workerPool->distributedExecution;
+
+	if (workerPool->failureState != WORKER_POOL_NOT_FAILED)
+	{
+		return false;
+	}
+
+	/* avoid scanning the pending queue if no other pool has ready tasks */
+	bool otherPoolHasReadyTasks = false;
+	WorkerPool *otherWorkerPool = NULL;
+	foreach_ptr(otherWorkerPool, execution->workerList)
+	{
+		if (otherWorkerPool != workerPool && otherWorkerPool->readyTaskCount > 0)
+		{
+			otherPoolHasReadyTasks = true;
+			break;
+		}
+	}
+
+	if (!otherPoolHasReadyTasks)
+	{
+		return false;
+	}
+
+	dlist_iter iter;
+	dlist_foreach(iter, &workerPool->pendingTaskQueue)
+	{
+		TaskPlacementExecution *placementExecution =
+			dlist_container(TaskPlacementExecution, workerPendingQueueNode, iter.cur);
+
+		TaskPlacementExecution *readyPlacementExecution =
+			StealablePlacementExecution(placementExecution);
+		if (readyPlacementExecution == NULL)
+		{
+			continue;
+		}
+
+		WorkerPool *readyWorkerPool = readyPlacementExecution->workerPool;
+
+		ereport(DEBUG4, (errmsg("worker pool %s:%d takes over a task from %s:%d",
+								workerPool->nodeName, workerPool->nodePort,
+								readyWorkerPool->nodeName,
+								readyWorkerPool->nodePort)));
+
+		/* move the waiting placement execution back to the not-ready queue */
+		dlist_delete(&readyPlacementExecution->workerReadyQueueNode);
+		readyWorkerPool->readyTaskCount--;
+
+		readyPlacementExecution->executionState = PLACEMENT_EXECUTION_NOT_READY;
+		dlist_push_tail(&readyWorkerPool->pendingTaskQueue,
+						&readyPlacementExecution->workerPendingQueueNode);
+
+		/* we return right away, so modifying the queue we iterate over is safe */
+		PlacementExecutionReady(placementExecution);
+
+		return true;
+	}
+
+	return false;
+}
+
+
+/*
+ * StealablePlacementExecution returns the ready placement execution of the
+ * task of the given not-ready placement execution if it is still waiting in
+ * the ready queue of another worker pool and the task can run on any of its
+ * placements. Otherwise, the function returns NULL.
+ */
+static TaskPlacementExecution *
+StealablePlacementExecution(TaskPlacementExecution *placementExecution)
+{
+	ShardCommandExecution *shardCommandExecution =
+		placementExecution->shardCommandExecution;
+
+	if (shardCommandExecution->executionOrder != EXECUTION_ORDER_ANY ||
+		shardCommandExecution->executionState != TASK_EXECUTION_NOT_FINISHED ||
+		placementExecution->executionState != PLACEMENT_EXECUTION_NOT_READY ||
+		placementExecution->assignedSession != NULL)
+	{
+		return NULL;
+	}
+
+	for (int placementExecutionIndex = 0;
+		 placementExecutionIndex < shardCommandExecution->placementExecutionCount;
+		 placementExecutionIndex++)
+	{
+		TaskPlacementExecution *otherPlacementExecution =
+			shardCommandExecution->placementExecutions[placementExecutionIndex];
+
+		if (otherPlacementExecution->executionState != PLACEMENT_EXECUTION_READY)
+		{
+			continue;
+		}
+
+		/*
+		 * A ready placement execution with an assigned session waits in the
+		 * queue of that session, since it needs to use that connection.
+		 */
+		if (otherPlacementExecution->assignedSession != NULL ||
+			otherPlacementExecution->workerPool == placementExecution->workerPool ||
+			otherPlacementExecution->workerPool->failureState !=
+			WORKER_POOL_NOT_FAILED)
+		{
+			return NULL;
+		}
+
+		return otherPlacementExecution;
+	}
+
+	return NULL;
+}
+
+
 /*
  * StartPlacementExecutionOnSession gets a TaskPlacementExecution and
  * WorkerSession, the task's query is sent to the worker via the session.
@@ -4399,6 +5523,8 @@ SendNextQuery(TaskPlacementExecution *placementExecution,
 	Assert(queryIndex < task->queryCount);
 	char *queryString = TaskQueryStringAtIndex(task, queryIndex);
 
+	session->currentPreparedStatement = NULL;
+
 	if (paramListInfo != NULL && !task->parametersInQueryStringResolved)
 	{
 		int parameterCount = paramListInfo->numParams;
@@ -4410,9 +5536,9 @@ SendNextQuery(TaskPlacementExecution *placementExecution,
 
 		ExtractParametersForRemoteExecution(paramListInfo, &parameterTypes,
 											&parameterValues);
-		querySent = SendRemoteCommandParams(connection, queryString, parameterCount,
-											parameterTypes, parameterValues,
-											binaryResults);
+		querySent = SendParameterizedQuery(session, task, queryString,
+										   parameterCount, parameterTypes,
+										   parameterValues, binaryResults);
 	}
 	else
 	{
@@ -4445,6 +5571,17 @@ SendNextQuery(TaskPlacementExecution *placementExecution,
 		return false;
 	}
 
+#if PG_VERSION_NUM >= PG_VERSION_14
+	if (PQpipelineStatus(connection->pgConn) != PQ_PIPELINE_OFF)
+	{
+		/*
+		 * The query follows other pipelined commands, single row mode is set
+		 * once their results are consumed.
+		 */
+		return true;
+	}
+#endif
+
 	int singleRowMode = PQsetSingleRowMode(connection->pgConn);
 	if (singleRowMode == 0)
 	{
@@ -4456,6 +5593,147 @@ SendNextQuery(TaskPlacementExecution *placementExecution,
 }
 
 
+/*
+ * SendParameterizedQuery sends a query with parameters on the session. If
+ * prepared statements are cached on the connection, the query is executed via
+ * a prepared statement. The statement is prepared the first time it is used on
+ * the connection, which is pipelined with its execution to avoid an additional
+ * round-trip. Statements that were evicted from the cache or became stale are
+ * deallocated in the same pipeline.
+ *
+ * The function returns 1 if the query is successfully sent, otherwise 0.
+ */
+static int
+SendParameterizedQuery(WorkerSession *session, Task *task, char *queryString,
+					   int parameterCount, Oid *parameterTypes,
+					   const char **parameterValues, bool binaryResults)
+{
+	MultiConnection *connection = session->connection;
+
+#if PG_VERSION_NUM >= PG_VERSION_14
+	List *relationIdList = NIL;
+	RelationShard *relationShard = NULL;
+	foreach_ptr(relationShard, task->relationShardList)
+	{
+		relationIdList = list_append_unique_oid(relationIdList,
+												relationShard->relationId);
+	}
+
+	PreparedStatementCacheEntry *preparedStatement =
+		GetCachedPreparedStatement(connection, queryString, parameterCount,
+								   parameterTypes, relationIdList);
+	if (preparedStatement != NULL)
+	{
+		bool startedPipeline = false;
+
+		if (!preparedStatement->prepared)
+		{
+			if (PQpipelineStatus(connection->pgConn) == PQ_PIPELINE_OFF)
+			{
+				if (PQenterPipelineMode(connection->pgConn) == 0)
+				{
+					return 0;
+				}
+
+				startedPipeline = true;
+			}
+
+			int deallocationCount = SendRemoteDeallocations(connection);
+			if (deallocationCount < 0)
+			{
+				return 0;
+			}
+
+			session->pipelinedCommandCount += deallocationCount;
+
+			if (SendRemotePrepare(connection, preparedStatement) == 0)
+			{
+				return 0;
+			}
+
+			session->pipelinedCommandCount++;
+			session->pendingPreparedStatement = preparedStatement;
+		}
+
+		if (SendRemotePreparedCommandParams(connection, preparedStatement,
+											parameterValues, binaryResults) == 0)
+		{
+			return 0;
+		}
+
+		session->currentPreparedStatement = preparedStatement;
+
+		/* if the pipeline was started by the caller, it also ends it */
+		if (startedPipeline && PQpipelineSync(connection->pgConn) == 0)
+		{
+			return 0;
+		}
+
+		return 1;
+	}
+#endif
+
+	return SendRemoteCommandParams(connection, queryString, parameterCount,
+								   parameterTypes, parameterValues, binaryResults);
+}
+
+
+/*
+ * ReceivePipelinedCommandResults consumes the results of the commands that are
+ * pipelined before the current task of the session. It returns true once all
+ * of them are consumed, and false if results are still pending or the
+ * connection is lost. Failures of the pipelined commands are hard errors.
+ */
+static bool
+ReceivePipelinedCommandResults(WorkerSession *session)
+{
+	MultiConnection *connection = session->connection;
+
+	while (session->pipelinedCommandCount > 0)
+	{
+		if (PQisBusy(connection->pgConn))
+		{
+			return false;
+		}
+
+		PGresult *result = PQgetResult(connection->pgConn);
+		if (result != NULL)
+		{
+			if (!IsResponseOK(result))
+			{
+				/* query failures are always hard errors */
+				ReportResultError(connection, result, ERROR);
+			}
+
+			PQclear(result);
+			continue;
+		}
+
+		/* in pipeline mode, a NULL result ends the results of a command */
+		session->pipelinedCommandCount--;
+	}
+
+	if (session->pendingPreparedStatement != NULL)
+	{
+		session->pendingPreparedStatement->prepared = true;
+		session->pendingPreparedStatement = NULL;
+	}
+
+	/*
+	 * The task is next in the pipeline. Single row mode can only be set for
+	 * the command whose results are about to be fetched, so SendNextQuery
+	 * could not set it when sending the task.
+	 */
+	if (PQsetSingleRowMode(connection->pgConn) == 0)
+	{
+		connection->connectionState = MULTI_CONNECTION_LOST;
+		return false;
+	}
+
+	return true;
+}
+
+
 /*
  * ReceiveResults reads the result of a command or query and writes returned
  * rows to the tuple store of the scan state. It returns whether fetching results
@@ -4476,6 +5754,13 @@ ReceiveResults(WorkerSession *session, bool storeRows)
 								  task->tupleDest :
 								  execution->defaultTupleDest;
 
+	if (session->pipelinedCommandCount > 0 &&
+		!ReceivePipelinedCommandResults(session))
+	{
+		/* the results of the task are not available yet */
+		return false;
+	}
+
 	/*
 	 * We use this context while converting each row fetched from remote node
 	 * into tuple. The context is reseted on every row, thus we create it at the
@@ -4495,12 +5780,32 @@ ReceiveResults(WorkerSession *session, bool storeRows)
 		PGresult *result = PQgetResult(connection->pgConn);
 		if (result == NULL)
 		{
+#if PG_VERSION_NUM >= PG_VERSION_14
+			if (PQpipelineStatus(connection->pgConn) != PQ_PIPELINE_OFF)
+			{
+				/* the task was pipelined, wait for the end of the pipeline */
+				if (PQexitPipelineMode(connection->pgConn) == 0)
+				{
+					continue;
+				}
+			}
+#endif
+
 			/* no more results, break out of loop and free allocated memory */
 			fetchDone = true;
 			break;
 		}
 
 		ExecStatusType resultStatus = PQresultStatus(result);
+#if PG_VERSION_NUM >= PG_VERSION_14
+		if (resultStatus == PGRES_PIPELINE_SYNC)
+		{
+			/* end of the pipeline, the next NULL result ends pipeline mode */
+			PQclear(result);
+			continue;
+		}
+#endif
+
 		if (resultStatus == PGRES_COMMAND_OK)
 		{
 			char *currentAffectedTupleString = PQcmdTuples(result);
@@ -4535,6 +5840,13 @@ ReceiveResults(WorkerSession *session, bool storeRows)
 		}
 		else if (resultStatus != PGRES_SINGLE_TUPLE)
 		{
+			if (session->currentPreparedStatement != NULL &&
+				IsPreparedStatementResultTypeError(result))
+			{
+				/* the next execution prepares the statement again */
+				InvalidatePreparedStatement(session->currentPreparedStatement);
+			}
+
 			/* query failures are always hard errors */
 			ReportResultError(connection, result, ERROR);
 		}
@@ -5012,6 +6324,16 @@ PlacementExecutionDone(TaskPlacementExecution *placementExecution, bool succeede
 	if (newExecutionState == TASK_EXECUTION_FINISHED)
 	{
 		execution->unfinishedTaskCount--;
+
+		StreamingExecution *streamingExecution = execution->streamingExecution;
+		if (streamingExecution != NULL &&
+			streamingExecution->sortedMergeTupleDest != NULL)
+		{
+			/* the merge no longer needs to wait for tuples of the task */
+			SortedMergeTaskFinished(streamingExecution->sortedMergeTupleDest,
+									shardCommandExecution->task);
+		}
+
 		return;
 	}
 	else if (newExecutionState == TASK_EXECUTION_FAILOVER_TO_LOCAL_EXECUTION)
@@ -5132,36 +6454,56 @@ ScheduleNextPlacementExecution(TaskPlacementExecution *placementExecution, bool
 		executionOrder == EXECUTION_ORDER_SEQUENTIAL)
 	{
 		TaskPlacementExecution *nextPlacementExecution = NULL;
+		int placementExecutionCount = shardCommandExecution->placementExecutionCount;
+		bool allPlacementExecutionsFailed = true;
 
-		/* find a placement execution that is not yet marked as failed */
-		do {
-			int nextPlacementExecutionIndex =
-				placementExecution->placementExecutionIndex + 1;
+		/*
+		 * Find the first placement in the planning order on which the execution
+		 * has not happened yet. Usually, that is the placement that follows the
+		 * current one, but when another worker pool took over the task (see
+		 * StealPlacementExecution) the placement that it was taken from comes
+		 * earlier in the planning order.
+		 */
+		for (int placementExecutionIndex = 0;
+			 placementExecutionIndex < placementExecutionCount;
+			 placementExecutionIndex++)
+		{
+			TaskPlacementExecution *otherPlacementExecution =
+				shardCommandExecution->placementExecutions[placementExecutionIndex];
 
-			/*
-			 * If all tasks failed then we should already have errored out.
-			 * Still, be defensive and throw error instead of crashes.
-			 */
-			int placementExecutionCount = shardCommandExecution->placementExecutionCount;
-			if (nextPlacementExecutionIndex >= placementExecutionCount)
+			if (otherPlacementExecution->executionState == PLACEMENT_EXECUTION_NOT_READY)
 			{
-				WorkerPool *workerPool = placementExecution->workerPool;
-				ereport(ERROR, (errmsg("execution cannot recover from multiple "
-									   "connection failures. Last node failed "
-									   "%s:%d", workerPool->nodeName,
-									   workerPool->nodePort)));
+				nextPlacementExecution = otherPlacementExecution;
+				break;
 			}
-
-			/* get the next placement in the planning order */
-			nextPlacementExecution =
-				shardCommandExecution->placementExecutions[nextPlacementExecutionIndex];
-
-			if (nextPlacementExecution->executionState == PLACEMENT_EXECUTION_NOT_READY)
+			else if (otherPlacementExecution->executionState !=
+					 PLACEMENT_EXECUTION_FAILED)
 			{
-				/* move the placement execution to the ready queue */
-				PlacementExecutionReady(nextPlacementExecution);
+				allPlacementExecutionsFailed = false;
 			}
-		} while (nextPlacementExecution->executionState == PLACEMENT_EXECUTION_FAILED);
+		}
+
+		if (nextPlacementExecution == NULL && !allPlacementExecutionsFailed)
+		{
+			/* another placement execution is still in progress */
+			return;
+		}
+
+		/*
+		 * If all tasks failed then we should already have errored out.
+		 * Still, be defensive and throw error instead of crashes.
+		 */
+		if (nextPlacementExecution == NULL)
+		{
+			WorkerPool *workerPool = placementExecution->workerPool;
+			ereport(ERROR, (errmsg("execution cannot recover from multiple "
+								   "connection failures. Last node failed "
+								   "%s:%d", workerPool->nodeName,
+								   workerPool->nodePort)));
+		}
+
+		/* move the placement execution to the ready queue */
+		PlacementExecutionReady(nextPlacementExecution);
 	}
 }
 
@@ -30,7 +30,9 @@
 #include "distributed/multi_executor.h"
 #include "distributed/multi_server_executor.h"
 #include "distributed/multi_router_planner.h"
+#include "distributed/parallel_combine.h"
 #include "distributed/query_stats.h"
+#include "distributed/remote_commands.h"
 #include "distributed/subplan_execution.h"
 #include "distributed/worker_log_messages.h"
 #include "distributed/worker_protocol.h"
@@ -60,6 +62,8 @@ static void CitusBeginModifyScan(CustomScanState *node, EState *estate, int efla
 static void CitusPreExecScan(CitusScanState *scanState);
 static bool ModifyJobNeedsEvaluation(Job *workerJob);
 static void RegenerateTaskForFasthPathQuery(Job *workerJob);
+static void UseParameterizedQueryForRemoteTask(Job *workerJob,
+											   Query *parameterizedJobQuery);
 static void RegenerateTaskListForInsert(Job *workerJob);
 static DistributedPlan * CopyDistributedPlanWithoutCache(
 	DistributedPlan *originalDistributedPlan);
@@ -139,6 +143,8 @@ RegisterCitusCustomScanMethods(void)
 	RegisterCustomScanMethods(&AdaptiveExecutorCustomScanMethods);
 	RegisterCustomScanMethods(&NonPushableInsertSelectCustomScanMethods);
 	RegisterCustomScanMethods(&DelayedErrorCustomScanMethods);
+	RegisterCustomScanMethods(&ParallelCombineCustomScanMethods);
+	RegisterCustomScanMethods(&CombineBucketScanCustomScanMethods);
 }
 
 
@@ -153,6 +159,9 @@ CitusBeginScan(CustomScanState *node, EState *estate, int eflags)
 {
 	CitusScanState *scanState = (CitusScanState *) node;
 
+	/* streaming the results is only possible for scans that never go backwards */
+	scanState->eflags = eflags;
+
 	/*
 	 * Make sure we can see notices during regular queries, which would typically
 	 * be the result of a function that raises a notices being called.
@@ -229,7 +238,9 @@ CitusPreExecScan(CitusScanState *scanState)
  * CitusExecScan is called when a tuple is pulled from a custom scan.
  * On the first call, it executes the distributed query and writes the
  * results to a tuple store. The postgres executor calls this function
- * repeatedly to read tuples from the tuple store.
+ * repeatedly to read tuples from the tuple store. When the results are
+ * streamed, the first call only starts the execution and the tuple store
+ * is filled while tuples are read from it.
  */
 TupleTableSlot *
 CitusExecScan(CustomScanState *node)
@@ -297,6 +308,12 @@ CitusBeginReadOnlyScan(CustomScanState *node, EState *estate, int eflags)
 	 *
 	 * TODO: evaluate stable functions
 	 */
+	Query *parameterizedJobQuery = NULL;
+	if (MaxCachedPreparedStatements > 0 && estate->es_param_list_info != NULL)
+	{
+		parameterizedJobQuery = copyObject(jobQuery);
+	}
+
 	ExecuteCoordinatorEvaluableExpressions(jobQuery, planState);
 
 	/* job query no longer has parameters, so we should not send any */
@@ -305,6 +322,11 @@ CitusBeginReadOnlyScan(CustomScanState *node, EState *estate, int eflags)
 	/* parameters are filled in, so we can generate a task for this execution */
 	RegenerateTaskForFasthPathQuery(workerJob);
 
+	if (parameterizedJobQuery != NULL)
+	{
+		UseParameterizedQueryForRemoteTask(workerJob, parameterizedJobQuery);
+	}
+
 	if (IsLocalPlanCachingSupported(workerJob, originalDistributedPlan))
 	{
 		Task *task = linitial(workerJob->taskList);
@@ -582,6 +604,39 @@ RegenerateTaskForFasthPathQuery(Job *workerJob)
 }
 
 
+/*
+ * UseParameterizedQueryForRemoteTask makes the task of a fast-path query send
+ * the query with its parameters instead of the query in which the parameters
+ * are resolved. The query string is then the same across executions, which
+ * allows the statement to be prepared once per worker connection when
+ * citus.max_cached_prepared_statements is set.
+ *
+ * Tasks that might be executed locally keep the resolved query, such that they
+ * can benefit from local plan caching.
+ */
+static void
+UseParameterizedQueryForRemoteTask(Job *workerJob, Query *parameterizedJobQuery)
+{
+	Task *task = linitial(workerJob->taskList);
+
+	if (TaskAccessesLocalNode(task))
+	{
+		return;
+	}
+
+	UpdateRelationToShardNames((Node *) parameterizedJobQuery, task->relationShardList);
+	SetTaskQueryIfShouldLazyDeparse(task, parameterizedJobQuery);
+	task->parametersInQueryStringResolved = false;
+
+	/*
+	 * The executor looks for unreferenced parameters in the job query, so it
+	 * should reflect the query that is sent. We leave parametersInJobQueryResolved
+	 * as is, since pruning is already done using the resolved parameters.
+	 */
+	workerJob->jobQuery = parameterizedJobQuery;
+}
+
+
 /*
  * AdaptiveExecutorCreateScan creates the scan state for the adaptive executor.
  */
@@ -661,6 +716,15 @@ CitusEndScan(CustomScanState *node)
 	Const *partitionKeyConst = NULL;
 	char *partitionKeyString = NULL;
 
+	/*
+	 * If the scan ends before all results arrived (e.g., due to a LIMIT on the
+	 * coordinator), we still need to finish the execution.
+	 */
+	if (scanState->streamingExecution != NULL)
+	{
+		FinishStreamingExecution(scanState);
+	}
+
 	/* stop propagating notices */
 	DisableWorkerMessagePropagation();
 
@@ -766,6 +830,20 @@ FetchCitusCustomScanIfExists(Plan *plan)
 		customScan = FetchCitusCustomScanIfExists(plan->righttree);
 	}
 
+	if (customScan == NULL && IsA(plan, CustomScan))
+	{
+		/* a parallel combine keeps the Citus scan in its custom plans */
+		Plan *customPlan = NULL;
+		foreach_ptr(customPlan, ((CustomScan *) plan)->custom_plans)
+		{
+			customScan = FetchCitusCustomScanIfExists(customPlan);
+			if (customScan != NULL)
+			{
+				break;
+			}
+		}
+	}
+
 	return customScan;
 }
 
@@ -787,6 +865,19 @@ IsCitusPlan(Plan *plan)
 		return true;
 	}
 
+	if (IsA(plan, CustomScan))
+	{
+		/* a parallel combine keeps the Citus scan in its custom plans */
+		Plan *customPlan = NULL;
+		foreach_ptr(customPlan, ((CustomScan *) plan)->custom_plans)
+		{
+			if (IsCitusPlan(customPlan))
+			{
+				return true;
+			}
+		}
+	}
+
 	return IsCitusPlan(plan->lefttree) || IsCitusPlan(plan->righttree);
 }
 
@@ -47,6 +47,14 @@
 #include "utils/syscache.h"
 
 
+/*
+ * Rows of an intermediate result are buffered up to this size before they are
+ * sent to the nodes, to avoid the overhead of sending each row to each node
+ * separately.
+ */
+#define BROADCAST_COPY_DATA_BUFFER_SIZE (64 * 1024)
+
+
 static List *CreatedResultsDirectories = NIL;
 
 
@@ -91,8 +99,7 @@ static void PrepareIntermediateResultBroadcast(RemoteFileDestReceiver *resultDes
 static StringInfo ConstructCopyResultStatement(const char *resultId);
 static bool RemoteFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest);
 static void BroadcastCopyData(StringInfo dataBuffer, List *connectionList);
-static void SendCopyDataOverConnection(StringInfo dataBuffer,
-									   MultiConnection *connection);
+static void FlushBufferedCopyData(RemoteFileDestReceiver *resultDest);
 static void RemoteFileDestReceiverShutdown(DestReceiver *destReceiver);
 static void RemoteFileDestReceiverDestroy(DestReceiver *destReceiver);
 
@@ -353,6 +360,9 @@ PrepareIntermediateResultBroadcast(RemoteFileDestReceiver *resultDest)
 		{
 			WriteToLocalFile(copyOutState->fe_msgbuf, &resultDest->fileCompat);
 		}
+
+		/* rows are buffered after the headers, which must not be sent again */
+		resetStringInfo(copyOutState->fe_msgbuf);
 	}
 
 	resultDest->connectionList = connectionList;
@@ -396,7 +406,6 @@ RemoteFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 
 	TupleDesc tupleDescriptor = resultDest->tupleDescriptor;
 
-	List *connectionList = resultDest->connectionList;
 	CopyOutState copyOutState = resultDest->copyOutState;
 	FmgrInfo *columnOutputFunctions = resultDest->columnOutputFunctions;
 
@@ -411,25 +420,19 @@ RemoteFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 	Datum *columnValues = slot->tts_values;
 	bool *columnNulls = slot->tts_isnull;
 
-	resetStringInfo(copyData);
-
-	/* construct row in COPY format */
+	/* construct row in COPY format, after the rows that were not sent yet */
 	AppendCopyRowData(columnValues, columnNulls, tupleDescriptor,
 					  copyOutState, columnOutputFunctions, NULL);
 
-	/* send row to nodes */
-	BroadcastCopyData(copyData, connectionList);
-
-	/* write to local file (if applicable) */
-	if (resultDest->writeLocalFile)
+	/* send rows to nodes and/or write them to the local file */
+	if (copyData->len >= BROADCAST_COPY_DATA_BUFFER_SIZE)
 	{
-		WriteToLocalFile(copyOutState->fe_msgbuf, &resultDest->fileCompat);
+		FlushBufferedCopyData(resultDest);
 	}
 
 	MemoryContextSwitchTo(oldContext);
 
 	resultDest->tuplesSent++;
-	resultDest->bytesSent += copyData->len;
 
 	ResetPerTupleExprContext(executorState);
 
@@ -437,6 +440,33 @@ RemoteFileDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 }
 
 
+/*
+ * FlushBufferedCopyData sends the rows that the RemoteFileDestReceiver
+ * buffered to all nodes and writes them to the local file, if applicable.
+ */
+static void
+FlushBufferedCopyData(RemoteFileDestReceiver *resultDest)
+{
+	StringInfo copyData = resultDest->copyOutState->fe_msgbuf;
+
+	if (copyData->len == 0)
+	{
+		return;
+	}
+
+	BroadcastCopyData(copyData, resultDest->connectionList);
+
+	if (resultDest->writeLocalFile)
+	{
+		WriteToLocalFile(copyData, &resultDest->fileCompat);
+	}
+
+	resultDest->bytesSent += copyData->len;
+
+	resetStringInfo(copyData);
+}
+
+
 /*
  * WriteToLocalResultsFile writes the bytes in a StringInfo to a local file.
  */
@@ -478,6 +508,9 @@ RemoteFileDestReceiverShutdown(DestReceiver *destReceiver)
 	List *connectionList = resultDest->connectionList;
 	CopyOutState copyOutState = resultDest->copyOutState;
 
+	/* send the rows that are still buffered */
+	FlushBufferedCopyData(resultDest);
+
 	if (copyOutState->binary)
 	{
 		/* send footers when using binary encoding */
@@ -502,30 +535,14 @@ RemoteFileDestReceiverShutdown(DestReceiver *destReceiver)
 
 
 /*
- * BroadcastCopyData sends copy data to all connections in a list.
+ * BroadcastCopyData sends copy data to all connections in a list. The data
+ * is flushed to all connections concurrently, such that a large result is
+ * not sent to one node after the other.
  */
 static void
 BroadcastCopyData(StringInfo dataBuffer, List *connectionList)
 {
-	MultiConnection *connection = NULL;
-	foreach_ptr(connection, connectionList)
-	{
-		SendCopyDataOverConnection(dataBuffer, connection);
-	}
-}
-
-
-/*
- * SendCopyDataOverConnection sends serialized COPY data over the given
- * connection.
- */
-static void
-SendCopyDataOverConnection(StringInfo dataBuffer, MultiConnection *connection)
-{
-	if (!PutRemoteCopyData(connection, dataBuffer->data, dataBuffer->len))
-	{
-		ReportConnectionError(connection, ERROR);
-	}
+	BroadcastRemoteCopyData(connectionList, dataBuffer->data, dataBuffer->len);
 }
 
 
@@ -0,0 +1,552 @@
+/*-------------------------------------------------------------------------
+ *
+ * join_key_filter.c
+ *
+ * Repartition joins hash partition both sides of the join and transfer all
+ * of their partitions between nodes, even when few rows of one side have a
+ * matching row on the other side. When citus.enable_repartition_join_key_filter
+ * is set, the planner instead marks the right side of inner dual partition
+ * joins to build a join key filter:
+ *
+ * - Before the map tasks run, the executor runs worker_join_key_hashes() on
+ *   the shards of the right side, which returns the distinct hashes of the
+ *   join keys of each shard.
+ * - The coordinator combines these hashes into a bloom filter, and broadcasts
+ *   it to all nodes as an intermediate result.
+ * - The map tasks of the left side read the filter and pass it to
+ *   worker_partition_query_result(), which skips rows whose join key hash is
+ *   not in the filter before writing them to the partition files.
+ *
+ * The hashes are computed with the same hash function that is used for
+ * partitioning, such that false positives only cost transferring a row that
+ * the join would discard anyway. If the right side has too many distinct join
+ * keys for the filter to be selective, an empty filter is broadcast, which
+ * disables the filtering.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+
+#include "access/hash.h"
+#include "catalog/pg_type.h"
+#include "distributed/citus_nodes.h"
+#include "distributed/hash_helpers.h"
+#include "distributed/intermediate_results.h"
+#include "distributed/join_key_filter.h"
+#include "distributed/listutils.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/multi_executor.h"
+#include "distributed/multi_physical_planner.h"
+#include "distributed/tuple_destination.h"
+#include "distributed/utils/array_type.h"
+#include "distributed/worker_manager.h"
+#include "executor/executor.h"
+#include "executor/tuptable.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/tuplestore.h"
+#include "utils/typcache.h"
+
+
+/* size of join key filters, which gives a false positive rate of about 1% */
+#define JOIN_KEY_FILTER_BITS_PER_KEY 10
+#define JOIN_KEY_FILTER_HASH_COUNT 7
+#define JOIN_KEY_FILTER_MIN_BITS 64
+
+
+/*
+ * JoinKeyHashDestReceiver collects the distinct hashes of the join key column
+ * of the tuples streamed into it.
+ */
+typedef struct JoinKeyHashDestReceiver
+{
+	/* public DestReceiver interface */
+	DestReceiver pub;
+
+	/* which column of streamed tuples holds the join key */
+	int keyColumnIndex;
+
+	/* number of distinct hashes after which we stop collecting */
+	int maxKeyCount;
+
+	/* hash function and collation of the join key column */
+	FmgrInfo *hashFunction;
+	Oid keyCollation;
+
+	/* set of uint32 hashes of the join keys */
+	HTAB *keyHashSet;
+
+	/* whether the query returned more than maxKeyCount distinct hashes */
+	bool tooManyKeys;
+} JoinKeyHashDestReceiver;
+
+
+static JoinKeyHashDestReceiver * CreateJoinKeyHashDestReceiver(int keyColumnIndex,
+															   int maxKeyCount);
+static void JoinKeyHashDestReceiverStartup(DestReceiver *dest, int operation,
+										   TupleDesc inputTupleDescriptor);
+static bool JoinKeyHashDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest);
+static void JoinKeyHashDestReceiverShutdown(DestReceiver *dest);
+static void JoinKeyHashDestReceiverDestroy(DestReceiver *dest);
+static HTAB * CreateJoinKeyHashSet(void);
+static void CollectJoinKeyFilterJobs(Job *job, List **mapMergeJobList);
+static bytea * ExecuteJoinKeyHashTasks(List *joinKeyHashTaskList);
+static void BroadcastJoinKeyFilter(char *resultId, bytea *joinKeyFilter);
+static bytea * BuildJoinKeyFilter(HTAB *keyHashSet);
+static uint32 JoinKeyFilterProbeStep(uint32 keyHash);
+
+/* exports for SQL callable functions */
+PG_FUNCTION_INFO_V1(worker_join_key_hashes);
+
+
+/*
+ * worker_join_key_hashes executes a query and returns the distinct hashes of
+ * the values in the given column of its result as an int array. NULL values
+ * are skipped, since they never match in an inner join.
+ *
+ * If the query returns more than the given number of distinct hashes, the
+ * query is cancelled and the function returns NULL.
+ */
+Datum
+worker_join_key_hashes(PG_FUNCTION_ARGS)
+{
+	CheckCitusVersion(ERROR);
+
+	text *queryText = PG_GETARG_TEXT_P(0);
+	char *queryString = text_to_cstring(queryText);
+	int keyColumnIndex = PG_GETARG_INT32(1);
+	int maxKeyCount = PG_GETARG_INT32(2);
+	ParamListInfo paramListInfo = NULL;
+
+	if (maxKeyCount < 0)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("maximum key count cannot be negative")));
+	}
+
+	JoinKeyHashDestReceiver *keyHashDest =
+		CreateJoinKeyHashDestReceiver(keyColumnIndex, maxKeyCount);
+
+	ExecuteQueryStringIntoDestReceiver(queryString, paramListInfo,
+									   (DestReceiver *) keyHashDest);
+
+	if (keyHashDest->tooManyKeys)
+	{
+		PG_RETURN_NULL();
+	}
+
+	int keyCount = hash_get_num_entries(keyHashDest->keyHashSet);
+	Datum *keyHashDatums = palloc0(keyCount * sizeof(Datum));
+	int keyIndex = 0;
+
+	HASH_SEQ_STATUS status;
+	uint32 *keyHash = NULL;
+
+	hash_seq_init(&status, keyHashDest->keyHashSet);
+	while ((keyHash = hash_seq_search(&status)) != NULL)
+	{
+		keyHashDatums[keyIndex++] = Int32GetDatum((int32) *keyHash);
+	}
+
+	ArrayType *keyHashArray = DatumArrayToArrayType(keyHashDatums, keyCount, INT4OID);
+
+	PG_RETURN_ARRAYTYPE_P(keyHashArray);
+}
+
+
+/*
+ * CreateJoinKeyHashDestReceiver sets up a JoinKeyHashDestReceiver.
+ */
+static JoinKeyHashDestReceiver *
+CreateJoinKeyHashDestReceiver(int keyColumnIndex, int maxKeyCount)
+{
+	JoinKeyHashDestReceiver *keyHashDest = palloc0(sizeof(JoinKeyHashDestReceiver));
+
+	/* set up the DestReceiver function pointers */
+	keyHashDest->pub.receiveSlot = JoinKeyHashDestReceiverReceive;
+	keyHashDest->pub.rStartup = JoinKeyHashDestReceiverStartup;
+	keyHashDest->pub.rShutdown = JoinKeyHashDestReceiverShutdown;
+	keyHashDest->pub.rDestroy = JoinKeyHashDestReceiverDestroy;
+	keyHashDest->pub.mydest = DestNone;
+
+	keyHashDest->keyColumnIndex = keyColumnIndex;
+	keyHashDest->maxKeyCount = maxKeyCount;
+	keyHashDest->keyHashSet = CreateJoinKeyHashSet();
+	keyHashDest->tooManyKeys = false;
+
+	return keyHashDest;
+}
+
+
+/*
+ * JoinKeyHashDestReceiverStartup implements the rStartup interface of
+ * JoinKeyHashDestReceiver by looking up the hash function of the key column.
+ */
+static void
+JoinKeyHashDestReceiverStartup(DestReceiver *dest, int operation,
+							   TupleDesc inputTupleDescriptor)
+{
+	JoinKeyHashDestReceiver *self = (JoinKeyHashDestReceiver *) dest;
+	int keyColumnIndex = self->keyColumnIndex;
+
+	if (keyColumnIndex < 0 || keyColumnIndex >= inputTupleDescriptor->natts)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("key column index must be between 0 and %d",
+							   inputTupleDescriptor->natts - 1)));
+	}
+
+	Form_pg_attribute keyColumnAttr = TupleDescAttr(inputTupleDescriptor,
+													keyColumnIndex);
+	TypeCacheEntry *typeEntry = lookup_type_cache(keyColumnAttr->atttypid,
+												  TYPECACHE_HASH_PROC_FINFO);
+	if (!OidIsValid(typeEntry->hash_proc_finfo.fn_oid))
+	{
+		ereport(ERROR, (errmsg("no hash function defined for type %s",
+							   format_type_be(keyColumnAttr->atttypid))));
+	}
+
+	self->hashFunction = palloc0(sizeof(FmgrInfo));
+	fmgr_info_copy(self->hashFunction, &(typeEntry->hash_proc_finfo),
+				   CurrentMemoryContext);
+	self->keyCollation = keyColumnAttr->attcollation;
+}
+
+
+/*
+ * JoinKeyHashDestReceiverReceive implements the receiveSlot interface of
+ * JoinKeyHashDestReceiver. It returns false to stop the execution once there
+ * are too many distinct hashes.
+ */
+static bool
+JoinKeyHashDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
+{
+	JoinKeyHashDestReceiver *self = (JoinKeyHashDestReceiver *) dest;
+	bool isNull = false;
+
+	Datum keyValue = slot_getattr(slot, self->keyColumnIndex + 1, &isNull);
+	if (isNull)
+	{
+		return true;
+	}
+
+	uint32 keyHash = DatumGetUInt32(FunctionCall1Coll(self->hashFunction,
+													  self->keyCollation,
+													  keyValue));
+
+	hash_search(self->keyHashSet, &keyHash, HASH_ENTER, NULL);
+
+	if (hash_get_num_entries(self->keyHashSet) > self->maxKeyCount)
+	{
+		self->tooManyKeys = true;
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * JoinKeyHashDestReceiverShutdown implements the rShutdown interface of
+ * JoinKeyHashDestReceiver. The hashes are read after the execution, so
+ * there is nothing to do.
+ */
+static void
+JoinKeyHashDestReceiverShutdown(DestReceiver *dest)
+{
+	/* nothing to do */
+}
+
+
+/*
+ * JoinKeyHashDestReceiverDestroy implements the rDestroy interface of
+ * JoinKeyHashDestReceiver.
+ */
+static void
+JoinKeyHashDestReceiverDestroy(DestReceiver *dest)
+{
+	/* the hashes are still needed, they go away with the memory context */
+}
+
+
+/*
+ * CreateJoinKeyHashSet creates a hash table that is used as a set of uint32
+ * join key hashes.
+ */
+static HTAB *
+CreateJoinKeyHashSet(void)
+{
+	HASHCTL info;
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(uint32);
+	info.entrysize = sizeof(uint32);
+	info.hcxt = CurrentMemoryContext;
+	int hashFlags = (HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	return hash_create("join key hash set", 1024, &info, hashFlags);
+}
+
+
+/*
+ * JoinKeyFilterResultId returns the id of the intermediate result in which
+ * the join key filter built from the given job is broadcast.
+ */
+char *
+JoinKeyFilterResultId(uint64 jobId)
+{
+	StringInfo resultId = makeStringInfo();
+
+	appendStringInfo(resultId, "repartition_" UINT64_FORMAT "_join_key_filter", jobId);
+
+	return resultId->data;
+}
+
+
+/*
+ * ExecuteJoinKeyFilterTasks builds the join key filters of the map merge jobs
+ * in the given job tree, and broadcasts them to all nodes. It must be called
+ * before the map tasks of the job tree are executed.
+ */
+void
+ExecuteJoinKeyFilterTasks(Job *topLevelJob)
+{
+	List *mapMergeJobList = NIL;
+	CollectJoinKeyFilterJobs(topLevelJob, &mapMergeJobList);
+
+	MapMergeJob *mapMergeJob = NULL;
+	foreach_ptr(mapMergeJob, mapMergeJobList)
+	{
+		char *resultId = JoinKeyFilterResultId(mapMergeJob->job.jobId);
+		bytea *joinKeyFilter =
+			ExecuteJoinKeyHashTasks(mapMergeJob->joinKeyFilterTaskList);
+
+		BroadcastJoinKeyFilter(resultId, joinKeyFilter);
+	}
+}
+
+
+/*
+ * CollectJoinKeyFilterJobs appends the map merge jobs in the given job tree
+ * that build a join key filter to mapMergeJobList.
+ */
+static void
+CollectJoinKeyFilterJobs(Job *job, List **mapMergeJobList)
+{
+	if (CitusIsA(job, MapMergeJob) && ((MapMergeJob *) job)->buildJoinKeyFilter)
+	{
+		*mapMergeJobList = lappend(*mapMergeJobList, job);
+	}
+
+	Job *dependentJob = NULL;
+	foreach_ptr(dependentJob, job->dependentJobList)
+	{
+		CollectJoinKeyFilterJobs(dependentJob, mapMergeJobList);
+	}
+}
+
+
+/*
+ * ExecuteJoinKeyHashTasks executes the given worker_join_key_hashes() tasks
+ * and returns a bloom filter over all hashes they return. If any of the tasks
+ * returned too many hashes, an empty filter is returned instead.
+ */
+static bytea *
+ExecuteJoinKeyHashTasks(List *joinKeyHashTaskList)
+{
+	TupleDesc tupleDescriptor = CreateTemplateTupleDesc(1);
+	TupleDescInitEntry(tupleDescriptor, (AttrNumber) 1, "key_hashes",
+					   INT4ARRAYOID, -1, 0);
+
+	bool randomAccess = false;
+	bool interTransactions = false;
+	Tuplestorestate *tupleStore =
+		tuplestore_begin_heap(randomAccess, interTransactions, work_mem);
+	TupleDestination *tupleDest = CreateTupleStoreTupleDest(tupleStore,
+															tupleDescriptor);
+
+	bool expectResults = true;
+	ExecuteTaskListIntoTupleDest(ROW_MODIFY_READONLY, joinKeyHashTaskList, tupleDest,
+								 expectResults);
+
+	HTAB *keyHashSet = CreateJoinKeyHashSet();
+	bool tooManyKeys = false;
+
+	TupleTableSlot *slot = MakeSingleTupleTableSlot(tupleDescriptor,
+													&TTSOpsMinimalTuple);
+	while (!tooManyKeys && tuplestore_gettupleslot(tupleStore, true, false, slot))
+	{
+		bool isNull = false;
+		Datum keyHashArrayDatum = slot_getattr(slot, 1, &isNull);
+		if (isNull)
+		{
+			tooManyKeys = true;
+			break;
+		}
+
+		ArrayType *keyHashArray = DatumGetArrayTypeP(keyHashArrayDatum);
+		Datum *keyHashDatums = DeconstructArrayObject(keyHashArray);
+		int keyHashCount = ArrayObjectCount(keyHashArray);
+
+		for (int keyHashIndex = 0; keyHashIndex < keyHashCount; keyHashIndex++)
+		{
+			uint32 keyHash = DatumGetUInt32(keyHashDatums[keyHashIndex]);
+
+			hash_search(keyHashSet, &keyHash, HASH_ENTER, NULL);
+		}
+
+		if (hash_get_num_entries(keyHashSet) > JOIN_KEY_FILTER_MAX_KEYS)
+		{
+			tooManyKeys = true;
+		}
+	}
+
+	ExecDropSingleTupleTableSlot(slot);
+	tuplestore_end(tupleStore);
+
+	if (tooManyKeys)
+	{
+		/* an empty filter tells the map tasks not to filter */
+		bytea *emptyFilter = palloc0(VARHDRSZ);
+		SET_VARSIZE(emptyFilter, VARHDRSZ);
+
+		return emptyFilter;
+	}
+
+	return BuildJoinKeyFilter(keyHashSet);
+}
+
+
+/*
+ * BroadcastJoinKeyFilter writes the given join key filter into an intermediate
+ * result with the given id on all nodes, including the local one.
+ */
+static void
+BroadcastJoinKeyFilter(char *resultId, bytea *joinKeyFilter)
+{
+	List *remoteNodeList = NIL;
+	int32 localGroupId = GetLocalGroupId();
+
+	WorkerNode *workerNode = NULL;
+	foreach_ptr(workerNode, ActivePrimaryNodeList(NoLock))
+	{
+		if (workerNode->groupId != localGroupId)
+		{
+			remoteNodeList = lappend(remoteNodeList, workerNode);
+		}
+	}
+
+	TupleDesc tupleDescriptor = CreateTemplateTupleDesc(1);
+	TupleDescInitEntry(tupleDescriptor, (AttrNumber) 1, "join_key_filter",
+					   BYTEAOID, -1, 0);
+
+	TupleTableSlot *slot = MakeSingleTupleTableSlot(tupleDescriptor, &TTSOpsVirtual);
+	ExecClearTuple(slot);
+	slot->tts_values[0] = PointerGetDatum(joinKeyFilter);
+	slot->tts_isnull[0] = false;
+	ExecStoreVirtualTuple(slot);
+
+	/* map tasks that are executed locally read the filter from a local file */
+	bool writeLocalFile = true;
+	EState *estate = CreateExecutorState();
+	DestReceiver *resultDest = CreateRemoteFileDestReceiver(resultId, estate,
+															remoteNodeList,
+															writeLocalFile);
+
+	resultDest->rStartup(resultDest, CMD_SELECT, tupleDescriptor);
+	resultDest->receiveSlot(slot, resultDest);
+	resultDest->rShutdown(resultDest);
+	resultDest->rDestroy(resultDest);
+
+	ExecDropSingleTupleTableSlot(slot);
+	FreeExecutorState(estate);
+}
+
+
+/*
+ * BuildJoinKeyFilter returns a bloom filter over the given set of join key
+ * hashes, with JOIN_KEY_FILTER_BITS_PER_KEY bits per hash.
+ */
+static bytea *
+BuildJoinKeyFilter(HTAB *keyHashSet)
+{
+	uint64 keyCount = hash_get_num_entries(keyHashSet);
+	uint64 bitCount = Max(keyCount * JOIN_KEY_FILTER_BITS_PER_KEY,
+						  JOIN_KEY_FILTER_MIN_BITS);
+	Size byteCount = (bitCount + BITS_PER_BYTE - 1) / BITS_PER_BYTE;
+
+	bitCount = byteCount * BITS_PER_BYTE;
+
+	bytea *joinKeyFilter = palloc0(VARHDRSZ + byteCount);
+	SET_VARSIZE(joinKeyFilter, VARHDRSZ + byteCount);
+
+	uint8 *filterBits = (uint8 *) VARDATA(joinKeyFilter);
+
+	HASH_SEQ_STATUS status;
+	uint32 *keyHash = NULL;
+
+	hash_seq_init(&status, keyHashSet);
+	while ((keyHash = hash_seq_search(&status)) != NULL)
+	{
+		uint32 probeStep = JoinKeyFilterProbeStep(*keyHash);
+
+		for (int probeIndex = 0; probeIndex < JOIN_KEY_FILTER_HASH_COUNT; probeIndex++)
+		{
+			uint64 bitIndex = ((uint64) *keyHash + (uint64) probeIndex * probeStep) %
+							  bitCount;
+
+			filterBits[bitIndex / BITS_PER_BYTE] |= (1 << (bitIndex % BITS_PER_BYTE));
+		}
+	}
+
+	return joinKeyFilter;
+}
+
+
+/*
+ * JoinKeyFilterContains returns whether the bits of the given join key hash
+ * are all set in the given non-empty join key filter. False positives are
+ * possible, false negatives are not.
+ */
+bool
+JoinKeyFilterContains(bytea *joinKeyFilter, uint32 keyHash)
+{
+	uint64 bitCount = (uint64) VARSIZE_ANY_EXHDR(joinKeyFilter) * BITS_PER_BYTE;
+	const uint8 *filterBits = (const uint8 *) VARDATA_ANY(joinKeyFilter);
+	uint32 probeStep = JoinKeyFilterProbeStep(keyHash);
+
+	Assert(bitCount > 0);
+
+	for (int probeIndex = 0; probeIndex < JOIN_KEY_FILTER_HASH_COUNT; probeIndex++)
+	{
+		uint64 bitIndex = ((uint64) keyHash + (uint64) probeIndex * probeStep) %
+						  bitCount;
+
+		uint8 bitMask = 1 << (bitIndex % BITS_PER_BYTE);
+
+		if ((filterBits[bitIndex / BITS_PER_BYTE] & bitMask) == 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * JoinKeyFilterProbeStep returns the distance between the bits of the given
+ * join key hash in a join key filter. The bits are picked by double hashing,
+ * where the second hash is derived from the first one. It is made odd, such
+ * that it is never 0.
+ */
+static uint32
+JoinKeyFilterProbeStep(uint32 keyHash)
+{
+	return DatumGetUInt32(hash_uint32(keyHash)) | 1;
+}
@@ -70,7 +70,8 @@
  *
  *  There are also a few limitations/trade-offs that are worth mentioning.
  *  - The local execution on multiple shards might be slow because the execution
- *  has to happen one task at a time (e.g., no parallelism).
+ *  has to happen one task at a time, unless the read-only tasks are executed by
+ *  parallel workers (see citus.max_parallel_workers_per_local_execution).
  *  - Related with the previous item, COPY command cannot be mixed with local
  *  execution in a transaction. The implication of that is any part of INSERT..SELECT
  *  via coordinator cannot happen via the local execution.
@@ -93,6 +94,7 @@
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_executor.h"
 #include "distributed/multi_server_executor.h"
+#include "distributed/parallel_local_executor.h"
 #include "distributed/relation_access_tracking.h"
 #include "distributed/remote_commands.h" /* to access LogRemoteCommands */
 #include "distributed/transaction_management.h"
@@ -226,6 +228,24 @@ ExecuteLocalTaskListExtended(List *taskList,
 		EnsureTaskExecutionAllowed(isRemote);
 	}
 
+	if (ShouldExecuteLocalTaskListInParallel(taskList, distributedPlan, paramListInfo,
+											 isUtilityCommand))
+	{
+		Task *task = NULL;
+		foreach_ptr(task, taskList)
+		{
+			if (task->anchorShardId != INVALID_SHARD_ID)
+			{
+				SetLocalExecutionStatus(LOCAL_EXECUTION_REQUIRED);
+			}
+
+			LogLocalCommand(task);
+			RecordNonDistTableAccessesForTask(task);
+		}
+
+		return ExecuteLocalTaskListInParallel(taskList, defaultTupleDest);
+	}
+
 	/*
 	 * Use a new memory context that gets reset after every task to free
 	 * the deparsed query string and query plan.
@@ -324,22 +344,42 @@ ExecuteLocalTaskListExtended(List *taskList,
 				continue;
 			}
 
-			Query *shardQuery = ParseQueryString(TaskQueryString(task),
-												 taskParameterTypes,
-												 taskNumParams);
-
-
-			int cursorOptions = CURSOR_OPT_PARALLEL_OK;
+			char *taskQueryString = TaskQueryString(task);
 
 			/*
-			 * Altough the shardQuery is local to this node, we prefer planner()
-			 * over standard_planner(). The primary reason for that is Citus itself
-			 * is not very tolarent standard_planner() calls that doesn't go through
-			 * distributed_planner() because of the way that restriction hooks are
-			 * implemented. So, let planner to call distributed_planner() which
-			 * eventually calls standard_planner().
+			 * Shard queries without parameters do not depend on the parameter
+			 * values, so we can reuse their plans across tasks and executions.
 			 */
-			localPlan = planner_compat(shardQuery, cursorOptions, paramListInfo);
+			bool useLocalShardPlanCache = taskNumParams == 0;
+			if (useLocalShardPlanCache)
+			{
+				localPlan = GetCachedLocalShardPlan(taskQueryString);
+			}
+
+			if (localPlan == NULL)
+			{
+				Query *shardQuery = ParseQueryString(taskQueryString,
+													 taskParameterTypes,
+													 taskNumParams);
+
+
+				int cursorOptions = CURSOR_OPT_PARALLEL_OK;
+
+				/*
+				 * Altough the shardQuery is local to this node, we prefer planner()
+				 * over standard_planner(). The primary reason for that is Citus itself
+				 * is not very tolarent standard_planner() calls that doesn't go through
+				 * distributed_planner() because of the way that restriction hooks are
+				 * implemented. So, let planner to call distributed_planner() which
+				 * eventually calls standard_planner().
+				 */
+				localPlan = planner_compat(shardQuery, cursorOptions, paramListInfo);
+
+				if (useLocalShardPlanCache)
+				{
+					CacheLocalShardPlan(taskQueryString, localPlan);
+				}
+			}
 		}
 
 		char *shardQueryString = NULL;
@@ -89,6 +89,8 @@ int ExecutorLevel = 0;
 
 
 /* local function forward declarations */
+static void FetchTupleFromTuplestore(CitusScanState *scanState,
+									 bool forwardScanDirection, TupleTableSlot *slot);
 static Relation StubRelation(TupleDesc tupleDescriptor);
 static char * GetObjectTypeString(ObjectType objType);
 static bool AlterTableConstraintCheck(QueryDesc *queryDesc);
@@ -321,6 +323,28 @@ CitusCustomScanStateWalker(PlanState *planState, List **citusCustomScanStates)
 }
 
 
+/*
+ * FetchTupleFromTuplestore reads the next tuple from the tuple store of the
+ * given Citus scan node into the slot. If the results of the scan are still
+ * being streamed into the tuple store, it first waits for the next tuple.
+ */
+static void
+FetchTupleFromTuplestore(CitusScanState *scanState, bool forwardScanDirection,
+						 TupleTableSlot *slot)
+{
+	if (scanState->streamingExecution != NULL)
+	{
+		/* we only stream results for scans that do not go backwards */
+		Assert(forwardScanDirection);
+
+		AdvanceStreamingExecution(scanState);
+	}
+
+	tuplestore_gettupleslot(scanState->tuplestorestate, forwardScanDirection, false,
+							slot);
+}
+
+
 /*
  * ReturnTupleFromTuplestore reads the next tuple from the tuple store of the
  * given Citus scan node and returns it. It returns null if all tuples are read
@@ -354,7 +378,7 @@ ReturnTupleFromTuplestore(CitusScanState *scanState)
 	{
 		/* no quals, nor projections return directly from the tuple store. */
 		TupleTableSlot *slot = scanState->customScanState.ss.ss_ScanTupleSlot;
-		tuplestore_gettupleslot(tupleStore, forwardScanDirection, false, slot);
+		FetchTupleFromTuplestore(scanState, forwardScanDirection, slot);
 		return slot;
 	}
 
@@ -373,7 +397,7 @@ ReturnTupleFromTuplestore(CitusScanState *scanState)
 		ResetExprContext(econtext);
 
 		TupleTableSlot *slot = scanState->customScanState.ss.ss_ScanTupleSlot;
-		tuplestore_gettupleslot(tupleStore, forwardScanDirection, false, slot);
+		FetchTupleFromTuplestore(scanState, forwardScanDirection, slot);
 
 		if (TupIsNull(slot))
 		{
@@ -36,6 +36,9 @@ int TaskExecutorType = MULTI_EXECUTOR_ADAPTIVE; /* distributed executor type */
 bool EnableRepartitionJoins = false;
 
 
+static bool DependsOnRepartitionJoin(Job *job);
+
+
 /*
  * JobExecutorType selects the executor type for the given distributedPlan using the task
  * executor type config value. The function then checks if the given distributedPlan needs
@@ -60,11 +63,11 @@ JobExecutorType(DistributedPlan *distributedPlan)
 	}
 
 	/*
-	 * If we have repartition jobs with adaptive executor and repartition
-	 * joins are not enabled, error out.
+	 * If we have repartition jobs for joins with adaptive executor and
+	 * repartition joins are not enabled, error out. Repartitioning the input
+	 * of window functions is enabled separately at planning time.
 	 */
-	int dependentJobCount = list_length(job->dependentJobList);
-	if (!EnableRepartitionJoins && dependentJobCount > 0)
+	if (!EnableRepartitionJoins && DependsOnRepartitionJoin(job))
 	{
 		ereport(ERROR, (errmsg("the query contains a join that requires repartitioning"),
 						errhint("Set citus.enable_repartition_joins to on to enable "
@@ -94,3 +97,24 @@ JobExecutorType(DistributedPlan *distributedPlan)
 
 	return MULTI_EXECUTOR_ADAPTIVE;
 }
+
+
+/*
+ * DependsOnRepartitionJoin returns true if the given job depends on a job other
+ * than a map merge job that repartitions the input of window functions.
+ */
+static bool
+DependsOnRepartitionJoin(Job *job)
+{
+	Job *dependentJob = NULL;
+	foreach_ptr(dependentJob, job->dependentJobList)
+	{
+		if (!CitusIsA(dependentJob, MapMergeJob) ||
+			((MapMergeJob *) dependentJob)->boundaryNodeJobType != WINDOW_MAP_MERGE_JOB)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
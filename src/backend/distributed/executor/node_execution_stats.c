@@ -0,0 +1,568 @@
+/*-------------------------------------------------------------------------
+ *
+ * node_execution_stats.c
+ *   Keeps track of the task execution and connection establishment times
+ *   of remote nodes across backends and executions.
+ *
+ *   The adaptive executor learns how many connections it should open to a
+ *   node from the statistics of the current execution. A short multi-shard
+ *   query finishes before the slow start algorithm had a chance to adjust,
+ *   so every execution records the averages it observed per node into the
+ *   shared memory, and the next execution starts from those averages.
+ *
+ *   Locking follows query_stats.c: the hash lock is only taken exclusively
+ *   to add the entry of a new node, and the statistics of an entry are
+ *   protected by its own spinlock, such that concurrent executions do not
+ *   serialize on recording their statistics.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "distributed/pg_version_constants.h"
+
+#include "miscadmin.h"
+
+#include "access/hash.h"
+#include "common/hashfn.h"
+#include "distributed/connection_management.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/node_execution_stats.h"
+#include "distributed/tuplestore.h"
+#include "distributed/worker_manager.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "storage/spin.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+
+#define NODE_EXECUTION_STATS_COLUMNS 6
+
+/*
+ * Weight of the statistics of a new execution in the moving averages. Recent
+ * executions dominate the averages after roughly 1 / factor executions.
+ */
+#define NODE_STATS_SMOOTHING_FACTOR 0.2
+
+
+/*
+ * The data structure used to store data in shared memory. The statistics
+ * themselves are kept in the hashmap, which is allocated separately.
+ */
+typedef struct NodeExecutionStatsSharedData
+{
+	int nodeStatsHashTrancheId;
+	char *nodeStatsHashTrancheName;
+
+	LWLock nodeStatsHashLock;
+} NodeExecutionStatsSharedData;
+
+
+typedef struct NodeExecutionStatsHashKey
+{
+	/* similar to the shared connection stats, we use hostname/port over nodeId */
+	char hostname[MAX_NODE_LENGTH];
+	int32 port;
+} NodeExecutionStatsHashKey;
+
+/* hash entry for per worker stats */
+typedef struct NodeExecutionStatsHashEntry
+{
+	NodeExecutionStatsHashKey key;
+
+	slock_t mutex;      /* protects the fields below */
+
+	NodeExecutionStats stats;
+
+	/* number of executions that contributed to each of the averages */
+	uint64 taskSampleCount;
+	uint64 connectionSampleCount;
+} NodeExecutionStatsHashEntry;
+
+
+/*
+ * DeferredNodeExecutionSample is the sample of a failed execution, which is
+ * kept in backend-local memory until it can be recorded outside of error
+ * handling.
+ */
+typedef struct DeferredNodeExecutionSample
+{
+	NodeExecutionStatsHashKey key;
+	NodeExecutionSample sample;
+
+	struct DeferredNodeExecutionSample *next;
+} DeferredNodeExecutionSample;
+
+
+/* GUC, whether the executor records and uses the shared node statistics */
+bool EnableNodeExecutionStats = false;
+
+
+/* the following two structs are used for accessing shared memory */
+static HTAB *NodeExecutionStatsHash = NULL;
+static NodeExecutionStatsSharedData *NodeExecutionStatsSharedState = NULL;
+
+/* samples of failed executions that are not recorded yet */
+static DeferredNodeExecutionSample *DeferredSampleList = NULL;
+
+
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+
+/* local function declarations */
+static void StoreAllNodeExecutionStats(Tuplestorestate *tupleStore,
+									   TupleDesc tupleDescriptor);
+static void InitNodeExecutionStatsHashKey(NodeExecutionStatsHashKey *key,
+										  const char *hostname, int port);
+static void UpdateNodeExecutionStats(NodeExecutionStatsHashEntry *statsEntry,
+									 NodeExecutionSample *sample);
+static double MovingAverage(double average, double value, uint64 previousCount);
+static uint32 NodeExecutionStatsHashHash(const void *key, Size keysize);
+static int NodeExecutionStatsHashCompare(const void *a, const void *b, Size keysize);
+
+
+PG_FUNCTION_INFO_V1(citus_node_execution_stats);
+
+
+/*
+ * citus_node_execution_stats returns the execution statistics that the
+ * backends on this node have collected for the remote nodes.
+ */
+Datum
+citus_node_execution_stats(PG_FUNCTION_ARGS)
+{
+	CheckCitusVersion(ERROR);
+
+	TupleDesc tupleDescriptor = NULL;
+	Tuplestorestate *tupleStore = SetupTuplestore(fcinfo, &tupleDescriptor);
+
+	StoreAllNodeExecutionStats(tupleStore, tupleDescriptor);
+
+	PG_RETURN_VOID();
+}
+
+
+/*
+ * StoreAllNodeExecutionStats inserts the statistics of all the remote nodes
+ * into the given tuplestore. The times are converted to milliseconds.
+ */
+static void
+StoreAllNodeExecutionStats(Tuplestorestate *tupleStore, TupleDesc tupleDescriptor)
+{
+	Datum values[NODE_EXECUTION_STATS_COLUMNS];
+	bool isNulls[NODE_EXECUTION_STATS_COLUMNS];
+
+	LWLockAcquire(&NodeExecutionStatsSharedState->nodeStatsHashLock, LW_SHARED);
+
+	HASH_SEQ_STATUS status;
+	NodeExecutionStatsHashEntry *statsEntry = NULL;
+
+	hash_seq_init(&status, NodeExecutionStatsHash);
+	while ((statsEntry = (NodeExecutionStatsHashEntry *) hash_seq_search(&status)) != 0)
+	{
+		/* copy the statistics, such that we do not allocate under the spinlock */
+		SpinLockAcquire(&statsEntry->mutex);
+		NodeExecutionStats stats = statsEntry->stats;
+		SpinLockRelease(&statsEntry->mutex);
+
+		/* get ready for the next tuple */
+		memset(values, 0, sizeof(values));
+		memset(isNulls, false, sizeof(isNulls));
+
+		values[0] = PointerGetDatum(cstring_to_text(statsEntry->key.hostname));
+		values[1] = Int32GetDatum(statsEntry->key.port);
+		values[2] = Int64GetDatum(stats.executionCount);
+		values[3] = Float8GetDatum(stats.avgTaskExecutionTime / 1000.0);
+		values[4] = Float8GetDatum(stats.avgConnectionEstablishmentTime / 1000.0);
+		values[5] = Float8GetDatum(stats.connectionFailureRate);
+
+		tuplestore_putvalues(tupleStore, tupleDescriptor, values, isNulls);
+	}
+
+	LWLockRelease(&NodeExecutionStatsSharedState->nodeStatsHashLock);
+}
+
+
+/*
+ * GetNodeExecutionStats copies the statistics of the given node into
+ * nodeExecutionStats and returns true. If no execution has recorded any
+ * statistics for the node yet, the function returns false.
+ */
+bool
+GetNodeExecutionStats(const char *hostname, int port,
+					  NodeExecutionStats *nodeExecutionStats)
+{
+	NodeExecutionStatsHashKey key;
+	bool found = false;
+
+	InitNodeExecutionStatsHashKey(&key, hostname, port);
+
+	LWLockAcquire(&NodeExecutionStatsSharedState->nodeStatsHashLock, LW_SHARED);
+
+	NodeExecutionStatsHashEntry *statsEntry =
+		(NodeExecutionStatsHashEntry *) hash_search(NodeExecutionStatsHash, &key,
+													HASH_FIND, &found);
+	if (found)
+	{
+		SpinLockAcquire(&statsEntry->mutex);
+		*nodeExecutionStats = statsEntry->stats;
+		SpinLockRelease(&statsEntry->mutex);
+	}
+
+	LWLockRelease(&NodeExecutionStatsSharedState->nodeStatsHashLock);
+
+	return found;
+}
+
+
+/*
+ * RecordNodeExecutionSample folds the statistics of a single execution on
+ * the given node into the shared moving averages of the node.
+ */
+void
+RecordNodeExecutionSample(const char *hostname, int port, NodeExecutionSample *sample)
+{
+	NodeExecutionStatsHashKey key;
+	bool found = false;
+
+	int connectionAttemptCount =
+		sample->establishedConnectionCount + sample->failedConnectionCount;
+	if (sample->executedTaskCount == 0 && connectionAttemptCount == 0)
+	{
+		/* nothing to learn from this execution */
+		return;
+	}
+
+	InitNodeExecutionStatsHashKey(&key, hostname, port);
+
+	LWLockAcquire(&NodeExecutionStatsSharedState->nodeStatsHashLock, LW_SHARED);
+
+	NodeExecutionStatsHashEntry *statsEntry =
+		(NodeExecutionStatsHashEntry *) hash_search(NodeExecutionStatsHash, &key,
+													HASH_FIND, NULL);
+	if (statsEntry == NULL)
+	{
+		/* need exclusive lock to make a new hashtable entry - promote */
+		LWLockRelease(&NodeExecutionStatsSharedState->nodeStatsHashLock);
+		LWLockAcquire(&NodeExecutionStatsSharedState->nodeStatsHashLock, LW_EXCLUSIVE);
+
+		/*
+		 * As the hash map is allocated in shared memory, it cannot grow beyond
+		 * MaxWorkerNodesTracked. In that case, we simply do not keep statistics
+		 * for the node.
+		 */
+		statsEntry =
+			(NodeExecutionStatsHashEntry *) hash_search(NodeExecutionStatsHash, &key,
+														HASH_ENTER_NULL, &found);
+		if (statsEntry == NULL)
+		{
+			LWLockRelease(&NodeExecutionStatsSharedState->nodeStatsHashLock);
+			return;
+		}
+
+		/* another backend might have added the entry in the meantime */
+		if (!found)
+		{
+			memset(&statsEntry->stats, 0, sizeof(NodeExecutionStats));
+			statsEntry->taskSampleCount = 0;
+			statsEntry->connectionSampleCount = 0;
+			SpinLockInit(&statsEntry->mutex);
+		}
+	}
+
+	SpinLockAcquire(&statsEntry->mutex);
+	UpdateNodeExecutionStats(statsEntry, sample);
+	SpinLockRelease(&statsEntry->mutex);
+
+	LWLockRelease(&NodeExecutionStatsSharedState->nodeStatsHashLock);
+}
+
+
+/*
+ * DeferNodeExecutionSample keeps the sample of a failed execution on the
+ * given node in backend-local memory, to be recorded by the next call to
+ * RecordDeferredNodeExecutionSamples. It is meant to be called while an
+ * error is being handled, so it neither takes locks nor throws errors, and
+ * drops the sample if it cannot keep it.
+ */
+void
+DeferNodeExecutionSample(const char *hostname, int port, NodeExecutionSample *sample)
+{
+	int connectionAttemptCount =
+		sample->establishedConnectionCount + sample->failedConnectionCount;
+	if ((sample->executedTaskCount == 0 && connectionAttemptCount == 0) ||
+		strlen(hostname) > MAX_NODE_LENGTH)
+	{
+		return;
+	}
+
+	DeferredNodeExecutionSample *deferredSample =
+		MemoryContextAllocExtended(TopMemoryContext, sizeof(DeferredNodeExecutionSample),
+								   MCXT_ALLOC_NO_OOM | MCXT_ALLOC_ZERO);
+	if (deferredSample == NULL)
+	{
+		return;
+	}
+
+	strlcpy(deferredSample->key.hostname, hostname, MAX_NODE_LENGTH);
+	deferredSample->key.port = port;
+	deferredSample->sample = *sample;
+
+	deferredSample->next = DeferredSampleList;
+	DeferredSampleList = deferredSample;
+}
+
+
+/*
+ * RecordDeferredNodeExecutionSamples records the samples of failed executions
+ * that DeferNodeExecutionSample kept, in the order they were kept.
+ */
+void
+RecordDeferredNodeExecutionSamples(void)
+{
+	DeferredNodeExecutionSample *reversedSampleList = NULL;
+
+	/* detach the list first, such that each sample is recorded at most once */
+	while (DeferredSampleList != NULL)
+	{
+		DeferredNodeExecutionSample *deferredSample = DeferredSampleList;
+
+		DeferredSampleList = deferredSample->next;
+		deferredSample->next = reversedSampleList;
+		reversedSampleList = deferredSample;
+	}
+
+	while (reversedSampleList != NULL)
+	{
+		DeferredNodeExecutionSample *deferredSample = reversedSampleList;
+		reversedSampleList = deferredSample->next;
+
+		RecordNodeExecutionSample(deferredSample->key.hostname,
+								  deferredSample->key.port,
+								  &deferredSample->sample);
+
+		pfree(deferredSample);
+	}
+}
+
+
+/*
+ * UpdateNodeExecutionStats folds the given sample into the moving averages of
+ * the given entry. The caller should hold the spinlock of the entry.
+ */
+static void
+UpdateNodeExecutionStats(NodeExecutionStatsHashEntry *statsEntry,
+						 NodeExecutionSample *sample)
+{
+	NodeExecutionStats *stats = &(statsEntry->stats);
+
+	int connectionAttemptCount =
+		sample->establishedConnectionCount + sample->failedConnectionCount;
+
+	if (sample->executedTaskCount > 0)
+	{
+		double avgTaskExecutionTime =
+			(double) sample->totalTaskExecutionTime / sample->executedTaskCount;
+
+		stats->avgTaskExecutionTime =
+			MovingAverage(stats->avgTaskExecutionTime, avgTaskExecutionTime,
+						  statsEntry->taskSampleCount);
+		statsEntry->taskSampleCount++;
+	}
+
+	if (sample->establishedConnectionCount > 0)
+	{
+		double avgConnectionEstablishmentTime =
+			(double) sample->totalConnectionEstablishmentTime /
+			sample->establishedConnectionCount;
+
+		stats->avgConnectionEstablishmentTime =
+			MovingAverage(stats->avgConnectionEstablishmentTime,
+						  avgConnectionEstablishmentTime,
+						  statsEntry->connectionSampleCount);
+		statsEntry->connectionSampleCount++;
+	}
+
+	if (connectionAttemptCount > 0)
+	{
+		double connectionFailureRate =
+			(double) sample->failedConnectionCount / connectionAttemptCount;
+
+		stats->connectionFailureRate =
+			MovingAverage(stats->connectionFailureRate, connectionFailureRate,
+						  stats->executionCount);
+	}
+
+	stats->executionCount++;
+}
+
+
+/*
+ * InitNodeExecutionStatsHashKey fills the hash key for the given node.
+ */
+static void
+InitNodeExecutionStatsHashKey(NodeExecutionStatsHashKey *key, const char *hostname,
+							  int port)
+{
+	memset(key, 0, sizeof(NodeExecutionStatsHashKey));
+
+	if (strlen(hostname) > MAX_NODE_LENGTH)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("hostname exceeds the maximum length of %d",
+							   MAX_NODE_LENGTH)));
+	}
+
+	strlcpy(key->hostname, hostname, MAX_NODE_LENGTH);
+	key->port = port;
+}
+
+
+/*
+ * MovingAverage returns the exponentially weighted moving average after
+ * adding the given value. The first value is taken as is, such that the
+ * average does not start from zero.
+ */
+static double
+MovingAverage(double average, double value, uint64 previousCount)
+{
+	if (previousCount == 0)
+	{
+		return value;
+	}
+
+	return average + NODE_STATS_SMOOTHING_FACTOR * (value - average);
+}
+
+
+/*
+ * InitializeNodeExecutionStats requests the necessary shared memory
+ * from Postgres and sets up the shared memory startup hook.
+ */
+void
+InitializeNodeExecutionStats(void)
+{
+/* on PG 15, we use shmem_request_hook_type */
+#if PG_VERSION_NUM < PG_VERSION_15
+
+	/* allocate shared memory */
+	if (!IsUnderPostmaster)
+	{
+		RequestAddinShmemSpace(NodeExecutionStatsShmemSize());
+	}
+#endif
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = NodeExecutionStatsShmemInit;
+}
+
+
+/*
+ * NodeExecutionStatsShmemSize returns the size that should be allocated
+ * on the shared memory for the node execution stats.
+ */
+size_t
+NodeExecutionStatsShmemSize(void)
+{
+	Size size = 0;
+
+	size = add_size(size, sizeof(NodeExecutionStatsSharedData));
+
+	Size hashSize = hash_estimate_size(MaxWorkerNodesTracked,
+									   sizeof(NodeExecutionStatsHashEntry));
+
+	size = add_size(size, hashSize);
+
+	return size;
+}
+
+
+/*
+ * NodeExecutionStatsShmemInit initializes the shared memory used for keeping
+ * track of the execution statistics of remote nodes across backends.
+ */
+void
+NodeExecutionStatsShmemInit(void)
+{
+	bool alreadyInitialized = false;
+	HASHCTL info;
+
+	/* create (hostname, port) -> [stats] */
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(NodeExecutionStatsHashKey);
+	info.entrysize = sizeof(NodeExecutionStatsHashEntry);
+	info.hash = NodeExecutionStatsHashHash;
+	info.match = NodeExecutionStatsHashCompare;
+	uint32 hashFlags = (HASH_ELEM | HASH_FUNCTION | HASH_COMPARE);
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	NodeExecutionStatsSharedState =
+		(NodeExecutionStatsSharedData *) ShmemInitStruct(
+			"Node Execution Stats Data",
+			sizeof(NodeExecutionStatsSharedData),
+			&alreadyInitialized);
+
+	if (!alreadyInitialized)
+	{
+		NodeExecutionStatsSharedState->nodeStatsHashTrancheId = LWLockNewTrancheId();
+		NodeExecutionStatsSharedState->nodeStatsHashTrancheName =
+			"Node Execution Stats Hash Tranche";
+		LWLockRegisterTranche(NodeExecutionStatsSharedState->nodeStatsHashTrancheId,
+							  NodeExecutionStatsSharedState->nodeStatsHashTrancheName);
+
+		LWLockInitialize(&NodeExecutionStatsSharedState->nodeStatsHashLock,
+						 NodeExecutionStatsSharedState->nodeStatsHashTrancheId);
+	}
+
+	/*  allocate hash table */
+	NodeExecutionStatsHash =
+		ShmemInitHash("Node Execution Stats Hash", MaxWorkerNodesTracked,
+					  MaxWorkerNodesTracked, &info, hashFlags);
+
+	LWLockRelease(AddinShmemInitLock);
+
+	Assert(NodeExecutionStatsHash != NULL);
+	Assert(NodeExecutionStatsSharedState->nodeStatsHashTrancheId != 0);
+
+	if (prev_shmem_startup_hook != NULL)
+	{
+		prev_shmem_startup_hook();
+	}
+}
+
+
+static uint32
+NodeExecutionStatsHashHash(const void *key, Size keysize)
+{
+	NodeExecutionStatsHashKey *entry = (NodeExecutionStatsHashKey *) key;
+
+	uint32 hash = string_hash(entry->hostname, NAMEDATALEN);
+	hash = hash_combine(hash, hash_uint32(entry->port));
+
+	return hash;
+}
+
+
+static int
+NodeExecutionStatsHashCompare(const void *a, const void *b, Size keysize)
+{
+	NodeExecutionStatsHashKey *ca = (NodeExecutionStatsHashKey *) a;
+	NodeExecutionStatsHashKey *cb = (NodeExecutionStatsHashKey *) b;
+
+	if (strncmp(ca->hostname, cb->hostname, MAX_NODE_LENGTH) != 0 ||
+		ca->port != cb->port)
+	{
+		return 1;
+	}
+	else
+	{
+		return 0;
+	}
+}
@@ -0,0 +1,1457 @@
+/*-------------------------------------------------------------------------
+ *
+ * parallel_combine.c
+ *
+ * When a multi-shard query groups by a column other than the distribution
+ * column, the workers return partial aggregates per shard and the combine
+ * query on the coordinator aggregates all of them in a single backend. With
+ * citus.max_parallel_workers_per_combine, we let the standard planner plan a
+ * parallel aggregate for the combine query: the partial aggregation runs in
+ * parallel workers, and the final aggregation combines the partial groups of
+ * the workers in the backend that runs the query.
+ *
+ * A Gather node of PostgreSQL cannot run the combine query, since it would
+ * need to serialize the Citus custom scan to the parallel workers, and since
+ * the parallel workers cannot run the distributed query. Instead, we replace
+ * the Gather node with a "Citus Parallel Combine" custom scan and the Citus
+ * scan below it with a "Citus Combine Bucket Scan":
+ *
+ *   Finalize HashAggregate
+ *     ->  Custom Scan (Citus Parallel Combine)
+ *           ->  Partial HashAggregate
+ *                 ->  Custom Scan (Citus Combine Bucket Scan)
+ *           ->  Custom Scan (Citus Adaptive)
+ *
+ * The parallel combine runs the distributed query first, and hash-partitions
+ * the results of the tasks on the group by columns into shared tuple stores,
+ * which we call buckets. The parallel workers and the backend then claim the
+ * buckets one by one, and run the partial aggregation on them. Since a group
+ * only appears in a single bucket, the partial groups of the participants
+ * are disjoint and the final aggregation only assembles them.
+ *
+ * The parallel combine collects all partial groups before returning the
+ * first one, so that we can leave parallel mode before the rest of the plan
+ * runs. That also keeps cursors on the query safe, which PostgreSQL handles
+ * by never running a Gather node for them.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "distributed/pg_version_constants.h"
+
+#include "miscadmin.h"
+#include "pgstat.h"
+
+#include "access/parallel.h"
+#include "access/xact.h"
+#include "commands/explain.h"
+#include "distributed/citus_custom_scan.h"
+#include "distributed/listutils.h"
+#include "distributed/multi_executor.h"
+#include "distributed/parallel_combine.h"
+#include "executor/executor.h"
+#include "executor/tqueue.h"
+#include "nodes/makefuncs.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/params.h"
+#include "parser/parsetree.h"
+#include "port/atomics.h"
+#include "storage/latch.h"
+#include "storage/sharedfileset.h"
+#include "storage/shm_mq.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/sharedtuplestore.h"
+#include "utils/snapmgr.h"
+
+
+/* keys of the entries in the table of contents of the parallel context */
+#define PARALLEL_KEY_COMBINE_STATE UINT64CONST(0xC17C000000000101)
+#define PARALLEL_KEY_COMBINE_BUCKETS UINT64CONST(0xC17C000000000102)
+#define PARALLEL_KEY_COMBINE_PLAN UINT64CONST(0xC17C000000000103)
+#define PARALLEL_KEY_COMBINE_PARAMS UINT64CONST(0xC17C000000000104)
+#define PARALLEL_KEY_COMBINE_TUPLE_QUEUES UINT64CONST(0xC17C000000000105)
+
+/* same size as the tuple queues of the parallel workers of a Gather */
+#define COMBINE_TUPLE_QUEUE_SIZE 65536
+
+/*
+ * We create a few buckets per participant, such that a participant that
+ * finishes early can help with the remaining buckets.
+ */
+#define COMBINE_BUCKETS_PER_PARTICIPANT 4
+
+
+/*
+ * ParallelCombineSharedState is the state of a parallel combine that is
+ * shared by the backend and the parallel workers. The buckets are stored in
+ * a separate chunk of the shared memory.
+ */
+typedef struct ParallelCombineSharedState
+{
+	/* index of the next bucket that is not claimed by a participant */
+	pg_atomic_uint32 nextBucketIndex;
+
+	uint32 bucketCount;
+
+	/* files of the buckets */
+	SharedFileSet fileSet;
+} ParallelCombineSharedState;
+
+
+/*
+ * CombineBucketScanState is the state of the scan at the bottom of the
+ * combine subplan, which returns the tuples of the buckets that the
+ * participant claims.
+ */
+typedef struct CombineBucketScanState
+{
+	CustomScanState customScanState;
+
+	/* buckets in shared memory, NULL when the backend combines by itself */
+	ParallelCombineSharedState *sharedState;
+	char *sharedBuckets;
+
+	/* reader of the bucket that the scan currently returns */
+	SharedTuplestoreAccessor *bucketReader;
+
+	/* scan to read from instead when the backend combines by itself */
+	PlanState *remoteScanState;
+} CombineBucketScanState;
+
+
+/*
+ * ParallelCombineScanState is the state of the scan that replaces the Gather
+ * node of the combine query.
+ */
+typedef struct ParallelCombineScanState
+{
+	CustomScanState customScanState;
+
+	/* number of parallel workers that we ask for */
+	int workerCount;
+
+	/* columns of the results of the remote scan that we hash into buckets */
+	int bucketColumnCount;
+	AttrNumber *bucketColumns;
+	FmgrInfo *hashFunctions;
+	Oid *hashCollations;
+
+	/* bucket scan in the combine subplan of the backend */
+	CombineBucketScanState *bucketScanState;
+
+	/* partial groups of all participants */
+	Tuplestorestate *tupleStore;
+	bool finishedCombine;
+} ParallelCombineScanState;
+
+
+/* GUC, maximum number of parallel workers used by the combine query */
+int MaxParallelWorkersPerCombine = 0;
+
+/* shared state of the parallel combine, set in parallel workers */
+static ParallelCombineSharedState *WorkerCombineSharedState = NULL;
+static char *WorkerCombineSharedBuckets = NULL;
+
+
+/*
+ * ParallelCombinePlanNodes contains the nodes of a combine plan that are
+ * relevant for running the combine in parallel.
+ */
+typedef struct ParallelCombinePlanNodes
+{
+	Plan **gatherLink;
+	Plan **remoteScanLink;
+	int gatherCount;
+	int parallelAwareCount;
+	bool hasUnsupportedNode;
+} ParallelCombinePlanNodes;
+
+
+static void FindParallelCombinePlanNodes(Plan **planLink, CustomScan *remoteScan,
+										 ParallelCombinePlanNodes *planNodes);
+static bool PlanTreeContains(Plan *plan, Plan *targetPlan);
+static AttrNumber RemoteScanOutputColumn(Plan *plan, AttrNumber columnNumber,
+										 CustomScan *remoteScan);
+static CustomScan * CreateCombineBucketScan(CustomScan *remoteScan);
+static Node * ReplaceVarnoMutator(Node *node, int *varnos);
+static Node * ReplaceIndexVarMutator(Node *node, List *indexTargetList);
+static Node * ParallelCombineCreateScan(CustomScan *scan);
+static void ParallelCombineBeginScan(CustomScanState *node, EState *estate,
+									 int eflags);
+static TupleTableSlot * ParallelCombineExecScan(CustomScanState *node);
+static void ParallelCombineEndScan(CustomScanState *node);
+static void ParallelCombineReScan(CustomScanState *node);
+static void ParallelCombineExplainScan(CustomScanState *node, List *ancestors,
+									   struct ExplainState *es);
+static bool FindCombineBucketScanState(PlanState *planState,
+									   CombineBucketScanState **bucketScanState);
+static void ExecuteParallelCombine(ParallelCombineScanState *combineState);
+static void ExecuteCombineLocally(ParallelCombineScanState *combineState,
+								  PlanState *remoteScanState);
+static PlannedStmt * CreateCombineWorkerPlannedStmt(Plan *combinePlan,
+													EState *executorState);
+static void PartitionRemoteScanResults(ParallelCombineScanState *combineState,
+									   PlanState *remoteScanState,
+									   SharedTuplestoreAccessor **bucketWriters,
+									   int bucketCount);
+static uint32 BucketHashValue(ParallelCombineScanState *combineState,
+							  TupleTableSlot *slot);
+static void GatherPartialGroups(ParallelCombineScanState *combineState,
+								TupleQueueReader **tupleQueueReaders,
+								int readerCount);
+static SharedTuplestore * BucketTupleStore(char *sharedBuckets, int bucketIndex);
+static Node * CombineBucketCreateScan(CustomScan *scan);
+static void CombineBucketBeginScan(CustomScanState *node, EState *estate, int eflags);
+static TupleTableSlot * CombineBucketExecScan(CustomScanState *node);
+static void CombineBucketEndScan(CustomScanState *node);
+static void CombineBucketReScan(CustomScanState *node);
+static void CloseBucketReader(CombineBucketScanState *bucketScanState);
+
+
+CustomScanMethods ParallelCombineCustomScanMethods = {
+	"Citus Parallel Combine",
+	ParallelCombineCreateScan
+};
+
+CustomScanMethods CombineBucketScanCustomScanMethods = {
+	"Citus Combine Bucket Scan",
+	CombineBucketCreateScan
+};
+
+static CustomExecMethods ParallelCombineCustomExecMethods = {
+	.CustomName = "ParallelCombineScan",
+	.BeginCustomScan = ParallelCombineBeginScan,
+	.ExecCustomScan = ParallelCombineExecScan,
+	.EndCustomScan = ParallelCombineEndScan,
+	.ReScanCustomScan = ParallelCombineReScan,
+	.ExplainCustomScan = ParallelCombineExplainScan
+};
+
+static CustomExecMethods CombineBucketScanCustomExecMethods = {
+	.CustomName = "CombineBucketScan",
+	.BeginCustomScan = CombineBucketBeginScan,
+	.ExecCustomScan = CombineBucketExecScan,
+	.EndCustomScan = CombineBucketEndScan,
+	.ReScanCustomScan = CombineBucketReScan
+};
+
+
+/*
+ * ShouldPlanParallelCombine returns true if we should let the standard
+ * planner consider a parallel plan for the given combine query.
+ */
+bool
+ShouldPlanParallelCombine(Query *combineQuery)
+{
+	if (MaxParallelWorkersPerCombine == 0)
+	{
+		return false;
+	}
+
+	if (combineQuery->commandType != CMD_SELECT || combineQuery->rowMarks != NIL ||
+		combineQuery->hasModifyingCTE)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * FinalizeParallelCombinePlan converts a combine plan that the standard
+ * planner planned with parallelism into a plan that we can execute, by
+ * replacing the Gather node with a parallel combine scan and the remote scan
+ * below it with a bucket scan.
+ *
+ * We only support a single Gather node on top of the partial aggregation of
+ * the remote scan. The function returns false for other parallel plans, in
+ * which case the caller should plan the combine query without parallelism.
+ */
+bool
+FinalizeParallelCombinePlan(PlannedStmt *plannedStmt, CustomScan *remoteScan)
+{
+	/* the parallel combine enters parallel mode by itself */
+	plannedStmt->parallelModeNeeded = false;
+
+	if (!remoteScan->scan.plan.parallel_aware)
+	{
+		/* the planner did not use the partial path of the remote scan */
+		return true;
+	}
+
+	if (plannedStmt->subplans != NIL ||
+		remoteScan->methods != &AdaptiveExecutorCustomScanMethods)
+	{
+		return false;
+	}
+
+	ParallelCombinePlanNodes planNodes;
+	memset(&planNodes, 0, sizeof(planNodes));
+
+	FindParallelCombinePlanNodes(&plannedStmt->planTree, remoteScan, &planNodes);
+
+	if (planNodes.gatherCount != 1 || planNodes.parallelAwareCount != 1 ||
+		planNodes.hasUnsupportedNode || planNodes.remoteScanLink == NULL)
+	{
+		return false;
+	}
+
+	Gather *gather = (Gather *) *planNodes.gatherLink;
+	if (gather->single_copy || gather->num_workers <= 0 || gather->initParam != NULL ||
+		gather->plan.qual != NIL || planNodes.gatherLink == &plannedStmt->planTree)
+	{
+		return false;
+	}
+
+	Plan *combinePlan = gather->plan.lefttree;
+	if (!IsA(combinePlan, Agg) ||
+		((Agg *) combinePlan)->aggsplit != AGGSPLIT_INITIAL_SERIAL ||
+		!PlanTreeContains(combinePlan, (Plan *) remoteScan))
+	{
+		return false;
+	}
+
+	/*
+	 * Find the group by columns of the partial aggregation in the results of
+	 * the remote scan. Hashing on any subset of them keeps the groups within
+	 * a bucket, and without any we spread the results over the buckets.
+	 */
+	Agg *partialAgg = (Agg *) combinePlan;
+	List *bucketColumnList = NIL;
+	List *hashFunctionList = NIL;
+	List *hashCollationList = NIL;
+
+	for (int groupIndex = 0; groupIndex < partialAgg->numCols; groupIndex++)
+	{
+		AttrNumber columnNumber =
+			RemoteScanOutputColumn(partialAgg->plan.lefttree,
+								   partialAgg->grpColIdx[groupIndex], remoteScan);
+		if (columnNumber == InvalidAttrNumber)
+		{
+			continue;
+		}
+
+		RegProcedure hashFunctionId = InvalidOid;
+		if (!get_op_hash_functions(partialAgg->grpOperators[groupIndex],
+								   &hashFunctionId, NULL))
+		{
+			continue;
+		}
+
+		bucketColumnList = lappend_int(bucketColumnList, columnNumber);
+		hashFunctionList = lappend_oid(hashFunctionList, hashFunctionId);
+		hashCollationList = lappend_oid(hashCollationList,
+										partialAgg->grpCollations[groupIndex]);
+	}
+
+	CustomScan *combineScan = makeNode(CustomScan);
+	combineScan->scan.plan.startup_cost = gather->plan.startup_cost;
+	combineScan->scan.plan.total_cost = gather->plan.total_cost;
+	combineScan->scan.plan.plan_rows = gather->plan.plan_rows;
+	combineScan->scan.plan.plan_width = gather->plan.plan_width;
+	combineScan->scan.plan.plan_node_id = gather->plan.plan_node_id;
+	combineScan->scan.plan.extParam = gather->plan.extParam;
+	combineScan->scan.plan.allParam = gather->plan.allParam;
+	combineScan->scan.plan.lefttree = combinePlan;
+	combineScan->scan.scanrelid = 0;
+
+	/*
+	 * The scan tuples of the parallel combine are the partial groups, so the
+	 * references of the Gather node to its subplan become references to the
+	 * scan tuple. We keep the subplan columns in the custom scan target list
+	 * to describe the scan tuple, and for EXPLAIN VERBOSE.
+	 */
+	int varnos[2] = { OUTER_VAR, INDEX_VAR };
+	combineScan->scan.plan.targetlist =
+		(List *) ReplaceVarnoMutator((Node *) gather->plan.targetlist, varnos);
+
+	TargetEntry *targetEntry = NULL;
+	foreach_ptr(targetEntry, combinePlan->targetlist)
+	{
+		Var *column = makeVar(OUTER_VAR, targetEntry->resno,
+							  exprType((Node *) targetEntry->expr),
+							  exprTypmod((Node *) targetEntry->expr),
+							  exprCollation((Node *) targetEntry->expr), 0);
+
+		combineScan->custom_scan_tlist =
+			lappend(combineScan->custom_scan_tlist,
+					makeTargetEntry((Expr *) column, targetEntry->resno,
+									targetEntry->resname, false));
+	}
+
+	combineScan->custom_plans = list_make1(remoteScan);
+	combineScan->custom_private = list_make4(makeInteger(gather->num_workers),
+											 bucketColumnList, hashFunctionList,
+											 hashCollationList);
+	combineScan->methods = &ParallelCombineCustomScanMethods;
+
+	*planNodes.remoteScanLink = (Plan *) CreateCombineBucketScan(remoteScan);
+	*planNodes.gatherLink = (Plan *) combineScan;
+
+	/* the remote scan now runs only in the backend */
+	remoteScan->scan.plan.parallel_aware = false;
+	remoteScan->scan.plan.parallel_safe = false;
+
+	return true;
+}
+
+
+/*
+ * FindParallelCombinePlanNodes walks the plan tree and records the Gather
+ * node and the remote scan along with the pointers that link to them.
+ */
+static void
+FindParallelCombinePlanNodes(Plan **planLink, CustomScan *remoteScan,
+							 ParallelCombinePlanNodes *planNodes)
+{
+	Plan *plan = *planLink;
+	if (plan == NULL)
+	{
+		return;
+	}
+
+	if (plan == (Plan *) remoteScan)
+	{
+		planNodes->remoteScanLink = planLink;
+	}
+	else if (IsA(plan, Gather))
+	{
+		planNodes->gatherLink = planLink;
+		planNodes->gatherCount++;
+	}
+	else if (IsA(plan, GatherMerge) || IsA(plan, Append) || IsA(plan, MergeAppend) ||
+			 IsA(plan, BitmapAnd) || IsA(plan, BitmapOr) ||
+			 IsA(plan, SubqueryScan) || IsA(plan, CustomScan) ||
+			 IsA(plan, ModifyTable))
+	{
+		/* the children of these nodes are not in lefttree and righttree */
+		planNodes->hasUnsupportedNode = true;
+	}
+
+	if (plan->parallel_aware)
+	{
+		planNodes->parallelAwareCount++;
+	}
+
+	FindParallelCombinePlanNodes(&plan->lefttree, remoteScan, planNodes);
+	FindParallelCombinePlanNodes(&plan->righttree, remoteScan, planNodes);
+}
+
+
+/*
+ * PlanTreeContains returns whether targetPlan is in the plan tree.
+ */
+static bool
+PlanTreeContains(Plan *plan, Plan *targetPlan)
+{
+	if (plan == NULL)
+	{
+		return false;
+	}
+
+	if (plan == targetPlan)
+	{
+		return true;
+	}
+
+	return PlanTreeContains(plan->lefttree, targetPlan) ||
+		   PlanTreeContains(plan->righttree, targetPlan);
+}
+
+
+/*
+ * RemoteScanOutputColumn follows the given output column of the plan down
+ * to the remote scan through nodes that pass the column on unchanged, and
+ * returns the column number in the output of the remote scan. The function
+ * returns InvalidAttrNumber if the column is computed above the remote scan.
+ */
+static AttrNumber
+RemoteScanOutputColumn(Plan *plan, AttrNumber columnNumber, CustomScan *remoteScan)
+{
+	while (plan != (Plan *) remoteScan)
+	{
+		if (plan == NULL || plan->lefttree == NULL || plan->righttree != NULL)
+		{
+			return InvalidAttrNumber;
+		}
+
+		TargetEntry *targetEntry = get_tle_by_resno(plan->targetlist, columnNumber);
+		if (targetEntry == NULL || !IsA(targetEntry->expr, Var))
+		{
+			return InvalidAttrNumber;
+		}
+
+		Var *column = (Var *) targetEntry->expr;
+		if (column->varno != OUTER_VAR)
+		{
+			return InvalidAttrNumber;
+		}
+
+		columnNumber = column->varattno;
+		plan = plan->lefttree;
+	}
+
+	return columnNumber;
+}
+
+
+/*
+ * CreateCombineBucketScan creates the scan that replaces the remote scan in
+ * the combine subplan. The scan returns the results of the remote scan as
+ * they are, so its scan tuple has the output columns of the remote scan.
+ */
+static CustomScan *
+CreateCombineBucketScan(CustomScan *remoteScan)
+{
+	CustomScan *bucketScan = makeNode(CustomScan);
+
+	/* start from the costs and identity of the remote scan */
+	bucketScan->scan.plan = remoteScan->scan.plan;
+	bucketScan->scan.plan.targetlist = NIL;
+	bucketScan->scan.plan.qual = NIL;
+	bucketScan->scan.plan.parallel_aware = false;
+	bucketScan->scan.plan.parallel_safe = true;
+	bucketScan->scan.scanrelid = 0;
+
+	TargetEntry *targetEntry = NULL;
+	foreach_ptr(targetEntry, remoteScan->scan.plan.targetlist)
+	{
+		Expr *expression = targetEntry->expr;
+		Var *column = makeVar(INDEX_VAR, targetEntry->resno,
+							  exprType((Node *) expression),
+							  exprTypmod((Node *) expression),
+							  exprCollation((Node *) expression), 0);
+
+		bucketScan->scan.plan.targetlist =
+			lappend(bucketScan->scan.plan.targetlist,
+					makeTargetEntry((Expr *) column, targetEntry->resno,
+									targetEntry->resname, targetEntry->resjunk));
+
+		/*
+		 * The expressions of the remote scan refer to its own scan tuple, so
+		 * we describe them in terms of the columns of the remote_scan range
+		 * table entry instead.
+		 */
+		Expr *scanExpression =
+			(Expr *) ReplaceIndexVarMutator((Node *) expression,
+											remoteScan->custom_scan_tlist);
+
+		bucketScan->custom_scan_tlist =
+			lappend(bucketScan->custom_scan_tlist,
+					makeTargetEntry(scanExpression, targetEntry->resno,
+									targetEntry->resname, false));
+	}
+
+	bucketScan->custom_relids = remoteScan->custom_relids;
+	bucketScan->methods = &CombineBucketScanCustomScanMethods;
+
+	return bucketScan;
+}
+
+
+/*
+ * ReplaceVarnoMutator returns a copy of the expression in which the Vars
+ * with varno varnos[0] have varno varnos[1].
+ */
+static Node *
+ReplaceVarnoMutator(Node *node, int *varnos)
+{
+	if (node == NULL)
+	{
+		return NULL;
+	}
+
+	if (IsA(node, Var) && ((Var *) node)->varno == varnos[0])
+	{
+		Var *column = (Var *) copyObject(node);
+		column->varno = varnos[1];
+
+		return (Node *) column;
+	}
+
+	return expression_tree_mutator(node, ReplaceVarnoMutator, varnos);
+}
+
+
+/*
+ * ReplaceIndexVarMutator returns a copy of the expression in which the
+ * INDEX_VAR Vars are replaced by the expressions they refer to in the given
+ * target list.
+ */
+static Node *
+ReplaceIndexVarMutator(Node *node, List *indexTargetList)
+{
+	if (node == NULL)
+	{
+		return NULL;
+	}
+
+	if (IsA(node, Var) && ((Var *) node)->varno == INDEX_VAR)
+	{
+		Var *column = (Var *) node;
+		TargetEntry *targetEntry = get_tle_by_resno(indexTargetList, column->varattno);
+		if (targetEntry == NULL)
+		{
+			elog(ERROR, "could not find the scan column %d of the remote scan",
+				 column->varattno);
+		}
+
+		return (Node *) copyObject(targetEntry->expr);
+	}
+
+	return expression_tree_mutator(node, ReplaceIndexVarMutator, indexTargetList);
+}
+
+
+/*
+ * ParallelCombineCreateScan creates the scan state of a parallel combine.
+ */
+static Node *
+ParallelCombineCreateScan(CustomScan *scan)
+{
+	ParallelCombineScanState *combineState = palloc0(sizeof(ParallelCombineScanState));
+
+	combineState->customScanState.ss.ps.type = T_CustomScanState;
+	combineState->customScanState.methods = &ParallelCombineCustomExecMethods;
+
+	return (Node *) combineState;
+}
+
+
+/*
+ * ParallelCombineBeginScan initializes the remote scan and the combine
+ * subplan of a parallel combine.
+ */
+static void
+ParallelCombineBeginScan(CustomScanState *node, EState *estate, int eflags)
+{
+	ParallelCombineScanState *combineState = (ParallelCombineScanState *) node;
+	CustomScan *combineScan = (CustomScan *) node->ss.ps.plan;
+
+	/* we return minimal tuples from a tuple store, like the Citus scans do */
+	ExecInitResultSlot(&node->ss.ps, &TTSOpsMinimalTuple);
+	ExecInitScanTupleSlot(estate, &node->ss, node->ss.ps.scandesc, &TTSOpsMinimalTuple);
+	ExecAssignScanProjectionInfoWithVarno(&node->ss, INDEX_VAR);
+
+	/*
+	 * We read the results of the remote scan while the partial groups of the
+	 * parallel workers are already arriving, so the remote scan should not
+	 * stream its results. The rewind flag disables streaming.
+	 */
+	Plan *remoteScan = (Plan *) linitial(combineScan->custom_plans);
+	PlanState *remoteScanState = ExecInitNode(remoteScan, estate,
+											  eflags | EXEC_FLAG_REWIND);
+	node->custom_ps = list_make1(remoteScanState);
+
+	outerPlanState(node) = ExecInitNode(outerPlan(combineScan), estate, eflags);
+
+	FindCombineBucketScanState(outerPlanState(node), &combineState->bucketScanState);
+	Assert(combineState->bucketScanState != NULL);
+
+	List *bucketColumnList = lsecond(combineScan->custom_private);
+	List *hashFunctionList = lthird(combineScan->custom_private);
+	List *hashCollationList = lfourth(combineScan->custom_private);
+	int bucketColumnCount = list_length(bucketColumnList);
+
+	combineState->workerCount = intVal(linitial(combineScan->custom_private));
+	combineState->bucketColumnCount = bucketColumnCount;
+	combineState->bucketColumns = palloc0(bucketColumnCount * sizeof(AttrNumber));
+	combineState->hashFunctions = palloc0(bucketColumnCount * sizeof(FmgrInfo));
+	combineState->hashCollations = palloc0(bucketColumnCount * sizeof(Oid));
+
+	for (int columnIndex = 0; columnIndex < bucketColumnCount; columnIndex++)
+	{
+		combineState->bucketColumns[columnIndex] =
+			list_nth_int(bucketColumnList, columnIndex);
+		fmgr_info(list_nth_oid(hashFunctionList, columnIndex),
+				  &combineState->hashFunctions[columnIndex]);
+		combineState->hashCollations[columnIndex] =
+			list_nth_oid(hashCollationList, columnIndex);
+	}
+}
+
+
+/*
+ * FindCombineBucketScanState finds the bucket scan in the given plan state
+ * tree.
+ */
+static bool
+FindCombineBucketScanState(PlanState *planState,
+						   CombineBucketScanState **bucketScanState)
+{
+	if (planState == NULL)
+	{
+		return false;
+	}
+
+	if (IsA(planState, CustomScanState) &&
+		((CustomScanState *) planState)->methods == &CombineBucketScanCustomExecMethods)
+	{
+		*bucketScanState = (CombineBucketScanState *) planState;
+		return true;
+	}
+
+	return planstate_tree_walker(planState, FindCombineBucketScanState,
+								 bucketScanState);
+}
+
+
+/*
+ * ParallelCombineExecScan runs the combine on the first call and returns the
+ * partial groups one by one.
+ */
+static TupleTableSlot *
+ParallelCombineExecScan(CustomScanState *node)
+{
+	ParallelCombineScanState *combineState = (ParallelCombineScanState *) node;
+
+	if (!combineState->finishedCombine)
+	{
+		EState *executorState = node->ss.ps.state;
+		MemoryContext oldContext = MemoryContextSwitchTo(executorState->es_query_cxt);
+
+		ExecuteParallelCombine(combineState);
+
+		MemoryContextSwitchTo(oldContext);
+
+		combineState->finishedCombine = true;
+	}
+
+	TupleTableSlot *scanSlot = node->ss.ss_ScanTupleSlot;
+	ProjectionInfo *projectionInfo = node->ss.ps.ps_ProjInfo;
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+
+	ResetExprContext(econtext);
+
+	bool forwardScan = true;
+	bool copyTuple = false;
+	if (!tuplestore_gettupleslot(combineState->tupleStore, forwardScan, copyTuple,
+								 scanSlot))
+	{
+		return NULL;
+	}
+
+	if (projectionInfo == NULL)
+	{
+		return scanSlot;
+	}
+
+	econtext->ecxt_scantuple = scanSlot;
+
+	return ExecProject(projectionInfo);
+}
+
+
+/*
+ * ExecuteParallelCombine runs the distributed query, partitions its results
+ * into buckets and runs the combine subplan on the buckets in the parallel
+ * workers and in the backend. The partial groups of all participants end up
+ * in the tuple store of the parallel combine.
+ */
+static void
+ExecuteParallelCombine(ParallelCombineScanState *combineState)
+{
+	CustomScanState *customScanState = &combineState->customScanState;
+	EState *executorState = customScanState->ss.ps.state;
+	CitusScanState *remoteScanState =
+		(CitusScanState *) linitial(customScanState->custom_ps);
+	CombineBucketScanState *bucketScanState = combineState->bucketScanState;
+
+	combineState->tupleStore = tuplestore_begin_heap(false, false, work_mem);
+
+	/*
+	 * Run the distributed query before we enter parallel mode, in the same
+	 * way CitusExecScan does on the first call.
+	 */
+	if (!remoteScanState->finishedRemoteScan)
+	{
+		AdaptiveExecutor(remoteScanState);
+
+		remoteScanState->finishedRemoteScan = true;
+	}
+
+	if (IsInParallelMode())
+	{
+		/* we cannot start parallel workers from a parallel worker */
+		ExecuteCombineLocally(combineState, (PlanState *) remoteScanState);
+		return;
+	}
+
+	int workerCount = combineState->workerCount;
+	int bucketCount = (workerCount + 1) * COMBINE_BUCKETS_PER_PARTICIPANT;
+
+	EnterParallelMode();
+
+	ParallelContext *parallelContext =
+		CreateParallelContext("citus", "ParallelCombineWorkerMain", workerCount);
+
+	CustomScan *combineScan = (CustomScan *) customScanState->ss.ps.plan;
+	PlannedStmt *workerPlannedStmt =
+		CreateCombineWorkerPlannedStmt(outerPlan(combineScan), executorState);
+	char *workerPlanString = nodeToString(workerPlannedStmt);
+	Size workerPlanSize = strlen(workerPlanString) + 1;
+
+	ParamListInfo paramListInfo = executorState->es_param_list_info;
+	Size paramSpaceSize = EstimateParamListSpace(paramListInfo);
+
+	Size bucketSize = MAXALIGN(sts_estimate(1));
+	Size bucketsSize = mul_size(bucketSize, bucketCount);
+	Size tupleQueuesSize = mul_size(COMBINE_TUPLE_QUEUE_SIZE, workerCount);
+
+	shm_toc_estimate_chunk(&parallelContext->estimator,
+						   sizeof(ParallelCombineSharedState));
+	shm_toc_estimate_chunk(&parallelContext->estimator, bucketsSize);
+	shm_toc_estimate_chunk(&parallelContext->estimator, workerPlanSize);
+	shm_toc_estimate_chunk(&parallelContext->estimator, paramSpaceSize);
+	shm_toc_estimate_chunk(&parallelContext->estimator, tupleQueuesSize);
+	shm_toc_estimate_keys(&parallelContext->estimator, 5);
+
+	InitializeParallelDSM(parallelContext);
+
+	if (parallelContext->seg == NULL)
+	{
+		/* we could not create a shared memory segment, combine by ourselves */
+		DestroyParallelContext(parallelContext);
+		ExitParallelMode();
+
+		ExecuteCombineLocally(combineState, (PlanState *) remoteScanState);
+		return;
+	}
+
+	shm_toc *toc = parallelContext->toc;
+
+	ParallelCombineSharedState *sharedState =
+		shm_toc_allocate(toc, sizeof(ParallelCombineSharedState));
+	pg_atomic_init_u32(&sharedState->nextBucketIndex, 0);
+	sharedState->bucketCount = bucketCount;
+	SharedFileSetInit(&sharedState->fileSet, parallelContext->seg);
+	shm_toc_insert(toc, PARALLEL_KEY_COMBINE_STATE, sharedState);
+
+	char *sharedBuckets = shm_toc_allocate(toc, bucketsSize);
+	SharedTuplestoreAccessor **bucketWriters =
+		palloc0(bucketCount * sizeof(SharedTuplestoreAccessor *));
+
+	for (int bucketIndex = 0; bucketIndex < bucketCount; bucketIndex++)
+	{
+		char bucketName[NAMEDATALEN];
+		snprintf(bucketName, NAMEDATALEN, "citus_combine_bucket_%d", bucketIndex);
+
+		int participantCount = 1;
+		int participantNumber = 0;
+		size_t metaDataSize = 0;
+		bucketWriters[bucketIndex] =
+			sts_initialize(BucketTupleStore(sharedBuckets, bucketIndex),
+						   participantCount, participantNumber, metaDataSize,
+						   SHARED_TUPLESTORE_SINGLE_PASS, &sharedState->fileSet,
+						   bucketName);
+	}
+
+	shm_toc_insert(toc, PARALLEL_KEY_COMBINE_BUCKETS, sharedBuckets);
+
+	char *sharedPlanString = shm_toc_allocate(toc, workerPlanSize);
+	memcpy(sharedPlanString, workerPlanString, workerPlanSize);
+	shm_toc_insert(toc, PARALLEL_KEY_COMBINE_PLAN, sharedPlanString);
+
+	char *paramSpace = shm_toc_allocate(toc, paramSpaceSize);
+	shm_toc_insert(toc, PARALLEL_KEY_COMBINE_PARAMS, paramSpace);
+	SerializeParamList(paramListInfo, &paramSpace);
+
+	PartitionRemoteScanResults(combineState, (PlanState *) remoteScanState,
+							   bucketWriters, bucketCount);
+
+	char *tupleQueueSpace = shm_toc_allocate(toc, tupleQueuesSize);
+	shm_mq_handle **tupleQueueHandles = palloc0(workerCount * sizeof(shm_mq_handle *));
+
+	for (int workerIndex = 0; workerIndex < workerCount; workerIndex++)
+	{
+		shm_mq *tupleQueue =
+			shm_mq_create(tupleQueueSpace + workerIndex * COMBINE_TUPLE_QUEUE_SIZE,
+						  COMBINE_TUPLE_QUEUE_SIZE);
+
+		shm_mq_set_receiver(tupleQueue, MyProc);
+		tupleQueueHandles[workerIndex] =
+			shm_mq_attach(tupleQueue, parallelContext->seg, NULL);
+	}
+
+	shm_toc_insert(toc, PARALLEL_KEY_COMBINE_TUPLE_QUEUES, tupleQueueSpace);
+
+	LaunchParallelWorkers(parallelContext);
+
+	/* the backend claims buckets along with the workers */
+	bucketScanState->sharedState = sharedState;
+	bucketScanState->sharedBuckets = sharedBuckets;
+
+	/* the workers that could be registered are always the first ones */
+	int launchedWorkerCount = parallelContext->nworkers_launched;
+	TupleQueueReader **tupleQueueReaders =
+		palloc0(Max(launchedWorkerCount, 1) * sizeof(TupleQueueReader *));
+
+	for (int workerIndex = 0; workerIndex < launchedWorkerCount; workerIndex++)
+	{
+		shm_mq_handle *tupleQueueHandle = tupleQueueHandles[workerIndex];
+
+		/* notice it when the worker fails to start */
+		shm_mq_set_handle(tupleQueueHandle,
+						  parallelContext->worker[workerIndex].bgwhandle);
+
+		tupleQueueReaders[workerIndex] = CreateTupleQueueReader(tupleQueueHandle);
+	}
+
+	ereport(DEBUG2, (errmsg("combining %d buckets of partial groups with %d "
+							"parallel workers", bucketCount, launchedWorkerCount)));
+
+	GatherPartialGroups(combineState, tupleQueueReaders, launchedWorkerCount);
+
+	/* the buckets go away along with the shared memory */
+	CloseBucketReader(bucketScanState);
+	bucketScanState->sharedState = NULL;
+	bucketScanState->sharedBuckets = NULL;
+
+	for (int workerIndex = 0; workerIndex < workerCount; workerIndex++)
+	{
+		shm_mq_detach(tupleQueueHandles[workerIndex]);
+	}
+
+	/* rethrows the errors of the workers, if any */
+	WaitForParallelWorkersToFinish(parallelContext);
+
+	DestroyParallelContext(parallelContext);
+	ExitParallelMode();
+}
+
+
+/*
+ * ExecuteCombineLocally runs the combine subplan on all the results of the
+ * remote scan in the backend.
+ */
+static void
+ExecuteCombineLocally(ParallelCombineScanState *combineState,
+					  PlanState *remoteScanState)
+{
+	CombineBucketScanState *bucketScanState = combineState->bucketScanState;
+	PlanState *combinePlanState = outerPlanState(combineState);
+
+	bucketScanState->remoteScanState = remoteScanState;
+
+	while (true)
+	{
+		TupleTableSlot *slot = ExecProcNode(combinePlanState);
+		if (TupIsNull(slot))
+		{
+			break;
+		}
+
+		tuplestore_puttupleslot(combineState->tupleStore, slot);
+	}
+
+	bucketScanState->remoteScanState = NULL;
+}
+
+
+/*
+ * CreateCombineWorkerPlannedStmt creates the PlannedStmt that the parallel
+ * workers run for the given combine subplan, similar to ExecSerializePlan.
+ */
+static PlannedStmt *
+CreateCombineWorkerPlannedStmt(Plan *combinePlan, EState *executorState)
+{
+	/*
+	 * We send all the columns of the partial groups, so that the tuples of
+	 * the workers have the same shape as the ones of the backend.
+	 */
+	Plan *workerPlan = copyObject(combinePlan);
+
+	TargetEntry *targetEntry = NULL;
+	foreach_ptr(targetEntry, workerPlan->targetlist)
+	{
+		targetEntry->resjunk = false;
+	}
+
+	PlannedStmt *plannedStmt = makeNode(PlannedStmt);
+	plannedStmt->commandType = CMD_SELECT;
+	plannedStmt->queryId = executorState->es_plannedstmt->queryId;
+	plannedStmt->hasReturning = false;
+	plannedStmt->hasModifyingCTE = false;
+	plannedStmt->canSetTag = true;
+	plannedStmt->transientPlan = false;
+	plannedStmt->dependsOnRole = false;
+	plannedStmt->parallelModeNeeded = false;
+	plannedStmt->planTree = workerPlan;
+	plannedStmt->rtable = executorState->es_range_table;
+	plannedStmt->resultRelations = NIL;
+	plannedStmt->subplans = NIL;
+	plannedStmt->rewindPlanIDs = NULL;
+	plannedStmt->rowMarks = NIL;
+	plannedStmt->relationOids = NIL;
+	plannedStmt->invalItems = NIL;
+	plannedStmt->paramExecTypes = executorState->es_plannedstmt->paramExecTypes;
+	plannedStmt->utilityStmt = NULL;
+	plannedStmt->stmt_location = -1;
+	plannedStmt->stmt_len = -1;
+
+	return plannedStmt;
+}
+
+
+/*
+ * PartitionRemoteScanResults writes the results of the remote scan to the
+ * buckets, based on the hash of the bucket columns.
+ */
+static void
+PartitionRemoteScanResults(ParallelCombineScanState *combineState,
+						   PlanState *remoteScanState,
+						   SharedTuplestoreAccessor **bucketWriters, int bucketCount)
+{
+	MemoryContext hashContext = AllocSetContextCreate(CurrentMemoryContext,
+													  "PartitionRemoteScanResults",
+													  ALLOCSET_DEFAULT_SIZES);
+	uint64 tupleCount = 0;
+
+	while (true)
+	{
+		TupleTableSlot *slot = ExecProcNode(remoteScanState);
+		if (TupIsNull(slot))
+		{
+			break;
+		}
+
+		uint32 bucketIndex = 0;
+		if (combineState->bucketColumnCount > 0)
+		{
+			MemoryContext oldContext = MemoryContextSwitchTo(hashContext);
+
+			bucketIndex = BucketHashValue(combineState, slot) % bucketCount;
+
+			MemoryContextSwitchTo(oldContext);
+			MemoryContextReset(hashContext);
+		}
+		else
+		{
+			/* there is nothing to hash, spread the tuples evenly */
+			bucketIndex = tupleCount % bucketCount;
+		}
+
+		bool shouldFree = false;
+		MinimalTuple tuple = ExecFetchSlotMinimalTuple(slot, &shouldFree);
+
+		sts_puttuple(bucketWriters[bucketIndex], NULL, tuple);
+
+		if (shouldFree)
+		{
+			pfree(tuple);
+		}
+
+		tupleCount++;
+	}
+
+	for (int bucketIndex = 0; bucketIndex < bucketCount; bucketIndex++)
+	{
+		sts_end_write(bucketWriters[bucketIndex]);
+	}
+
+	MemoryContextDelete(hashContext);
+}
+
+
+/*
+ * BucketHashValue returns the hash of the bucket columns of the given tuple,
+ * combining the hashes of the columns in the same way execGrouping.c does.
+ */
+static uint32
+BucketHashValue(ParallelCombineScanState *combineState, TupleTableSlot *slot)
+{
+	uint32 hashValue = 0;
+
+	for (int columnIndex = 0; columnIndex < combineState->bucketColumnCount;
+		 columnIndex++)
+	{
+		AttrNumber columnNumber = combineState->bucketColumns[columnIndex];
+		bool isNull = false;
+		Datum value = slot_getattr(slot, columnNumber, &isNull);
+
+		/* rotate hashValue left 1 bit at each step */
+		hashValue = (hashValue << 1) | ((hashValue & 0x80000000) ? 1 : 0);
+
+		if (!isNull)
+		{
+			Datum columnHash =
+				FunctionCall1Coll(&combineState->hashFunctions[columnIndex],
+								  combineState->hashCollations[columnIndex], value);
+
+			hashValue ^= DatumGetUInt32(columnHash);
+		}
+	}
+
+	return hashValue;
+}
+
+
+/*
+ * GatherPartialGroups collects the partial groups of the parallel workers
+ * and of the backend into the tuple store of the parallel combine. The
+ * backend runs the combine subplan between reading the tuple queues, and
+ * waits for the workers once it cannot claim any more buckets.
+ */
+static void
+GatherPartialGroups(ParallelCombineScanState *combineState,
+					TupleQueueReader **tupleQueueReaders, int readerCount)
+{
+	PlanState *combinePlanState = outerPlanState(combineState);
+	TupleDesc tupleDescriptor = combineState->customScanState.ss.ps.scandesc;
+	TupleTableSlot *readerSlot = MakeSingleTupleTableSlot(tupleDescriptor,
+														  &TTSOpsMinimalTuple);
+	int activeReaderCount = readerCount;
+	bool finishedCombinePlan = false;
+	bool nowait = true;
+
+	MemoryContext tupleContext = AllocSetContextCreate(CurrentMemoryContext,
+													   "GatherPartialGroups",
+													   ALLOCSET_DEFAULT_SIZES);
+
+	while (activeReaderCount > 0 || !finishedCombinePlan)
+	{
+		bool receivedTuple = false;
+
+		CHECK_FOR_INTERRUPTS();
+
+		for (int readerIndex = 0; readerIndex < readerCount; readerIndex++)
+		{
+			TupleQueueReader *tupleQueueReader = tupleQueueReaders[readerIndex];
+			if (tupleQueueReader == NULL)
+			{
+				continue;
+			}
+
+			MemoryContext oldContext = MemoryContextSwitchTo(tupleContext);
+
+			/* drain the queue, the worker might be blocked on a full queue */
+			while (true)
+			{
+				bool readerDone = false;
+
+#if PG_VERSION_NUM >= PG_VERSION_14
+				MinimalTuple minimalTuple =
+					TupleQueueReaderNext(tupleQueueReader, nowait, &readerDone);
+				bool tupleReceived = minimalTuple != NULL;
+#else
+				HeapTuple heapTuple =
+					TupleQueueReaderNext(tupleQueueReader, nowait, &readerDone);
+				bool tupleReceived = heapTuple != NULL;
+#endif
+
+				if (readerDone)
+				{
+					DestroyTupleQueueReader(tupleQueueReader);
+					tupleQueueReaders[readerIndex] = NULL;
+					activeReaderCount--;
+					break;
+				}
+
+				if (!tupleReceived)
+				{
+					break;
+				}
+
+#if PG_VERSION_NUM >= PG_VERSION_14
+				ExecStoreMinimalTuple(minimalTuple, readerSlot, false);
+#else
+				ExecForceStoreHeapTuple(heapTuple, readerSlot, false);
+#endif
+
+				tuplestore_puttupleslot(combineState->tupleStore, readerSlot);
+				ExecClearTuple(readerSlot);
+
+				receivedTuple = true;
+			}
+
+			MemoryContextSwitchTo(oldContext);
+			MemoryContextReset(tupleContext);
+		}
+
+		if (!finishedCombinePlan)
+		{
+			TupleTableSlot *slot = ExecProcNode(combinePlanState);
+			if (TupIsNull(slot))
+			{
+				finishedCombinePlan = true;
+			}
+			else
+			{
+				tuplestore_puttupleslot(combineState->tupleStore, slot);
+			}
+		}
+		else if (!receivedTuple && activeReaderCount > 0)
+		{
+			/* the workers set our latch when they write to or detach from a queue */
+			(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, 0,
+							 WAIT_EVENT_EXECUTE_GATHER);
+			ResetLatch(MyLatch);
+		}
+	}
+
+	ExecDropSingleTupleTableSlot(readerSlot);
+	MemoryContextDelete(tupleContext);
+}
+
+
+/*
+ * BucketTupleStore returns the shared tuple store of the given bucket.
+ */
+static SharedTuplestore *
+BucketTupleStore(char *sharedBuckets, int bucketIndex)
+{
+	return (SharedTuplestore *) (sharedBuckets +
+								 bucketIndex * MAXALIGN(sts_estimate(1)));
+}
+
+
+/*
+ * ParallelCombineEndScan ends the remote scan and the combine subplan.
+ */
+static void
+ParallelCombineEndScan(CustomScanState *node)
+{
+	ParallelCombineScanState *combineState = (ParallelCombineScanState *) node;
+
+	ExecEndNode(outerPlanState(node));
+	ExecEndNode((PlanState *) linitial(node->custom_ps));
+
+	if (combineState->tupleStore != NULL)
+	{
+		tuplestore_end(combineState->tupleStore);
+		combineState->tupleStore = NULL;
+	}
+}
+
+
+/*
+ * ParallelCombineReScan rewinds the partial groups. They only depend on the
+ * results of the remote scan, which does not run again on a rescan either.
+ */
+static void
+ParallelCombineReScan(CustomScanState *node)
+{
+	ParallelCombineScanState *combineState = (ParallelCombineScanState *) node;
+
+	if (combineState->tupleStore != NULL)
+	{
+		tuplestore_rescan(combineState->tupleStore);
+	}
+}
+
+
+/*
+ * ParallelCombineExplainScan shows the number of planned parallel workers.
+ */
+static void
+ParallelCombineExplainScan(CustomScanState *node, List *ancestors,
+						   struct ExplainState *es)
+{
+	ParallelCombineScanState *combineState = (ParallelCombineScanState *) node;
+
+	ExplainPropertyInteger("Workers Planned", NULL, combineState->workerCount, es);
+}
+
+
+/*
+ * ParallelCombineWorkerMain is the entry point of the parallel workers of a
+ * parallel combine. The worker runs the combine subplan, which claims
+ * buckets until all buckets are claimed, and sends the partial groups to its
+ * tuple queue.
+ */
+void
+ParallelCombineWorkerMain(dsm_segment *segment, shm_toc *toc)
+{
+	ParallelCombineSharedState *sharedState =
+		shm_toc_lookup(toc, PARALLEL_KEY_COMBINE_STATE, false);
+	char *sharedBuckets = shm_toc_lookup(toc, PARALLEL_KEY_COMBINE_BUCKETS, false);
+	char *planString = shm_toc_lookup(toc, PARALLEL_KEY_COMBINE_PLAN, false);
+	char *paramSpace = shm_toc_lookup(toc, PARALLEL_KEY_COMBINE_PARAMS, false);
+	char *tupleQueueSpace = shm_toc_lookup(toc, PARALLEL_KEY_COMBINE_TUPLE_QUEUES,
+										   false);
+
+	SharedFileSetAttach(&sharedState->fileSet, segment);
+
+	shm_mq *tupleQueue = (shm_mq *) (tupleQueueSpace + ParallelWorkerNumber *
+									 COMBINE_TUPLE_QUEUE_SIZE);
+	shm_mq_set_sender(tupleQueue, MyProc);
+	shm_mq_handle *tupleQueueHandle = shm_mq_attach(tupleQueue, segment, NULL);
+
+	/* the executor detaches from the tuple queue when it shuts the receiver down */
+	DestReceiver *tupleQueueReceiver = CreateTupleQueueDestReceiver(tupleQueueHandle);
+
+	PlannedStmt *plannedStmt = (PlannedStmt *) stringToNode(planString);
+	ParamListInfo paramListInfo = RestoreParamList(&paramSpace);
+
+	/* the bucket scan of the combine subplan picks up the shared state */
+	WorkerCombineSharedState = sharedState;
+	WorkerCombineSharedBuckets = sharedBuckets;
+
+	QueryDesc *queryDesc = CreateQueryDesc(plannedStmt, "<citus parallel combine>",
+										   GetActiveSnapshot(), InvalidSnapshot,
+										   tupleQueueReceiver, paramListInfo,
+										   NULL, 0);
+
+	ExecutorStart(queryDesc, 0);
+	ExecutorRun(queryDesc, ForwardScanDirection, 0L, true);
+	ExecutorFinish(queryDesc);
+	ExecutorEnd(queryDesc);
+
+	FreeQueryDesc(queryDesc);
+
+	tupleQueueReceiver->rDestroy(tupleQueueReceiver);
+
+	WorkerCombineSharedState = NULL;
+	WorkerCombineSharedBuckets = NULL;
+}
+
+
+/*
+ * CombineBucketCreateScan creates the scan state of a bucket scan.
+ */
+static Node *
+CombineBucketCreateScan(CustomScan *scan)
+{
+	CombineBucketScanState *bucketScanState = palloc0(sizeof(CombineBucketScanState));
+
+	bucketScanState->customScanState.ss.ps.type = T_CustomScanState;
+	bucketScanState->customScanState.methods = &CombineBucketScanCustomExecMethods;
+
+	return (Node *) bucketScanState;
+}
+
+
+/*
+ * CombineBucketBeginScan initializes a bucket scan. In the backend, the
+ * parallel combine sets up the buckets once it filled them.
+ */
+static void
+CombineBucketBeginScan(CustomScanState *node, EState *estate, int eflags)
+{
+	CombineBucketScanState *bucketScanState = (CombineBucketScanState *) node;
+
+	/* the buckets contain minimal tuples */
+	ExecInitResultSlot(&node->ss.ps, &TTSOpsMinimalTuple);
+	ExecInitScanTupleSlot(estate, &node->ss, node->ss.ps.scandesc, &TTSOpsMinimalTuple);
+	ExecAssignScanProjectionInfoWithVarno(&node->ss, INDEX_VAR);
+
+	if (IsParallelWorker())
+	{
+		bucketScanState->sharedState = WorkerCombineSharedState;
+		bucketScanState->sharedBuckets = WorkerCombineSharedBuckets;
+	}
+}
+
+
+/*
+ * CombineBucketExecScan returns the next tuple of the buckets that the
+ * participant claimed, and claims the next bucket when the current one is
+ * exhausted.
+ */
+static TupleTableSlot *
+CombineBucketExecScan(CustomScanState *node)
+{
+	CombineBucketScanState *bucketScanState = (CombineBucketScanState *) node;
+	ParallelCombineSharedState *sharedState = bucketScanState->sharedState;
+	TupleTableSlot *scanSlot = node->ss.ss_ScanTupleSlot;
+
+	if (sharedState == NULL)
+	{
+		/* the backend combines by itself, read the remote scan directly */
+		TupleTableSlot *remoteSlot = ExecProcNode(bucketScanState->remoteScanState);
+		if (TupIsNull(remoteSlot))
+		{
+			return NULL;
+		}
+
+		ExecCopySlot(scanSlot, remoteSlot);
+	}
+	else
+	{
+		MinimalTuple tuple = NULL;
+
+		while (tuple == NULL)
+		{
+			if (bucketScanState->bucketReader == NULL)
+			{
+				uint32 bucketIndex =
+					pg_atomic_fetch_add_u32(&sharedState->nextBucketIndex, 1);
+				if (bucketIndex >= sharedState->bucketCount)
+				{
+					return NULL;
+				}
+
+				int participantNumber = 0;
+				bucketScanState->bucketReader =
+					sts_attach(BucketTupleStore(bucketScanState->sharedBuckets,
+												bucketIndex),
+							   participantNumber, &sharedState->fileSet);
+				sts_begin_parallel_scan(bucketScanState->bucketReader);
+			}
+
+			tuple = sts_parallel_scan_next(bucketScanState->bucketReader, NULL);
+			if (tuple == NULL)
+			{
+				CloseBucketReader(bucketScanState);
+			}
+		}
+
+		ExecStoreMinimalTuple(tuple, scanSlot, false);
+	}
+
+	ProjectionInfo *projectionInfo = node->ss.ps.ps_ProjInfo;
+	if (projectionInfo == NULL)
+	{
+		return scanSlot;
+	}
+
+	ExprContext *econtext = node->ss.ps.ps_ExprContext;
+	ResetExprContext(econtext);
+	econtext->ecxt_scantuple = scanSlot;
+
+	return ExecProject(projectionInfo);
+}
+
+
+/*
+ * CombineBucketEndScan closes the bucket that the scan currently reads.
+ */
+static void
+CombineBucketEndScan(CustomScanState *node)
+{
+	CloseBucketReader((CombineBucketScanState *) node);
+}
+
+
+/*
+ * CombineBucketReScan closes the bucket that the scan currently reads. The
+ * parallel combine never rescans its subplan.
+ */
+static void
+CombineBucketReScan(CustomScanState *node)
+{
+	CloseBucketReader((CombineBucketScanState *) node);
+}
+
+
+/*
+ * CloseBucketReader ends the scan of the current bucket, if any.
+ */
+static void
+CloseBucketReader(CombineBucketScanState *bucketScanState)
+{
+	if (bucketScanState->bucketReader == NULL)
+	{
+		return;
+	}
+
+	sts_end_parallel_scan(bucketScanState->bucketReader);
+	pfree(bucketScanState->bucketReader);
+	bucketScanState->bucketReader = NULL;
+}
@@ -0,0 +1,768 @@
+/*-------------------------------------------------------------------------
+ *
+ * parallel_local_executor.c
+ *
+ * The local executor runs the local tasks of a multi-shard query one by one
+ * in the backend that executes the query, which means that a query on a node
+ * with many local shards uses a single core. For read-only queries, we can
+ * instead fan the local tasks out to PostgreSQL's parallel workers, in the
+ * same way the Gather node of PostgreSQL distributes a parallel plan.
+ *
+ * The parallel workers share the snapshot, transaction and lock group of the
+ * backend that executes the query, so the tasks see the same data as they
+ * would with the sequential local execution, including the changes that the
+ * transaction block made earlier. Each worker claims the next unclaimed task
+ * from the shared memory, plans and executes the shard query, and sends the
+ * resulting tuples back through its own tuple queue. The backend collects
+ * the tuples into the tuple destination of the execution, and executes the
+ * tasks that no worker claimed, for instance when no workers were available.
+ *
+ * A worker sends the tuples of the tasks it claimed one task after the other.
+ * It records in the shared memory which tasks it claimed in which order and
+ * how many tuples each of them produced, which lets the backend attribute
+ * every tuple to the task that produced it.
+ *
+ * Rows that columnar buffers in the memory of the backend before flushing
+ * them are not visible to the workers, so we execute the tasks sequentially
+ * while there are such rows.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "distributed/pg_version_constants.h"
+
+#include "miscadmin.h"
+#include "pgstat.h"
+
+#include "access/htup_details.h"
+#include "access/parallel.h"
+#include "access/xact.h"
+#include "catalog/pg_proc.h"
+#include "distributed/deparse_shard_query.h"
+#include "distributed/listutils.h"
+#include "distributed/local_executor.h"
+#include "distributed/multi_executor.h"
+#include "distributed/multi_physical_planner.h"
+#include "distributed/parallel_local_executor.h"
+#include "distributed/shared_library_init.h"
+#include "distributed/version_compat.h"
+#include "executor/executor.h"
+#include "executor/tqueue.h"
+#include "optimizer/clauses.h"
+#include "optimizer/planner.h"
+#include "port/atomics.h"
+#include "storage/latch.h"
+#include "storage/shm_mq.h"
+#include "utils/memutils.h"
+#include "utils/queryenvironment.h"
+#include "utils/snapmgr.h"
+
+
+/* keys of the entries in the table of contents of the parallel context */
+#define PARALLEL_KEY_LOCAL_EXECUTION_STATE UINT64CONST(0xC17C000000000001)
+#define PARALLEL_KEY_LOCAL_EXECUTION_QUERIES UINT64CONST(0xC17C000000000002)
+#define PARALLEL_KEY_LOCAL_EXECUTION_TUPLE_QUEUES UINT64CONST(0xC17C000000000003)
+#define PARALLEL_KEY_LOCAL_EXECUTION_WORKERS UINT64CONST(0xC17C000000000004)
+
+/* same size as the tuple queues of the parallel workers of a Gather */
+#define LOCAL_EXECUTION_TUPLE_QUEUE_SIZE 65536
+
+
+/*
+ * ParallelLocalTask describes a local task in the shared memory of the
+ * parallel context.
+ */
+typedef struct ParallelLocalTask
+{
+	uint64 anchorShardId;
+
+	/* offset of the query string of the task in the query strings chunk */
+	Size queryStringOffset;
+
+	/* index of the task that the same worker claimed next, -1 if none */
+	int32 nextTaskIndexOfWorker;
+
+	/* whether the task finished, and the number of tuples it produced */
+	bool finished;
+	uint64 tupleCount;
+} ParallelLocalTask;
+
+
+/*
+ * ParallelLocalWorkerState keeps track of the tasks that a parallel worker
+ * claimed, in the shared memory of the parallel context.
+ */
+typedef struct ParallelLocalWorkerState
+{
+	/* index of the first task the worker claimed, -1 if none */
+	int32 firstTaskIndex;
+
+	/* index of the last task the worker claimed, only used by the worker */
+	int32 lastTaskIndex;
+} ParallelLocalWorkerState;
+
+
+/*
+ * TupleQueueTaskState is used by the backend to find out which task produced
+ * the tuples that it reads from the tuple queue of a parallel worker.
+ */
+typedef struct TupleQueueTaskState
+{
+	/* index of the task that produced the last tuple, -1 before the first */
+	int32 taskIndex;
+
+	/* number of tuples of that task read so far */
+	uint64 tupleCount;
+} TupleQueueTaskState;
+
+
+/*
+ * ParallelLocalExecutionState is the state of a parallel local execution
+ * that is shared by the backend and the parallel workers.
+ */
+typedef struct ParallelLocalExecutionState
+{
+	/* index of the next task that is not claimed by a parallel worker */
+	pg_atomic_uint32 nextTaskIndex;
+
+	uint32 taskCount;
+	ParallelLocalTask tasks[FLEXIBLE_ARRAY_MEMBER];
+} ParallelLocalExecutionState;
+
+
+/*
+ * ParallelTaskDestReceiver forwards the tuples of all the tasks that a
+ * parallel worker executes to the tuple queue of the worker. The tuple queue
+ * receiver detaches from the queue when the executor shuts it down, so we
+ * only shut it down after the last task.
+ */
+typedef struct ParallelTaskDestReceiver
+{
+	DestReceiver pub;
+
+	DestReceiver *tupleQueueReceiver;
+} ParallelTaskDestReceiver;
+
+
+/* GUC, maximum number of parallel workers used by a local execution */
+int MaxParallelWorkersPerLocalExecution = 0;
+
+
+static uint64 ReadTuplesFromTupleQueues(TupleQueueReader **tupleQueueReaders,
+										int readerCount,
+										ParallelLocalExecutionState *sharedState,
+										ParallelLocalWorkerState *workerStates,
+										List *taskList, TupleDestination *tupleDest);
+static int32 TaskIndexOfNextTuple(ParallelLocalExecutionState *sharedState,
+								  ParallelLocalWorkerState *workerState,
+								  TupleQueueTaskState *taskState);
+static uint64 ExecuteLocalShardQuery(const char *queryString, uint64 anchorShardId,
+									 DestReceiver *destReceiver);
+static DestReceiver * CreateParallelTaskDestReceiver(DestReceiver *tupleQueueReceiver);
+static void ParallelTaskDestReceiverStartup(DestReceiver *destReceiver, int operation,
+											TupleDesc inputTupleDescriptor);
+static bool ParallelTaskDestReceiverReceive(TupleTableSlot *slot,
+											DestReceiver *destReceiver);
+static void ParallelTaskDestReceiverShutdown(DestReceiver *destReceiver);
+static void ParallelTaskDestReceiverDestroy(DestReceiver *destReceiver);
+
+
+/*
+ * ShouldExecuteLocalTaskListInParallel returns true if the given local tasks
+ * of a distributed plan can be executed by parallel workers.
+ *
+ * Parallel workers cannot modify data, take row locks, read the intermediate
+ * results of the transaction or see the rows that columnar did not flush yet,
+ * so we only execute the tasks of parallel safe SELECT queries without
+ * subplans in parallel, and only when there are no pending columnar writes.
+ */
+bool
+ShouldExecuteLocalTaskListInParallel(List *taskList, DistributedPlan *distributedPlan,
+									 ParamListInfo paramListInfo,
+									 bool isUtilityCommand)
+{
+	if (MaxParallelWorkersPerLocalExecution == 0 || isUtilityCommand)
+	{
+		return false;
+	}
+
+	if (list_length(taskList) < 2)
+	{
+		/* nothing to parallelize */
+		return false;
+	}
+
+	if (IsInParallelMode())
+	{
+		/* we cannot start parallel workers from a parallel worker */
+		return false;
+	}
+
+	if (distributedPlan == NULL || distributedPlan->workerJob == NULL ||
+		distributedPlan->subPlanList != NIL)
+	{
+		return false;
+	}
+
+	Query *jobQuery = distributedPlan->workerJob->jobQuery;
+	if (jobQuery == NULL || jobQuery->commandType != CMD_SELECT ||
+		jobQuery->rowMarks != NIL || jobQuery->hasModifyingCTE)
+	{
+		return false;
+	}
+
+	if (max_parallel_hazard(jobQuery) != PROPARALLEL_SAFE)
+	{
+		return false;
+	}
+
+	/*
+	 * Columnar flushes the rows it buffers when a scan starts, which parallel
+	 * workers cannot do on behalf of the backend.
+	 */
+	if (extern_ColumnarHasPendingWrites != NULL && extern_ColumnarHasPendingWrites())
+	{
+		return false;
+	}
+
+	Task *task = NULL;
+	foreach_ptr(task, taskList)
+	{
+		if (!ReadOnlyTask(task->taskType) || task->tupleDest != NULL)
+		{
+			return false;
+		}
+
+		int taskQueryType = GetTaskQueryType(task);
+		if (taskQueryType != TASK_QUERY_TEXT && taskQueryType != TASK_QUERY_OBJECT)
+		{
+			return false;
+		}
+
+		if (paramListInfo != NULL && !task->parametersInQueryStringResolved)
+		{
+			/* parallel workers plan the shard queries without the parameters */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * ExecuteLocalTaskListInParallel executes the given read-only local tasks
+ * using parallel workers, writes the resulting tuples to tupleDest and
+ * returns the number of rows processed. The caller is expected to have
+ * checked the tasks using ShouldExecuteLocalTaskListInParallel.
+ */
+uint64
+ExecuteLocalTaskListInParallel(List *taskList, TupleDestination *tupleDest)
+{
+	uint64 totalRowsProcessed = 0;
+	int taskCount = list_length(taskList);
+	int workerCount = Min(MaxParallelWorkersPerLocalExecution, taskCount);
+
+	StringInfo queryStrings = makeStringInfo();
+	Size stateSize = add_size(offsetof(ParallelLocalExecutionState, tasks),
+							  mul_size(taskCount, sizeof(ParallelLocalTask)));
+	ParallelLocalExecutionState *localState = palloc0(stateSize);
+
+	localState->taskCount = taskCount;
+
+	int taskIndex = 0;
+	Task *task = NULL;
+	foreach_ptr(task, taskList)
+	{
+		ParallelLocalTask *parallelTask = &localState->tasks[taskIndex];
+		char *taskQueryString = TaskQueryString(task);
+
+		parallelTask->anchorShardId = task->anchorShardId;
+		parallelTask->queryStringOffset = queryStrings->len;
+		parallelTask->nextTaskIndexOfWorker = -1;
+		parallelTask->finished = false;
+		parallelTask->tupleCount = 0;
+
+		/* include the terminating null byte */
+		appendBinaryStringInfo(queryStrings, taskQueryString,
+							   strlen(taskQueryString) + 1);
+
+		taskIndex++;
+	}
+
+	EnterParallelMode();
+
+	ParallelContext *parallelContext =
+		CreateParallelContext("citus", "ParallelLocalExecutionWorkerMain", workerCount);
+
+	Size tupleQueuesSize = mul_size(LOCAL_EXECUTION_TUPLE_QUEUE_SIZE, workerCount);
+	Size workerStatesSize = mul_size(sizeof(ParallelLocalWorkerState), workerCount);
+
+	shm_toc_estimate_chunk(&parallelContext->estimator, stateSize);
+	shm_toc_estimate_chunk(&parallelContext->estimator, queryStrings->len);
+	shm_toc_estimate_chunk(&parallelContext->estimator, tupleQueuesSize);
+	shm_toc_estimate_chunk(&parallelContext->estimator, workerStatesSize);
+	shm_toc_estimate_keys(&parallelContext->estimator, 4);
+
+	InitializeParallelDSM(parallelContext);
+
+	shm_toc *toc = parallelContext->toc;
+
+	ParallelLocalExecutionState *sharedState = shm_toc_allocate(toc, stateSize);
+	memcpy(sharedState, localState, stateSize);
+	pg_atomic_init_u32(&sharedState->nextTaskIndex, 0);
+	shm_toc_insert(toc, PARALLEL_KEY_LOCAL_EXECUTION_STATE, sharedState);
+
+	char *sharedQueryStrings = shm_toc_allocate(toc, queryStrings->len);
+	memcpy(sharedQueryStrings, queryStrings->data, queryStrings->len);
+	shm_toc_insert(toc, PARALLEL_KEY_LOCAL_EXECUTION_QUERIES, sharedQueryStrings);
+
+	ParallelLocalWorkerState *workerStates = shm_toc_allocate(toc, workerStatesSize);
+	for (int workerIndex = 0; workerIndex < workerCount; workerIndex++)
+	{
+		workerStates[workerIndex].firstTaskIndex = -1;
+		workerStates[workerIndex].lastTaskIndex = -1;
+	}
+	shm_toc_insert(toc, PARALLEL_KEY_LOCAL_EXECUTION_WORKERS, workerStates);
+
+	char *tupleQueueSpace = shm_toc_allocate(toc, tupleQueuesSize);
+	shm_mq_handle **tupleQueueHandles = palloc0(workerCount * sizeof(shm_mq_handle *));
+
+	for (int workerIndex = 0; workerIndex < workerCount; workerIndex++)
+	{
+		shm_mq *tupleQueue =
+			shm_mq_create(tupleQueueSpace +
+						  workerIndex * LOCAL_EXECUTION_TUPLE_QUEUE_SIZE,
+						  LOCAL_EXECUTION_TUPLE_QUEUE_SIZE);
+
+		shm_mq_set_receiver(tupleQueue, MyProc);
+		tupleQueueHandles[workerIndex] =
+			shm_mq_attach(tupleQueue, parallelContext->seg, NULL);
+	}
+
+	shm_toc_insert(toc, PARALLEL_KEY_LOCAL_EXECUTION_TUPLE_QUEUES, tupleQueueSpace);
+
+	LaunchParallelWorkers(parallelContext);
+
+	/* the workers that could be registered are always the first ones */
+	int launchedWorkerCount = parallelContext->nworkers_launched;
+	if (launchedWorkerCount > 0)
+	{
+		TupleQueueReader **tupleQueueReaders =
+			palloc0(launchedWorkerCount * sizeof(TupleQueueReader *));
+
+		for (int workerIndex = 0; workerIndex < launchedWorkerCount; workerIndex++)
+		{
+			shm_mq_handle *tupleQueueHandle = tupleQueueHandles[workerIndex];
+
+			/* notice it when the worker fails to start */
+			shm_mq_set_handle(tupleQueueHandle,
+							  parallelContext->worker[workerIndex].bgwhandle);
+
+			tupleQueueReaders[workerIndex] = CreateTupleQueueReader(tupleQueueHandle);
+		}
+
+		ereport(DEBUG1, (errmsg("executing local tasks with parallel workers")));
+
+		totalRowsProcessed +=
+			ReadTuplesFromTupleQueues(tupleQueueReaders, launchedWorkerCount,
+									  sharedState, workerStates, taskList, tupleDest);
+	}
+
+	for (int workerIndex = 0; workerIndex < workerCount; workerIndex++)
+	{
+		shm_mq_detach(tupleQueueHandles[workerIndex]);
+	}
+
+	/* rethrows the errors of the workers, if any */
+	WaitForParallelWorkersToFinish(parallelContext);
+
+	uint32 nextTaskIndex = pg_atomic_read_u32(&sharedState->nextTaskIndex);
+
+	DestroyParallelContext(parallelContext);
+	ExitParallelMode();
+
+	/* execute the tasks that were not claimed by any of the workers ourselves */
+	for (taskIndex = nextTaskIndex; taskIndex < taskCount; taskIndex++)
+	{
+		ParallelLocalTask *parallelTask = &localState->tasks[taskIndex];
+		Task *unclaimedTask = list_nth(taskList, taskIndex);
+
+		/* tasks can only have one local placement */
+		int localPlacementIndex = 0;
+		DestReceiver *destReceiver =
+			CreateTupleDestDestReceiver(tupleDest, unclaimedTask, localPlacementIndex);
+
+		totalRowsProcessed +=
+			ExecuteLocalShardQuery(queryStrings->data + parallelTask->queryStringOffset,
+								   parallelTask->anchorShardId, destReceiver);
+	}
+
+	return totalRowsProcessed;
+}
+
+
+/*
+ * ReadTuplesFromTupleQueues reads the tuples from the tuple queues of the
+ * parallel workers until all workers detached from their queues, writes them
+ * to the given tuple destination, and returns the number of tuples read.
+ */
+static uint64
+ReadTuplesFromTupleQueues(TupleQueueReader **tupleQueueReaders, int readerCount,
+						  ParallelLocalExecutionState *sharedState,
+						  ParallelLocalWorkerState *workerStates, List *taskList,
+						  TupleDestination *tupleDest)
+{
+	int activeReaderCount = readerCount;
+	bool nowait = true;
+	uint64 tupleCount = 0;
+
+	TupleQueueTaskState *taskStates = palloc0(readerCount * sizeof(TupleQueueTaskState));
+	for (int readerIndex = 0; readerIndex < readerCount; readerIndex++)
+	{
+		taskStates[readerIndex].taskIndex = -1;
+	}
+
+	/* tuples have not been produced by a remote node */
+	int placementIndex = 0;
+	int queryNumber = 0;
+	uint64 tupleLibpqSize = 0;
+
+	MemoryContext tupleContext = AllocSetContextCreate(CurrentMemoryContext,
+													   "ReadTuplesFromTupleQueues",
+													   ALLOCSET_DEFAULT_SIZES);
+
+	while (activeReaderCount > 0)
+	{
+		bool receivedTuple = false;
+
+		CHECK_FOR_INTERRUPTS();
+
+		for (int readerIndex = 0; readerIndex < readerCount; readerIndex++)
+		{
+			TupleQueueReader *tupleQueueReader = tupleQueueReaders[readerIndex];
+			if (tupleQueueReader == NULL)
+			{
+				continue;
+			}
+
+			MemoryContext oldContext = MemoryContextSwitchTo(tupleContext);
+
+			/* drain the queue, the worker might be blocked on a full queue */
+			while (true)
+			{
+				bool readerDone = false;
+
+#if PG_VERSION_NUM >= PG_VERSION_14
+				MinimalTuple minimalTuple =
+					TupleQueueReaderNext(tupleQueueReader, nowait, &readerDone);
+				HeapTuple heapTuple = minimalTuple != NULL ?
+									  heap_tuple_from_minimal_tuple(minimalTuple) :
+									  NULL;
+#else
+				HeapTuple heapTuple =
+					TupleQueueReaderNext(tupleQueueReader, nowait, &readerDone);
+#endif
+
+				if (readerDone)
+				{
+					DestroyTupleQueueReader(tupleQueueReader);
+					tupleQueueReaders[readerIndex] = NULL;
+					activeReaderCount--;
+					break;
+				}
+
+				if (heapTuple == NULL)
+				{
+					break;
+				}
+
+				/* the reader index is the number of the worker */
+				int32 taskIndex = TaskIndexOfNextTuple(sharedState,
+													   &workerStates[readerIndex],
+													   &taskStates[readerIndex]);
+				Task *task = list_nth(taskList, taskIndex);
+
+				tupleDest->putTuple(tupleDest, task, placementIndex, queryNumber,
+									heapTuple, tupleLibpqSize);
+				receivedTuple = true;
+				tupleCount++;
+			}
+
+			MemoryContextSwitchTo(oldContext);
+			MemoryContextReset(tupleContext);
+		}
+
+		if (!receivedTuple && activeReaderCount > 0)
+		{
+			/* the workers set our latch when they write to or detach from a queue */
+			(void) WaitLatch(MyLatch, WL_LATCH_SET | WL_EXIT_ON_PM_DEATH, 0,
+							 WAIT_EVENT_EXECUTE_GATHER);
+			ResetLatch(MyLatch);
+		}
+	}
+
+	MemoryContextDelete(tupleContext);
+	pfree(taskStates);
+
+	return tupleCount;
+}
+
+
+/*
+ * TaskIndexOfNextTuple returns the index of the task that produced the next
+ * tuple read from the tuple queue of the given worker. A worker sends the
+ * tuples of its tasks in the order it claimed them, so the next tuple belongs
+ * to the first task in that order whose tuples were not all read yet.
+ */
+static int32
+TaskIndexOfNextTuple(ParallelLocalExecutionState *sharedState,
+					 ParallelLocalWorkerState *workerState,
+					 TupleQueueTaskState *taskState)
+{
+	/* the worker recorded the claim before it sent the tuple */
+	pg_read_barrier();
+
+	if (taskState->taskIndex < 0)
+	{
+		taskState->taskIndex = workerState->firstTaskIndex;
+		taskState->tupleCount = 0;
+	}
+
+	while (true)
+	{
+		Assert(taskState->taskIndex >= 0);
+
+		ParallelLocalTask *parallelTask = &sharedState->tasks[taskState->taskIndex];
+		if (!parallelTask->finished)
+		{
+			break;
+		}
+
+		pg_read_barrier();
+
+		if (taskState->tupleCount < parallelTask->tupleCount)
+		{
+			break;
+		}
+
+		/* all tuples of the task were read, move on to the next task */
+		taskState->taskIndex = parallelTask->nextTaskIndexOfWorker;
+		taskState->tupleCount = 0;
+	}
+
+	taskState->tupleCount++;
+
+	return taskState->taskIndex;
+}
+
+
+/*
+ * ParallelLocalExecutionWorkerMain is the entry point of the parallel workers
+ * of a parallel local execution. The worker executes unclaimed tasks until
+ * all tasks are claimed, and sends the resulting tuples to its tuple queue.
+ */
+void
+ParallelLocalExecutionWorkerMain(dsm_segment *segment, shm_toc *toc)
+{
+	ParallelLocalExecutionState *sharedState =
+		shm_toc_lookup(toc, PARALLEL_KEY_LOCAL_EXECUTION_STATE, false);
+	char *queryStrings = shm_toc_lookup(toc, PARALLEL_KEY_LOCAL_EXECUTION_QUERIES,
+										false);
+	char *tupleQueueSpace = shm_toc_lookup(toc, PARALLEL_KEY_LOCAL_EXECUTION_TUPLE_QUEUES,
+										   false);
+	ParallelLocalWorkerState *workerStates =
+		shm_toc_lookup(toc, PARALLEL_KEY_LOCAL_EXECUTION_WORKERS, false);
+	ParallelLocalWorkerState *workerState = &workerStates[ParallelWorkerNumber];
+
+	shm_mq *tupleQueue = (shm_mq *) (tupleQueueSpace + ParallelWorkerNumber *
+									 LOCAL_EXECUTION_TUPLE_QUEUE_SIZE);
+	shm_mq_set_sender(tupleQueue, MyProc);
+	shm_mq_handle *tupleQueueHandle = shm_mq_attach(tupleQueue, segment, NULL);
+
+	DestReceiver *tupleQueueReceiver = CreateTupleQueueDestReceiver(tupleQueueHandle);
+	DestReceiver *destReceiver = CreateParallelTaskDestReceiver(tupleQueueReceiver);
+
+	while (true)
+	{
+		uint32 taskIndex = pg_atomic_fetch_add_u32(&sharedState->nextTaskIndex, 1);
+		if (taskIndex >= sharedState->taskCount)
+		{
+			break;
+		}
+
+		ParallelLocalTask *parallelTask = &sharedState->tasks[taskIndex];
+
+		/* record the claim, the backend reads it after the tuples of the task */
+		if (workerState->lastTaskIndex < 0)
+		{
+			workerState->firstTaskIndex = taskIndex;
+		}
+		else
+		{
+			sharedState->tasks[workerState->lastTaskIndex].nextTaskIndexOfWorker =
+				taskIndex;
+		}
+
+		workerState->lastTaskIndex = taskIndex;
+
+		pg_write_barrier();
+
+		uint64 tupleCount =
+			ExecuteLocalShardQuery(queryStrings + parallelTask->queryStringOffset,
+								   parallelTask->anchorShardId, destReceiver);
+
+		parallelTask->tupleCount = tupleCount;
+
+		pg_write_barrier();
+
+		parallelTask->finished = true;
+	}
+
+	/* detaches from the tuple queue, which tells the backend we are done */
+	tupleQueueReceiver->rShutdown(tupleQueueReceiver);
+	tupleQueueReceiver->rDestroy(tupleQueueReceiver);
+	destReceiver->rDestroy(destReceiver);
+}
+
+
+/*
+ * ExecuteLocalShardQuery plans and executes the given read-only shard query,
+ * sends the resulting tuples to the given destination and returns the number
+ * of tuples.
+ */
+static uint64
+ExecuteLocalShardQuery(const char *queryString, uint64 anchorShardId,
+					   DestReceiver *destReceiver)
+{
+	uint64 processedRows = 0;
+
+	MemoryContext queryContext = AllocSetContextCreate(CurrentMemoryContext,
+													   "ExecuteLocalShardQuery",
+													   ALLOCSET_DEFAULT_SIZES);
+	MemoryContext oldContext = MemoryContextSwitchTo(queryContext);
+
+	/*
+	 * If we roll back to a savepoint, we may no longer be in a query on
+	 * a shard. Reset the value as we go back up the stack.
+	 */
+	uint64 prevLocalExecutorShardId = LocalExecutorShardId;
+
+	if (anchorShardId != INVALID_SHARD_ID)
+	{
+		LocalExecutorShardId = anchorShardId;
+	}
+
+	PG_TRY();
+	{
+		Query *shardQuery = ParseQueryString(queryString, NULL, 0);
+
+		int cursorOptions = 0;
+		ParamListInfo paramListInfo = NULL;
+		PlannedStmt *localPlan = planner_compat(shardQuery, cursorOptions,
+												paramListInfo);
+
+		QueryDesc *queryDesc = CreateQueryDesc(localPlan, queryString,
+											   GetActiveSnapshot(), InvalidSnapshot,
+											   destReceiver, paramListInfo,
+											   create_queryEnv(), 0);
+
+		ExecutorStart(queryDesc, 0);
+		ExecutorRun(queryDesc, ForwardScanDirection, 0L, true);
+		ExecutorFinish(queryDesc);
+
+		processedRows = queryDesc->estate->es_processed;
+
+		ExecutorEnd(queryDesc);
+
+		FreeQueryDesc(queryDesc);
+	}
+	PG_CATCH();
+	{
+		LocalExecutorShardId = prevLocalExecutorShardId;
+
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	LocalExecutorShardId = prevLocalExecutorShardId;
+
+	MemoryContextSwitchTo(oldContext);
+	MemoryContextDelete(queryContext);
+
+	return processedRows;
+}
+
+
+/*
+ * CreateParallelTaskDestReceiver creates a DestReceiver that forwards the
+ * tuples of multiple queries to the given tuple queue receiver.
+ */
+static DestReceiver *
+CreateParallelTaskDestReceiver(DestReceiver *tupleQueueReceiver)
+{
+	ParallelTaskDestReceiver *destReceiver = palloc0(sizeof(ParallelTaskDestReceiver));
+
+	destReceiver->pub.rStartup = ParallelTaskDestReceiverStartup;
+	destReceiver->pub.receiveSlot = ParallelTaskDestReceiverReceive;
+	destReceiver->pub.rShutdown = ParallelTaskDestReceiverShutdown;
+	destReceiver->pub.rDestroy = ParallelTaskDestReceiverDestroy;
+	destReceiver->pub.mydest = DestTupleQueue;
+
+	destReceiver->tupleQueueReceiver = tupleQueueReceiver;
+
+	return (DestReceiver *) destReceiver;
+}
+
+
+/*
+ * ParallelTaskDestReceiverStartup implements DestReceiver->rStartup for
+ * ParallelTaskDestReceiver.
+ */
+static void
+ParallelTaskDestReceiverStartup(DestReceiver *destReceiver, int operation,
+								TupleDesc inputTupleDescriptor)
+{
+	/* the tuple queue receiver needs no startup */
+}
+
+
+/*
+ * ParallelTaskDestReceiverReceive implements DestReceiver->receiveSlot for
+ * ParallelTaskDestReceiver.
+ */
+static bool
+ParallelTaskDestReceiverReceive(TupleTableSlot *slot, DestReceiver *destReceiver)
+{
+	ParallelTaskDestReceiver *parallelTaskDest =
+		(ParallelTaskDestReceiver *) destReceiver;
+	DestReceiver *tupleQueueReceiver = parallelTaskDest->tupleQueueReceiver;
+
+	return tupleQueueReceiver->receiveSlot(slot, tupleQueueReceiver);
+}
+
+
+/*
+ * ParallelTaskDestReceiverShutdown implements DestReceiver->rShutdown for
+ * ParallelTaskDestReceiver.
+ */
+static void
+ParallelTaskDestReceiverShutdown(DestReceiver *destReceiver)
+{
+	/* keep the tuple queue attached for the next task */
+}
+
+
+/*
+ * ParallelTaskDestReceiverDestroy implements DestReceiver->rDestroy for
+ * ParallelTaskDestReceiver.
+ */
+static void
+ParallelTaskDestReceiverDestroy(DestReceiver *destReceiver)
+{
+	pfree(destReceiver);
+}
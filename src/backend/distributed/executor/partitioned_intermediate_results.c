@@ -21,6 +21,7 @@
 #include "catalog/pg_am.h"
 #include "catalog/pg_type.h"
 #include "distributed/intermediate_results.h"
+#include "distributed/join_key_filter.h"
 #include "distributed/metadata_utility.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_executor.h"
@@ -92,6 +93,9 @@ typedef struct PartitionedResultDestReceiver
 
 	/* whether NULL partition column values are allowed */
 	bool allowNullPartitionColumnValues;
+
+	/* if set, tuples whose partition column hash is not in the filter are dropped */
+	bytea *joinKeyFilter;
 } PartitionedResultDestReceiver;
 
 static Portal StartPortalForQueryExecution(const char *queryString);
@@ -101,6 +105,8 @@ static bool PartitionedResultDestReceiverReceive(TupleTableSlot *slot,
 												 DestReceiver *dest);
 static void PartitionedResultDestReceiverShutdown(DestReceiver *dest);
 static void PartitionedResultDestReceiverDestroy(DestReceiver *copyDest);
+static bool PartitionColumnValueInJoinKeyFilter(PartitionedResultDestReceiver *self,
+												Datum partitionColumnValue);
 
 /* exports for SQL callable functions */
 PG_FUNCTION_INFO_V1(worker_partition_query_result);
@@ -146,6 +152,24 @@ worker_partition_query_result(PG_FUNCTION_ARGS)
 	bool allowNullPartitionColumnValues = PG_GETARG_BOOL(7);
 	bool generateEmptyResults = PG_GETARG_BOOL(8);
 
+	/* an empty join key filter means that rows are not filtered */
+	bytea *joinKeyFilter = NULL;
+	if (PG_NARGS() > 9)
+	{
+		joinKeyFilter = PG_GETARG_BYTEA_PP(9);
+
+		if (VARSIZE_ANY_EXHDR(joinKeyFilter) == 0)
+		{
+			joinKeyFilter = NULL;
+		}
+		else if (partitionMethod != DISTRIBUTE_BY_HASH)
+		{
+			ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+							errmsg("join key filters are only supported for hash "
+								   "partitioning")));
+		}
+	}
+
 	if (!IsMultiStatementTransaction())
 	{
 		ereport(ERROR, (errmsg("worker_partition_query_result can only be used in a "
@@ -237,7 +261,8 @@ worker_partition_query_result(PG_FUNCTION_ARGS)
 		shardSearchInfo,
 		dests,
 		lazyStartup,
-		allowNullPartitionColumnValues);
+		allowNullPartitionColumnValues,
+		joinKeyFilter);
 
 	/* execute the query */
 	PortalRun(portal, FETCH_ALL, false, true, dest, dest, NULL);
@@ -402,7 +427,8 @@ CreatePartitionedResultDestReceiver(int partitionColumnIndex,
 									CitusTableCacheEntry *shardSearchInfo,
 									DestReceiver **partitionedDestReceivers,
 									bool lazyStartup,
-									bool allowNullPartitionColumnValues)
+									bool allowNullPartitionColumnValues,
+									bytea *joinKeyFilter)
 {
 	PartitionedResultDestReceiver *resultDest =
 		palloc0(sizeof(PartitionedResultDestReceiver));
@@ -422,6 +448,7 @@ CreatePartitionedResultDestReceiver(int partitionColumnIndex,
 	resultDest->startedDestReceivers = NULL;
 	resultDest->lazyStartup = lazyStartup;
 	resultDest->allowNullPartitionColumnValues = allowNullPartitionColumnValues;
+	resultDest->joinKeyFilter = joinKeyFilter;
 
 	return (DestReceiver *) resultDest;
 }
@@ -475,7 +502,12 @@ PartitionedResultDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 
 	if (columnNulls[self->partitionColumnIndex])
 	{
-		if (self->allowNullPartitionColumnValues)
+		if (self->joinKeyFilter != NULL)
+		{
+			/* NULL join keys never have a match */
+			return true;
+		}
+		else if (self->allowNullPartitionColumnValues)
 		{
 			/*
 			 * NULL values go into the first partition for both hash- and range-
@@ -493,6 +525,13 @@ PartitionedResultDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 	else
 	{
 		Datum partitionColumnValue = columnValues[self->partitionColumnIndex];
+
+		if (self->joinKeyFilter != NULL &&
+			!PartitionColumnValueInJoinKeyFilter(self, partitionColumnValue))
+		{
+			return true;
+		}
+
 		ShardInterval *shardInterval = FindShardInterval(partitionColumnValue,
 														 self->shardSearchInfo);
 		if (shardInterval == NULL)
@@ -524,6 +563,25 @@ PartitionedResultDestReceiverReceive(TupleTableSlot *slot, DestReceiver *dest)
 }
 
 
+/*
+ * PartitionColumnValueInJoinKeyFilter returns whether the hash of the given
+ * partition column value is in the join key filter of the dest receiver. The
+ * join key filter is built using the same hash function as the one that is
+ * used for hash partitioning.
+ */
+static bool
+PartitionColumnValueInJoinKeyFilter(PartitionedResultDestReceiver *self,
+									Datum partitionColumnValue)
+{
+	CitusTableCacheEntry *shardSearchInfo = self->shardSearchInfo;
+	Datum hashedValue = FunctionCall1Coll(shardSearchInfo->hashFunction,
+										  shardSearchInfo->partitionColumn->varcollid,
+										  partitionColumnValue);
+
+	return JoinKeyFilterContains(self->joinKeyFilter, DatumGetUInt32(hashedValue));
+}
+
+
 /*
  * PartitionedResultDestReceiverShutdown implements the rShutdown interface of
  * PartitionedResultDestReceiver by calling rShutdown on all started
@@ -0,0 +1,686 @@
+/*-------------------------------------------------------------------------
+ *
+ * reference_table_result_cache.c
+ *
+ * Reference tables typically hold small amounts of data that rarely change,
+ * yet router queries on them are sent to a placement on every execution.
+ * This file implements a backend-local cache for the results of such
+ * queries, keyed on the shard query string, its parameters and the current
+ * user.
+ *
+ * Cached results are removed when a relcache invalidation is received for
+ * any of the reference tables accessed by the query. Modifications of
+ * reference tables register such an invalidation, which the modifying
+ * backend processes at the end of the command, and other backends process
+ * once the modifying transaction commits.
+ *
+ * Other backends process the invalidation when the transaction commits on
+ * the coordinator, which is before COMMIT PREPARED finishes on the workers.
+ * A query that runs in between might still read the old rows. Transactions
+ * that modify reference tables are therefore counted in shared memory until
+ * they finished on all nodes, and results are only stored if no such
+ * transaction was in progress or finished while the query ran. Results are
+ * only cached in READ COMMITTED outside of transaction blocks, since other
+ * snapshots might not see the latest writes, and they are not reused after
+ * citus.reference_table_result_cache_max_age, which bounds how long writes
+ * made via other nodes go unnoticed. Since that is up to the user to decide,
+ * the cache is off unless both the max age and the size of the cache are set.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "miscadmin.h"
+
+#include "access/htup_details.h"
+#include "access/xact.h"
+#include "common/hashfn.h"
+#include "distributed/backend_data.h"
+#include "distributed/deparse_shard_query.h"
+#include "distributed/distributed_planner.h"
+#include "distributed/listutils.h"
+#include "distributed/metadata_cache.h"
+#include "distributed/multi_executor.h"
+#include "distributed/reference_table_result_cache.h"
+#include "distributed/transaction_management.h"
+#include "lib/ilist.h"
+#include "lib/stringinfo.h"
+#include "optimizer/optimizer.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/timestamp.h"
+
+
+/*
+ * ReferenceTableResultCacheEntry holds the result of a query, keyed on its
+ * cache key.
+ */
+typedef struct ReferenceTableResultCacheEntry
+{
+	/* cache key, allocated in context */
+	char *cacheKey;
+
+	/* reference tables accessed by the query */
+	List *relationIdList;
+
+	/* tuples of the result */
+	HeapTuple *tuples;
+	int tupleCount;
+
+	/* when the result was stored */
+	TimestampTz storeTime;
+
+	/* memory context that holds all of the above, and its accounted size */
+	MemoryContext context;
+	Size size;
+
+	/* membership in the list of entries, most recently used first */
+	dlist_node lruNode;
+} ReferenceTableResultCacheEntry;
+
+
+/*
+ * ResultCacheTupleDestination is a TupleDestination that forwards tuples to
+ * the target destination and collects a copy of them to store in the cache.
+ */
+typedef struct ResultCacheTupleDestination
+{
+	TupleDestination pub;
+
+	/* destination of tuples */
+	TupleDestination *targetTupleDest;
+
+	/* copies of the tuples, allocated in tupleContext, and their total size */
+	MemoryContext tupleContext;
+	List *tupleList;
+	Size tupleListSize;
+
+	/* whether the result is too large to cache */
+	bool resultTooLarge;
+
+	/* value of ResultCacheInvalidationCount when the execution started */
+	uint64 invalidationCount;
+
+	/* shared reference table write counters when the execution started */
+	uint32 referenceTableWritesInProgress;
+	uint64 referenceTableWritesFinished;
+} ResultCacheTupleDestination;
+
+
+/* GUC, size of the reference table result cache of a backend in kilobytes */
+int ReferenceTableResultCacheSize = 0;
+
+/* GUC, time in milliseconds after which cached results are no longer used */
+int ReferenceTableResultCacheMaxAge = 0;
+
+static MemoryContext ResultCacheContext = NULL;
+static HTAB *ResultCacheHash = NULL;
+static dlist_head ResultCacheLRUList = DLIST_STATIC_INIT(ResultCacheLRUList);
+static Size ResultCacheUsedSize = 0;
+
+/*
+ * Number of relcache invalidations processed by the backend. Results are only
+ * cached when no invalidation is processed during the execution, since the
+ * result might have been read before the invalidating change committed.
+ */
+static uint64 ResultCacheInvalidationCount = 0;
+
+/* whether the current transaction is counted as a reference table write */
+static bool ReferenceTableWriteRegistered = false;
+
+
+static void InitializeReferenceTableResultCache(void);
+static uint32 ResultCacheKeyHash(const void *key, Size keysize);
+static int ResultCacheKeyCompare(const void *a, const void *b, Size keysize);
+static ReferenceTableResultCacheEntry * LookupResultCacheEntry(const char *cacheKey);
+static void RemoveResultCacheEntry(ReferenceTableResultCacheEntry *entry);
+static void InvalidateReferenceTableResultCacheCallback(Datum argument, Oid relationId);
+static void ResultCacheTupleDestPutTuple(TupleDestination *self, Task *task,
+										 int placementIndex, int queryNumber,
+										 HeapTuple heapTuple, uint64 tupleLibpqSize);
+static TupleDesc ResultCacheTupleDestTupleDescForQuery(TupleDestination *self,
+													   int queryNumber);
+
+
+/*
+ * IsReferenceTableResultCacheable returns whether the result of the given
+ * distributed plan can be served from the reference table result cache. That
+ * is the case for single task SELECT queries that only access reference
+ * tables and do not contain mutable functions, and that run in READ COMMITTED
+ * outside of a transaction block.
+ */
+bool
+IsReferenceTableResultCacheable(DistributedPlan *distributedPlan)
+{
+	if (ReferenceTableResultCacheSize <= 0 || ReferenceTableResultCacheMaxAge <= 0)
+	{
+		return false;
+	}
+
+	/* results read after a modification might contain uncommitted data */
+	if (XactModificationLevel != XACT_MODIFICATION_NONE)
+	{
+		return false;
+	}
+
+	/*
+	 * The worker snapshot of a transaction block might not see writes that
+	 * were committed after the transaction started, and vice versa.
+	 */
+	if (IsTransactionBlock() || XactIsoLevel != XACT_READ_COMMITTED)
+	{
+		return false;
+	}
+
+	if (distributedPlan->modLevel != ROW_MODIFY_READONLY ||
+		distributedPlan->subPlanList != NIL)
+	{
+		return false;
+	}
+
+	Job *job = distributedPlan->workerJob;
+	if (job == NULL || job->dependentJobList != NIL ||
+		list_length(job->taskList) != 1)
+	{
+		return false;
+	}
+
+	Query *jobQuery = job->jobQuery;
+	if (jobQuery == NULL || jobQuery->commandType != CMD_SELECT ||
+		jobQuery->rowMarks != NIL)
+	{
+		return false;
+	}
+
+	/* mutable functions might return a different result on every execution */
+	if (contain_mutable_functions((Node *) jobQuery))
+	{
+		return false;
+	}
+
+	Task *task = (Task *) linitial(job->taskList);
+	if (task->relationShardList == NIL)
+	{
+		return false;
+	}
+
+	RelationShard *relationShard = NULL;
+	foreach_ptr(relationShard, task->relationShardList)
+	{
+		if (!IsCitusTableType(relationShard->relationId, REFERENCE_TABLE))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+/*
+ * ReferenceTableResultCacheKey returns the key under which the result of the
+ * given task is cached. The key consists of the current user, since the result
+ * might depend on row level security policies, the query string of the task and
+ * the values of the parameters that are sent along with it.
+ */
+char *
+ReferenceTableResultCacheKey(Task *task, ParamListInfo paramListInfo)
+{
+	StringInfo cacheKey = makeStringInfo();
+
+	appendStringInfo(cacheKey, "%u\n%s", GetUserId(), TaskQueryString(task));
+
+	if (paramListInfo != NULL && !task->parametersInQueryStringResolved)
+	{
+		Oid *parameterTypes = NULL;
+		const char **parameterValues = NULL;
+
+		/* force evaluation of bound params */
+		paramListInfo = copyParamList(paramListInfo);
+
+		ExtractParametersFromParamList(paramListInfo, &parameterTypes,
+									   &parameterValues, true);
+
+		for (int parameterIndex = 0; parameterIndex < paramListInfo->numParams;
+			 parameterIndex++)
+		{
+			const char *parameterValue = parameterValues[parameterIndex];
+
+			appendStringInfo(cacheKey, "\n%u", parameterTypes[parameterIndex]);
+
+			/* prefix values with their length to keep keys unambiguous */
+			if (parameterValue != NULL)
+			{
+				appendStringInfo(cacheKey, ":%zu:%s", strlen(parameterValue),
+								 parameterValue);
+			}
+		}
+	}
+
+	return cacheKey->data;
+}
+
+
+/*
+ * ReadReferenceTableResultCache writes the cached result for the given cache
+ * key into the tuple store. It returns false if there is no cached result.
+ */
+bool
+ReadReferenceTableResultCache(const char *cacheKey, Tuplestorestate *tupleStore)
+{
+	InitializeReferenceTableResultCache();
+
+	ReferenceTableResultCacheEntry *entry = LookupResultCacheEntry(cacheKey);
+	if (entry == NULL)
+	{
+		return false;
+	}
+
+	if (TimestampDifferenceExceeds(entry->storeTime, GetCurrentTimestamp(),
+								   ReferenceTableResultCacheMaxAge))
+	{
+		/* the result might miss writes made via other nodes */
+		RemoveResultCacheEntry(entry);
+		return false;
+	}
+
+	ereport(DEBUG1, (errmsg("using the cached result of the query on reference "
+							"tables")));
+
+	for (int tupleIndex = 0; tupleIndex < entry->tupleCount; tupleIndex++)
+	{
+		tuplestore_puttuple(tupleStore, entry->tuples[tupleIndex]);
+	}
+
+	dlist_delete(&entry->lruNode);
+	dlist_push_head(&ResultCacheLRUList, &entry->lruNode);
+
+	return true;
+}
+
+
+/*
+ * CreateResultCacheTupleDest creates a TupleDestination which forwards tuples
+ * to targetTupleDest and collects them to be stored via
+ * StoreReferenceTableResult once the execution succeeds.
+ */
+TupleDestination *
+CreateResultCacheTupleDest(TupleDestination *targetTupleDest)
+{
+	ResultCacheTupleDestination *resultCacheDest =
+		palloc0(sizeof(ResultCacheTupleDestination));
+
+	resultCacheDest->targetTupleDest = targetTupleDest;
+	resultCacheDest->tupleContext = CurrentMemoryContext;
+	resultCacheDest->invalidationCount = ResultCacheInvalidationCount;
+	GetReferenceTableWriteCounters(&resultCacheDest->referenceTableWritesInProgress,
+								   &resultCacheDest->referenceTableWritesFinished);
+	resultCacheDest->pub.putTuple = ResultCacheTupleDestPutTuple;
+	resultCacheDest->pub.tupleDescForQuery = ResultCacheTupleDestTupleDescForQuery;
+	resultCacheDest->pub.tupleDestinationStats =
+		targetTupleDest->tupleDestinationStats;
+
+	return (TupleDestination *) resultCacheDest;
+}
+
+
+/*
+ * ResultCacheTupleDestPutTuple implements TupleDestination->putTuple for
+ * ResultCacheTupleDestination.
+ */
+static void
+ResultCacheTupleDestPutTuple(TupleDestination *self, Task *task,
+							 int placementIndex, int queryNumber,
+							 HeapTuple heapTuple, uint64 tupleLibpqSize)
+{
+	ResultCacheTupleDestination *resultCacheDest = (ResultCacheTupleDestination *) self;
+	TupleDestination *targetTupleDest = resultCacheDest->targetTupleDest;
+
+	targetTupleDest->putTuple(targetTupleDest, task, placementIndex, queryNumber,
+							  heapTuple, tupleLibpqSize);
+
+	if (resultCacheDest->resultTooLarge)
+	{
+		return;
+	}
+
+	Size tupleSize = HEAPTUPLESIZE + heapTuple->t_len;
+	if (resultCacheDest->tupleListSize + tupleSize >
+		(Size) ReferenceTableResultCacheSize * 1024L)
+	{
+		/* the result would not fit in the cache, stop collecting tuples */
+		resultCacheDest->resultTooLarge = true;
+		resultCacheDest->tupleList = NIL;
+
+		return;
+	}
+
+	MemoryContext oldContext = MemoryContextSwitchTo(resultCacheDest->tupleContext);
+
+	resultCacheDest->tupleList = lappend(resultCacheDest->tupleList,
+										 heap_copytuple(heapTuple));
+	resultCacheDest->tupleListSize += tupleSize;
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * ResultCacheTupleDestTupleDescForQuery implements TupleDestination->
+ * tupleDescForQuery for ResultCacheTupleDestination.
+ */
+static TupleDesc
+ResultCacheTupleDestTupleDescForQuery(TupleDestination *self, int queryNumber)
+{
+	ResultCacheTupleDestination *resultCacheDest = (ResultCacheTupleDestination *) self;
+	TupleDestination *targetTupleDest = resultCacheDest->targetTupleDest;
+
+	return targetTupleDest->tupleDescForQuery(targetTupleDest, queryNumber);
+}
+
+
+/*
+ * StoreReferenceTableResult stores the tuples collected by the given
+ * ResultCacheTupleDestination in the cache, evicting the least recently
+ * used results if the cache would otherwise exceed its size.
+ */
+void
+StoreReferenceTableResult(const char *cacheKey, Task *task,
+						  TupleDestination *resultCacheTupleDest)
+{
+	ResultCacheTupleDestination *resultCacheDest =
+		(ResultCacheTupleDestination *) resultCacheTupleDest;
+
+	if (resultCacheDest->resultTooLarge ||
+		resultCacheDest->invalidationCount != ResultCacheInvalidationCount)
+	{
+		return;
+	}
+
+	/*
+	 * A reference table write that was in progress or finished while the
+	 * query ran might have committed on the placement after we read it.
+	 */
+	uint32 referenceTableWritesInProgress = 0;
+	uint64 referenceTableWritesFinished = 0;
+	GetReferenceTableWriteCounters(&referenceTableWritesInProgress,
+								   &referenceTableWritesFinished);
+
+	if (resultCacheDest->referenceTableWritesInProgress != 0 ||
+		referenceTableWritesInProgress != 0 ||
+		resultCacheDest->referenceTableWritesFinished != referenceTableWritesFinished)
+	{
+		return;
+	}
+
+	InitializeReferenceTableResultCache();
+
+	if (LookupResultCacheEntry(cacheKey) != NULL)
+	{
+		/* a result with the same key is already cached */
+		return;
+	}
+
+	Size cacheSize = (Size) ReferenceTableResultCacheSize * 1024L;
+	Size entrySize = resultCacheDest->tupleListSize + strlen(cacheKey) +
+					 sizeof(ReferenceTableResultCacheEntry);
+	if (entrySize > cacheSize)
+	{
+		return;
+	}
+
+	while (ResultCacheUsedSize + entrySize > cacheSize &&
+		   !dlist_is_empty(&ResultCacheLRUList))
+	{
+		ReferenceTableResultCacheEntry *leastRecentlyUsedEntry =
+			dlist_container(ReferenceTableResultCacheEntry, lruNode,
+							dlist_tail_node(&ResultCacheLRUList));
+
+		RemoveResultCacheEntry(leastRecentlyUsedEntry);
+	}
+
+	MemoryContext entryContext = AllocSetContextCreate(ResultCacheContext,
+													   "Reference Table Result",
+													   ALLOCSET_SMALL_SIZES);
+	MemoryContext oldContext = MemoryContextSwitchTo(entryContext);
+
+	/* the entry points to the caller's key until we copy it */
+	ReferenceTableResultCacheEntry *entry =
+		hash_search(ResultCacheHash, &cacheKey, HASH_ENTER, NULL);
+
+	entry->cacheKey = pstrdup(cacheKey);
+	entry->relationIdList = NIL;
+
+	RelationShard *relationShard = NULL;
+	foreach_ptr(relationShard, task->relationShardList)
+	{
+		entry->relationIdList = list_append_unique_oid(entry->relationIdList,
+													   relationShard->relationId);
+	}
+
+	entry->tupleCount = list_length(resultCacheDest->tupleList);
+	entry->tuples = palloc0(Max(entry->tupleCount, 1) * sizeof(HeapTuple));
+
+	int tupleIndex = 0;
+	HeapTuple heapTuple = NULL;
+	foreach_ptr(heapTuple, resultCacheDest->tupleList)
+	{
+		entry->tuples[tupleIndex++] = heap_copytuple(heapTuple);
+	}
+
+	MemoryContextSwitchTo(oldContext);
+
+	entry->context = entryContext;
+	entry->size = entrySize;
+	entry->storeTime = GetCurrentTimestamp();
+
+	dlist_push_head(&ResultCacheLRUList, &entry->lruNode);
+	ResultCacheUsedSize += entrySize;
+}
+
+
+/*
+ * InvalidateReferenceTableResultsForTaskList registers a relcache invalidation
+ * for the reference tables modified by the given tasks, such that cached
+ * results of queries on them are removed in all backends.
+ */
+void
+InvalidateReferenceTableResultsForTaskList(List *taskList)
+{
+	if (ReferenceTableResultCacheSize <= 0)
+	{
+		return;
+	}
+
+	List *relationIdList = NIL;
+
+	Task *task = NULL;
+	foreach_ptr(task, taskList)
+	{
+		if (task->anchorShardId == INVALID_SHARD_ID)
+		{
+			continue;
+		}
+
+		Oid relationId = RelationIdForShard(task->anchorShardId);
+		if (IsCitusTableType(relationId, REFERENCE_TABLE))
+		{
+			relationIdList = list_append_unique_oid(relationIdList, relationId);
+		}
+	}
+
+	Oid relationId = InvalidOid;
+	foreach_oid(relationId, relationIdList)
+	{
+		InvalidateReferenceTableResults(relationId);
+	}
+}
+
+
+/*
+ * InvalidateReferenceTableResults registers a relcache invalidation for the
+ * given reference table, which removes cached results of queries on it, and
+ * counts the current transaction as a reference table write until it ends.
+ *
+ * Since modifications need to register invalidations for the cache to be
+ * correct, citus.reference_table_result_cache_size can only be set for the
+ * whole server.
+ */
+void
+InvalidateReferenceTableResults(Oid relationId)
+{
+	if (ReferenceTableResultCacheSize <= 0)
+	{
+		return;
+	}
+
+	if (!ReferenceTableWriteRegistered)
+	{
+		ReferenceTableWriteStarted();
+		ReferenceTableWriteRegistered = true;
+	}
+
+	CitusInvalidateRelcacheByRelid(relationId);
+}
+
+
+/*
+ * ReferenceTableResultCacheTransactionEnd is called once the current
+ * transaction committed or aborted on all nodes, and stops counting it as a
+ * reference table write.
+ */
+void
+ReferenceTableResultCacheTransactionEnd(void)
+{
+	if (ReferenceTableWriteRegistered)
+	{
+		ReferenceTableWriteFinished();
+		ReferenceTableWriteRegistered = false;
+	}
+}
+
+
+/*
+ * InitializeReferenceTableResultCache creates the memory context and hash of
+ * the cache, and registers the relcache callback that removes stale results.
+ */
+static void
+InitializeReferenceTableResultCache(void)
+{
+	static bool registeredInvalidationCallback = false;
+
+	if (!registeredInvalidationCallback)
+	{
+		CacheRegisterRelcacheCallback(InvalidateReferenceTableResultCacheCallback,
+									  (Datum) 0);
+		registeredInvalidationCallback = true;
+	}
+
+	if (ResultCacheHash != NULL)
+	{
+		return;
+	}
+
+	ResultCacheContext = AllocSetContextCreate(CacheMemoryContext,
+											   "Reference Table Result Cache",
+											   ALLOCSET_DEFAULT_SIZES);
+
+	HASHCTL info;
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(char *);
+	info.entrysize = sizeof(ReferenceTableResultCacheEntry);
+	info.hash = ResultCacheKeyHash;
+	info.match = ResultCacheKeyCompare;
+	info.hcxt = ResultCacheContext;
+	int hashFlags = (HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+
+	ResultCacheHash = hash_create("Reference Table Result Cache Hash", 64, &info,
+								  hashFlags);
+}
+
+
+/*
+ * ResultCacheKeyHash hashes the cache key string that the given hash key
+ * points to.
+ */
+static uint32
+ResultCacheKeyHash(const void *key, Size keysize)
+{
+	const char *cacheKey = *((const char **) key);
+
+	return hash_bytes((const unsigned char *) cacheKey, strlen(cacheKey));
+}
+
+
+/*
+ * ResultCacheKeyCompare compares the cache key strings that the given hash
+ * keys point to.
+ */
+static int
+ResultCacheKeyCompare(const void *a, const void *b, Size keysize)
+{
+	const char *cacheKeyA = *((const char **) a);
+	const char *cacheKeyB = *((const char **) b);
+
+	return strcmp(cacheKeyA, cacheKeyB);
+}
+
+
+/*
+ * LookupResultCacheEntry returns the cache entry for the given key, or NULL
+ * if there is none.
+ */
+static ReferenceTableResultCacheEntry *
+LookupResultCacheEntry(const char *cacheKey)
+{
+	return hash_search(ResultCacheHash, &cacheKey, HASH_FIND, NULL);
+}
+
+
+/*
+ * RemoveResultCacheEntry removes the entry from the cache and frees its memory.
+ */
+static void
+RemoveResultCacheEntry(ReferenceTableResultCacheEntry *entry)
+{
+	MemoryContext entryContext = entry->context;
+
+	dlist_delete(&entry->lruNode);
+	ResultCacheUsedSize -= entry->size;
+
+	hash_search(ResultCacheHash, &entry->cacheKey, HASH_REMOVE, NULL);
+	MemoryContextDelete(entryContext);
+}
+
+
+/*
+ * InvalidateReferenceTableResultCacheCallback removes the cached results of
+ * queries that access the invalidated relation, or all results when all
+ * relations are invalidated.
+ */
+static void
+InvalidateReferenceTableResultCacheCallback(Datum argument, Oid relationId)
+{
+	ResultCacheInvalidationCount++;
+
+	if (ResultCacheHash == NULL || hash_get_num_entries(ResultCacheHash) == 0)
+	{
+		return;
+	}
+
+	dlist_mutable_iter iter;
+	dlist_foreach_modify(iter, &ResultCacheLRUList)
+	{
+		ReferenceTableResultCacheEntry *entry =
+			dlist_container(ReferenceTableResultCacheEntry, lruNode, iter.cur);
+
+		if (relationId == InvalidOid ||
+			list_member_oid(entry->relationIdList, relationId))
+		{
+			RemoveResultCacheEntry(entry);
+		}
+	}
+}
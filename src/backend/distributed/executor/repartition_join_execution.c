@@ -11,6 +11,8 @@
  *  gives an error, so if we come to a fetchTask we know for sure that its dependedMapTask is executed in all
  *  replicas.
  * - It creates schemas in each worker in a single transaction to store intermediate results.
+ * - It builds and broadcasts the join key filters of the jobs that filter the map
+ *  output of other jobs, see join_key_filter.c.
  * - It iterates all tasks and finds the ones whose dependencies are already executed, and executes them with
  *  adaptive executor logic.
  *
@@ -31,6 +33,7 @@
 
 #include "distributed/adaptive_executor.h"
 #include "distributed/directed_acyclic_graph_execution.h"
+#include "distributed/join_key_filter.h"
 #include "distributed/listutils.h"
 #include "distributed/local_executor.h"
 #include "distributed/metadata_cache.h"
@@ -59,6 +62,8 @@ ExecuteDependentTasks(List *topLevelTasks, Job *topLevelJob)
 	List *allTasks = CreateTaskListForJobTree(topLevelTasks);
 	List *jobIds = ExtractJobsInJobTree(topLevelJob);
 
+	ExecuteJoinKeyFilterTasks(topLevelJob);
+
 	ExecuteTasksInDependencyOrder(allTasks, topLevelTasks, jobIds);
 
 	return jobIds;
@@ -0,0 +1,915 @@
+/*-------------------------------------------------------------------------
+ *
+ * sorted_merge.c
+ *
+ * For multi-shard queries with ORDER BY and LIMIT, the logical optimizer
+ * pushes the sort and the limit (plus offset) down to the worker query, and
+ * the combine query sorts all task results again on the coordinator before
+ * applying the limit. Since the result of each task is already sorted, the
+ * coordinator only needs the first limit + offset rows of a k-way merge of
+ * the task results.
+ *
+ * This file implements a TupleDestination that buffers the result of each
+ * task separately and merges the buffered results into its target
+ * destination while the results arrive. The next tuple of the merge is only
+ * known once every task either has a buffered tuple or has finished, so that
+ * is when merged tuples are emitted. After limit + offset tuples are merged,
+ * the remaining tuples are not needed, which allows a streaming execution to
+ * stop early (see AdvanceStreamingExecution).
+ *
+ * The combine query still runs on top of the merged result, such that its
+ * sort only needs to handle limit + offset rows instead of that many rows
+ * per task.
+ *
+ * If a task returns its rows in a different order than we expect, we fall
+ * back to forwarding all tuples to the target destination and leave the
+ * sorting to the combine query.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "miscadmin.h"
+
+#include "access/htup_details.h"
+#include "catalog/pg_type.h"
+#include "distributed/listutils.h"
+#include "distributed/sorted_merge.h"
+#include "distributed/version_compat.h"
+#include "executor/tuptable.h"
+#include "lib/binaryheap.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/tlist.h"
+#include "utils/hsearch.h"
+#include "utils/sortsupport.h"
+#include "utils/tuplestore.h"
+
+
+/*
+ * SortedMergeTaskResult holds the buffered result of a single task.
+ */
+typedef struct SortedMergeTaskResult
+{
+	/* hash key, the ID of the task that produces the tuples */
+	uint32 taskId;
+
+	/* task that produced the tuples, NULL until the first tuple arrives */
+	Task *task;
+
+	/* received tuples of the task that are not merged yet */
+	Tuplestorestate *tupleStore;
+	int64 bufferedTupleCount;
+
+	/* libpq sizes of the buffered tuples, starting at firstTupleSizeIndex */
+	uint64 *tupleSizeArray;
+	int64 tupleSizeArrayLength;
+	int64 firstTupleSizeIndex;
+
+	/* number of tuples of the task that were kept for the merge */
+	int64 keptTupleCount;
+
+	/* copy of the last tuple received from the task */
+	TupleTableSlot *lastTupleSlot;
+
+	/* next tuple of the task in the merge, and its libpq size */
+	TupleTableSlot *mergeTupleSlot;
+	uint64 mergeTupleSize;
+	bool inMergeHeap;
+
+	/* set once the task does not return any more tuples */
+	bool finished;
+} SortedMergeTaskResult;
+
+
+/*
+ * SortedMergeTupleDestination is a TupleDestination that buffers sorted
+ * task results and merges them into the target destination.
+ */
+typedef struct SortedMergeTupleDestination
+{
+	TupleDestination pub;
+
+	/* destination of tuples */
+	TupleDestination *targetTupleDest;
+	TupleDesc tupleDesc;
+
+	/* sort keys of the worker query */
+	int sortKeyCount;
+	SortSupport sortKeys;
+
+	/* number of rows the combine query needs, i.e. limit + offset */
+	int64 mergeLimit;
+
+	/* number of tuples merged into the target destination */
+	int64 mergedTupleCount;
+
+	/* buffered task results, keyed on the task ID */
+	HTAB *taskResultHash;
+
+	/* task results that have their next tuple in the merge */
+	binaryheap *mergeHeap;
+
+	/* number of unfinished tasks that have no tuple in the merge */
+	int waitingTaskCount;
+
+	/* slot used to compare an incoming tuple */
+	TupleTableSlot *inputTupleSlot;
+
+	/* set once a task returned an unsorted result */
+	bool forwardTuples;
+
+	/* memory context in which the buffers are allocated */
+	MemoryContext mergeContext;
+} SortedMergeTupleDestination;
+
+
+/* GUC, whether the executor merges the sorted results of tasks */
+bool EnableSortedMerge = false;
+
+
+/* forward declarations for local functions */
+static List * MergeableSortClauseList(DistributedPlan *distributedPlan,
+									  int64 *mergeLimit);
+static bool GetConstInt64(Node *node, int64 *value);
+static int ScanColumnNumber(List *targetList, TargetEntry *targetEntry);
+static void SortedMergeTupleDestPutTuple(TupleDestination *self, Task *task,
+										 int placementIndex, int queryNumber,
+										 HeapTuple heapTuple, uint64 tupleLibpqSize);
+static TupleDesc SortedMergeTupleDestTupleDescForQuery(TupleDestination *self,
+													   int queryNumber);
+static void CreateTaskResultBuffer(SortedMergeTupleDestination *mergeDest,
+								   SortedMergeTaskResult *taskResult);
+static void BufferTaskTuple(SortedMergeTaskResult *taskResult, HeapTuple heapTuple,
+							uint64 tupleLibpqSize);
+static void LoadNextMergeTuple(SortedMergeTaskResult *taskResult);
+static void MergeTaskResults(SortedMergeTupleDestination *mergeDest);
+static void ForwardBufferedTuples(SortedMergeTupleDestination *mergeDest);
+static void ReleaseTaskResultBuffers(SortedMergeTupleDestination *mergeDest);
+static int CompareSortedMergeSlots(SortedMergeTupleDestination *mergeDest,
+								   TupleTableSlot *leftSlot,
+								   TupleTableSlot *rightSlot);
+static int CompareSortedMergeTaskResults(Datum left, Datum right, void *arg);
+
+
+/*
+ * CreateSortedMergeTupleDest creates a TupleDestination which merges the
+ * sorted task results of the given plan into targetTupleDest. Returns NULL
+ * if the result of the combine query does not only depend on the first rows
+ * of such a merge.
+ */
+TupleDestination *
+CreateSortedMergeTupleDest(DistributedPlan *distributedPlan,
+						   TupleDestination *targetTupleDest,
+						   TupleDesc tupleDescriptor)
+{
+	int64 mergeLimit = 0;
+	List *sortClauseList = MergeableSortClauseList(distributedPlan, &mergeLimit);
+	if (sortClauseList == NIL)
+	{
+		return NULL;
+	}
+
+	SortedMergeTupleDestination *mergeDest =
+		palloc0(sizeof(SortedMergeTupleDestination));
+
+	List *workerTargetList = distributedPlan->workerJob->jobQuery->targetList;
+	int sortKeyCount = list_length(sortClauseList);
+	SortSupport sortKeys = palloc0(sortKeyCount * sizeof(SortSupportData));
+	int sortKeyIndex = 0;
+
+	SortGroupClause *sortClause = NULL;
+	foreach_ptr(sortClause, sortClauseList)
+	{
+		TargetEntry *targetEntry = get_sortgroupclause_tle(sortClause,
+														   workerTargetList);
+		SortSupport sortKey = &sortKeys[sortKeyIndex];
+
+		sortKey->ssup_cxt = CurrentMemoryContext;
+		sortKey->ssup_collation = exprCollation((Node *) targetEntry->expr);
+		sortKey->ssup_nulls_first = sortClause->nulls_first;
+		sortKey->ssup_attno = ScanColumnNumber(workerTargetList, targetEntry);
+		sortKey->abbreviate = false;
+
+		PrepareSortSupportFromOrderingOp(sortClause->sortop, sortKey);
+
+		sortKeyIndex++;
+	}
+
+	HASHCTL info;
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(uint32);
+	info.entrysize = sizeof(SortedMergeTaskResult);
+	info.hcxt = CurrentMemoryContext;
+	int hashFlags = (HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	mergeDest->taskResultHash = hash_create("Sorted Merge Task Result Hash", 32,
+											&info, hashFlags);
+
+	/*
+	 * Tasks are keyed on their ID, since local execution might run a copy of
+	 * the task. Each task needs a result in the merge, also if it returns no
+	 * tuples.
+	 */
+	List *taskList = distributedPlan->workerJob->taskList;
+
+	Task *task = NULL;
+	foreach_ptr(task, taskList)
+	{
+		bool found = false;
+		SortedMergeTaskResult *taskResult =
+			hash_search(mergeDest->taskResultHash, &task->taskId, HASH_ENTER, &found);
+		if (!found)
+		{
+			taskResult->task = NULL;
+			taskResult->tupleStore = NULL;
+			taskResult->inMergeHeap = false;
+			taskResult->finished = false;
+		}
+	}
+
+	mergeDest->waitingTaskCount = hash_get_num_entries(mergeDest->taskResultHash);
+	mergeDest->mergeHeap = binaryheap_allocate(mergeDest->waitingTaskCount,
+											   CompareSortedMergeTaskResults,
+											   mergeDest);
+	mergeDest->targetTupleDest = targetTupleDest;
+	mergeDest->tupleDesc = tupleDescriptor;
+	mergeDest->sortKeyCount = sortKeyCount;
+	mergeDest->sortKeys = sortKeys;
+	mergeDest->mergeLimit = mergeLimit;
+	mergeDest->mergedTupleCount = 0;
+	mergeDest->inputTupleSlot =
+		MakeSingleTupleTableSlotCompat(tupleDescriptor, &TTSOpsHeapTuple);
+	mergeDest->mergeContext = CurrentMemoryContext;
+	mergeDest->pub.putTuple = SortedMergeTupleDestPutTuple;
+	mergeDest->pub.tupleDescForQuery = SortedMergeTupleDestTupleDescForQuery;
+	mergeDest->pub.tupleDestinationStats = targetTupleDest->tupleDestinationStats;
+
+	return (TupleDestination *) mergeDest;
+}
+
+
+/*
+ * MergeableSortClauseList returns the sort clauses of the worker query if the
+ * combine query of the given plan only sorts the rows of the remote scan by
+ * (a prefix of) the same sort keys and applies a constant limit, and sets
+ * mergeLimit to limit + offset. Returns NIL otherwise.
+ */
+static List *
+MergeableSortClauseList(DistributedPlan *distributedPlan, int64 *mergeLimit)
+{
+	Query *combineQuery = distributedPlan->combineQuery;
+	Job *workerJob = distributedPlan->workerJob;
+
+	if (combineQuery == NULL || workerJob == NULL ||
+		workerJob->dependentJobList != NIL ||
+		list_length(workerJob->taskList) < 2)
+	{
+		return NIL;
+	}
+
+	Query *workerQuery = workerJob->jobQuery;
+	if (workerQuery->commandType != CMD_SELECT || workerQuery->sortClause == NIL ||
+		workerQuery->limitCount == NULL)
+	{
+		return NIL;
+	}
+
+	/* the combine query should not do anything but sorting and limiting */
+	if (combineQuery->sortClause == NIL || combineQuery->hasAggs ||
+		combineQuery->hasWindowFuncs || combineQuery->hasTargetSRFs ||
+		combineQuery->groupClause != NIL || combineQuery->groupingSets != NIL ||
+		combineQuery->distinctClause != NIL || combineQuery->havingQual != NULL ||
+		combineQuery->limitOption == LIMIT_OPTION_WITH_TIES ||
+		list_length(combineQuery->rtable) != 1 ||
+		combineQuery->jointree == NULL || combineQuery->jointree->quals != NULL)
+	{
+		return NIL;
+	}
+
+	int64 limitCount = 0;
+	int64 limitOffset = 0;
+	if (!GetConstInt64(combineQuery->limitCount, &limitCount) ||
+		(combineQuery->limitOffset != NULL &&
+		 !GetConstInt64(combineQuery->limitOffset, &limitOffset)) ||
+		limitCount < 0 || limitOffset < 0 ||
+		limitCount > PG_INT64_MAX - limitOffset)
+	{
+		return NIL;
+	}
+
+	/* there is nothing to merge for LIMIT 0 */
+	if (limitCount == 0)
+	{
+		return NIL;
+	}
+
+	if (list_length(combineQuery->sortClause) > list_length(workerQuery->sortClause))
+	{
+		return NIL;
+	}
+
+	/*
+	 * Each sort key of the combine query should be a column of the remote scan
+	 * that the worker query sorts on in the same position, with the same
+	 * ordering. Extra sort keys of the worker query only break ties.
+	 */
+	ListCell *combineSortCell = NULL;
+	ListCell *workerSortCell = NULL;
+	forboth(combineSortCell, combineQuery->sortClause,
+			workerSortCell, workerQuery->sortClause)
+	{
+		SortGroupClause *combineSortClause = lfirst(combineSortCell);
+		SortGroupClause *workerSortClause = lfirst(workerSortCell);
+
+		TargetEntry *combineTargetEntry =
+			get_sortgroupclause_tle(combineSortClause, combineQuery->targetList);
+		TargetEntry *workerTargetEntry =
+			get_sortgroupclause_tle(workerSortClause, workerQuery->targetList);
+
+		if (!IsA(combineTargetEntry->expr, Var))
+		{
+			return NIL;
+		}
+
+		Var *column = (Var *) combineTargetEntry->expr;
+		if (column->varlevelsup != 0 ||
+			column->varattno != ScanColumnNumber(workerQuery->targetList,
+												 workerTargetEntry) ||
+			combineSortClause->sortop != workerSortClause->sortop ||
+			combineSortClause->nulls_first != workerSortClause->nulls_first)
+		{
+			return NIL;
+		}
+	}
+
+	/* worker sort keys that are not part of the scan cannot be compared */
+	SortGroupClause *sortClause = NULL;
+	foreach_ptr(sortClause, workerQuery->sortClause)
+	{
+		TargetEntry *workerTargetEntry =
+			get_sortgroupclause_tle(sortClause, workerQuery->targetList);
+
+		if (ScanColumnNumber(workerQuery->targetList, workerTargetEntry) ==
+			InvalidAttrNumber)
+		{
+			return NIL;
+		}
+	}
+
+	*mergeLimit = limitCount + limitOffset;
+
+	return workerQuery->sortClause;
+}
+
+
+/*
+ * GetConstInt64 sets value to the value of the given node if it is a
+ * non-NULL bigint constant, and returns whether it is.
+ */
+static bool
+GetConstInt64(Node *node, int64 *value)
+{
+	if (node == NULL || !IsA(node, Const))
+	{
+		return false;
+	}
+
+	Const *constNode = (Const *) node;
+	if (constNode->constisnull || constNode->consttype != INT8OID)
+	{
+		return false;
+	}
+
+	*value = DatumGetInt64(constNode->constvalue);
+
+	return true;
+}
+
+
+/*
+ * ScanColumnNumber returns the attribute number of the column of the remote
+ * scan that corresponds to the given worker target entry, which skips the
+ * junk entries of the worker target list (see RemoteScanTargetList). Returns
+ * InvalidAttrNumber for junk entries.
+ */
+static int
+ScanColumnNumber(List *targetList, TargetEntry *targetEntry)
+{
+	int columnNumber = 0;
+
+	if (targetEntry->resjunk)
+	{
+		return InvalidAttrNumber;
+	}
+
+	TargetEntry *currentEntry = NULL;
+	foreach_ptr(currentEntry, targetList)
+	{
+		if (currentEntry->resjunk)
+		{
+			continue;
+		}
+
+		columnNumber++;
+
+		if (currentEntry == targetEntry)
+		{
+			return columnNumber;
+		}
+	}
+
+	return InvalidAttrNumber;
+}
+
+
+/*
+ * SortedMergeTupleDestPutTuple implements TupleDestination->putTuple for
+ * SortedMergeTupleDestination.
+ */
+static void
+SortedMergeTupleDestPutTuple(TupleDestination *self, Task *task,
+							 int placementIndex, int queryNumber,
+							 HeapTuple heapTuple, uint64 tupleLibpqSize)
+{
+	SortedMergeTupleDestination *mergeDest = (SortedMergeTupleDestination *) self;
+	TupleDestination *targetTupleDest = mergeDest->targetTupleDest;
+
+	if (mergeDest->forwardTuples)
+	{
+		targetTupleDest->putTuple(targetTupleDest, task, placementIndex, queryNumber,
+								  heapTuple, tupleLibpqSize);
+		return;
+	}
+
+	if (mergeDest->mergedTupleCount >= mergeDest->mergeLimit)
+	{
+		/* the combine query does not need more tuples, but we record them */
+		task->totalReceivedTupleData += tupleLibpqSize;
+		return;
+	}
+
+	MemoryContext oldContext = MemoryContextSwitchTo(mergeDest->mergeContext);
+
+	SortedMergeTaskResult *taskResult =
+		hash_search(mergeDest->taskResultHash, &task->taskId, HASH_FIND, NULL);
+	if (taskResult == NULL)
+	{
+		ereport(ERROR, (errmsg("could not find the result of task %u in the "
+							   "sorted merge", task->taskId)));
+	}
+
+	if (taskResult->tupleStore == NULL)
+	{
+		CreateTaskResultBuffer(mergeDest, taskResult);
+	}
+
+	/* in case the result turns out to be unsorted, give up on merging */
+	if (!TupIsNull(taskResult->lastTupleSlot))
+	{
+		TupleTableSlot *inputTupleSlot = mergeDest->inputTupleSlot;
+		ExecStoreHeapTuple(heapTuple, inputTupleSlot, false);
+
+		int compareResult = CompareSortedMergeSlots(mergeDest, inputTupleSlot,
+													taskResult->lastTupleSlot);
+
+		ExecClearTuple(inputTupleSlot);
+
+		if (compareResult < 0)
+		{
+			ereport(DEBUG2, (errmsg("task results are not sorted, skipping the "
+									"sorted merge")));
+
+			ForwardBufferedTuples(mergeDest);
+			mergeDest->forwardTuples = true;
+
+			MemoryContextSwitchTo(oldContext);
+
+			targetTupleDest->putTuple(targetTupleDest, task, placementIndex,
+									  queryNumber, heapTuple, tupleLibpqSize);
+			return;
+		}
+	}
+
+	ExecStoreHeapTuple(heap_copytuple(heapTuple), taskResult->lastTupleSlot, true);
+
+	/*
+	 * Tuples beyond the first limit + offset tuples of a task sort after
+	 * those tuples, so the combine query does not need them.
+	 */
+	if (taskResult->keptTupleCount >= mergeDest->mergeLimit)
+	{
+		task->totalReceivedTupleData += tupleLibpqSize;
+
+		MemoryContextSwitchTo(oldContext);
+		return;
+	}
+
+	taskResult->task = task;
+	taskResult->keptTupleCount++;
+
+	BufferTaskTuple(taskResult, heapTuple, tupleLibpqSize);
+
+	if (!taskResult->inMergeHeap)
+	{
+		LoadNextMergeTuple(taskResult);
+		binaryheap_add(mergeDest->mergeHeap, PointerGetDatum(taskResult));
+		taskResult->inMergeHeap = true;
+		mergeDest->waitingTaskCount--;
+
+		MergeTaskResults(mergeDest);
+	}
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * SortedMergeTupleDestTupleDescForQuery implements TupleDestination->
+ * tupleDescForQuery for SortedMergeTupleDestination.
+ */
+static TupleDesc
+SortedMergeTupleDestTupleDescForQuery(TupleDestination *self, int queryNumber)
+{
+	SortedMergeTupleDestination *mergeDest = (SortedMergeTupleDestination *) self;
+	TupleDestination *targetTupleDest = mergeDest->targetTupleDest;
+
+	return targetTupleDest->tupleDescForQuery(targetTupleDest, queryNumber);
+}
+
+
+/*
+ * CreateTaskResultBuffer creates the buffer for the tuples of the given task
+ * result.
+ */
+static void
+CreateTaskResultBuffer(SortedMergeTupleDestination *mergeDest,
+					   SortedMergeTaskResult *taskResult)
+{
+	taskResult->tupleStore = tuplestore_begin_heap(false, false, work_mem);
+	taskResult->bufferedTupleCount = 0;
+
+	/* allow freeing the tuples once they are merged */
+	tuplestore_set_eflags(taskResult->tupleStore, 0);
+
+	taskResult->tupleSizeArrayLength = 16;
+	taskResult->tupleSizeArray =
+		palloc(taskResult->tupleSizeArrayLength * sizeof(uint64));
+	taskResult->firstTupleSizeIndex = 0;
+	taskResult->keptTupleCount = 0;
+
+	taskResult->lastTupleSlot =
+		MakeSingleTupleTableSlotCompat(mergeDest->tupleDesc, &TTSOpsHeapTuple);
+	taskResult->mergeTupleSlot =
+		MakeSingleTupleTableSlotCompat(mergeDest->tupleDesc, &TTSOpsMinimalTuple);
+	taskResult->mergeTupleSize = 0;
+}
+
+
+/*
+ * BufferTaskTuple appends a tuple and its libpq size to the buffer of the
+ * given task result.
+ */
+static void
+BufferTaskTuple(SortedMergeTaskResult *taskResult, HeapTuple heapTuple,
+				uint64 tupleLibpqSize)
+{
+	int64 tupleSizeIndex = taskResult->firstTupleSizeIndex +
+						   taskResult->bufferedTupleCount;
+
+	if (tupleSizeIndex >= taskResult->tupleSizeArrayLength)
+	{
+		taskResult->tupleSizeArrayLength *= 2;
+		taskResult->tupleSizeArray =
+			repalloc(taskResult->tupleSizeArray,
+					 taskResult->tupleSizeArrayLength * sizeof(uint64));
+	}
+
+	tuplestore_puttuple(taskResult->tupleStore, heapTuple);
+	taskResult->tupleSizeArray[tupleSizeIndex] = tupleLibpqSize;
+	taskResult->bufferedTupleCount++;
+}
+
+
+/*
+ * LoadNextMergeTuple moves the oldest buffered tuple of the given task result
+ * into its merge slot.
+ */
+static void
+LoadNextMergeTuple(SortedMergeTaskResult *taskResult)
+{
+	Assert(taskResult->bufferedTupleCount > 0);
+
+	/* copy the tuple, since the tuple store might free it when it grows */
+	tuplestore_gettupleslot(taskResult->tupleStore, true, true,
+							taskResult->mergeTupleSlot);
+
+	taskResult->mergeTupleSize =
+		taskResult->tupleSizeArray[taskResult->firstTupleSizeIndex];
+	taskResult->firstTupleSizeIndex++;
+	taskResult->bufferedTupleCount--;
+
+	if (taskResult->bufferedTupleCount == 0)
+	{
+		/* free the tuples that we read */
+		tuplestore_trim(taskResult->tupleStore);
+		taskResult->firstTupleSizeIndex = 0;
+	}
+}
+
+
+/*
+ * MergeTaskResults passes the tuples of the merge to the target destination
+ * for as long as the next tuple is known, which is the case when every task
+ * that did not finish has a tuple in the merge heap. It stops once limit +
+ * offset tuples are merged.
+ */
+static void
+MergeTaskResults(SortedMergeTupleDestination *mergeDest)
+{
+	TupleDestination *targetTupleDest = mergeDest->targetTupleDest;
+	binaryheap *mergeHeap = mergeDest->mergeHeap;
+
+	while (mergeDest->waitingTaskCount == 0 && !binaryheap_empty(mergeHeap) &&
+		   mergeDest->mergedTupleCount < mergeDest->mergeLimit)
+	{
+		SortedMergeTaskResult *taskResult =
+			(SortedMergeTaskResult *) DatumGetPointer(binaryheap_first(mergeHeap));
+
+		bool shouldFree = false;
+		HeapTuple heapTuple = ExecFetchSlotHeapTuple(taskResult->mergeTupleSlot,
+													 false, &shouldFree);
+
+		targetTupleDest->putTuple(targetTupleDest, taskResult->task, 0, 0,
+								  heapTuple, taskResult->mergeTupleSize);
+
+		if (shouldFree)
+		{
+			heap_freetuple(heapTuple);
+		}
+
+		mergeDest->mergedTupleCount++;
+
+		if (taskResult->bufferedTupleCount > 0)
+		{
+			LoadNextMergeTuple(taskResult);
+			binaryheap_replace_first(mergeHeap, PointerGetDatum(taskResult));
+		}
+		else
+		{
+			/* we need the next tuple of the task before we can continue */
+			binaryheap_remove_first(mergeHeap);
+			ExecClearTuple(taskResult->mergeTupleSlot);
+			taskResult->inMergeHeap = false;
+
+			if (!taskResult->finished)
+			{
+				mergeDest->waitingTaskCount++;
+			}
+		}
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	if (mergeDest->mergedTupleCount >= mergeDest->mergeLimit)
+	{
+		ReleaseTaskResultBuffers(mergeDest);
+	}
+}
+
+
+/*
+ * SortedMergeTaskFinished lets the SortedMergeTupleDestination know that the
+ * given task does not return any more tuples, which allows merging the tuples
+ * of the other tasks without waiting for it.
+ */
+void
+SortedMergeTaskFinished(TupleDestination *sortedMergeTupleDest, Task *task)
+{
+	SortedMergeTupleDestination *mergeDest =
+		(SortedMergeTupleDestination *) sortedMergeTupleDest;
+
+	if (mergeDest->forwardTuples ||
+		mergeDest->mergedTupleCount >= mergeDest->mergeLimit)
+	{
+		return;
+	}
+
+	SortedMergeTaskResult *taskResult =
+		hash_search(mergeDest->taskResultHash, &task->taskId, HASH_FIND, NULL);
+	if (taskResult == NULL || taskResult->finished)
+	{
+		return;
+	}
+
+	MemoryContext oldContext = MemoryContextSwitchTo(mergeDest->mergeContext);
+
+	taskResult->finished = true;
+
+	if (!taskResult->inMergeHeap)
+	{
+		mergeDest->waitingTaskCount--;
+
+		MergeTaskResults(mergeDest);
+	}
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * SortedMergeReachedLimit returns whether the given SortedMergeTupleDestination
+ * merged all the tuples that the combine query needs.
+ */
+bool
+SortedMergeReachedLimit(TupleDestination *sortedMergeTupleDest)
+{
+	SortedMergeTupleDestination *mergeDest =
+		(SortedMergeTupleDestination *) sortedMergeTupleDest;
+
+	return !mergeDest->forwardTuples &&
+		   mergeDest->mergedTupleCount >= mergeDest->mergeLimit;
+}
+
+
+/*
+ * ForwardBufferedTuples forwards all buffered tuples to the target
+ * destination without merging them, and releases the buffers.
+ */
+static void
+ForwardBufferedTuples(SortedMergeTupleDestination *mergeDest)
+{
+	TupleDestination *targetTupleDest = mergeDest->targetTupleDest;
+
+	HASH_SEQ_STATUS status;
+	hash_seq_init(&status, mergeDest->taskResultHash);
+
+	SortedMergeTaskResult *taskResult = NULL;
+	while ((taskResult = hash_seq_search(&status)) != NULL)
+	{
+		if (taskResult->tupleStore == NULL)
+		{
+			continue;
+		}
+
+		while (taskResult->inMergeHeap)
+		{
+			bool shouldFree = false;
+			HeapTuple heapTuple = ExecFetchSlotHeapTuple(taskResult->mergeTupleSlot,
+														 false, &shouldFree);
+
+			targetTupleDest->putTuple(targetTupleDest, taskResult->task, 0, 0,
+									  heapTuple, taskResult->mergeTupleSize);
+
+			if (shouldFree)
+			{
+				heap_freetuple(heapTuple);
+			}
+
+			if (taskResult->bufferedTupleCount > 0)
+			{
+				LoadNextMergeTuple(taskResult);
+			}
+			else
+			{
+				ExecClearTuple(taskResult->mergeTupleSlot);
+				taskResult->inMergeHeap = false;
+			}
+		}
+	}
+
+	binaryheap_reset(mergeDest->mergeHeap);
+
+	ReleaseTaskResultBuffers(mergeDest);
+}
+
+
+/*
+ * ReleaseTaskResultBuffers frees the tuple stores of the task results, and
+ * records the tuples that were not merged as received data of their task.
+ */
+static void
+ReleaseTaskResultBuffers(SortedMergeTupleDestination *mergeDest)
+{
+	HASH_SEQ_STATUS status;
+	hash_seq_init(&status, mergeDest->taskResultHash);
+
+	SortedMergeTaskResult *taskResult = NULL;
+	while ((taskResult = hash_seq_search(&status)) != NULL)
+	{
+		if (taskResult->tupleStore == NULL)
+		{
+			continue;
+		}
+
+		uint64 unmergedTupleDataSize = 0;
+		if (taskResult->inMergeHeap)
+		{
+			unmergedTupleDataSize += taskResult->mergeTupleSize;
+			taskResult->inMergeHeap = false;
+		}
+
+		int64 lastTupleSizeIndex = taskResult->firstTupleSizeIndex +
+								   taskResult->bufferedTupleCount;
+		for (int64 tupleSizeIndex = taskResult->firstTupleSizeIndex;
+			 tupleSizeIndex < lastTupleSizeIndex; tupleSizeIndex++)
+		{
+			unmergedTupleDataSize += taskResult->tupleSizeArray[tupleSizeIndex];
+		}
+
+		if (taskResult->task != NULL)
+		{
+			taskResult->task->totalReceivedTupleData += unmergedTupleDataSize;
+		}
+
+		tuplestore_end(taskResult->tupleStore);
+		taskResult->tupleStore = NULL;
+		taskResult->bufferedTupleCount = 0;
+	}
+}
+
+
+/*
+ * FinishSortedMerge merges the remaining buffered task results of the given
+ * SortedMergeTupleDestination into its target destination once all tasks
+ * are done, stopping once limit + offset tuples are merged.
+ */
+void
+FinishSortedMerge(TupleDestination *sortedMergeTupleDest)
+{
+	SortedMergeTupleDestination *mergeDest =
+		(SortedMergeTupleDestination *) sortedMergeTupleDest;
+
+	if (mergeDest->forwardTuples)
+	{
+		/* tuples were already forwarded */
+		return;
+	}
+
+	MemoryContext oldContext = MemoryContextSwitchTo(mergeDest->mergeContext);
+
+	/* tasks that ran locally did not report that they finished */
+	HASH_SEQ_STATUS status;
+	hash_seq_init(&status, mergeDest->taskResultHash);
+
+	SortedMergeTaskResult *taskResult = NULL;
+	while ((taskResult = hash_seq_search(&status)) != NULL)
+	{
+		taskResult->finished = true;
+	}
+
+	mergeDest->waitingTaskCount = 0;
+
+	MergeTaskResults(mergeDest);
+	ReleaseTaskResultBuffers(mergeDest);
+
+	MemoryContextSwitchTo(oldContext);
+}
+
+
+/*
+ * CompareSortedMergeSlots compares the tuples in the given slots on the sort
+ * keys of the SortedMergeTupleDestination.
+ */
+static int
+CompareSortedMergeSlots(SortedMergeTupleDestination *mergeDest,
+						TupleTableSlot *leftSlot, TupleTableSlot *rightSlot)
+{
+	for (int sortKeyIndex = 0; sortKeyIndex < mergeDest->sortKeyCount; sortKeyIndex++)
+	{
+		SortSupport sortKey = &mergeDest->sortKeys[sortKeyIndex];
+		bool leftIsNull = false;
+		bool rightIsNull = false;
+
+		Datum leftDatum = slot_getattr(leftSlot, sortKey->ssup_attno, &leftIsNull);
+		Datum rightDatum = slot_getattr(rightSlot, sortKey->ssup_attno, &rightIsNull);
+
+		int compareResult = ApplySortComparator(leftDatum, leftIsNull,
+												rightDatum, rightIsNull, sortKey);
+		if (compareResult != 0)
+		{
+			return compareResult;
+		}
+	}
+
+	return 0;
+}
+
+
+/*
+ * CompareSortedMergeTaskResults compares the current tuples of two task
+ * results for the merge heap. Since binaryheap is a max-heap, the result is
+ * inverted to get the smallest tuple first.
+ */
+static int
+CompareSortedMergeTaskResults(Datum left, Datum right, void *arg)
+{
+	SortedMergeTupleDestination *mergeDest = (SortedMergeTupleDestination *) arg;
+	SortedMergeTaskResult *leftResult = (SortedMergeTaskResult *) DatumGetPointer(left);
+	SortedMergeTaskResult *rightResult =
+		(SortedMergeTaskResult *) DatumGetPointer(right);
+
+	return -CompareSortedMergeSlots(mergeDest, leftResult->mergeTupleSlot,
+									rightResult->mergeTupleSlot);
+}
@@ -1080,7 +1080,7 @@ CitusCreateAlterColumnarTableSet(char *qualifiedRelationName,
 					 "columnar.chunk_group_row_limit = %d, "
 					 "columnar.stripe_row_limit = %lu, "
 					 "columnar.compression_level = %d, "
-					 "columnar.compression = %s);",
+					 "columnar.compression = %s",
 					 qualifiedRelationName,
 					 options->chunkRowCount,
 					 options->stripeRowCount,
@@ -1088,6 +1088,20 @@ CitusCreateAlterColumnarTableSet(char *qualifiedRelationName,
 					 quote_literal_cstr(extern_CompressionTypeStr(
 											options->compressionType)));
 
+	if (options->bloomFilterColumns != NULL)
+	{
+		appendStringInfo(&buf, ", columnar.bloom_filter_columns = %s",
+						 quote_literal_cstr(options->bloomFilterColumns));
+	}
+
+	if (options->sortKey != NULL)
+	{
+		appendStringInfo(&buf, ", columnar.sort_key = %s",
+						 quote_literal_cstr(options->sortKey));
+	}
+
+	appendStringInfoString(&buf, ");");
+
 	return buf.data;
 }
 
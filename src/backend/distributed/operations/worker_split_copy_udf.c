@@ -258,7 +258,8 @@ CreatePartitionedSplitCopyDestReceiver(EState *estate,
 		shardSearchInfo,
 		shardCopyDestReceivers,
 		true /* lazyStartup */,
-		false /* allowNullPartitionColumnValues */);
+		false /* allowNullPartitionColumnValues */,
+		NULL /* joinKeyFilter */);
 
 	return splitCopyDestReceiver;
 }
@@ -20,9 +20,13 @@
 #include "distributed/metadata_cache.h"
 #include "distributed/combine_query_planner.h"
 #include "distributed/multi_physical_planner.h"
+#include "distributed/parallel_combine.h"
 #include "nodes/makefuncs.h"
 #include "nodes/nodeFuncs.h"
 #include "optimizer/clauses.h"
+#include "optimizer/cost.h"
+#include "optimizer/optimizer.h"
+#include "optimizer/pathnode.h"
 #include "optimizer/planner.h"
 #include "rewrite/rewriteManip.h"
 
@@ -30,6 +34,9 @@ static List * RemoteScanTargetList(List *workerTargetList);
 static PlannedStmt * BuildSelectStatementViaStdPlanner(Query *combineQuery,
 													   List *remoteScanTargetList,
 													   CustomScan *remoteScan);
+static PlannedStmt * PlanCombineQueryViaStdPlanner(Query *combineQuery,
+												   CustomScan *remoteScan,
+												   int cursorOptions);
 static bool FindCitusExtradataContainerRTE(Node *node, RangeTblEntry **result);
 
 static Plan * CitusCustomScanPathPlan(PlannerInfo *root, RelOptInfo *rel,
@@ -155,6 +162,44 @@ CreateCitusCustomScanPath(PlannerInfo *root, RelOptInfo *relOptInfo,
 }
 
 
+/*
+ * AddPartialCitusCustomScanPath adds a partial path for the custom scan to the
+ * relation when we plan the combine query with parallelism, such that the
+ * standard planner can consider a parallel aggregate on top of it. The plan
+ * of the partial path is converted into a parallel combine afterwards, see
+ * FinalizeParallelCombinePlan.
+ */
+void
+AddPartialCitusCustomScanPath(PlannerInfo *root, RelOptInfo *relOptInfo,
+							  Index restrictionIndex, RangeTblEntry *rte,
+							  CustomScan *remoteScan)
+{
+	/*
+	 * The standard planner only considers parallelism for the relation when it
+	 * plans with CURSOR_OPT_PARALLEL_OK and the quals and columns of the remote
+	 * scan are parallel safe.
+	 */
+	if (MaxParallelWorkersPerCombine == 0 || !relOptInfo->consider_parallel)
+	{
+		return;
+	}
+
+	int parallelWorkers = Min(MaxParallelWorkersPerCombine,
+							  max_parallel_workers_per_gather);
+
+	Path *partialPath = CreateCitusCustomScanPath(root, relOptInfo, restrictionIndex,
+												  rte, remoteScan);
+	partialPath->parallel_aware = true;
+	partialPath->parallel_safe = true;
+	partialPath->parallel_workers = parallelWorkers;
+
+	/* the rows of a partial path are the rows of a single participant */
+	partialPath->rows = clamp_row_est(partialPath->rows / (parallelWorkers + 1));
+
+	add_partial_path(relOptInfo, partialPath);
+}
+
+
 /*
  * CitusCustomScanPathPlan is called for the CitusCustomScanPath node in the best_path
  * after the postgres planner has evaluated all possible paths.
@@ -286,6 +331,44 @@ BuildSelectStatementViaStdPlanner(Query *combineQuery, List *remoteScanTargetLis
 		elog(logCombineQueryLevel, "combine query: %s", queryString->data);
 	}
 
+	int cursorOptions = 0;
+	Query *serialCombineQuery = NULL;
+	List *remoteScanQual = list_copy(remoteScan->scan.plan.qual);
+
+	if (ShouldPlanParallelCombine(combineQuery))
+	{
+		/* the planner scribbles on the query, keep a copy in case we replan */
+		serialCombineQuery = copyObject(combineQuery);
+		cursorOptions |= CURSOR_OPT_PARALLEL_OK;
+	}
+
+	PlannedStmt *standardStmt = PlanCombineQueryViaStdPlanner(combineQuery, remoteScan,
+															  cursorOptions);
+
+	if (serialCombineQuery != NULL &&
+		!FinalizeParallelCombinePlan(standardStmt, remoteScan))
+	{
+		/* we cannot execute the parallel plan, undo the changes to the remote scan */
+		remoteScan->custom_scan_tlist = copyObject(remoteScanTargetList);
+		remoteScan->scan.plan.targetlist = copyObject(remoteScanTargetList);
+		remoteScan->scan.plan.qual = remoteScanQual;
+
+		standardStmt = PlanCombineQueryViaStdPlanner(serialCombineQuery, remoteScan, 0);
+	}
+
+	return standardStmt;
+}
+
+
+/*
+ * PlanCombineQueryViaStdPlanner plans the combine query with the standard
+ * planner, which replaces the citus_extradata_container call with the
+ * remote scan.
+ */
+static PlannedStmt *
+PlanCombineQueryViaStdPlanner(Query *combineQuery, CustomScan *remoteScan,
+							  int cursorOptions)
+{
 	PlannedStmt *standardStmt = NULL;
 	PG_TRY();
 	{
@@ -295,7 +378,7 @@ BuildSelectStatementViaStdPlanner(Query *combineQuery, List *remoteScanTargetLis
 		ReplaceCitusExtraDataContainer = true;
 		ReplaceCitusExtraDataContainerWithCustomScan = remoteScan;
 
-		standardStmt = standard_planner_compat(combineQuery, 0, NULL);
+		standardStmt = standard_planner_compat(combineQuery, cursorOptions, NULL);
 
 		ReplaceCitusExtraDataContainer = false;
 		ReplaceCitusExtraDataContainerWithCustomScan = NULL;
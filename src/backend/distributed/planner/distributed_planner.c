@@ -1763,6 +1763,11 @@ multi_relation_restriction_hook(PlannerInfo *root, RelOptInfo *relOptInfo,
 
 		/* replace all paths with our custom scan and recalculate cheapest */
 		relOptInfo->pathlist = list_make1(path);
+		relOptInfo->partial_pathlist = NIL;
+
+		AddPartialCitusCustomScanPath(root, relOptInfo, restrictionIndex, rte,
+									  ReplaceCitusExtraDataContainerWithCustomScan);
+
 		set_cheapest(relOptInfo);
 
 		return;
@@ -4,6 +4,12 @@
  *
  * Local plan cache related functions
  *
+ * Plans of single shard queries in prepared statements are cached in the
+ * distributed plan (see CacheLocalPlanForShardQuery). In addition, the local
+ * executor can cache the plans of other shard queries in a backend-local,
+ * bounded LRU cache keyed on the shard query string, which avoids planning
+ * the same shard queries of multi-shard and repeated queries over and over.
+ *
  * Copyright (c) Citus Data, Inc.
  *-------------------------------------------------------------------------
  */
@@ -20,8 +26,46 @@
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_executor.h"
 #include "distributed/version_compat.h"
+#include "catalog/namespace.h"
+#include "common/hashfn.h"
+#include "lib/ilist.h"
+#include "miscadmin.h"
 #include "optimizer/optimizer.h"
 #include "optimizer/clauses.h"
+#include "storage/lmgr.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/syscache.h"
+
+
+/*
+ * LocalShardPlanCacheEntry holds the plan of a shard query, keyed on the hash
+ * of its cache key.
+ */
+typedef struct LocalShardPlanCacheEntry
+{
+	uint32 keyHash;
+
+	/* full cache key, to detect hash collisions */
+	char *cacheKey;
+
+	PlannedStmt *localPlan;
+
+	/* memory context that holds all of the above */
+	MemoryContext context;
+
+	/* membership in the list of entries, most recently used first */
+	dlist_node lruNode;
+} LocalShardPlanCacheEntry;
+
+
+/* GUC, maximum number of shard query plans cached by the local executor */
+int MaxCachedLocalPlans = 0;
+
+static MemoryContext LocalShardPlanCacheContext = NULL;
+static HTAB *LocalShardPlanCacheHash = NULL;
+static dlist_head LocalShardPlanLRUList = DLIST_STATIC_INIT(LocalShardPlanLRUList);
 
 
 static Query * GetLocalShardQueryForCache(Query *jobQuery, Task *task,
@@ -30,6 +74,13 @@ static char * DeparseLocalShardQuery(Query *jobQuery, List *relationShardList,
 									 Oid anchorDistributedTableId, int64 anchorShardId);
 static int ExtractParameterTypesForParamListInfo(ParamListInfo originalParamListInfo,
 												 Oid **parameterTypes);
+static void InitializeLocalShardPlanCache(void);
+static char * LocalShardPlanCacheKey(const char *shardQueryString);
+static LocalShardPlanCacheEntry * LookupLocalShardPlanCacheEntry(const char *cacheKey);
+static void RemoveLocalShardPlanCacheEntry(LocalShardPlanCacheEntry *entry);
+static void InvalidateLocalShardPlansForRelation(Datum argument, Oid relationId);
+static void InvalidateAllLocalShardPlans(Datum argument, int cacheId,
+										 uint32 hashValue);
 
 /*
  * CacheLocalPlanForShardQuery replaces the relation OIDs in the job query
@@ -330,3 +381,255 @@ IsLocalPlanCachingSupported(Job *currentJob, DistributedPlan *originalDistribute
 
 	return true;
 }
+
+
+/*
+ * GetCachedLocalShardPlan returns a copy of the cached plan for the given
+ * shard query string, after acquiring the locks on the relations in the plan,
+ * or NULL if there is no (longer a) cached plan.
+ *
+ * Only queries without parameters can be served from this cache, since the
+ * planner might use the values of parameters when planning.
+ */
+PlannedStmt *
+GetCachedLocalShardPlan(const char *shardQueryString)
+{
+	if (MaxCachedLocalPlans <= 0)
+	{
+		return NULL;
+	}
+
+	InitializeLocalShardPlanCache();
+
+	char *cacheKey = LocalShardPlanCacheKey(shardQueryString);
+
+	LocalShardPlanCacheEntry *entry = LookupLocalShardPlanCacheEntry(cacheKey);
+	if (entry == NULL)
+	{
+		return NULL;
+	}
+
+	/*
+	 * Processing invalidations, e.g. while acquiring locks below or during
+	 * execution, might remove the entry, so we execute a copy of the plan.
+	 */
+	PlannedStmt *localPlan = copyObject(entry->localPlan);
+
+	dlist_delete(&entry->lruNode);
+	dlist_push_head(&LocalShardPlanLRUList, &entry->lruNode);
+
+	RangeTblEntry *rangeTableEntry = NULL;
+	foreach_ptr(rangeTableEntry, localPlan->rtable)
+	{
+		if (rangeTableEntry->rtekind == RTE_RELATION)
+		{
+			LockRelationOid(rangeTableEntry->relid, rangeTableEntry->rellockmode);
+		}
+	}
+
+	/* the relations might have changed before we acquired the locks */
+	if (LookupLocalShardPlanCacheEntry(cacheKey) == NULL)
+	{
+		return NULL;
+	}
+
+	ereport(DEBUG4, (errmsg("using cached local plan for shard query")));
+
+	return localPlan;
+}
+
+
+/*
+ * CacheLocalShardPlan stores a copy of the plan for the given shard query
+ * string in the cache, evicting the least recently used plan if the cache
+ * is full.
+ */
+void
+CacheLocalShardPlan(const char *shardQueryString, PlannedStmt *localPlan)
+{
+	if (MaxCachedLocalPlans <= 0 || localPlan->transientPlan)
+	{
+		/* transient plans are only valid within the current transaction */
+		return;
+	}
+
+	InitializeLocalShardPlanCache();
+
+	char *cacheKey = LocalShardPlanCacheKey(shardQueryString);
+	uint32 keyHash = hash_bytes((const unsigned char *) cacheKey, strlen(cacheKey));
+	bool found = false;
+
+	hash_search(LocalShardPlanCacheHash, &keyHash, HASH_FIND, &found);
+	if (found)
+	{
+		/* a plan with the same key hash is already cached */
+		return;
+	}
+
+	while (hash_get_num_entries(LocalShardPlanCacheHash) >= MaxCachedLocalPlans &&
+		   !dlist_is_empty(&LocalShardPlanLRUList))
+	{
+		LocalShardPlanCacheEntry *leastRecentlyUsedEntry =
+			dlist_container(LocalShardPlanCacheEntry, lruNode,
+							dlist_tail_node(&LocalShardPlanLRUList));
+
+		RemoveLocalShardPlanCacheEntry(leastRecentlyUsedEntry);
+	}
+
+	MemoryContext entryContext = AllocSetContextCreate(LocalShardPlanCacheContext,
+													   "Local Shard Plan",
+													   ALLOCSET_SMALL_SIZES);
+	MemoryContext oldContext = MemoryContextSwitchTo(entryContext);
+
+	LocalShardPlanCacheEntry *entry =
+		hash_search(LocalShardPlanCacheHash, &keyHash, HASH_ENTER, &found);
+
+	entry->cacheKey = pstrdup(cacheKey);
+	entry->localPlan = copyObject(localPlan);
+	entry->context = entryContext;
+
+	MemoryContextSwitchTo(oldContext);
+
+	dlist_push_head(&LocalShardPlanLRUList, &entry->lruNode);
+}
+
+
+/*
+ * LocalShardPlanCacheKey returns the key under which the plan of the given
+ * shard query string is cached. Besides the query string, the plan depends
+ * on the current user, due to row level security policies, and on the search
+ * path, which determines the objects that unqualified names refer to.
+ */
+static char *
+LocalShardPlanCacheKey(const char *shardQueryString)
+{
+	StringInfo cacheKey = makeStringInfo();
+
+	appendStringInfo(cacheKey, "%u\n%s\n%s", GetUserId(), namespace_search_path,
+					 shardQueryString);
+
+	return cacheKey->data;
+}
+
+
+/*
+ * InitializeLocalShardPlanCache creates the memory context and hash of the
+ * cache, and registers the callbacks that remove stale plans.
+ */
+static void
+InitializeLocalShardPlanCache(void)
+{
+	static bool registeredInvalidationCallbacks = false;
+
+	if (!registeredInvalidationCallbacks)
+	{
+		/* similar to the plan cache of Postgres, see InitPlanCache() */
+		CacheRegisterRelcacheCallback(InvalidateLocalShardPlansForRelation, (Datum) 0);
+		CacheRegisterSyscacheCallback(PROCOID, InvalidateAllLocalShardPlans, (Datum) 0);
+		CacheRegisterSyscacheCallback(TYPEOID, InvalidateAllLocalShardPlans, (Datum) 0);
+		CacheRegisterSyscacheCallback(NAMESPACEOID, InvalidateAllLocalShardPlans,
+									  (Datum) 0);
+		CacheRegisterSyscacheCallback(OPEROID, InvalidateAllLocalShardPlans, (Datum) 0);
+		CacheRegisterSyscacheCallback(AMOPOPID, InvalidateAllLocalShardPlans,
+									  (Datum) 0);
+		registeredInvalidationCallbacks = true;
+	}
+
+	if (LocalShardPlanCacheHash != NULL)
+	{
+		return;
+	}
+
+	LocalShardPlanCacheContext = AllocSetContextCreate(CacheMemoryContext,
+													   "Local Shard Plan Cache",
+													   ALLOCSET_DEFAULT_SIZES);
+
+	HASHCTL info;
+	memset(&info, 0, sizeof(info));
+	info.keysize = sizeof(uint32);
+	info.entrysize = sizeof(LocalShardPlanCacheEntry);
+	info.hcxt = LocalShardPlanCacheContext;
+	int hashFlags = (HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	LocalShardPlanCacheHash = hash_create("Local Shard Plan Cache Hash", 64, &info,
+										  hashFlags);
+}
+
+
+/*
+ * LookupLocalShardPlanCacheEntry returns the cache entry for the given key,
+ * or NULL if there is none.
+ */
+static LocalShardPlanCacheEntry *
+LookupLocalShardPlanCacheEntry(const char *cacheKey)
+{
+	uint32 keyHash = hash_bytes((const unsigned char *) cacheKey, strlen(cacheKey));
+	bool found = false;
+
+	LocalShardPlanCacheEntry *entry =
+		hash_search(LocalShardPlanCacheHash, &keyHash, HASH_FIND, &found);
+	if (!found || strcmp(entry->cacheKey, cacheKey) != 0)
+	{
+		return NULL;
+	}
+
+	return entry;
+}
+
+
+/*
+ * RemoveLocalShardPlanCacheEntry removes the entry from the cache and frees
+ * its memory.
+ */
+static void
+RemoveLocalShardPlanCacheEntry(LocalShardPlanCacheEntry *entry)
+{
+	MemoryContext entryContext = entry->context;
+
+	dlist_delete(&entry->lruNode);
+
+	hash_search(LocalShardPlanCacheHash, &entry->keyHash, HASH_REMOVE, NULL);
+	MemoryContextDelete(entryContext);
+}
+
+
+/*
+ * InvalidateLocalShardPlansForRelation removes the cached plans that depend
+ * on the invalidated relation, or all plans when all relations are
+ * invalidated.
+ */
+static void
+InvalidateLocalShardPlansForRelation(Datum argument, Oid relationId)
+{
+	if (LocalShardPlanCacheHash == NULL ||
+		hash_get_num_entries(LocalShardPlanCacheHash) == 0)
+	{
+		return;
+	}
+
+	dlist_mutable_iter iter;
+	dlist_foreach_modify(iter, &LocalShardPlanLRUList)
+	{
+		LocalShardPlanCacheEntry *entry =
+			dlist_container(LocalShardPlanCacheEntry, lruNode, iter.cur);
+
+		if (relationId == InvalidOid ||
+			list_member_oid(entry->localPlan->relationOids, relationId))
+		{
+			RemoveLocalShardPlanCacheEntry(entry);
+		}
+	}
+}
+
+
+/*
+ * InvalidateAllLocalShardPlans removes all cached plans when a function,
+ * type, or other object that plans might depend on changes. Unlike the plan
+ * cache of Postgres, we do not track the individual objects a plan depends on,
+ * since such changes are rare.
+ */
+static void
+InvalidateAllLocalShardPlans(Datum argument, int cacheId, uint32 hashValue)
+{
+	InvalidateLocalShardPlansForRelation(argument, InvalidOid);
+}
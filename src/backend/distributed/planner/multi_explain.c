@@ -523,6 +523,14 @@ ExplainMapMergeJob(MapMergeJob *mapMergeJob, ExplainState *es)
 	ExplainPropertyInteger("Map Task Count", NULL, mapTaskCount, es);
 	ExplainPropertyInteger("Merge Task Count", NULL, mergeTaskCount, es);
 
+	if (mapMergeJob->buildJoinKeyFilter)
+	{
+		int joinKeyFilterTaskCount = list_length(mapMergeJob->joinKeyFilterTaskList);
+
+		ExplainPropertyInteger("Join Key Filter Task Count", NULL,
+							   joinKeyFilterTaskCount, es);
+	}
+
 	if (dependentJobCount > 0)
 	{
 		ExplainOpenGroup("Dependent Jobs", "Dependent Jobs", false, es);
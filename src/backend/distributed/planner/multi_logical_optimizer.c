@@ -58,11 +58,14 @@
 #include "utils/lsyscache.h"
 #include "utils/rel.h"
 #include "utils/syscache.h"
+#include "utils/typcache.h"
 
 /* Config variable managed via guc.c */
 int LimitClauseRowFetchCount = -1; /* number of rows to fetch from each task */
 double CountDistinctErrorRate = 0.0; /* precision of count(distinct) approximate */
+bool EnableBuiltinCountDistinctApproximation = false; /* approximate without hll */
 int CoordinatorAggregationStrategy = COORDINATOR_AGGREGATION_ROW_GATHER;
+bool EnableRepartitionedWindowFunctions = false; /* repartition input of windows */
 
 /* Constant used throughout file */
 static const uint32 masterTableId = 1; /* first range table reference on the master node */
@@ -204,6 +207,9 @@ static void ParentSetNewChild(MultiNode *parentNode, MultiNode *oldChildNode,
 							  MultiNode *newChildNode);
 
 /* Local functions forward declarations for aggregate expressions */
+static Var * WindowRepartitionColumn(MultiExtendedOp *extendedOpNode);
+static void ApplyWindowRepartition(MultiExtendedOp *workerExtendedOpNode,
+								   Var *partitionColumn);
 static void ApplyExtendedOpNodes(MultiExtendedOp *originalNode,
 								 MultiExtendedOp *masterNode,
 								 MultiExtendedOp *workerNode);
@@ -348,6 +354,24 @@ MultiLogicalPlanOptimize(MultiTreeRoot *multiLogicalPlan)
 		logicalPlanNode);
 	List *extendedOpNodeList = FindNodesOfType(logicalPlanNode, T_MultiExtendedOp);
 	MultiExtendedOp *extendedOpNode = (MultiExtendedOp *) linitial(extendedOpNodeList);
+
+	/*
+	 * Window functions that are not partitioned by the distribution column are
+	 * evaluated on the coordinator. If all of them are partitioned by the same
+	 * column, we can instead repartition the rows on that column and evaluate
+	 * the window functions on the workers.
+	 */
+	Var *windowPartitionColumn = NULL;
+	if (EnableRepartitionedWindowFunctions && extendedOpNode->hasWindowFuncs &&
+		!extendedOpNode->onlyPushableWindowFunctions)
+	{
+		windowPartitionColumn = WindowRepartitionColumn(extendedOpNode);
+		if (windowPartitionColumn != NULL)
+		{
+			extendedOpNode->onlyPushableWindowFunctions = true;
+		}
+	}
+
 	ExtendedOpNodeProperties extendedOpNodeProperties = BuildExtendedOpNodeProperties(
 		extendedOpNode, hasNonDistributableAggregates);
 
@@ -433,6 +457,11 @@ MultiLogicalPlanOptimize(MultiTreeRoot *multiLogicalPlan)
 
 	ApplyExtendedOpNodes(extendedOpNode, masterExtendedOpNode, workerExtendedOpNode);
 
+	if (windowPartitionColumn != NULL)
+	{
+		ApplyWindowRepartition(workerExtendedOpNode, windowPartitionColumn);
+	}
+
 	List *tableNodeList = FindNodesOfType(logicalPlanNode, T_MultiTable);
 	MultiTable *tableNode = NULL;
 	foreach_ptr(tableNode, tableNodeList)
@@ -1315,6 +1344,130 @@ ApplyExtendedOpNodes(MultiExtendedOp *originalNode, MultiExtendedOp *masterNode,
 }
 
 
+/*
+ * WindowRepartitionColumn returns a column that all window functions in the
+ * given extended operator node are partitioned by, if the rows of the single
+ * table below the node can be repartitioned on that column for the workers to
+ * evaluate the window functions. Otherwise, the function returns NULL.
+ */
+static Var *
+WindowRepartitionColumn(MultiExtendedOp *extendedOpNode)
+{
+	List *targetList = extendedOpNode->targetList;
+
+	/* window functions over groups would require repartitioning the groups */
+	if (extendedOpNode->groupClauseList != NIL || extendedOpNode->havingQual != NULL ||
+		TargetListHasAggregates(targetList))
+	{
+		return NULL;
+	}
+
+	/* joins would require repartitioning their output rather than a table */
+	if (FindNodesOfType((MultiNode *) extendedOpNode, T_MultiJoin) != NIL ||
+		FindNodesOfType((MultiNode *) extendedOpNode, T_MultiCartesianProduct) != NIL ||
+		FindNodesOfType((MultiNode *) extendedOpNode, T_MultiPartition) != NIL)
+	{
+		return NULL;
+	}
+
+	List *tableNodeList = FindNodesOfType((MultiNode *) extendedOpNode, T_MultiTable);
+	if (list_length(tableNodeList) != 1)
+	{
+		return NULL;
+	}
+
+	MultiTable *tableNode = (MultiTable *) linitial(tableNodeList);
+	if (tableNode->relationId == SUBQUERY_RELATION_ID ||
+		tableNode->relationId == SUBQUERY_PUSHDOWN_RELATION_ID ||
+		!IsCitusTableType(tableNode->relationId, DISTRIBUTED_TABLE))
+	{
+		return NULL;
+	}
+
+	/* find the columns that appear in the PARTITION BY of all windows */
+	List *commonColumnList = NIL;
+	bool firstWindowClause = true;
+	WindowClause *windowClause = NULL;
+	foreach_ptr(windowClause, extendedOpNode->windowClause)
+	{
+		List *windowColumnList = NIL;
+
+		SortGroupClause *partitionClause = NULL;
+		foreach_ptr(partitionClause, windowClause->partitionClause)
+		{
+			TargetEntry *partitionTargetEntry =
+				get_sortgroupclause_tle(partitionClause, targetList);
+
+			if (IsA(partitionTargetEntry->expr, Var))
+			{
+				windowColumnList = lappend(windowColumnList,
+										   partitionTargetEntry->expr);
+			}
+		}
+
+		if (firstWindowClause)
+		{
+			commonColumnList = windowColumnList;
+			firstWindowClause = false;
+		}
+		else
+		{
+			commonColumnList = list_intersection(commonColumnList, windowColumnList);
+		}
+	}
+
+	/*
+	 * worker_partition_query_result hashes the column with the default hash
+	 * function of its type, which needs to agree with the equality that the
+	 * windows use to form partitions.
+	 */
+	Var *column = NULL;
+	foreach_ptr(column, commonColumnList)
+	{
+		TypeCacheEntry *typeEntry = lookup_type_cache(column->vartype,
+													  TYPECACHE_HASH_PROC);
+
+		if (column->varattno <= 0 || !OidIsValid(typeEntry->hash_proc))
+		{
+			continue;
+		}
+
+		if (OidIsValid(column->varcollid) &&
+			!get_collation_isdeterministic(column->varcollid))
+		{
+			continue;
+		}
+
+		return column;
+	}
+
+	return NULL;
+}
+
+
+/*
+ * ApplyWindowRepartition adds a partition node on the given column and a
+ * collect node between the worker extended operator node and its child. The
+ * physical planner turns these into a map merge job that hash partitions the
+ * rows of the table, such that the worker query evaluates window functions
+ * over complete window partitions.
+ */
+static void
+ApplyWindowRepartition(MultiExtendedOp *workerExtendedOpNode, Var *partitionColumn)
+{
+	MultiNode *childNode = ChildNode((MultiUnaryNode *) workerExtendedOpNode);
+
+	MultiPartition *partitionNode = CitusMakeNode(MultiPartition);
+	partitionNode->partitionColumn = copyObject(partitionColumn);
+
+	MultiCollect *collectNode = CitusMakeNode(MultiCollect);
+
+	SetChild((MultiUnaryNode *) workerExtendedOpNode, (MultiNode *) collectNode);
+	SetChild((MultiUnaryNode *) collectNode, (MultiNode *) partitionNode);
+	SetChild((MultiUnaryNode *) partitionNode, childNode);
+}
+
+
 /*
  * TransformSubqueryNode splits the extended operator node under subquery
  * multi table node into its equivalent master and worker operator nodes, and
@@ -1696,6 +1849,42 @@ MasterAggregateExpression(Aggref *originalAggregate,
 
 		newMasterExpression = (Expr *) aggregate;
 	}
+	else if (aggregateType == AGGREGATE_COUNT && originalAggregate->aggdistinct &&
+			 CountDistinctErrorRate != DISABLE_DISTINCT_APPROXIMATION &&
+			 EnableBuiltinCountDistinctApproximation)
+	{
+		/*
+		 * The built-in approximation follows the same steps as the hll one,
+		 * without the extension. Workers compute citus_hll_add_agg(column),
+		 * and we compute citus_hll_cardinality_agg(sketch) on the coordinator,
+		 * which merges the sketches and returns the estimated count.
+		 */
+		const int argCount = 1;
+		const int defaultTypeMod = -1;
+
+		Oid cardinalityAggregateId = FunctionOid("pg_catalog",
+												 CITUS_HLL_CARDINALITY_AGGREGATE_NAME,
+												 argCount);
+
+		Var *sketchColumn = makeVar(masterTableId, walkerContext->columnId, BYTEAOID,
+									defaultTypeMod, InvalidOid, columnLevelsUp);
+		walkerContext->columnId++;
+
+		TargetEntry *sketchTargetEntry = makeTargetEntry((Expr *) sketchColumn,
+														 argumentId, NULL, false);
+
+		Aggref *cardinalityAggregate = makeNode(Aggref);
+		cardinalityAggregate->aggfnoid = cardinalityAggregateId;
+		cardinalityAggregate->aggtype = get_func_rettype(cardinalityAggregateId);
+		cardinalityAggregate->args = list_make1(sketchTargetEntry);
+		cardinalityAggregate->aggkind = AGGKIND_NORMAL;
+		cardinalityAggregate->aggfilter = NULL;
+		cardinalityAggregate->aggtranstype = InvalidOid;
+		cardinalityAggregate->aggargtypes = list_make1_oid(BYTEAOID);
+		cardinalityAggregate->aggsplit = AGGSPLIT_SIMPLE;
+
+		newMasterExpression = (Expr *) cardinalityAggregate;
+	}
 	else if (aggregateType == AGGREGATE_COUNT && originalAggregate->aggdistinct &&
 			 CountDistinctErrorRate != DISABLE_DISTINCT_APPROXIMATION)
 	{
@@ -3114,6 +3303,46 @@ WorkerAggregateExpressionList(Aggref *originalAggregate,
 
 		walkerContext->createGroupByClause = true;
 	}
+	else if (aggregateType == AGGREGATE_COUNT && originalAggregate->aggdistinct &&
+			 CountDistinctErrorRate != DISABLE_DISTINCT_APPROXIMATION &&
+			 EnableBuiltinCountDistinctApproximation)
+	{
+		/*
+		 * For the built-in approximation, we want to compute
+		 * citus_hll_add_agg(var, precision) on worker nodes, which hashes the
+		 * values itself.
+		 */
+		const AttrNumber firstArgumentId = 1;
+		const AttrNumber secondArgumentId = 2;
+		const int addArgumentCount = 2;
+
+		Oid argumentType = AggregateArgumentType(originalAggregate);
+		TargetEntry *argument = (TargetEntry *) linitial(originalAggregate->args);
+		Expr *argumentExpression = copyObject(argument->expr);
+
+		Oid addAggregateId = FunctionOid("pg_catalog", CITUS_HLL_ADD_AGGREGATE_NAME,
+										 addArgumentCount);
+		int precision = CountDistinctStorageSize(CountDistinctErrorRate);
+		Const *precisionConst = MakeIntegerConst(precision);
+
+		TargetEntry *valueArgument = makeTargetEntry(argumentExpression,
+													 firstArgumentId, NULL, false);
+		TargetEntry *precisionArgument = makeTargetEntry((Expr *) precisionConst,
+														 secondArgumentId, NULL, false);
+
+		Aggref *addAggregate = makeNode(Aggref);
+		addAggregate->aggfnoid = addAggregateId;
+		addAggregate->aggtype = get_func_rettype(addAggregateId);
+		addAggregate->args = list_make2(valueArgument, precisionArgument);
+		addAggregate->aggkind = AGGKIND_NORMAL;
+		addAggregate->aggfilter = (Expr *) copyObject(originalAggregate->aggfilter);
+		addAggregate->inputcollid = originalAggregate->inputcollid;
+		addAggregate->aggtranstype = InvalidOid;
+		addAggregate->aggargtypes = list_make2_oid(argumentType, INT4OID);
+		addAggregate->aggsplit = AGGSPLIT_SIMPLE;
+
+		workerAggregateList = lappend(workerAggregateList, addAggregate);
+	}
 	else if (aggregateType == AGGREGATE_COUNT && originalAggregate->aggdistinct &&
 			 CountDistinctErrorRate != DISABLE_DISTINCT_APPROXIMATION)
 	{
@@ -4115,6 +4344,12 @@ DeferErrorIfUnsupportedAggregateDistinct(Aggref *aggregateExpression,
 	if (aggregateType == AGGREGATE_COUNT &&
 		CountDistinctErrorRate != DISABLE_DISTINCT_APPROXIMATION)
 	{
+		/* the built-in approximation does not depend on any extension */
+		if (EnableBuiltinCountDistinctApproximation)
+		{
+			return NULL;
+		}
+
 		bool missingOK = true;
 		Oid distinctExtensionId = get_extension_oid(HLL_EXTENSION_NAME, missingOK);
 
@@ -4971,22 +5206,35 @@ HasOrderByComplexExpression(List *sortClauseList, List *targetList)
 
 /*
  * HasOrderByHllType walks over the given order by clauses, and checks if any of
- * those clauses operate on hll data type. If they do, the function returns true.
+ * those clauses operate on hll data type, or on the sketches of the built-in
+ * count(distinct) approximation. If they do, the function returns true.
  */
 static bool
 HasOrderByHllType(List *sortClauseList, List *targetList)
 {
 	bool hasOrderByHllType = false;
+	Oid hllTypeId = InvalidOid;
+	Oid builtinAddAggregateId = InvalidOid;
 
 	/* check whether HLL is loaded */
 	Oid hllId = get_extension_oid(HLL_EXTENSION_NAME, true);
-	if (!OidIsValid(hllId))
+	if (OidIsValid(hllId))
 	{
-		return hasOrderByHllType;
+		Oid hllSchemaOid = get_extension_schema(hllId);
+		hllTypeId = TypeOid(hllSchemaOid, HLL_TYPE_NAME);
 	}
 
-	Oid hllSchemaOid = get_extension_schema(hllId);
-	Oid hllTypeId = TypeOid(hllSchemaOid, HLL_TYPE_NAME);
+	if (EnableBuiltinCountDistinctApproximation)
+	{
+		const int addArgumentCount = 2;
+		builtinAddAggregateId = FunctionOid("pg_catalog", CITUS_HLL_ADD_AGGREGATE_NAME,
+											addArgumentCount);
+	}
+
+	if (!OidIsValid(hllTypeId) && !OidIsValid(builtinAddAggregateId))
+	{
+		return hasOrderByHllType;
+	}
 
 	SortGroupClause *sortClause = NULL;
 	foreach_ptr(sortClause, sortClauseList)
@@ -4994,7 +5242,15 @@ HasOrderByHllType(List *sortClauseList, List *targetList)
 		Node *sortExpression = get_sortgroupclause_expr(sortClause, targetList);
 
 		Oid sortColumnTypeId = exprType(sortExpression);
-		if (sortColumnTypeId == hllTypeId)
+		if (OidIsValid(hllTypeId) && sortColumnTypeId == hllTypeId)
+		{
+			hasOrderByHllType = true;
+			break;
+		}
+
+		/* sketches are bytea, so look for the aggregate that computes them */
+		if (OidIsValid(builtinAddAggregateId) && IsA(sortExpression, Aggref) &&
+			((Aggref *) sortExpression)->aggfnoid == builtinAddAggregateId)
 		{
 			hasOrderByHllType = true;
 			break;
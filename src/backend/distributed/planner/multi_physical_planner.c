@@ -41,6 +41,7 @@
 #include "distributed/deparse_shard_query.h"
 #include "distributed/coordinator_protocol.h"
 #include "distributed/intermediate_results.h"
+#include "distributed/join_key_filter.h"
 #include "distributed/metadata_cache.h"
 #include "distributed/multi_router_planner.h"
 #include "distributed/multi_join_order.h"
@@ -84,6 +85,9 @@
 /* RepartitionJoinBucketCountPerNode determines bucket amount during repartitions */
 int RepartitionJoinBucketCountPerNode = 8;
 
+/* whether dual partition joins filter the map output of one side by join keys */
+bool EnableRepartitionJoinKeyFilter = false;
+
 /* Policy to use when assigning tasks to worker nodes */
 int TaskAssignmentPolicy = TASK_ASSIGNMENT_GREEDY;
 bool EnableUniqueJobIds = true;
@@ -119,6 +123,8 @@ typedef struct AddAnyValueAggregatesContext
 static Job * BuildJobTree(MultiTreeRoot *multiTree);
 static MultiNode * LeftMostNode(MultiTreeRoot *multiTree);
 static Oid RangePartitionJoinBaseRelationId(MultiJoin *joinNode);
+static bool ShouldBuildJoinKeyFilter(MultiJoin *joinNode, MapMergeJob *leftMapMergeJob,
+									 MapMergeJob *rightMapMergeJob);
 static MultiTable * FindTableNode(MultiNode *multiNode, int rangeTableId);
 static Query * BuildJobQuery(MultiNode *multiNode, List *dependentJobList);
 static List * BaseRangeTableList(MultiNode *multiNode);
@@ -217,6 +223,8 @@ static List * AssignDualHashTaskList(List *taskList);
 static void AssignDataFetchDependencies(List *taskList);
 static uint32 TaskListHighestTaskId(List *taskList);
 static List * MapTaskList(MapMergeJob *mapMergeJob, List *filterTaskList);
+static List * JoinKeyFilterTaskList(MapMergeJob *mapMergeJob, List *filterTaskList);
+static uint32 MapMergeJobPartitionColumnResNo(MapMergeJob *mapMergeJob);
 static StringInfo CreateMapQueryString(MapMergeJob *mapMergeJob, Task *filterTask,
 									   uint32 partitionColumnIndex, bool useBinaryFormat);
 static char * PartitionResultNamePrefix(uint64 jobId, int32 taskId);
@@ -321,6 +329,12 @@ BuildJobTree(MultiTreeRoot *multiTree)
 		{
 			boundaryNodeJobType = SUBQUERY_MAP_MERGE_JOB;
 		}
+		else if (currentNodeType == T_MultiCollect &&
+				 parentNodeType == T_MultiExtendedOp &&
+				 CitusIsA(ChildNode((MultiUnaryNode *) currentNode), MultiPartition))
+		{
+			boundaryNodeJobType = WINDOW_MAP_MERGE_JOB;
+		}
 		else if (currentNodeType == T_MultiCollect &&
 				 parentNodeType != T_MultiPartition)
 		{
@@ -339,6 +353,8 @@ BuildJobTree(MultiTreeRoot *multiTree)
 
 			PartitionType partitionType = PARTITION_INVALID_FIRST;
 			Oid baseRelationId = InvalidOid;
+			MapMergeJob *leftMapMergeJob = NULL;
+			MapMergeJob *rightMapMergeJob = NULL;
 
 			if (joinNode->joinRuleType == SINGLE_RANGE_PARTITION_JOIN)
 			{
@@ -373,6 +389,7 @@ BuildJobTree(MultiTreeRoot *multiTree)
 				/* reset dependent job list */
 				loopDependentJobList = NIL;
 				loopDependentJobList = list_make1(mapMergeJob);
+				leftMapMergeJob = mapMergeJob;
 			}
 
 			if (CitusIsA(rightChildNode, MultiPartition))
@@ -393,8 +410,38 @@ BuildJobTree(MultiTreeRoot *multiTree)
 
 				/* append to the dependent job list for on-going dependencies */
 				loopDependentJobList = lappend(loopDependentJobList, mapMergeJob);
+				rightMapMergeJob = mapMergeJob;
+			}
+
+			/*
+			 * The right side of a left deep join tree is often a filtered
+			 * dimension table, so its join keys filter the left side.
+			 */
+			if (ShouldBuildJoinKeyFilter(joinNode, leftMapMergeJob, rightMapMergeJob))
+			{
+				rightMapMergeJob->buildJoinKeyFilter = true;
+				leftMapMergeJob->joinKeyFilterJobId = rightMapMergeJob->job.jobId;
 			}
 		}
+		else if (boundaryNodeJobType == WINDOW_MAP_MERGE_JOB)
+		{
+			MultiPartition *partitionNode =
+				(MultiPartition *) ChildNode((MultiUnaryNode *) currentNode);
+			MultiNode *queryNode = ChildNode((MultiUnaryNode *) partitionNode);
+			Var *partitionKey = partitionNode->partitionColumn;
+
+			/*
+			 * The window functions above are partitioned by the partition key,
+			 * so we hash partition the rows they take as input on that key.
+			 */
+			Query *jobQuery = BuildJobQuery(queryNode, NIL);
+			MapMergeJob *mapMergeJob = BuildMapMergeJob(jobQuery, NIL, partitionKey,
+														DUAL_HASH_PARTITION_TYPE,
+														InvalidOid,
+														WINDOW_MAP_MERGE_JOB);
+
+			loopDependentJobList = list_make1(mapMergeJob);
+		}
 		else if (boundaryNodeJobType == TOP_LEVEL_WORKER_JOB)
 		{
 			MultiNode *childNode = ChildNode((MultiUnaryNode *) currentNode);
@@ -469,6 +516,40 @@ LeftMostNode(MultiTreeRoot *multiTree)
 }
 
 
+/*
+ * ShouldBuildJoinKeyFilter returns whether the join keys of the right side of
+ * the given join should filter the map output of its left side. Rows without
+ * a matching join key can only be dropped in inner joins, and the hashes of
+ * the join keys can only be compared if both sides hash them the same way.
+ */
+static bool
+ShouldBuildJoinKeyFilter(MultiJoin *joinNode, MapMergeJob *leftMapMergeJob,
+						 MapMergeJob *rightMapMergeJob)
+{
+	if (!EnableRepartitionJoinKeyFilter)
+	{
+		return false;
+	}
+
+	if (joinNode->joinRuleType != DUAL_PARTITION_JOIN ||
+		joinNode->joinType != JOIN_INNER)
+	{
+		return false;
+	}
+
+	if (leftMapMergeJob == NULL || rightMapMergeJob == NULL)
+	{
+		return false;
+	}
+
+	Var *leftPartitionColumn = leftMapMergeJob->partitionColumn;
+	Var *rightPartitionColumn = rightMapMergeJob->partitionColumn;
+
+	return leftPartitionColumn->vartype == rightPartitionColumn->vartype &&
+		   leftPartitionColumn->varcollid == rightPartitionColumn->varcollid;
+}
+
+
 /*
  * RangePartitionJoinBaseRelationId finds partition node from join node, and
  * returns base relation id of this node. Note that this function assumes that
@@ -1964,6 +2045,7 @@ BuildMapMergeJob(Query *jobQuery, List *dependentJobList, Var *partitionKey,
 	mapMergeJob->job.jobId = UniqueJobId();
 	mapMergeJob->job.jobQuery = jobQuery;
 	mapMergeJob->job.dependentJobList = dependentJobList;
+	mapMergeJob->boundaryNodeJobType = boundaryNodeJobType;
 	mapMergeJob->partitionColumn = partitionColumn;
 	mapMergeJob->sortedShardIntervalArrayLength = 0;
 
@@ -2148,6 +2230,13 @@ BuildJobTreeTaskList(Job *jobTree, PlannerRestrictionContext *plannerRestriction
 			MapMergeJob *mapMergeJob = (MapMergeJob *) job;
 			uint32 taskIdIndex = TaskListHighestTaskId(assignedSqlTaskList) + 1;
 
+			/* the map tasks overwrite the query strings of the sql tasks */
+			if (mapMergeJob->buildJoinKeyFilter)
+			{
+				mapMergeJob->joinKeyFilterTaskList =
+					JoinKeyFilterTaskList(mapMergeJob, assignedSqlTaskList);
+			}
+
 			List *mapTaskList = MapTaskList(mapMergeJob, assignedSqlTaskList);
 			List *mergeTaskList = MergeTaskList(mapMergeJob, mapTaskList, taskIdIndex);
 
@@ -4310,24 +4399,7 @@ MapTaskList(MapMergeJob *mapMergeJob, List *filterTaskList)
 	List *mapTaskList = NIL;
 	Query *filterQuery = mapMergeJob->job.jobQuery;
 	ListCell *filterTaskCell = NULL;
-	Var *partitionColumn = mapMergeJob->partitionColumn;
-
-	uint32 partitionColumnResNo = 0;
-	List *groupClauseList = filterQuery->groupClause;
-	if (groupClauseList != NIL)
-	{
-		List *targetEntryList = filterQuery->targetList;
-		List *groupTargetEntryList = GroupTargetEntryList(groupClauseList,
-														  targetEntryList);
-		TargetEntry *groupByTargetEntry = (TargetEntry *) linitial(groupTargetEntryList);
-
-		partitionColumnResNo = groupByTargetEntry->resno;
-	}
-	else
-	{
-		partitionColumnResNo = PartitionColumnIndex(partitionColumn,
-													filterQuery->targetList);
-	}
+	uint32 partitionColumnResNo = MapMergeJobPartitionColumnResNo(mapMergeJob);
 
 	/* determine whether all types have binary input/output functions */
 	bool useBinaryFormat = CanUseBinaryCopyFormatForTargetList(filterQuery->targetList);
@@ -4358,6 +4430,65 @@ MapTaskList(MapMergeJob *mapMergeJob, List *filterTaskList)
 }
 
 
+/*
+ * JoinKeyFilterTaskList creates a list of tasks that return the hashes of the
+ * join keys of the given MapMerge job. For this, the function copies each
+ * filter task in the given filter task list, and wraps its query with a
+ * worker_join_key_hashes() call.
+ */
+static List *
+JoinKeyFilterTaskList(MapMergeJob *mapMergeJob, List *filterTaskList)
+{
+	List *joinKeyFilterTaskList = NIL;
+	uint32 partitionColumnResNo = MapMergeJobPartitionColumnResNo(mapMergeJob);
+
+	Task *filterTask = NULL;
+	foreach_ptr(filterTask, filterTaskList)
+	{
+		StringInfo keyHashQueryString = makeStringInfo();
+		char *filterQueryString = TaskQueryString(filterTask);
+
+		appendStringInfo(keyHashQueryString,
+						 "SELECT pg_catalog.worker_join_key_hashes(%s,%d,%d)",
+						 quote_literal_cstr(filterQueryString),
+						 partitionColumnResNo - 1,
+						 JOIN_KEY_FILTER_MAX_KEYS);
+
+		Task *keyHashTask = copyObject(filterTask);
+		SetTaskQueryString(keyHashTask, keyHashQueryString->data);
+
+		joinKeyFilterTaskList = lappend(joinKeyFilterTaskList, keyHashTask);
+	}
+
+	return joinKeyFilterTaskList;
+}
+
+
+/*
+ * MapMergeJobPartitionColumnResNo returns the position of the partition column
+ * of the given MapMerge job in the target list of its filter query.
+ */
+static uint32
+MapMergeJobPartitionColumnResNo(MapMergeJob *mapMergeJob)
+{
+	Query *filterQuery = mapMergeJob->job.jobQuery;
+	Var *partitionColumn = mapMergeJob->partitionColumn;
+
+	List *groupClauseList = filterQuery->groupClause;
+	if (groupClauseList != NIL)
+	{
+		List *targetEntryList = filterQuery->targetList;
+		List *groupTargetEntryList = GroupTargetEntryList(groupClauseList,
+														  targetEntryList);
+		TargetEntry *groupByTargetEntry = (TargetEntry *) linitial(groupTargetEntryList);
+
+		return groupByTargetEntry->resno;
+	}
+
+	return PartitionColumnIndex(partitionColumn, filterQuery->targetList);
+}
+
+
 /*
  * PartitionColumnIndex finds the index of the given target var.
  */
@@ -4459,7 +4590,7 @@ CreateMapQueryString(MapMergeJob *mapMergeJob, Task *filterTask,
 					 ", %s || '_' || partition_index::text "
 					 ", rows_written "
 					 "FROM pg_catalog.worker_partition_query_result"
-					 "(%s,%s,%d,%s,%s,%s,%s,%s,%s) WHERE rows_written > 0",
+					 "(%s,%s,%d,%s,%s,%s,%s,%s,%s",
 					 quote_literal_cstr(resultNamePrefix),
 					 quote_literal_cstr(resultNamePrefix),
 					 quote_literal_cstr(filterQueryString),
@@ -4471,6 +4602,24 @@ CreateMapQueryString(MapMergeJob *mapMergeJob, Task *filterTask,
 					 allowNullPartitionColumnValue ? "true" : "false",
 					 generateEmptyResults ? "true" : "false");
 
+	/*
+	 * The executor broadcasts the join key filter of the other side of the join
+	 * before the map tasks run, so rows without a matching key are dropped
+	 * before they are written to the partition files.
+	 */
+	if (mapMergeJob->joinKeyFilterJobId != INVALID_JOB_ID)
+	{
+		char *filterResultId = JoinKeyFilterResultId(mapMergeJob->joinKeyFilterJobId);
+
+		appendStringInfo(mapQueryString,
+						 ",(SELECT join_key_filter "
+						 "FROM pg_catalog.read_intermediate_result(%s,'binary') "
+						 "AS res (join_key_filter bytea))",
+						 quote_literal_cstr(filterResultId));
+	}
+
+	appendStringInfoString(mapQueryString, ") WHERE rows_written > 0");
+
 	return mapQueryString;
 }
 
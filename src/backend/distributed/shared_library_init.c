@@ -46,6 +46,7 @@
 #include "distributed/local_multi_copy.h"
 #include "distributed/local_executor.h"
 #include "distributed/local_distributed_join_planner.h"
+#include "distributed/local_plan_cache.h"
 #include "distributed/locally_reserved_shared_connections.h"
 #include "distributed/maintenanced.h"
 #include "distributed/shard_cleaner.h"
@@ -63,10 +64,14 @@
 #include "distributed/combine_query_planner.h"
 #include "distributed/multi_router_planner.h"
 #include "distributed/multi_server_executor.h"
+#include "distributed/node_execution_stats.h"
+#include "distributed/parallel_combine.h"
+#include "distributed/parallel_local_executor.h"
 #include "distributed/pg_dist_partition.h"
 #include "distributed/placement_connection.h"
 #include "distributed/query_stats.h"
 #include "distributed/recursive_planning.h"
+#include "distributed/reference_table_result_cache.h"
 #include "distributed/reference_table_utils.h"
 #include "distributed/relation_access_tracking.h"
 #include "distributed/repair_shards.h"
@@ -79,6 +84,7 @@
 #include "distributed/remote_commands.h"
 #include "distributed/shard_rebalancer.h"
 #include "distributed/shared_library_init.h"
+#include "distributed/sorted_merge.h"
 #include "distributed/statistics_collection.h"
 #include "distributed/subplan_execution.h"
 #include "distributed/resource_lock.h"
@@ -92,6 +98,7 @@
 #include "distributed/adaptive_executor.h"
 #include "libpq/auth.h"
 #include "port/atomics.h"
+#include "postmaster/bgworker.h"
 #include "postmaster/postmaster.h"
 #include "replication/walsender.h"
 #include "storage/ipc.h"
@@ -112,6 +119,7 @@ ColumnarSupportsIndexAM_type extern_ColumnarSupportsIndexAM = NULL;
 CompressionTypeStr_type extern_CompressionTypeStr = NULL;
 IsColumnarTableAmTable_type extern_IsColumnarTableAmTable = NULL;
 ReadColumnarOptions_type extern_ReadColumnarOptions = NULL;
+ColumnarHasPendingWrites_type extern_ColumnarHasPendingWrites = NULL;
 
 /*
  * Define "pass-through" functions so that a SQL function defined as one of
@@ -390,6 +398,7 @@ _PG_init(void)
 	InitPlacementConnectionManagement();
 	InitializeCitusQueryStats();
 	InitializeSharedConnectionStats();
+	InitializeNodeExecutionStats();
 	InitializeLocallyReservedSharedConnections();
 
 	/* enable modification of pg_catalog tables during pg_upgrade */
@@ -442,6 +451,7 @@ _PG_init(void)
 	INIT_COLUMNAR_SYMBOL(CompressionTypeStr_type, CompressionTypeStr);
 	INIT_COLUMNAR_SYMBOL(IsColumnarTableAmTable_type, IsColumnarTableAmTable);
 	INIT_COLUMNAR_SYMBOL(ReadColumnarOptions_type, ReadColumnarOptions);
+	INIT_COLUMNAR_SYMBOL(ColumnarHasPendingWrites_type, ColumnarHasPendingWrites);
 
 	/* initialize symbols for "pass-through" functions */
 	INIT_COLUMNAR_SYMBOL(PGFunction, columnar_handler);
@@ -471,6 +481,7 @@ citus_shmem_request(void)
 
 	RequestAddinShmemSpace(BackendManagementShmemSize());
 	RequestAddinShmemSpace(SharedConnectionStatsShmemSize());
+	RequestAddinShmemSpace(NodeExecutionStatsShmemSize());
 	RequestAddinShmemSpace(MaintenanceDaemonShmemSize());
 	RequestAddinShmemSpace(CitusQueryStatsSharedMemSize());
 	RequestNamedLWLockTranche(STATS_SHARED_MEM_NAME, 1);
@@ -946,6 +957,20 @@ RegisterCitusConfigVariables(void)
 		GUC_STANDARD,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_builtin_count_distinct_approximation",
+		gettext_noop("Approximates count(distinct) using the HyperLogLog aggregates "
+					 "of Citus instead of the postgresql-hll extension."),
+		gettext_noop("When citus.count_distinct_error_rate is set, workers compute "
+					 "HyperLogLog sketches of the distinct values, which are merged "
+					 "on the coordinator. Unlike the default, this does not require "
+					 "the hll extension to be installed on all nodes."),
+		&EnableBuiltinCountDistinctApproximation,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_cost_based_connection_establishment",
 		gettext_noop("When enabled the connection establishment times "
@@ -1069,6 +1094,55 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_node_execution_stats",
+		gettext_noop("Enables sizing the connection pools of the executor using "
+					 "statistics of earlier executions"),
+		gettext_noop("When enabled, every execution records the average task "
+					 "execution time, connection establishment time and "
+					 "connection failure rate per worker node in shared memory. "
+					 "Subsequent executions use these statistics to decide how "
+					 "many connections to open to a node right away, instead of "
+					 "relearning them through slow start. The statistics can be "
+					 "inspected via citus_node_execution_stats()."),
+		&EnableNodeExecutionStats,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_pipelining",
+		gettext_noop("Enables sending BEGIN together with the first task over a "
+					 "connection using libpq pipeline mode"),
+		gettext_noop("When enabled, the adaptive executor does not wait for the "
+					 "result of the commands that open a transaction block on a "
+					 "worker before sending the first task over the connection, "
+					 "which saves a round-trip per connection in multi-statement "
+					 "transactions. Only tasks that are sent with parameters or "
+					 "binary results are pipelined, and only on PostgreSQL 14 "
+					 "and later."),
+		&EnablePipelining,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomBoolVariable(
+		"citus.enable_repartition_join_key_filter",
+		gettext_noop("Enables filtering the rows of repartition joins by the join "
+					 "keys of the other side"),
+		gettext_noop("When enabled, the join keys of the right side of inner "
+					 "joins that repartition both sides are collected into a bloom "
+					 "filter, which is broadcast to all nodes. Rows of the left "
+					 "side without a matching join key are then dropped before "
+					 "they are transferred between nodes."),
+		&EnableRepartitionJoinKeyFilter,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_repartition_joins",
 		gettext_noop("Allows Citus to repartition data between nodes."),
@@ -1089,6 +1163,21 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_repartitioned_window_functions",
+		gettext_noop("Enables evaluating window functions on the workers by "
+					 "repartitioning their input"),
+		gettext_noop("Window functions that are not partitioned by the "
+					 "distribution column are evaluated on the coordinator. When "
+					 "enabled, the rows of the table are instead repartitioned by "
+					 "a column that all window functions are partitioned by, such "
+					 "that the workers can evaluate the window functions."),
+		&EnableRepartitionedWindowFunctions,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_router_execution",
 		gettext_noop("Enables router execution"),
@@ -1099,6 +1188,26 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_shared_pool_leasing",
+		gettext_noop("Releases connections to worker nodes whose shared pool "
+					 "is under pressure at the end of each transaction."),
+		gettext_noop("By default, each backend keeps up to "
+					 "citus.max_cached_conns_per_worker connections per worker "
+					 "open across transactions, which other backends cannot "
+					 "use. When enabled, a backend only keeps its connections "
+					 "to a worker open while the shared pool of the worker "
+					 "(see citus.max_shared_pool_size) is not full and no "
+					 "other backend waits for a connection slot. Otherwise, "
+					 "the connection slots are passed on to the other backends "
+					 "at the end of the transaction, such that many concurrent "
+					 "sessions share a bounded number of worker connections."),
+		&EnableSharedPoolLeasing,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_single_hash_repartition_joins",
 		gettext_noop("Enables single hash repartitioning between hash "
@@ -1110,6 +1219,23 @@ RegisterCitusConfigVariables(void)
 		GUC_NO_SHOW_ALL,
 		NULL, NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_sorted_merge",
+		gettext_noop("Merges the sorted results of multi-shard queries with "
+					 "ORDER BY and LIMIT on the coordinator"),
+		gettext_noop("For multi-shard queries with ORDER BY and LIMIT, the "
+					 "workers sort their results and apply the limit. When "
+					 "enabled, the coordinator keeps at most LIMIT + OFFSET "
+					 "rows of each task and merges the sorted task results, "
+					 "such that the final sort on the coordinator only needs "
+					 "to handle LIMIT + OFFSET rows instead of that many rows "
+					 "per shard."),
+		&EnableSortedMerge,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_statistics_collection",
 		gettext_noop("Enables sending basic usage statistics to Citus."),
@@ -1128,6 +1254,22 @@ RegisterCitusConfigVariables(void)
 		&StatisticsCollectionGucCheckHook,
 		NULL, NULL);
 
+	DefineCustomBoolVariable(
+		"citus.enable_task_stealing",
+		gettext_noop("Enables worker pools that ran out of tasks to take over "
+					 "tasks that are waiting for another worker"),
+		gettext_noop("When enabled, a connection that has no more tasks to run "
+					 "on its worker picks up a read-only task that is queued "
+					 "for a different worker, if the shard has a placement on "
+					 "its own worker. This reduces the impact of a slow worker "
+					 "on multi-shard queries on replicated and reference "
+					 "tables."),
+		&EnableTaskStealing,
+		false,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.enable_unique_job_ids",
 		gettext_noop("Enables unique job IDs by prepending the local process ID and "
@@ -1190,6 +1332,25 @@ RegisterCitusConfigVariables(void)
 		GUC_UNIT_MS | GUC_NO_SHOW_ALL,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.executor_streaming_buffer_size",
+		gettext_noop("Sets the amount of results of a multi-shard SELECT that "
+					 "are buffered before they are returned."),
+		gettext_noop("By default, the executor stores all the results of a "
+					 "multi-shard query on the coordinator before it returns "
+					 "the first row. When set to a value other than 0, read-only "
+					 "queries outside of transaction blocks instead return the "
+					 "results once the buffer of the given size is full, and "
+					 "only read more results from the workers when the client "
+					 "consumed the buffered ones. This lowers the memory usage "
+					 "and the time to the first row of queries with large "
+					 "results."),
+		&ExecutorStreamingBufferSize,
+		0, 0, MAX_KILOBYTES,
+		PGC_USERSET,
+		GUC_UNIT_KB | GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomBoolVariable(
 		"citus.explain_all_tasks",
 		gettext_noop("Enables showing output for all tasks in Explain."),
@@ -1490,6 +1651,38 @@ RegisterCitusConfigVariables(void)
 		GUC_STANDARD,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.max_cached_local_plans",
+		gettext_noop("Sets the maximum number of shard query plans that the local "
+					 "executor caches per backend."),
+		gettext_noop("Queries that access shards on the local node are planned "
+					 "for every shard on every execution. When set to a value "
+					 "other than 0, the local executor caches the plans of shard "
+					 "queries without parameters, such that repeated multi-shard "
+					 "queries and queries that are not prepared reuse them. The "
+					 "least recently used plans are evicted once the cache is full."),
+		&MaxCachedLocalPlans,
+		0, 0, INT_MAX,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.max_cached_prepared_statements",
+		gettext_noop("Sets the maximum number of prepared statements to cache per "
+					 "connection."),
+		gettext_noop("Parameterized router queries are prepared on the worker "
+					 "connection the first time they are executed, and subsequent "
+					 "executions on the same connection only bind the parameters "
+					 "to the prepared statement, which avoids parsing and planning "
+					 "the query on the worker. Setting this to 0 disables caching "
+					 "prepared statements. Requires PostgreSQL 14 or later."),
+		&MaxCachedPreparedStatements,
+		0, 0, INT_MAX,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.max_client_connections",
 		gettext_noop("Sets the maximum number of connections regular clients can make"),
@@ -1529,6 +1722,38 @@ RegisterCitusConfigVariables(void)
 		GUC_UNIT_MB | GUC_STANDARD,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.max_parallel_workers_per_combine",
+		gettext_noop("Sets the maximum number of parallel workers that aggregate "
+					 "the results of a multi-shard query on the coordinator."),
+		gettext_noop("When set to 0, which is the default, the combine query of a "
+					 "multi-shard query aggregates the results of all shards in "
+					 "the backend that runs the query. Otherwise, the planner "
+					 "considers a parallel aggregate for the combine query, in "
+					 "which parallel workers aggregate disjoint sets of groups. "
+					 "The planner picks it when parallel_setup_cost and "
+					 "parallel_tuple_cost make it cheaper."),
+		&MaxParallelWorkersPerCombine,
+		0, 0, MAX_PARALLEL_WORKER_LIMIT,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.max_parallel_workers_per_local_execution",
+		gettext_noop("Sets the maximum number of parallel workers that execute "
+					 "the local tasks of a read-only multi-shard query."),
+		gettext_noop("When set to 0, which is the default, the local tasks are "
+					 "executed one by one in the backend that runs the query. "
+					 "The parallel workers are taken from the pool of "
+					 "max_parallel_workers, and the backend executes the tasks "
+					 "itself when no workers are available."),
+		&MaxParallelWorkersPerLocalExecution,
+		0, 0, MAX_PARALLEL_WORKER_LIMIT,
+		PGC_USERSET,
+		GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.max_rebalancer_logged_ignored_moves",
 		gettext_noop("Sets the maximum number of ignored moves the rebalance logs"),
@@ -1725,6 +1950,41 @@ RegisterCitusConfigVariables(void)
 		GUC_UNIT_MS | GUC_STANDARD,
 		NULL, NULL, NULL);
 
+	DefineCustomIntVariable(
+		"citus.reference_table_result_cache_max_age",
+		gettext_noop("Sets the time after which cached results of router queries "
+					 "on reference tables are no longer used."),
+		gettext_noop("Modifications made via other nodes do not invalidate the "
+					 "reference table result cache of this node. This setting "
+					 "bounds for how long such modifications can go unnoticed. "
+					 "Setting this to 0 disables the cache."),
+		&ReferenceTableResultCacheMaxAge,
+		0, 0, INT_MAX,
+		PGC_USERSET,
+		GUC_UNIT_MS | GUC_STANDARD,
+		NULL, NULL, NULL);
+
+	DefineCustomIntVariable(
+		"citus.reference_table_result_cache_size",
+		gettext_noop("Sets the size of the cache for results of router queries on "
+					 "reference tables in each backend."),
+		gettext_noop("SELECT queries that only access reference tables and do not "
+					 "contain mutable functions are answered from the cache when "
+					 "the same query was executed before with the same parameters. "
+					 "Cached results are invalidated when the reference table is "
+					 "modified via this node. Modifications made via other nodes "
+					 "are only observed after "
+					 "citus.reference_table_result_cache_max_age, hence the cache "
+					 "should only be enabled when reference tables are modified "
+					 "via a single node. Results are only cached in READ "
+					 "COMMITTED outside of transaction blocks. "
+					 "Setting this to 0 disables the cache."),
+		&ReferenceTableResultCacheSize,
+		0, 0, MAX_KILOBYTES,
+		PGC_SIGHUP,
+		GUC_UNIT_KB | GUC_STANDARD,
+		NULL, NULL, NULL);
+
 	DefineCustomIntVariable(
 		"citus.remote_copy_flush_threshold",
 		gettext_noop("Sets the threshold for remote copy to be flushed."),
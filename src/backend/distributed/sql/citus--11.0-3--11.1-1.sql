@@ -44,6 +44,7 @@ BEGIN
     ALTER EXTENSION citus DROP FUNCTION pg_catalog.alter_columnar_table_set;
     ALTER EXTENSION citus DROP FUNCTION pg_catalog.alter_columnar_table_reset;
     ALTER EXTENSION citus DROP FUNCTION columnar.get_storage_id;
+    ALTER EXTENSION citus DROP FUNCTION columnar.compact_stripes;
 
     -- columnar view
     ALTER EXTENSION citus DROP VIEW columnar.storage;
@@ -67,3 +68,11 @@ DROP FUNCTION pg_catalog.get_all_active_transactions(OUT datid oid, OUT process_
 #include "udfs/get_all_active_transactions/11.1-1.sql"
 #include "udfs/citus_split_shard_by_split_points/11.1-1.sql"
 #include "udfs/worker_split_copy/11.1-1.sql"
+#include "udfs/citus_node_execution_stats/11.1-1.sql"
+#include "udfs/citus_hll_add_agg/11.1-1.sql"
+#include "udfs/citus_hll_cardinality_agg/11.1-1.sql"
+#include "udfs/worker_partition_query_result/11.1-1.sql"
+#include "udfs/worker_join_key_hashes/11.1-1.sql"
+
+-- the standard planner can plan a parallel combine query over the remote scan
+ALTER FUNCTION pg_catalog.citus_extradata_container(INTERNAL) PARALLEL SAFE;
@@ -77,3 +77,29 @@ DROP FUNCTION pg_catalog.get_all_active_transactions(OUT datid oid, OUT process_
                                                      OUT worker_query BOOL, OUT transaction_number int8, OUT transaction_stamp timestamptz,
                                                      OUT global_pid int8);
 #include "../udfs/get_all_active_transactions/11.0-1.sql"
+
+DROP FUNCTION pg_catalog.citus_node_execution_stats(
+	OUT hostname text,
+	OUT port int,
+	OUT execution_count bigint,
+	OUT avg_task_execution_time float8,
+	OUT avg_connection_establishment_time float8,
+	OUT connection_failure_rate float8);
+
+DROP AGGREGATE pg_catalog.citus_hll_add_agg(anyelement, int);
+DROP FUNCTION pg_catalog.citus_hll_add_agg_sfunc(internal, anyelement, int);
+DROP FUNCTION pg_catalog.citus_hll_add_agg_ffunc(internal);
+DROP FUNCTION pg_catalog.citus_hll_add_agg_combinefunc(internal, internal);
+DROP FUNCTION pg_catalog.citus_hll_add_agg_serialfunc(internal);
+DROP FUNCTION pg_catalog.citus_hll_add_agg_deserialfunc(bytea, internal);
+DROP AGGREGATE pg_catalog.citus_hll_cardinality_agg(bytea);
+DROP FUNCTION pg_catalog.citus_hll_cardinality_agg_sfunc(internal, bytea);
+DROP FUNCTION pg_catalog.citus_hll_cardinality_agg_ffunc(internal);
+DROP FUNCTION pg_catalog.citus_hll_cardinality_agg_combinefunc(internal, internal);
+DROP FUNCTION pg_catalog.citus_hll_cardinality_agg_serialfunc(internal);
+DROP FUNCTION pg_catalog.citus_hll_cardinality_agg_deserialfunc(bytea, internal);
+
+DROP FUNCTION pg_catalog.worker_partition_query_result(text, text, int, citus.distribution_type, text[], text[], boolean, boolean, boolean, bytea);
+DROP FUNCTION pg_catalog.worker_join_key_hashes(text, int, int);
+
+ALTER FUNCTION pg_catalog.citus_extradata_container(INTERNAL) PARALLEL UNSAFE;
@@ -0,0 +1,48 @@
+CREATE OR REPLACE FUNCTION pg_catalog.citus_hll_add_agg_sfunc(internal, anyelement, int)
+RETURNS internal
+LANGUAGE C PARALLEL SAFE
+AS 'MODULE_PATHNAME';
+COMMENT ON FUNCTION pg_catalog.citus_hll_add_agg_sfunc(internal, anyelement, int)
+    IS 'transition function for citus_hll_add_agg';
+
+CREATE OR REPLACE FUNCTION pg_catalog.citus_hll_add_agg_ffunc(internal)
+RETURNS bytea
+LANGUAGE C PARALLEL SAFE
+AS 'MODULE_PATHNAME';
+COMMENT ON FUNCTION pg_catalog.citus_hll_add_agg_ffunc(internal)
+    IS 'finalizer for citus_hll_add_agg';
+
+CREATE OR REPLACE FUNCTION pg_catalog.citus_hll_add_agg_combinefunc(internal, internal)
+RETURNS internal
+LANGUAGE C PARALLEL SAFE
+AS 'MODULE_PATHNAME', 'citus_hll_combinefunc';
+COMMENT ON FUNCTION pg_catalog.citus_hll_add_agg_combinefunc(internal, internal)
+    IS 'combine function for citus_hll_add_agg';
+
+CREATE OR REPLACE FUNCTION pg_catalog.citus_hll_add_agg_serialfunc(internal)
+RETURNS bytea
+LANGUAGE C STRICT PARALLEL SAFE
+AS 'MODULE_PATHNAME', 'citus_hll_serialfunc';
+COMMENT ON FUNCTION pg_catalog.citus_hll_add_agg_serialfunc(internal)
+    IS 'serialization function for citus_hll_add_agg';
+
+CREATE OR REPLACE FUNCTION pg_catalog.citus_hll_add_agg_deserialfunc(bytea, internal)
+RETURNS internal
+LANGUAGE C STRICT PARALLEL SAFE
+AS 'MODULE_PATHNAME', 'citus_hll_deserialfunc';
+COMMENT ON FUNCTION pg_catalog.citus_hll_add_agg_deserialfunc(bytea, internal)
+    IS 'deserialization function for citus_hll_add_agg';
+
+-- computes a HyperLogLog sketch of the given values, used by workers to
+-- approximate count(distinct) when the hll extension is not available
+CREATE OR REPLACE AGGREGATE pg_catalog.citus_hll_add_agg(anyelement, int) (
+    STYPE = internal,
+    SFUNC = pg_catalog.citus_hll_add_agg_sfunc,
+    FINALFUNC = pg_catalog.citus_hll_add_agg_ffunc,
+    COMBINEFUNC = pg_catalog.citus_hll_add_agg_combinefunc,
+    SERIALFUNC = pg_catalog.citus_hll_add_agg_serialfunc,
+    DESERIALFUNC = pg_catalog.citus_hll_add_agg_deserialfunc,
+    PARALLEL = SAFE
+);
+COMMENT ON AGGREGATE pg_catalog.citus_hll_add_agg(anyelement, int)
+    IS 'computes a HyperLogLog sketch of the values with the given precision';
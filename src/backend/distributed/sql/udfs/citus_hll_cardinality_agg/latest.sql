@@ -0,0 +1,48 @@
+CREATE OR REPLACE FUNCTION pg_catalog.citus_hll_cardinality_agg_sfunc(internal, bytea)
+RETURNS internal
+LANGUAGE C PARALLEL SAFE
+AS 'MODULE_PATHNAME';
+COMMENT ON FUNCTION pg_catalog.citus_hll_cardinality_agg_sfunc(internal, bytea)
+    IS 'transition function for citus_hll_cardinality_agg';
+
+CREATE OR REPLACE FUNCTION pg_catalog.citus_hll_cardinality_agg_ffunc(internal)
+RETURNS bigint
+LANGUAGE C PARALLEL SAFE
+AS 'MODULE_PATHNAME';
+COMMENT ON FUNCTION pg_catalog.citus_hll_cardinality_agg_ffunc(internal)
+    IS 'finalizer for citus_hll_cardinality_agg';
+
+CREATE OR REPLACE FUNCTION pg_catalog.citus_hll_cardinality_agg_combinefunc(internal, internal)
+RETURNS internal
+LANGUAGE C PARALLEL SAFE
+AS 'MODULE_PATHNAME', 'citus_hll_combinefunc';
+COMMENT ON FUNCTION pg_catalog.citus_hll_cardinality_agg_combinefunc(internal, internal)
+    IS 'combine function for citus_hll_cardinality_agg';
+
+CREATE OR REPLACE FUNCTION pg_catalog.citus_hll_cardinality_agg_serialfunc(internal)
+RETURNS bytea
+LANGUAGE C STRICT PARALLEL SAFE
+AS 'MODULE_PATHNAME', 'citus_hll_serialfunc';
+COMMENT ON FUNCTION pg_catalog.citus_hll_cardinality_agg_serialfunc(internal)
+    IS 'serialization function for citus_hll_cardinality_agg';
+
+CREATE OR REPLACE FUNCTION pg_catalog.citus_hll_cardinality_agg_deserialfunc(bytea, internal)
+RETURNS internal
+LANGUAGE C STRICT PARALLEL SAFE
+AS 'MODULE_PATHNAME', 'citus_hll_deserialfunc';
+COMMENT ON FUNCTION pg_catalog.citus_hll_cardinality_agg_deserialfunc(bytea, internal)
+    IS 'deserialization function for citus_hll_cardinality_agg';
+
+-- merges the HyperLogLog sketches computed by citus_hll_add_agg on the
+-- coordinator and returns the approximate number of distinct values
+CREATE OR REPLACE AGGREGATE pg_catalog.citus_hll_cardinality_agg(bytea) (
+    STYPE = internal,
+    SFUNC = pg_catalog.citus_hll_cardinality_agg_sfunc,
+    FINALFUNC = pg_catalog.citus_hll_cardinality_agg_ffunc,
+    COMBINEFUNC = pg_catalog.citus_hll_cardinality_agg_combinefunc,
+    SERIALFUNC = pg_catalog.citus_hll_cardinality_agg_serialfunc,
+    DESERIALFUNC = pg_catalog.citus_hll_cardinality_agg_deserialfunc,
+    PARALLEL = SAFE
+);
+COMMENT ON AGGREGATE pg_catalog.citus_hll_cardinality_agg(bytea)
+    IS 'estimates the number of distinct values of the merged HyperLogLog sketches';
@@ -0,0 +1,28 @@
+CREATE OR REPLACE FUNCTION pg_catalog.citus_node_execution_stats(
+	OUT hostname text,
+	OUT port int,
+	OUT execution_count bigint,
+	OUT avg_task_execution_time float8,
+	OUT avg_connection_establishment_time float8,
+	OUT connection_failure_rate float8)
+RETURNS SETOF RECORD
+LANGUAGE C STRICT
+AS 'MODULE_PATHNAME', $$citus_node_execution_stats$$;
+
+COMMENT ON FUNCTION pg_catalog.citus_node_execution_stats(
+	OUT hostname text,
+	OUT port int,
+	OUT execution_count bigint,
+	OUT avg_task_execution_time float8,
+	OUT avg_connection_establishment_time float8,
+	OUT connection_failure_rate float8)
+     IS 'returns the execution statistics of remote nodes that are used for sizing connection pools';
+
+REVOKE ALL ON FUNCTION pg_catalog.citus_node_execution_stats(
+		OUT hostname text,
+		OUT port int,
+		OUT execution_count bigint,
+		OUT avg_task_execution_time float8,
+		OUT avg_connection_establishment_time float8,
+		OUT connection_failure_rate float8)
+FROM PUBLIC;
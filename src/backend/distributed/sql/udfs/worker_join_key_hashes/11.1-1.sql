@@ -0,0 +1,9 @@
+CREATE OR REPLACE FUNCTION pg_catalog.worker_join_key_hashes(
+    query text,
+    key_column_index int,
+    max_key_count int)
+RETURNS int[]
+LANGUAGE C STRICT VOLATILE
+AS 'MODULE_PATHNAME', $$worker_join_key_hashes$$;
+COMMENT ON FUNCTION pg_catalog.worker_join_key_hashes(text, int, int)
+IS 'execute a query and return the distinct hashes of a column of its results, or NULL if there are too many';
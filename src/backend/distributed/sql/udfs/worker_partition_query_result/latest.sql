@@ -1,5 +1,3 @@
-DROP FUNCTION pg_catalog.worker_partition_query_result(text, text, int, citus.distribution_type, text[], text[], boolean);
-
 CREATE OR REPLACE FUNCTION pg_catalog.worker_partition_query_result(
     result_prefix text,
     query text,
@@ -18,3 +16,25 @@ LANGUAGE C STRICT VOLATILE
 AS 'MODULE_PATHNAME', $$worker_partition_query_result$$;
 COMMENT ON FUNCTION pg_catalog.worker_partition_query_result(text, text, int, citus.distribution_type, text[], text[], boolean, boolean, boolean)
 IS 'execute a query and partitions its results in set of local result files';
+
+-- skips rows whose partition column hash is not in the join key filter, an
+-- empty filter disables the filtering
+CREATE OR REPLACE FUNCTION pg_catalog.worker_partition_query_result(
+    result_prefix text,
+    query text,
+    partition_column_index int,
+    partition_method citus.distribution_type,
+    partition_min_values text[],
+    partition_max_values text[],
+    binary_copy boolean,
+    allow_null_partition_column boolean,
+    generate_empty_results boolean,
+    join_key_filter bytea,
+    OUT partition_index int,
+    OUT rows_written bigint,
+    OUT bytes_written bigint)
+RETURNS SETOF record
+LANGUAGE C STRICT VOLATILE
+AS 'MODULE_PATHNAME', $$worker_partition_query_result$$;
+COMMENT ON FUNCTION pg_catalog.worker_partition_query_result(text, text, int, citus.distribution_type, text[], text[], boolean, boolean, boolean, bytea)
+IS 'execute a query and partitions the rows that pass the join key filter in set of local result files';
@@ -75,6 +75,15 @@ typedef struct BackendManagementShmemData
 	 */
 	pg_atomic_uint32 externalClientBackendCounter;
 
+	/*
+	 * Number of transactions that modified reference tables and did not yet
+	 * finish committing or aborting on all nodes, and the number of such
+	 * transactions that finished. The reference table result cache uses
+	 * them to avoid caching results that might predate a write.
+	 */
+	pg_atomic_uint32 referenceTableWritesInProgress;
+	pg_atomic_uint64 referenceTableWritesFinished;
+
 	BackendData backends[FLEXIBLE_ARRAY_MEMBER];
 } BackendManagementShmemData;
 
@@ -569,6 +578,10 @@ BackendManagementShmemInit(void)
 		/* there are no active backends yet, so start with zero */
 		pg_atomic_init_u32(&backendManagementShmemData->externalClientBackendCounter, 0);
 
+		/* no reference table writes happened yet */
+		pg_atomic_init_u32(&backendManagementShmemData->referenceTableWritesInProgress, 0);
+		pg_atomic_init_u64(&backendManagementShmemData->referenceTableWritesFinished, 0);
+
 		/*
 		 * We need to init per backend's spinlock before any backend
 		 * starts its execution. Note that we initialize TotalProcs (e.g., not
@@ -1378,3 +1391,50 @@ DetermineCitusBackendType(void)
 		CurrentBackendType = EXTERNAL_CLIENT_BACKEND;
 	}
 }
+
+
+/*
+ * ReferenceTableWriteStarted records in shared memory that the current
+ * transaction modifies reference tables.
+ */
+void
+ReferenceTableWriteStarted(void)
+{
+	pg_atomic_add_fetch_u32(&backendManagementShmemData->referenceTableWritesInProgress,
+							1);
+}
+
+
+/*
+ * ReferenceTableWriteFinished records in shared memory that a transaction that
+ * modified reference tables committed or aborted on all nodes. The finished
+ * counter is incremented first, such that a concurrent reader always observes
+ * one of the two changes.
+ */
+void
+ReferenceTableWriteFinished(void)
+{
+	pg_atomic_add_fetch_u64(&backendManagementShmemData->referenceTableWritesFinished,
+							1);
+	pg_atomic_sub_fetch_u32(&backendManagementShmemData->referenceTableWritesInProgress,
+							1);
+}
+
+
+/*
+ * GetReferenceTableWriteCounters returns the number of transactions that are
+ * modifying reference tables and the number of such transactions that have
+ * finished.
+ */
+void
+GetReferenceTableWriteCounters(uint32 *writesInProgress, uint64 *writesFinished)
+{
+	pg_memory_barrier();
+
+	*writesInProgress =
+		pg_atomic_read_u32(&backendManagementShmemData->referenceTableWritesInProgress);
+	*writesFinished =
+		pg_atomic_read_u64(&backendManagementShmemData->referenceTableWritesFinished);
+
+	pg_memory_barrier();
+}
@@ -10,6 +10,8 @@
 
 #include "postgres.h"
 
+#include "distributed/pg_version_constants.h"
+
 #include "libpq-fe.h"
 
 #include "miscadmin.h"
@@ -121,6 +123,81 @@ StartRemoteTransactionBegin(struct MultiConnection *connection)
 }
 
 
+/*
+ * CanPipelineRemoteTransactionBegin returns whether a remote transaction can
+ * currently be started by StartRemoteTransactionBeginInPipeline, which is the
+ * case when there are no SAVEPOINTs or SET LOCAL statements that need to be
+ * replayed on a new remote transaction. Those are kept as multi-statement
+ * strings that cannot be sent in pipeline mode.
+ */
+bool
+CanPipelineRemoteTransactionBegin(void)
+{
+#if PG_VERSION_NUM >= PG_VERSION_14
+	if (ActiveSubXactContexts() != NIL)
+	{
+		return false;
+	}
+
+	if (activeSetStmts != NULL && activeSetStmts->len > 0)
+	{
+		return false;
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+
+/*
+ * StartRemoteTransactionBeginInPipeline is a variant of
+ * StartRemoteTransactionBegin that puts the connection into libpq pipeline
+ * mode and sends "BEGIN" and assign_distributed_transaction_id() as separate
+ * commands of the pipeline. The caller is expected to queue more commands
+ * into the pipeline and to end it with PQpipelineSync(), such that all of
+ * them are sent to the remote node at once. The results of the two commands
+ * that start the transaction come first, each followed by a NULL result.
+ *
+ * The function should only be called if CanPipelineRemoteTransactionBegin()
+ * returns true.
+ */
+void
+StartRemoteTransactionBeginInPipeline(struct MultiConnection *connection)
+{
+#if PG_VERSION_NUM >= PG_VERSION_14
+	RemoteTransaction *transaction = &connection->remoteTransaction;
+
+	Assert(transaction->transactionState == REMOTE_TRANS_NOT_STARTED);
+	Assert(CanPipelineRemoteTransactionBegin());
+
+	/* remember transaction as being in-progress */
+	dlist_push_tail(&InProgressTransactions, &connection->transactionNode);
+
+	transaction->transactionState = REMOTE_TRANS_STARTING;
+	transaction->lastSuccessfulSubXact = TopSubTransactionId;
+	transaction->lastQueuedSubXact = TopSubTransactionId;
+
+	if (PQenterPipelineMode(connection->pgConn) == 0 ||
+		!SendRemoteCommandParams(connection,
+								 "BEGIN TRANSACTION ISOLATION LEVEL READ COMMITTED",
+								 0, NULL, NULL, false) ||
+		!SendRemoteCommandParams(connection, AssignDistributedTransactionIdCommand(),
+								 0, NULL, NULL, false))
+	{
+		const bool raiseErrors = true;
+
+		HandleRemoteTransactionConnectionError(connection, raiseErrors);
+	}
+
+	transaction->beginSent = true;
+#else
+	ereport(ERROR, (errmsg("pipeline mode requires PostgreSQL 14 or later")));
+#endif
+}
+
+
 /*
  * BeginAndSetDistributedTransactionIdCommand returns a command which starts
  * a transaction and assigns the current distributed transaction id.
@@ -33,6 +33,7 @@
 #include "distributed/multi_executor.h"
 #include "distributed/multi_logical_replication.h"
 #include "distributed/multi_explain.h"
+#include "distributed/reference_table_result_cache.h"
 #include "distributed/repartition_join_execution.h"
 #include "distributed/transaction_management.h"
 #include "distributed/placement_connection.h"
@@ -446,6 +447,8 @@ CoordinatedTransactionCallback(XactEvent event, void *arg)
 			RemoveIntermediateResultsDirectories();
 
 			UnSetDistributedTransactionId();
+
+			ReferenceTableResultCacheTransactionEnd();
 			break;
 		}
 
@@ -600,6 +603,11 @@ ResetGlobalVariables()
 	ResetWorkerErrorIndication();
 	memset(&AllowedDistributionColumnValue, 0,
 		   sizeof(AllowedDistributionColumn));
+
+	/* remote transactions are finished, cached results can be stored again */
+	ReferenceTableResultCacheTransactionEnd();
+
+	ResetStreamingConnectionClaims();
 }
 
 
@@ -669,6 +677,9 @@ CoordinatedSubTransactionCallback(SubXactEvent event, SubTransactionId subId,
 			}
 			PopSubXact(subId);
 
+			/* scans of the subtransaction no longer use their connections */
+			ReleaseStreamingConnectionClaims(subId);
+
 			/*
 			 * Clear MetadataCache table if we're aborting from a CREATE EXTENSION Citus
 			 * so that any created OIDs from the table are cleared and invalidated. We
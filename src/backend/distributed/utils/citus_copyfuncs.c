@@ -199,6 +199,7 @@ CopyNodeMapMergeJob(COPYFUNC_ARGS)
 	copyJobInfo(&newnode->job, &from->job);
 
 	COPY_NODE_FIELD(reduceQuery);
+	COPY_SCALAR_FIELD(boundaryNodeJobType);
 	COPY_SCALAR_FIELD(partitionType);
 	COPY_NODE_FIELD(partitionColumn);
 	COPY_SCALAR_FIELD(partitionCount);
@@ -211,6 +212,9 @@ CopyNodeMapMergeJob(COPYFUNC_ARGS)
 
 	COPY_NODE_FIELD(mapTaskList);
 	COPY_NODE_FIELD(mergeTaskList);
+	COPY_SCALAR_FIELD(buildJoinKeyFilter);
+	COPY_NODE_FIELD(joinKeyFilterTaskList);
+	COPY_SCALAR_FIELD(joinKeyFilterJobId);
 }
 
 
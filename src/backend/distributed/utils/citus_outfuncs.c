@@ -402,6 +402,7 @@ OutMapMergeJob(OUTFUNC_ARGS)
 
 	OutJobFields(str, (Job *) node);
 	WRITE_NODE_FIELD(reduceQuery);
+	WRITE_ENUM_FIELD(boundaryNodeJobType, BoundaryNodeJobType);
 	WRITE_ENUM_FIELD(partitionType, PartitionType);
 	WRITE_NODE_FIELD(partitionColumn);
 	WRITE_UINT_FIELD(partitionCount);
@@ -414,6 +415,9 @@ OutMapMergeJob(OUTFUNC_ARGS)
 
 	WRITE_NODE_FIELD(mapTaskList);
 	WRITE_NODE_FIELD(mergeTaskList);
+	WRITE_BOOL_FIELD(buildJoinKeyFilter);
+	WRITE_NODE_FIELD(joinKeyFilterTaskList);
+	WRITE_UINT64_FIELD(joinKeyFilterJobId);
 }
 
 
@@ -0,0 +1,691 @@
+/*-------------------------------------------------------------------------
+ *
+ * hyperloglog.c
+ *
+ * Implementation of the built-in HyperLogLog aggregates that Citus uses to
+ * approximate count(distinct) when the hll extension is not available.
+ *
+ * Worker nodes compute citus_hll_add_agg(value, precision), which hashes the
+ * values using the extended hash function of their type and returns a
+ * serialized sketch per group. The coordinator merges the sketches of all
+ * shards using citus_hll_cardinality_agg(sketch), which returns the estimated
+ * number of distinct values.
+ *
+ * A sketch with precision p has 2^p registers. Sketches of small groups
+ * only have a few registers set, so we keep them as a list of (index, rank)
+ * entries until they grow large, both in memory and when serialized. This
+ * keeps the intermediate results of high-cardinality GROUP BYs small. Sparse
+ * entries are serialized in network byte order, so sketches can be merged on
+ * nodes with a different byte order.
+ *
+ * Both aggregates have the sketch as their transition state, and share the
+ * combine, serialization and deserialization functions that allow them to
+ * run in parallel workers.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <math.h>
+
+#include "fmgr.h"
+#include "miscadmin.h"
+
+#include "port/pg_bitutils.h"
+#include "port/pg_bswap.h"
+#include "utils/builtins.h"
+#include "utils/memutils.h"
+#include "utils/typcache.h"
+
+
+/* allowed range of the precision, in line with the hll extension */
+#define HLL_MIN_PRECISION 4
+#define HLL_MAX_PRECISION 17
+
+/* a sketch becomes dense once a sparse list would be larger than this */
+#define HLL_MAX_SPARSE_ENTRIES(precision) Min((1 << (precision)) / 16, 256)
+
+/* formats of serialized sketches */
+#define HLL_FORMAT_SPARSE 1
+#define HLL_FORMAT_DENSE 2
+
+/* precision and format bytes in front of the registers of a serialized sketch */
+#define HLL_HEADER_SIZE 2
+
+/* sparse entries hold the register index in the upper bits */
+#define HLL_SPARSE_ENTRY(index, rank) (((uint32) (index) << 8) | (rank))
+#define HLL_SPARSE_ENTRY_INDEX(entry) ((entry) >> 8)
+#define HLL_SPARSE_ENTRY_RANK(entry) ((uint8) ((entry) & 0xFF))
+
+
+/*
+ * HllSketch is the transition state of the HyperLogLog aggregates.
+ */
+typedef struct HllSketch
+{
+	int precision;
+
+	/* extended hash function of the input type, only set by the add aggregate */
+	FmgrInfo *hashFunction;
+
+	/* registers that are set while the sketch is sparse */
+	uint32 *sparseEntries;
+	int sparseEntryCount;
+
+	/* all registers once the sketch is dense, NULL while sparse */
+	uint8 *registers;
+} HllSketch;
+
+
+static HllSketch * CreateHllSketch(int precision, MemoryContext aggregateContext);
+static void HllAddHash(HllSketch *sketch, uint64 hash);
+static void HllUpdateRegister(HllSketch *sketch, uint32 registerIndex, uint8 rank);
+static void HllMakeDense(HllSketch *sketch);
+static void HllMergeSketch(HllSketch *sketch, HllSketch *otherSketch);
+static int HllSerializedPrecision(bytea *serializedSketch);
+static void HllMergeSerialized(HllSketch *sketch, bytea *serializedSketch);
+static bytea * HllSerialize(HllSketch *sketch);
+static double HllEstimate(HllSketch *sketch);
+static MemoryContext HllAggregateContext(FunctionCallInfo fcinfo);
+
+
+PG_FUNCTION_INFO_V1(citus_hll_add_agg_sfunc);
+PG_FUNCTION_INFO_V1(citus_hll_add_agg_ffunc);
+PG_FUNCTION_INFO_V1(citus_hll_cardinality_agg_sfunc);
+PG_FUNCTION_INFO_V1(citus_hll_cardinality_agg_ffunc);
+PG_FUNCTION_INFO_V1(citus_hll_combinefunc);
+PG_FUNCTION_INFO_V1(citus_hll_serialfunc);
+PG_FUNCTION_INFO_V1(citus_hll_deserialfunc);
+
+
+/*
+ * citus_hll_add_agg_sfunc adds the hash of the given value to the sketch,
+ * which is created on the first call with the given precision.
+ */
+Datum
+citus_hll_add_agg_sfunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggregateContext = HllAggregateContext(fcinfo);
+	HllSketch *sketch = PG_ARGISNULL(0) ? NULL : (HllSketch *) PG_GETARG_POINTER(0);
+
+	if (sketch == NULL)
+	{
+		if (PG_ARGISNULL(2))
+		{
+			ereport(ERROR, (errmsg("precision of the sketch cannot be NULL")));
+		}
+
+		int precision = PG_GETARG_INT32(2);
+		sketch = CreateHllSketch(precision, aggregateContext);
+
+		Oid argumentType = get_fn_expr_argtype(fcinfo->flinfo, 1);
+		TypeCacheEntry *typeEntry =
+			lookup_type_cache(argumentType, TYPECACHE_HASH_EXTENDED_PROC_FINFO);
+		if (!OidIsValid(typeEntry->hash_extended_proc))
+		{
+			ereport(ERROR, (errcode(ERRCODE_UNDEFINED_FUNCTION),
+							errmsg("could not identify an extended hash function "
+								   "for type %s", format_type_be(argumentType))));
+		}
+
+		sketch->hashFunction = &typeEntry->hash_extended_proc_finfo;
+	}
+
+	/* count(distinct) ignores NULLs */
+	if (!PG_ARGISNULL(1))
+	{
+		uint64 seed = 0;
+		Datum hashDatum = FunctionCall2Coll(sketch->hashFunction, PG_GET_COLLATION(),
+											PG_GETARG_DATUM(1), UInt64GetDatum(seed));
+
+		HllAddHash(sketch, DatumGetUInt64(hashDatum));
+	}
+
+	PG_RETURN_POINTER(sketch);
+}
+
+
+/*
+ * citus_hll_add_agg_ffunc serializes the sketch, or returns NULL if there
+ * were no rows.
+ */
+Datum
+citus_hll_add_agg_ffunc(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(0))
+	{
+		PG_RETURN_NULL();
+	}
+
+	HllSketch *sketch = (HllSketch *) PG_GETARG_POINTER(0);
+
+	PG_RETURN_BYTEA_P(HllSerialize(sketch));
+}
+
+
+/*
+ * citus_hll_cardinality_agg_sfunc merges the given serialized sketch into
+ * the transition state.
+ */
+Datum
+citus_hll_cardinality_agg_sfunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggregateContext = HllAggregateContext(fcinfo);
+	HllSketch *sketch = PG_ARGISNULL(0) ? NULL : (HllSketch *) PG_GETARG_POINTER(0);
+
+	/* shards without rows in the group send NULL */
+	if (PG_ARGISNULL(1))
+	{
+		if (sketch == NULL)
+		{
+			PG_RETURN_NULL();
+		}
+
+		PG_RETURN_POINTER(sketch);
+	}
+
+	bytea *serializedSketch = PG_GETARG_BYTEA_PP(1);
+
+	if (sketch == NULL)
+	{
+		int precision = HllSerializedPrecision(serializedSketch);
+		sketch = CreateHllSketch(precision, aggregateContext);
+	}
+
+	HllMergeSerialized(sketch, serializedSketch);
+
+	PG_RETURN_POINTER(sketch);
+}
+
+
+/*
+ * citus_hll_cardinality_agg_ffunc returns the estimated number of distinct
+ * values of the merged sketches.
+ */
+Datum
+citus_hll_cardinality_agg_ffunc(PG_FUNCTION_ARGS)
+{
+	if (PG_ARGISNULL(0))
+	{
+		PG_RETURN_INT64(0);
+	}
+
+	HllSketch *sketch = (HllSketch *) PG_GETARG_POINTER(0);
+
+	PG_RETURN_INT64((int64) rint(HllEstimate(sketch)));
+}
+
+
+/*
+ * citus_hll_combinefunc merges the second sketch into the first one, which
+ * is created in the aggregate context if it does not exist yet.
+ */
+Datum
+citus_hll_combinefunc(PG_FUNCTION_ARGS)
+{
+	MemoryContext aggregateContext = HllAggregateContext(fcinfo);
+	HllSketch *sketch = PG_ARGISNULL(0) ? NULL : (HllSketch *) PG_GETARG_POINTER(0);
+
+	if (PG_ARGISNULL(1))
+	{
+		if (sketch == NULL)
+		{
+			PG_RETURN_NULL();
+		}
+
+		PG_RETURN_POINTER(sketch);
+	}
+
+	HllSketch *otherSketch = (HllSketch *) PG_GETARG_POINTER(1);
+
+	if (sketch == NULL)
+	{
+		sketch = CreateHllSketch(otherSketch->precision, aggregateContext);
+	}
+
+	HllMergeSketch(sketch, otherSketch);
+
+	PG_RETURN_POINTER(sketch);
+}
+
+
+/*
+ * citus_hll_serialfunc serializes the sketch to pass it between parallel
+ * workers and the leader.
+ */
+Datum
+citus_hll_serialfunc(PG_FUNCTION_ARGS)
+{
+	if (!AggCheckCallContext(fcinfo, NULL))
+	{
+		elog(ERROR, "HyperLogLog function called in non-aggregate context");
+	}
+
+	HllSketch *sketch = (HllSketch *) PG_GETARG_POINTER(0);
+
+	PG_RETURN_BYTEA_P(HllSerialize(sketch));
+}
+
+
+/*
+ * citus_hll_deserialfunc deserializes a sketch that was serialized by
+ * citus_hll_serialfunc.
+ */
+Datum
+citus_hll_deserialfunc(PG_FUNCTION_ARGS)
+{
+	if (!AggCheckCallContext(fcinfo, NULL))
+	{
+		elog(ERROR, "HyperLogLog function called in non-aggregate context");
+	}
+
+	bytea *serializedSketch = PG_GETARG_BYTEA_PP(0);
+
+	int precision = HllSerializedPrecision(serializedSketch);
+	HllSketch *sketch = CreateHllSketch(precision, CurrentMemoryContext);
+
+	HllMergeSerialized(sketch, serializedSketch);
+
+	PG_RETURN_POINTER(sketch);
+}
+
+
+/*
+ * CreateHllSketch creates an empty sparse sketch with the given precision
+ * in the aggregate context.
+ */
+static HllSketch *
+CreateHllSketch(int precision, MemoryContext aggregateContext)
+{
+	if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("precision of the sketch must be between %d and %d",
+							   HLL_MIN_PRECISION, HLL_MAX_PRECISION)));
+	}
+
+	HllSketch *sketch = MemoryContextAllocZero(aggregateContext, sizeof(HllSketch));
+	sketch->precision = precision;
+	sketch->sparseEntries =
+		MemoryContextAlloc(aggregateContext,
+						   HLL_MAX_SPARSE_ENTRIES(precision) * sizeof(uint32));
+
+	return sketch;
+}
+
+
+/*
+ * HllAddHash adds a 64-bit hash value to the sketch. The first bits of the
+ * hash pick the register, and the register keeps the maximum position of
+ * the first set bit in the remaining bits.
+ */
+static void
+HllAddHash(HllSketch *sketch, uint64 hash)
+{
+	int precision = sketch->precision;
+	uint32 registerIndex = (uint32) (hash >> (64 - precision));
+	uint64 remainingBits = hash << precision;
+	uint8 rank = 0;
+
+	if (remainingBits == 0)
+	{
+		rank = 64 - precision + 1;
+	}
+	else
+	{
+		rank = 64 - pg_leftmost_one_pos64(remainingBits);
+	}
+
+	HllUpdateRegister(sketch, registerIndex, rank);
+}
+
+
+/*
+ * HllUpdateRegister raises the given register of the sketch to rank, and
+ * makes the sketch dense when the sparse list is full.
+ */
+static void
+HllUpdateRegister(HllSketch *sketch, uint32 registerIndex, uint8 rank)
+{
+	if (sketch->registers != NULL)
+	{
+		sketch->registers[registerIndex] = Max(sketch->registers[registerIndex], rank);
+		return;
+	}
+
+	for (int entryIndex = 0; entryIndex < sketch->sparseEntryCount; entryIndex++)
+	{
+		uint32 entry = sketch->sparseEntries[entryIndex];
+		if (HLL_SPARSE_ENTRY_INDEX(entry) == registerIndex)
+		{
+			if (rank > HLL_SPARSE_ENTRY_RANK(entry))
+			{
+				sketch->sparseEntries[entryIndex] = HLL_SPARSE_ENTRY(registerIndex, rank);
+			}
+
+			return;
+		}
+	}
+
+	if (sketch->sparseEntryCount < HLL_MAX_SPARSE_ENTRIES(sketch->precision))
+	{
+		sketch->sparseEntries[sketch->sparseEntryCount++] =
+			HLL_SPARSE_ENTRY(registerIndex, rank);
+		return;
+	}
+
+	HllMakeDense(sketch);
+	sketch->registers[registerIndex] = Max(sketch->registers[registerIndex], rank);
+}
+
+
+/*
+ * HllMakeDense switches the sketch from the sparse list to an array of all
+ * registers. The registers are allocated in the memory context of the
+ * sparse list.
+ */
+static void
+HllMakeDense(HllSketch *sketch)
+{
+	if (sketch->registers != NULL)
+	{
+		return;
+	}
+
+	MemoryContext sketchContext = GetMemoryChunkContext(sketch->sparseEntries);
+	uint8 *registers = MemoryContextAllocZero(sketchContext, 1 << sketch->precision);
+
+	for (int entryIndex = 0; entryIndex < sketch->sparseEntryCount; entryIndex++)
+	{
+		uint32 entry = sketch->sparseEntries[entryIndex];
+		registers[HLL_SPARSE_ENTRY_INDEX(entry)] = HLL_SPARSE_ENTRY_RANK(entry);
+	}
+
+	sketch->registers = registers;
+	sketch->sparseEntryCount = 0;
+}
+
+
+/*
+ * HllMergeSketch merges another sketch into the given sketch, by taking the
+ * maximum of each register.
+ */
+static void
+HllMergeSketch(HllSketch *sketch, HllSketch *otherSketch)
+{
+	if (otherSketch->precision != sketch->precision)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("cannot merge HyperLogLog sketches with precisions "
+							   "%d and %d", sketch->precision, otherSketch->precision)));
+	}
+
+	if (otherSketch->registers != NULL)
+	{
+		uint32 registerCount = 1 << sketch->precision;
+
+		HllMakeDense(sketch);
+
+		for (uint32 registerIndex = 0; registerIndex < registerCount; registerIndex++)
+		{
+			sketch->registers[registerIndex] = Max(sketch->registers[registerIndex],
+												   otherSketch->registers[registerIndex]);
+		}
+
+		return;
+	}
+
+	for (int entryIndex = 0; entryIndex < otherSketch->sparseEntryCount; entryIndex++)
+	{
+		uint32 entry = otherSketch->sparseEntries[entryIndex];
+
+		HllUpdateRegister(sketch, HLL_SPARSE_ENTRY_INDEX(entry),
+						  HLL_SPARSE_ENTRY_RANK(entry));
+	}
+}
+
+
+/*
+ * HllSerializedPrecision returns the precision of a serialized sketch, and
+ * errors out if it is too short to be one.
+ */
+static int
+HllSerializedPrecision(bytea *serializedSketch)
+{
+	if (VARSIZE_ANY_EXHDR(serializedSketch) < HLL_HEADER_SIZE)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						errmsg("invalid HyperLogLog sketch")));
+	}
+
+	return (uint8) VARDATA_ANY(serializedSketch)[0];
+}
+
+
+/*
+ * HllMergeSerialized merges a serialized sketch into the given sketch, by
+ * taking the maximum of each register.
+ */
+static void
+HllMergeSerialized(HllSketch *sketch, bytea *serializedSketch)
+{
+	uint8 *data = (uint8 *) VARDATA_ANY(serializedSketch);
+	Size dataSize = VARSIZE_ANY_EXHDR(serializedSketch);
+	int precision = data[0];
+	int format = data[1];
+	uint32 registerCount = 1 << sketch->precision;
+
+	if (precision != sketch->precision)
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						errmsg("cannot merge HyperLogLog sketches with precisions "
+							   "%d and %d", sketch->precision, precision)));
+	}
+
+	if (format == HLL_FORMAT_DENSE && dataSize == HLL_HEADER_SIZE + registerCount)
+	{
+		uint8 *registers = data + HLL_HEADER_SIZE;
+
+		HllMakeDense(sketch);
+
+		for (uint32 registerIndex = 0; registerIndex < registerCount; registerIndex++)
+		{
+			sketch->registers[registerIndex] = Max(sketch->registers[registerIndex],
+												   registers[registerIndex]);
+		}
+	}
+	else if (format == HLL_FORMAT_SPARSE &&
+			 (dataSize - HLL_HEADER_SIZE) % sizeof(uint32) == 0)
+	{
+		int entryCount = (dataSize - HLL_HEADER_SIZE) / sizeof(uint32);
+
+		for (int entryIndex = 0; entryIndex < entryCount; entryIndex++)
+		{
+			uint32 networkEntry = 0;
+			memcpy(&networkEntry, data + HLL_HEADER_SIZE + entryIndex * sizeof(uint32),
+				   sizeof(uint32));
+
+			uint32 entry = pg_ntoh32(networkEntry);
+
+			if (HLL_SPARSE_ENTRY_INDEX(entry) >= registerCount)
+			{
+				ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+								errmsg("invalid HyperLogLog sketch")));
+			}
+
+			HllUpdateRegister(sketch, HLL_SPARSE_ENTRY_INDEX(entry),
+							  HLL_SPARSE_ENTRY_RANK(entry));
+		}
+	}
+	else
+	{
+		ereport(ERROR, (errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+						errmsg("invalid HyperLogLog sketch")));
+	}
+}
+
+
+/*
+ * HllSerialize returns the sketch as a bytea, using the sparse format when
+ * it is smaller than the dense one.
+ */
+static bytea *
+HllSerialize(HllSketch *sketch)
+{
+	uint32 registerCount = 1 << sketch->precision;
+	uint32 *sparseEntries = sketch->sparseEntries;
+	int sparseEntryCount = sketch->sparseEntryCount;
+
+	if (sketch->registers != NULL)
+	{
+		/* dense sketches of merged small groups can still be mostly empty */
+		int setRegisterCount = 0;
+		for (uint32 registerIndex = 0; registerIndex < registerCount; registerIndex++)
+		{
+			setRegisterCount += (sketch->registers[registerIndex] != 0);
+		}
+
+		if (setRegisterCount * sizeof(uint32) < registerCount)
+		{
+			sparseEntries = palloc(setRegisterCount * sizeof(uint32));
+			sparseEntryCount = 0;
+
+			for (uint32 registerIndex = 0; registerIndex < registerCount;
+				 registerIndex++)
+			{
+				uint8 rank = sketch->registers[registerIndex];
+				if (rank != 0)
+				{
+					sparseEntries[sparseEntryCount++] =
+						HLL_SPARSE_ENTRY(registerIndex, rank);
+				}
+			}
+		}
+		else
+		{
+			Size dataSize = HLL_HEADER_SIZE + registerCount;
+			bytea *serializedSketch = palloc(VARHDRSZ + dataSize);
+			SET_VARSIZE(serializedSketch, VARHDRSZ + dataSize);
+
+			uint8 *data = (uint8 *) VARDATA(serializedSketch);
+			data[0] = sketch->precision;
+			data[1] = HLL_FORMAT_DENSE;
+			memcpy(data + HLL_HEADER_SIZE, sketch->registers, registerCount);
+
+			return serializedSketch;
+		}
+	}
+
+	Size dataSize = HLL_HEADER_SIZE + sparseEntryCount * sizeof(uint32);
+	bytea *serializedSketch = palloc(VARHDRSZ + dataSize);
+	SET_VARSIZE(serializedSketch, VARHDRSZ + dataSize);
+
+	uint8 *data = (uint8 *) VARDATA(serializedSketch);
+	data[0] = sketch->precision;
+	data[1] = HLL_FORMAT_SPARSE;
+
+	for (int entryIndex = 0; entryIndex < sparseEntryCount; entryIndex++)
+	{
+		uint32 networkEntry = pg_hton32(sparseEntries[entryIndex]);
+
+		memcpy(data + HLL_HEADER_SIZE + entryIndex * sizeof(uint32), &networkEntry,
+			   sizeof(uint32));
+	}
+
+	return serializedSketch;
+}
+
+
+/*
+ * HllEstimate returns the HyperLogLog estimate of the number of distinct
+ * values in the sketch, using linear counting for small cardinalities. We
+ * use 64-bit hashes, so no correction is needed for large cardinalities.
+ */
+static double
+HllEstimate(HllSketch *sketch)
+{
+	uint32 registerCount = 1 << sketch->precision;
+	double registerCountDouble = (double) registerCount;
+	double inverseSum = 0.0;
+	uint32 zeroRegisterCount = 0;
+
+	if (sketch->registers != NULL)
+	{
+		for (uint32 registerIndex = 0; registerIndex < registerCount; registerIndex++)
+		{
+			uint8 rank = sketch->registers[registerIndex];
+
+			inverseSum += ldexp(1.0, -rank);
+			zeroRegisterCount += (rank == 0);
+		}
+	}
+	else
+	{
+		zeroRegisterCount = registerCount - sketch->sparseEntryCount;
+		inverseSum = zeroRegisterCount;
+
+		for (int entryIndex = 0; entryIndex < sketch->sparseEntryCount; entryIndex++)
+		{
+			inverseSum += ldexp(1.0, -HLL_SPARSE_ENTRY_RANK(
+									sketch->sparseEntries[entryIndex]));
+		}
+	}
+
+	double alpha = 0.0;
+	switch (registerCount)
+	{
+		case 16:
+		{
+			alpha = 0.673;
+			break;
+		}
+
+		case 32:
+		{
+			alpha = 0.697;
+			break;
+		}
+
+		case 64:
+		{
+			alpha = 0.709;
+			break;
+		}
+
+		default:
+		{
+			alpha = 0.7213 / (1.0 + 1.079 / registerCountDouble);
+			break;
+		}
+	}
+
+	double estimate = alpha * registerCountDouble * registerCountDouble / inverseSum;
+
+	if (estimate <= 2.5 * registerCountDouble && zeroRegisterCount > 0)
+	{
+		estimate = registerCountDouble * log(registerCountDouble / zeroRegisterCount);
+	}
+
+	return estimate;
+}
+
+
+/*
+ * HllAggregateContext returns the aggregate context of the call, and errors
+ * out if the function is not called as an aggregate.
+ */
+static MemoryContext
+HllAggregateContext(FunctionCallInfo fcinfo)
+{
+	MemoryContext aggregateContext = NULL;
+
+	if (!AggCheckCallContext(fcinfo, &aggregateContext))
+	{
+		elog(ERROR, "HyperLogLog function called in non-aggregate context");
+	}
+
+	return aggregateContext;
+}
@@ -14,8 +14,10 @@
 #include "postgres.h"
 
 #include "fmgr.h"
+#include "access/relscan.h"
 #include "lib/stringinfo.h"
 #include "nodes/parsenodes.h"
+#include "port/atomics.h"
 #include "storage/bufpage.h"
 #include "storage/lockdefs.h"
 #include "storage/relfilenode.h"
@@ -23,6 +25,7 @@
 #include "utils/snapmgr.h"
 
 #include "columnar/columnar_compression.h"
+#include "columnar/columnar_encoding.h"
 #include "columnar/columnar_metadata.h"
 
 #define COLUMNAR_AM_NAME "columnar"
@@ -43,6 +46,16 @@
 #define COMPRESSION_LEVEL_MIN 1
 #define COMPRESSION_LEVEL_MAX 19
 
+/*
+ * Parameters of the per chunk membership information built for the columns
+ * listed in the bloom_filter_columns option. Chunks with at most
+ * COLUMNAR_DISTINCT_VALUES_MAX distinct values keep the exact value set,
+ * other chunks keep a bloom filter sized for ~1% false positives.
+ */
+#define COLUMNAR_DISTINCT_VALUES_MAX 16
+#define COLUMNAR_BLOOM_FILTER_BITS_PER_ROW 10
+#define COLUMNAR_BLOOM_FILTER_HASH_COUNT 7
+
 /* Columnar file signature */
 #define COLUMNAR_VERSION_MAJOR 2
 #define COLUMNAR_VERSION_MINOR 0
@@ -67,6 +80,12 @@ typedef struct ColumnarOptions
 	uint32 chunkRowCount;
 	CompressionType compressionType;
 	int compressionLevel;
+
+	/* comma separated list of column names, NULL if not set */
+	char *bloomFilterColumns;
+
+	/* comma separated list of columns to sort stripes by, NULL if not set */
+	char *sortKey;
 } ColumnarOptions;
 
 
@@ -97,6 +116,20 @@ typedef struct ColumnChunkSkipNode
 
 	CompressionType valueCompressionType;
 	int valueCompressionLevel;
+
+	/* lightweight encoding applied to the value stream before compression */
+	ColumnarEncodingType valueEncodingType;
+
+	/*
+	 * Membership information used to skip chunks for equality lookups. Only
+	 * built for columns listed in the bloom_filter_columns option. Either the
+	 * exact set of distinct values (hasDistinctValues) or a bloom filter over
+	 * the hashes of the values is available.
+	 */
+	bool hasDistinctValues;
+	uint32 distinctValueCount;
+	Datum *distinctValues;
+	bytea *bloomFilter;
 } ColumnChunkSkipNode;
 
 
@@ -138,18 +171,35 @@ typedef struct ChunkData
 } ChunkData;
 
 
+/*
+ * ParallelColumnarScanDescData is the shared state of a parallel columnar
+ * scan. Stripes are the unit of work: participants claim the stripe at
+ * nextStripeIndex in the row number ordered list of stripes visible to the
+ * (shared) snapshot of the scan.
+ */
+typedef struct ParallelColumnarScanDescData
+{
+	ParallelTableScanDescData base;
+	pg_atomic_uint64 nextStripeIndex;
+} ParallelColumnarScanDescData;
+
+typedef struct ParallelColumnarScanDescData *ParallelColumnarScanDesc;
+
+
 /*
  * ColumnChunkBuffers represents a chunk of serialized data in a column.
  * valueBuffer stores the serialized values of data, and existsBuffer stores
  * serialized value of presence information. valueCompressionType contains
- * compression type if valueBuffer is compressed. Finally rowCount has
- * the number of rows in this chunk.
+ * compression type if valueBuffer is compressed, and valueEncodingType
+ * contains the encoding applied to the values before compression. Finally
+ * rowCount has the number of rows in this chunk.
  */
 typedef struct ColumnChunkBuffers
 {
 	StringInfo existsBuffer;
 	StringInfo valueBuffer;
 	CompressionType valueCompressionType;
+	ColumnarEncodingType valueEncodingType;
 	uint64 decompressedValueSize;
 } ColumnChunkBuffers;
 
@@ -195,15 +245,72 @@ typedef enum StripeWriteStateEnum
 	STRIPE_WRITE_IN_PROGRESS
 } StripeWriteStateEnum;
 
+/*
+ * ColumnarBloomFilterBit returns the bit to set or test for the given hash
+ * function index, using double hashing to derive the hash functions from a
+ * single 32-bit hash value.
+ */
+static inline uint32
+ColumnarBloomFilterBit(uint32 hashValue, int hashIndex, uint32 bitCount)
+{
+	uint32 secondHash = (hashValue >> 17) | (hashValue << 15);
+
+	return (hashValue + hashIndex * (secondHash | 1)) % bitCount;
+}
+
+
+/*
+ * ColumnarBloomFilterMightContain returns false if the value with the given
+ * hash is certainly not in the set described by the bloom filter.
+ */
+static inline bool
+ColumnarBloomFilterMightContain(bytea *bloomFilter, uint32 hashValue)
+{
+	uint8 *bits = (uint8 *) VARDATA_ANY(bloomFilter);
+	uint32 bitCount = VARSIZE_ANY_EXHDR(bloomFilter) * 8;
+
+	for (int hashIndex = 0; hashIndex < COLUMNAR_BLOOM_FILTER_HASH_COUNT; hashIndex++)
+	{
+		uint32 bit = ColumnarBloomFilterBit(hashValue, hashIndex, bitCount);
+		if ((bits[bit / 8] & (1 << (bit % 8))) == 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
 typedef bool (*ColumnarSupportsIndexAM_type)(char *);
 typedef const char *(*CompressionTypeStr_type)(CompressionType);
 typedef bool (*IsColumnarTableAmTable_type)(Oid);
 typedef bool (*ReadColumnarOptions_type)(Oid, ColumnarOptions *);
+typedef bool (*ColumnarHasPendingWrites_type)(void);
 
 /* ColumnarReadState represents state of a columnar scan. */
 struct ColumnarReadState;
 typedef struct ColumnarReadState ColumnarReadState;
 
+/*
+ * ColumnarCoveredChunkGroupCallback is called for each chunk group that has
+ * no NULLs in the filtered columns and whose rows all satisfy the scan quals
+ * according to the skip list. If it returns true, the chunk group is not read.
+ */
+typedef bool (*ColumnarCoveredChunkGroupCallback)(StripeMetadata *stripeMetadata,
+												  StripeSkipList *stripeSkipList,
+												  uint32 chunkIndex, void *arg);
+
+/*
+ * ColumnarChunkGroupBatchCallback is called for each chunk group that is read
+ * when all scan quals could be evaluated over the column arrays of the chunk
+ * group. selectionMask marks the rows that satisfy the quals, or is NULL if
+ * all rows do. The rows of the chunk group are not returned by the scan.
+ */
+typedef void (*ColumnarChunkGroupBatchCallback)(ChunkData *chunkData,
+												const bool *selectionMask,
+												void *arg);
+
 
 /* ColumnarWriteState represents state of a columnar write operation. */
 struct ColumnarWriteState;
@@ -214,6 +321,10 @@ extern int columnar_compression;
 extern int columnar_stripe_row_limit;
 extern int columnar_chunk_group_row_limit;
 extern int columnar_compression_level;
+extern bool columnar_enable_vectorized_filter;
+extern bool columnar_enable_column_encoding;
+extern bool columnar_enable_prefetch;
+extern int columnar_max_parallel_compression_workers;
 
 /* called when the user changes options on the given relation */
 typedef void (*ColumnarTableSetOptions_hook_type)(Oid relid, ColumnarOptions options);
@@ -222,6 +333,7 @@ extern void columnar_init(void);
 extern void columnar_init_gucs(void);
 
 extern CompressionType ParseCompressionType(const char *compressionTypeString);
+extern List * ColumnarOptionColumnNameList(const char *columnNames);
 
 /* Function declarations for writing to a columnar table */
 extern ColumnarWriteState * ColumnarBeginWrite(RelFileNode relfilenode,
@@ -231,6 +343,7 @@ extern uint64 ColumnarWriteRow(ColumnarWriteState *state, Datum *columnValues,
 							   bool *columnNulls);
 extern void ColumnarFlushPendingWrites(ColumnarWriteState *state);
 extern void ColumnarEndWrite(ColumnarWriteState *state);
+extern void ColumnarEndWriteAtTransactionEnd(ColumnarWriteState *state);
 extern bool ContainsPendingWrites(ColumnarWriteState *state);
 extern MemoryContext ColumnarWritePerTupleContext(ColumnarWriteState *state);
 
@@ -243,8 +356,12 @@ extern ColumnarReadState * ColumnarBeginRead(Relation relation,
 											 List *qualConditions,
 											 MemoryContext scanContext,
 											 Snapshot snaphot,
-											 bool randomAccess);
+											 bool randomAccess,
+											 ParallelColumnarScanDesc parallelScan);
 extern void ColumnarReadFlushPendingWrites(ColumnarReadState *readState);
+extern Snapshot ColumnarFlushPendingWritesForSnapshot(Relation relation,
+													  Snapshot snapshot,
+													  bool *snapshotRegisteredByUs);
 extern void ColumnarEndRead(ColumnarReadState *state);
 extern void ColumnarResetRead(ColumnarReadState *readState);
 
@@ -253,6 +370,12 @@ extern bool ColumnarReadNextRow(ColumnarReadState *state, Datum *columnValues,
 								bool *columnNulls, uint64 *rowNumber);
 extern int64 ColumnarReadChunkGroupsFiltered(ColumnarReadState *state);
 extern void ColumnarRescan(ColumnarReadState *readState, List *scanQual);
+extern void ColumnarReadSetCoveredChunkGroupCallback(ColumnarReadState *readState,
+													 ColumnarCoveredChunkGroupCallback
+													 callback, void *arg);
+extern void ColumnarReadSetChunkGroupBatchCallback(ColumnarReadState *readState,
+												   ColumnarChunkGroupBatchCallback
+												   callback, void *arg);
 
 /* functions only applicable for random access */
 extern void ColumnarReadRowByRowNumberOrError(ColumnarReadState *readState,
@@ -280,6 +403,7 @@ extern bool IsColumnarTableAmTable(Oid relationId);
 
 /* columnar_metadata_tables.c */
 extern void DeleteMetadataRows(RelFileNode relfilenode);
+extern void DeleteStripeMetadataRows(RelFileNode relfilenode, uint64 stripeId);
 extern uint64 ColumnarMetadataNewStorageId(void);
 extern uint64 GetHighestUsedAddress(RelFileNode relfilenode);
 extern EmptyStripeReservation * ReserveEmptyStripe(Relation rel, uint64 columnCount,
@@ -323,6 +447,7 @@ extern void DiscardWriteStateForAllRels(SubTransactionId currentSubXid, SubTrans
 										parentSubXid);
 extern void MarkRelfilenodeDropped(Oid relfilenode, SubTransactionId currentSubXid);
 extern void NonTransactionDropWriteState(Oid relfilenode);
+extern bool ColumnarHasPendingWrites(void);
 extern bool PendingWritesInUpperTransactions(Oid relfilenode,
 											 SubTransactionId currentSubXid);
 extern MemoryContext GetWriteContextForDebug(void);
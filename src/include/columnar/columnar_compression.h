@@ -12,6 +12,9 @@
 #ifndef COLUMNAR_COMPRESSION_H
 #define COLUMNAR_COMPRESSION_H
 
+#include "storage/dsm.h"
+#include "storage/shm_toc.h"
+
 /* Enumaration for columnar table's compression method */
 typedef enum
 {
@@ -30,5 +33,10 @@ extern bool CompressBuffer(StringInfo inputBuffer,
 						   int compressionLevel);
 extern StringInfo DecompressBuffer(StringInfo buffer, CompressionType compressionType,
 								   uint64 decompressedSize);
+extern void CompressBuffersInParallel(StringInfo *bufferArray, bool *compressedArray,
+									  int bufferCount, CompressionType compressionType,
+									  int compressionLevel, int parallelWorkerCount);
+extern PGDLLEXPORT void ColumnarParallelCompressionMain(dsm_segment *segment,
+														shm_toc *toc);
 
 #endif /* COLUMNAR_COMPRESSION_H */
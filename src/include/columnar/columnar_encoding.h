@@ -0,0 +1,39 @@
+/*-------------------------------------------------------------------------
+ *
+ * columnar_encoding.h
+ *
+ * Type and function declarations for lightweight column encodings.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef COLUMNAR_ENCODING_H
+#define COLUMNAR_ENCODING_H
+
+#include "access/tupdesc.h"
+#include "lib/stringinfo.h"
+
+/*
+ * Enumeration for lightweight encodings that can be applied to the serialized
+ * values of a chunk before it gets compressed.
+ */
+typedef enum
+{
+	ENCODING_NONE = 0,
+	ENCODING_RLE = 1,
+	ENCODING_FOR = 2,
+	ENCODING_DELTA = 3,
+	ENCODING_DICTIONARY = 4,
+
+	ENCODING_COUNT
+} ColumnarEncodingType;
+
+extern ColumnarEncodingType EncodeBuffer(StringInfo inputBuffer,
+										 StringInfo outputBuffer,
+										 Form_pg_attribute attributeForm);
+extern StringInfo DecodeBuffer(StringInfo buffer, ColumnarEncodingType encodingType,
+							   Form_pg_attribute attributeForm);
+
+#endif /* COLUMNAR_ENCODING_H */
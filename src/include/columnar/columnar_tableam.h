@@ -11,6 +11,8 @@
 #include "catalog/indexing.h"
 #include "utils/acl.h"
 
+#include "columnar/columnar.h"
+
 /*
  * Number of valid ItemPointer Offset's for "row number" <> "ItemPointer"
  * mapping.
@@ -56,6 +58,12 @@ extern TableScanDesc columnar_beginscan_extended(Relation relation, Snapshot sna
 												 uint32 flags, Bitmapset *attr_needed,
 												 List *scanQual);
 extern int64 ColumnarScanChunkGroupsFiltered(ColumnarScanDesc columnarScanDesc);
+extern void ColumnarScanSetCoveredChunkGroupCallback(ColumnarScanDesc columnarScanDesc,
+													 ColumnarCoveredChunkGroupCallback
+													 callback, void *arg);
+extern void ColumnarScanSetChunkGroupBatchCallback(ColumnarScanDesc columnarScanDesc,
+												   ColumnarChunkGroupBatchCallback
+												   callback, void *arg);
 extern bool ColumnarSupportsIndexAM(char *indexAMName);
 extern bool IsColumnarTableAmTable(Oid relationId);
 extern void CheckCitusColumnarCreateExtensionStmt(Node *parseTree);
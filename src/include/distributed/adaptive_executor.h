@@ -7,6 +7,8 @@
 extern bool ForceMaxQueryParallelization;
 extern int MaxAdaptiveExecutorPoolSize;
 extern bool EnableBinaryProtocol;
+extern bool EnablePipelining;
+extern bool EnableTaskStealing;
 
 
 /* GUC, number of ms to wait between opening connections to the same worker */
@@ -14,6 +16,9 @@ extern int ExecutorSlowStartInterval;
 extern bool EnableCostBasedConnectionEstablishment;
 extern bool PreventIncompleteConnectionEstablishment;
 
+/* GUC, size of the buffer for streamed results in kilobytes, 0 disables */
+extern int ExecutorStreamingBufferSize;
+
 extern bool ShouldRunTasksSequentially(List *taskList);
 extern uint64 ExecuteTaskList(RowModifyLevel modLevel, List *taskList);
 extern uint64 ExecuteUtilityTaskList(List *utilityTaskList, bool localExecutionSupported);
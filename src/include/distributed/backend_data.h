@@ -71,6 +71,10 @@ extern LocalTransactionId GetMyProcLocalTransactionId(void);
 extern int GetExternalClientBackendCount(void);
 extern uint32 IncrementExternalClientBackendCounter(void);
 extern void DecrementExternalClientBackendCounter(void);
+extern void ReferenceTableWriteStarted(void);
+extern void ReferenceTableWriteFinished(void);
+extern void GetReferenceTableWriteCounters(uint32 *writesInProgress,
+										   uint64 *writesFinished);
 extern bool IsCitusInternalBackend(void);
 extern bool IsRebalancerInternalBackend(void);
 extern bool IsCitusRunCommandBackend(void);
@@ -27,6 +27,11 @@ typedef struct CitusScanState
 	MultiExecutorType executorType;   /* distributed executor type */
 	bool finishedRemoteScan;          /* flag to check if remote scan is finished */
 	Tuplestorestate *tuplestorestate; /* tuple store to store distributed results */
+
+	int eflags;                       /* executor flags passed to BeginCustomScan */
+
+	/* execution that is still streaming results into the tuple store, if any */
+	struct StreamingExecution *streamingExecution;
 } CitusScanState;
 
 
@@ -25,6 +25,9 @@ struct CustomScan;
 extern Path * CreateCitusCustomScanPath(PlannerInfo *root, RelOptInfo *relOptInfo,
 										Index restrictionIndex, RangeTblEntry *rte,
 										CustomScan *remoteScan);
+extern void AddPartialCitusCustomScanPath(PlannerInfo *root, RelOptInfo *relOptInfo,
+										  Index restrictionIndex, RangeTblEntry *rte,
+										  CustomScan *remoteScan);
 extern PlannedStmt * PlanCombineQuery(struct DistributedPlan *distributedPlan,
 									  struct CustomScan *dataScan);
 extern bool ReplaceCitusExtraDataContainer;
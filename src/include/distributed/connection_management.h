@@ -187,6 +187,16 @@ typedef struct MultiConnection
 	/* number of bytes sent to PQputCopyData() since last flush */
 	uint64 copyBytesWrittenSinceLastFlush;
 
+	/* statements prepared on the connection, see GetCachedPreparedStatement() */
+	MemoryContext preparedStatementContext;
+	HTAB *preparedStatementHash;
+
+	/* cached statements, most recently used first, for eviction */
+	dlist_head preparedStatementLRUList;
+
+	/* names of evicted or stale statements that still need to be deallocated */
+	List *deallocatePreparedStatementList;
+
 	MultiConnectionStructInitializationState initilizationState;
 } MultiConnection;
 
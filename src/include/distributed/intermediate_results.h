@@ -84,7 +84,8 @@ extern DestReceiver * CreatePartitionedResultDestReceiver(int partitionColumnInd
 														  DestReceiver **
 														  partitionedDestReceivers,
 														  bool lazyStartup,
-														  bool allowNullPartitionValues);
+														  bool allowNullPartitionValues,
+														  bytea *joinKeyFilter);
 extern CitusTableCacheEntry * QueryTupleShardSearchInfo(ArrayType *minValuesArray,
 														ArrayType *maxValuesArray,
 														char partitionMethod,
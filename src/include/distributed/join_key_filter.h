@@ -0,0 +1,26 @@
+/*-------------------------------------------------------------------------
+ *
+ * join_key_filter.h
+ *	  Bloom filters over the join keys of one side of a repartition join,
+ *	  which let the map tasks of the other side drop rows without a match.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef JOIN_KEY_FILTER_H
+#define JOIN_KEY_FILTER_H
+
+#include "distributed/multi_physical_planner.h"
+
+
+/* largest number of join key hashes a single join key filter is built from */
+#define JOIN_KEY_FILTER_MAX_KEYS (1024 * 1024)
+
+
+extern char * JoinKeyFilterResultId(uint64 jobId);
+extern void ExecuteJoinKeyFilterTasks(Job *topLevelJob);
+extern bool JoinKeyFilterContains(bytea *joinKeyFilter, uint32 keyHash);
+
+
+#endif /* JOIN_KEY_FILTER_H */
@@ -1,11 +1,16 @@
 #ifndef LOCAL_PLAN_CACHE
 #define LOCAL_PLAN_CACHE
 
+/* GUC, maximum number of shard query plans cached by the local executor */
+extern int MaxCachedLocalPlans;
+
 extern bool IsLocalPlanCachingSupported(Job *currentJob,
 										DistributedPlan *originalDistributedPlan);
 extern PlannedStmt * GetCachedLocalPlan(Task *task, DistributedPlan *distributedPlan);
 extern void CacheLocalPlanForShardQuery(Task *task,
 										DistributedPlan *originalDistributedPlan,
 										ParamListInfo paramListInfo);
+extern PlannedStmt * GetCachedLocalShardPlan(const char *shardQueryString);
+extern void CacheLocalShardPlan(const char *shardQueryString, PlannedStmt *localPlan);
 
 #endif /* LOCAL_PLAN_CACHE */
@@ -77,6 +77,10 @@ extern void CitusExecutorRun(QueryDesc *queryDesc, ScanDirection direction, uint
 							 bool execute_once);
 extern void AdaptiveExecutorPreExecutorRun(CitusScanState *scanState);
 extern TupleTableSlot * AdaptiveExecutor(CitusScanState *scanState);
+extern void AdvanceStreamingExecution(CitusScanState *scanState);
+extern void FinishStreamingExecution(CitusScanState *scanState);
+extern void ReleaseStreamingConnectionClaims(SubTransactionId subId);
+extern void ResetStreamingConnectionClaims(void);
 
 
 /*
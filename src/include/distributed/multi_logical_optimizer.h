@@ -42,6 +42,10 @@
 #define HLL_CARDINALITY_FUNC_NAME "hll_cardinality"
 #define HLL_FORCE_GROUPAGG_GUC_NAME "hll.force_groupagg"
 
+/* Definitions related to the built-in count(distinct) approximation */
+#define CITUS_HLL_ADD_AGGREGATE_NAME "citus_hll_add_agg"
+#define CITUS_HLL_CARDINALITY_AGGREGATE_NAME "citus_hll_cardinality_agg"
+
 /* Definitions related to Top-N approximations */
 #define TOPN_ADD_AGGREGATE_NAME "topn_add_agg"
 #define TOPN_UNION_AGGREGATE_NAME "topn_union_agg"
@@ -157,7 +161,9 @@ static const char *const AggregateNames[] = {
 /* Config variable managed via guc.c */
 extern int LimitClauseRowFetchCount;
 extern double CountDistinctErrorRate;
+extern bool EnableBuiltinCountDistinctApproximation;
 extern int CoordinatorAggregationStrategy;
+extern bool EnableRepartitionedWindowFunctions;
 
 
 /* Function declaration for optimizing logical plans */
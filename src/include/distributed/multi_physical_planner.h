@@ -38,6 +38,7 @@
 #define RESERVED_HASHED_COLUMN_ID MaxAttrNumber
 
 extern int RepartitionJoinBucketCountPerNode;
+extern bool EnableRepartitionJoinKeyFilter;
 
 typedef enum CitusRTEKind
 {
@@ -96,7 +97,8 @@ typedef enum
 	JOB_INVALID_FIRST = 0,
 	JOIN_MAP_MERGE_JOB = 1,
 	SUBQUERY_MAP_MERGE_JOB = 2,
-	TOP_LEVEL_WORKER_JOB = 3
+	TOP_LEVEL_WORKER_JOB = 3,
+	WINDOW_MAP_MERGE_JOB = 4
 } BoundaryNodeJobType;
 
 
@@ -161,6 +163,7 @@ typedef struct MapMergeJob
 {
 	Job job;
 	Query *reduceQuery;
+	BoundaryNodeJobType boundaryNodeJobType;
 	PartitionType partitionType;
 	Var *partitionColumn;
 	uint32 partitionCount;
@@ -168,6 +171,13 @@ typedef struct MapMergeJob
 	ShardInterval **sortedShardIntervalArray; /* only applies to range partitioning */
 	List *mapTaskList;
 	List *mergeTaskList;
+
+	/* whether the join keys of this job filter the map output of another job */
+	bool buildJoinKeyFilter;
+	List *joinKeyFilterTaskList;
+
+	/* job whose join keys filter the map output of this job, if any */
+	uint64 joinKeyFilterJobId;
 } MapMergeJob;
 
 typedef enum TaskQueryType
@@ -0,0 +1,64 @@
+/*-------------------------------------------------------------------------
+ *
+ * node_execution_stats.h
+ *   Execution statistics of remote nodes that are shared across backends
+ *   and used by the adaptive executor to size its connection pools.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef NODE_EXECUTION_STATS_H
+#define NODE_EXECUTION_STATS_H
+
+
+/*
+ * NodeExecutionStats holds the exponentially weighted moving averages of the
+ * statistics of executions on a remote node. Times are in microseconds.
+ */
+typedef struct NodeExecutionStats
+{
+	/* number of executions that contributed to the averages */
+	uint64 executionCount;
+
+	double avgTaskExecutionTime;
+	double avgConnectionEstablishmentTime;
+
+	/* fraction of connection attempts that failed */
+	double connectionFailureRate;
+} NodeExecutionStats;
+
+
+/*
+ * NodeExecutionSample holds the statistics of a single execution on a
+ * remote node, which are folded into the shared NodeExecutionStats.
+ */
+typedef struct NodeExecutionSample
+{
+	int executedTaskCount;
+	uint64 totalTaskExecutionTime;
+
+	int establishedConnectionCount;
+	uint64 totalConnectionEstablishmentTime;
+
+	int failedConnectionCount;
+} NodeExecutionSample;
+
+
+/* GUC, whether the executor records and uses the shared node statistics */
+extern bool EnableNodeExecutionStats;
+
+
+extern void InitializeNodeExecutionStats(void);
+extern size_t NodeExecutionStatsShmemSize(void);
+extern void NodeExecutionStatsShmemInit(void);
+extern bool GetNodeExecutionStats(const char *hostname, int port,
+								  NodeExecutionStats *nodeExecutionStats);
+extern void RecordNodeExecutionSample(const char *hostname, int port,
+									  NodeExecutionSample *sample);
+extern void DeferNodeExecutionSample(const char *hostname, int port,
+									 NodeExecutionSample *sample);
+extern void RecordDeferredNodeExecutionSamples(void);
+
+#endif /* NODE_EXECUTION_STATS_H */
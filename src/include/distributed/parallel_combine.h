@@ -0,0 +1,34 @@
+/*-------------------------------------------------------------------------
+ *
+ * parallel_combine.h
+ *	  Parallel execution of the partial aggregation in the combine query of
+ *	  multi-shard queries on the coordinator.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PARALLEL_COMBINE_H
+#define PARALLEL_COMBINE_H
+
+#include "nodes/extensible.h"
+#include "nodes/parsenodes.h"
+#include "nodes/plannodes.h"
+#include "storage/dsm.h"
+#include "storage/shm_toc.h"
+
+
+/* GUC, maximum number of parallel workers used by the combine query */
+extern int MaxParallelWorkersPerCombine;
+
+extern CustomScanMethods ParallelCombineCustomScanMethods;
+extern CustomScanMethods CombineBucketScanCustomScanMethods;
+
+
+extern bool ShouldPlanParallelCombine(Query *combineQuery);
+extern bool FinalizeParallelCombinePlan(PlannedStmt *plannedStmt,
+										CustomScan *remoteScan);
+extern void ParallelCombineWorkerMain(dsm_segment *segment, shm_toc *toc);
+
+#endif /* PARALLEL_COMBINE_H */
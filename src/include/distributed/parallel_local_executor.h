@@ -0,0 +1,33 @@
+/*-------------------------------------------------------------------------
+ *
+ * parallel_local_executor.h
+ *	  Functions to execute local read-only tasks in parallel workers.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef PARALLEL_LOCAL_EXECUTOR_H
+#define PARALLEL_LOCAL_EXECUTOR_H
+
+#include "distributed/multi_physical_planner.h"
+#include "distributed/tuple_destination.h"
+#include "nodes/params.h"
+#include "storage/dsm.h"
+#include "storage/shm_toc.h"
+
+
+/* GUC, maximum number of parallel workers used by a local execution */
+extern int MaxParallelWorkersPerLocalExecution;
+
+
+extern bool ShouldExecuteLocalTaskListInParallel(List *taskList,
+												 DistributedPlan *distributedPlan,
+												 ParamListInfo paramListInfo,
+												 bool isUtilityCommand);
+extern uint64 ExecuteLocalTaskListInParallel(List *taskList,
+											 TupleDestination *tupleDest);
+extern void ParallelLocalExecutionWorkerMain(dsm_segment *segment, shm_toc *toc);
+
+#endif /* PARALLEL_LOCAL_EXECUTOR_H */
@@ -0,0 +1,39 @@
+/*-------------------------------------------------------------------------
+ *
+ * reference_table_result_cache.h
+ *	  Backend-local cache of the results of router queries on reference
+ *	  tables.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef REFERENCE_TABLE_RESULT_CACHE_H
+#define REFERENCE_TABLE_RESULT_CACHE_H
+
+#include "distributed/multi_physical_planner.h"
+#include "distributed/tuple_destination.h"
+#include "nodes/params.h"
+#include "utils/tuplestore.h"
+
+
+/* GUC, size of the reference table result cache of a backend in kilobytes */
+extern int ReferenceTableResultCacheSize;
+
+/* GUC, time in milliseconds after which cached results are no longer used */
+extern int ReferenceTableResultCacheMaxAge;
+
+
+extern bool IsReferenceTableResultCacheable(DistributedPlan *distributedPlan);
+extern char * ReferenceTableResultCacheKey(Task *task, ParamListInfo paramListInfo);
+extern bool ReadReferenceTableResultCache(const char *cacheKey,
+										  Tuplestorestate *tupleStore);
+extern TupleDestination * CreateResultCacheTupleDest(TupleDestination *targetTupleDest);
+extern void StoreReferenceTableResult(const char *cacheKey, Task *task,
+									  TupleDestination *resultCacheTupleDest);
+extern void InvalidateReferenceTableResultsForTaskList(List *taskList);
+extern void InvalidateReferenceTableResults(Oid relationId);
+extern void ReferenceTableResultCacheTransactionEnd(void);
+
+#endif /* REFERENCE_TABLE_RESULT_CACHE_H */
@@ -25,9 +25,43 @@ extern char *GrepRemoteCommands;
 /* GUC that determines the number of bytes after which remote COPY is flushed */
 extern int RemoteCopyFlushThreshold;
 
+/* GUC, maximum number of prepared statements cached on a single connection */
+extern int MaxCachedPreparedStatements;
+
+
+/*
+ * PreparedStatementCacheEntry describes a statement that is (being) prepared
+ * on a connection, keyed on the hash of the command and its parameter types.
+ */
+typedef struct PreparedStatementCacheEntry
+{
+	uint32 queryHash;
+
+	char *command;
+	int parameterCount;
+	Oid *parameterTypes;
+
+	char statementName[NAMEDATALEN];
+
+	/* whether the remote node confirmed that the statement is prepared */
+	bool prepared;
+
+	/*
+	 * Value of the invalidation counter when the statement was prepared, and
+	 * whether the statement was invalidated on its own. Invalidated statements
+	 * are deallocated and prepared again when they are used next.
+	 */
+	uint64 invalidationCount;
+	bool invalidated;
+
+	/* membership in the LRU list of the connection */
+	dlist_node lruNode;
+} PreparedStatementCacheEntry;
+
 
 /* simple helpers */
 extern bool IsResponseOK(PGresult *result);
+extern bool IsPreparedStatementResultTypeError(PGresult *result);
 extern void ForgetResults(MultiConnection *connection);
 extern bool ClearResults(MultiConnection *connection, bool raiseErrors);
 extern bool ClearResultsDiscardWarnings(MultiConnection *connection, bool raiseErrors);
@@ -54,11 +88,28 @@ extern int SendRemoteCommandParams(MultiConnection *connection, const char *comm
 								   int parameterCount, const Oid *parameterTypes,
 								   const char *const *parameterValues,
 								   bool binaryResults);
+extern PreparedStatementCacheEntry * GetCachedPreparedStatement(MultiConnection *
+																connection,
+																const char *command,
+																int parameterCount,
+																const Oid *
+																parameterTypes,
+																List *relationIdList);
+extern void InvalidatePreparedStatement(PreparedStatementCacheEntry *entry);
+extern int SendRemoteDeallocations(MultiConnection *connection);
+extern int SendRemotePrepare(MultiConnection *connection,
+							 PreparedStatementCacheEntry *entry);
+extern int SendRemotePreparedCommandParams(MultiConnection *connection,
+										   PreparedStatementCacheEntry *entry,
+										   const char *const *parameterValues,
+										   bool binaryResults);
 extern List * ReadFirstColumnAsText(PGresult *queryResult);
 extern PGresult * GetRemoteCommandResult(MultiConnection *connection,
 										 bool raiseInterrupts);
 extern bool PutRemoteCopyData(MultiConnection *connection, const char *buffer,
 							  int nbytes);
+extern void BroadcastRemoteCopyData(List *connectionList, const char *buffer,
+									int nbytes);
 extern bool PutRemoteCopyEnd(MultiConnection *connection, const char *errormsg);
 
 /* waiting for multiple command results */
@@ -96,6 +96,8 @@ extern bool ParsePreparedTransactionName(char *preparedTransactionName, int32 *g
 
 /* change an individual remote transaction's state */
 extern void StartRemoteTransactionBegin(struct MultiConnection *connection);
+extern bool CanPipelineRemoteTransactionBegin(void);
+extern void StartRemoteTransactionBeginInPipeline(struct MultiConnection *connection);
 extern void FinishRemoteTransactionBegin(struct MultiConnection *connection);
 extern void RemoteTransactionBegin(struct MultiConnection *connection);
 extern void RemoteTransactionListBegin(List *connectionList);
@@ -20,6 +20,7 @@
 extern int MaxSharedPoolSize;
 extern int LocalSharedPoolSize;
 extern int MaxClientConnections;
+extern bool EnableSharedPoolLeasing;
 
 
 extern void InitializeSharedConnectionStats(void);
@@ -32,6 +33,7 @@ extern int GetMaxSharedPoolSize(void);
 extern int GetLocalSharedPoolSize(void);
 extern bool TryToIncrementSharedConnectionCounter(const char *hostname, int port);
 extern void WaitLoopForSharedConnection(const char *hostname, int port);
+extern bool SharedConnectionPoolUnderPressure(const char *hostname, int port);
 extern void DecrementSharedConnectionCounter(const char *hostname, int port);
 extern void IncrementSharedConnectionCounter(const char *hostname, int port);
 extern int AdaptiveConnectionManagementFlag(bool connectToLocalNode, int
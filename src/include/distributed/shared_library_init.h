@@ -21,6 +21,7 @@ extern ColumnarSupportsIndexAM_type extern_ColumnarSupportsIndexAM;
 extern CompressionTypeStr_type extern_CompressionTypeStr;
 extern IsColumnarTableAmTable_type extern_IsColumnarTableAmTable;
 extern ReadColumnarOptions_type extern_ReadColumnarOptions;
+extern ColumnarHasPendingWrites_type extern_ColumnarHasPendingWrites;
 
 extern void StartupCitusBackend(void);
 
@@ -0,0 +1,30 @@
+/*-------------------------------------------------------------------------
+ *
+ * sorted_merge.h
+ *	  Merging of the sorted task results of multi-shard ORDER BY ... LIMIT
+ *	  queries on the coordinator.
+ *
+ * Copyright (c) Citus Data, Inc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#ifndef SORTED_MERGE_H
+#define SORTED_MERGE_H
+
+#include "distributed/multi_physical_planner.h"
+#include "distributed/tuple_destination.h"
+
+
+/* GUC, whether the executor merges the sorted results of tasks */
+extern bool EnableSortedMerge;
+
+
+extern TupleDestination * CreateSortedMergeTupleDest(DistributedPlan *distributedPlan,
+													 TupleDestination *targetTupleDest,
+													 TupleDesc tupleDescriptor);
+extern void SortedMergeTaskFinished(TupleDestination *sortedMergeTupleDest, Task *task);
+extern bool SortedMergeReachedLimit(TupleDestination *sortedMergeTupleDest);
+extern void FinishSortedMerge(TupleDestination *sortedMergeTupleDest);
+
+#endif /* SORTED_MERGE_H */
@@ -33,4 +33,50 @@ SELECT sum(result::bigint) FROM run_command_on_workers($$
 $$);
 END;
 
+-- idle worker pools take over tasks on replicated shards from busy pools
+CREATE TABLE test_replicated (x int, y int);
+SET citus.shard_replication_factor TO 2;
+SELECT create_distributed_table('test_replicated','x');
+INSERT INTO test_replicated SELECT i, i FROM generate_series(1,100) i;
+
+SET citus.task_assignment_policy TO 'first-replica';
+SET citus.max_adaptive_executor_pool_size TO 1;
+SET citus.enable_task_stealing TO on;
+
+SELECT count(*), sum(y) FROM (SELECT x, y, pg_sleep(0.01) FROM test_replicated) a;
+BEGIN;
+SELECT count(*), sum(y) FROM (SELECT x, y, pg_sleep(0.01) FROM test_replicated) a;
+SELECT count(*) FROM test_replicated WHERE x = 1;
+END;
+
+-- a task on a placement that was accessed in the transaction is not taken over
+BEGIN;
+UPDATE test_replicated SET y = y + 1 WHERE x = 1;
+SELECT count(*), sum(y) FROM (SELECT x, y, pg_sleep(0.01) FROM test_replicated) a;
+ROLLBACK;
+
+RESET citus.enable_task_stealing;
+RESET citus.max_adaptive_executor_pool_size;
+RESET citus.task_assignment_policy;
+
+-- executions record per node statistics that the next executions start from
+SET citus.enable_node_execution_stats TO on;
+SELECT count(*) FROM test;
+SELECT count(*) FROM test;
+SELECT count(*), bool_and(execution_count >= 2), bool_and(avg_task_execution_time > 0),
+       bool_and(connection_failure_rate = 0)
+FROM citus_node_execution_stats() WHERE port IN (:worker_1_port, :worker_2_port);
+SELECT count(*) FROM test;
+RESET citus.enable_node_execution_stats;
+
+-- results of multi-shard queries are returned while they are still arriving
+SET citus.executor_streaming_buffer_size TO '1kB';
+SELECT x, y FROM test_replicated ORDER BY x LIMIT 3;
+SELECT count(*), sum(y) FROM (SELECT x, y, pg_sleep(0.001) FROM test_replicated) a;
+SELECT count(*), sum(x) FROM test_replicated a JOIN test_replicated b USING (x);
+-- remaining tasks are cancelled when the scan ends early
+SELECT EXISTS (SELECT x, pg_sleep(0.001) FROM test_replicated);
+SELECT count(*) FROM test_replicated;
+RESET citus.executor_streaming_buffer_size;
+
 DROP SCHEMA adaptive_executor CASCADE;
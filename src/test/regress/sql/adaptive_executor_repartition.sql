@@ -79,4 +79,28 @@ select count(*) from trips t1, cars r1, trips t2, cars r2 where t1.trip_id = t2.
 set citus.enable_single_hash_repartition_joins to on;
 select count(*) from trips t1, cars r1, trips t2, cars r2 where t1.trip_id = t2.trip_id and t1.car_id = r1.car_id and t2.car_id = r2.car_id;
 
+-- filter the rows of dual partition joins by the join keys of the right side
+CREATE TABLE join_key_filter_facts (id int, dim_id int, value int);
+CREATE TABLE join_key_filter_dims (id int, dim_key int, name text);
+SELECT create_distributed_table('join_key_filter_facts', 'id');
+SELECT create_distributed_table('join_key_filter_dims', 'id');
+INSERT INTO join_key_filter_facts SELECT i, i % 100, i FROM generate_series(1, 1000) i;
+INSERT INTO join_key_filter_facts VALUES (1001, NULL, 1001);
+INSERT INTO join_key_filter_dims SELECT i, i, 'dim ' || i FROM generate_series(1, 100) i;
+
+SET citus.enable_repartition_join_key_filter TO on;
+
+EXPLAIN (COSTS OFF)
+SELECT count(*) FROM join_key_filter_facts f, join_key_filter_dims d
+WHERE f.dim_id = d.dim_key AND d.name LIKE 'dim 1%';
+
+SELECT count(*), sum(value) FROM join_key_filter_facts f, join_key_filter_dims d
+WHERE f.dim_id = d.dim_key AND d.name LIKE 'dim 1%';
+
+-- no rows of the left side are left when the right side is empty
+SELECT count(*) FROM join_key_filter_facts f, join_key_filter_dims d
+WHERE f.dim_id = d.dim_key AND d.name = 'no such dim';
+
+RESET citus.enable_repartition_join_key_filter;
+
 DROP SCHEMA adaptive_executor CASCADE;
@@ -645,5 +645,25 @@ CREATE AGGREGATE newavg (
 
 SELECT run_command_on_workers($$select aggfnoid from pg_aggregate where aggfnoid::text like '%newavg%';$$);
 
+-- parallel workers aggregate the partial groups of the shards on the coordinator
+CREATE TABLE parallel_combine_table (key int, category int, value int);
+SELECT create_distributed_table('parallel_combine_table', 'key');
+INSERT INTO parallel_combine_table SELECT i, i % 7, i FROM generate_series(1, 1000) i;
+
+SET citus.max_parallel_workers_per_combine TO 2;
+SET max_parallel_workers_per_gather TO 2;
+SET parallel_setup_cost TO 0;
+SET parallel_tuple_cost TO 0;
+
+SELECT category, count(*), sum(value), max(value)
+FROM parallel_combine_table GROUP BY category ORDER BY category;
+SELECT value % 2 AS parity, count(*) FROM parallel_combine_table GROUP BY 1 ORDER BY 1;
+SELECT count(*), sum(value) FROM parallel_combine_table;
+
+RESET citus.max_parallel_workers_per_combine;
+RESET max_parallel_workers_per_gather;
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+
 set client_min_messages to error;
 drop schema aggregate_support cascade;
@@ -0,0 +1,93 @@
+--
+-- Test computing aggregates over columnar tables while scanning them.
+--
+CREATE SCHEMA columnar_aggregate_pushdown;
+SET search_path TO columnar_aggregate_pushdown;
+
+-- rows are inserted in the order of i, and every 100th row has a NULL n
+CREATE TABLE agg_table (i int, t text, n int) USING columnar;
+ALTER TABLE agg_table SET (columnar.chunk_group_row_limit = 1000);
+INSERT INTO agg_table
+SELECT g, g::text, CASE WHEN g % 100 = 0 THEN NULL ELSE g END FROM generate_series(1, 10000) g;
+
+-- without quals, all chunk groups are answered from metadata
+EXPLAIN (costs off)
+SELECT count(*), min(i), max(i), min(t), max(t), min(n), max(n) FROM agg_table;
+EXPLAIN (analyze on, costs off, timing off, summary off)
+SELECT count(*), min(i), max(i), min(t), max(t), min(n), max(n) FROM agg_table;
+SELECT count(*), min(i), max(i), min(t), max(t), min(n), max(n) FROM agg_table;
+SELECT max(i) - min(i) AS spread FROM agg_table;
+
+-- only the chunk groups that are partially covered by the quals are read
+EXPLAIN (analyze on, costs off, timing off, summary off)
+SELECT count(*), min(i), max(i) FROM agg_table WHERE i > 1500 AND i <= 7300;
+SELECT count(*), min(i), max(i) FROM agg_table WHERE i > 1500 AND i <= 7300;
+
+-- chunk groups with NULLs in the filtered columns need to be read
+EXPLAIN (analyze on, costs off, timing off, summary off)
+SELECT count(*), min(n), max(n) FROM agg_table WHERE n > 5000;
+SELECT count(*), min(n), max(n) FROM agg_table WHERE n > 5000;
+
+-- rescans with different parameters
+SELECT s, (SELECT max(i) FROM agg_table WHERE i < s) FROM (VALUES (0), (1500), (10001)) v(s);
+SELECT s, (SELECT sum(i) FROM agg_table WHERE i < s) FROM (VALUES (0), (1500), (10001)) v(s);
+
+-- count() of a column and integer sum() and avg() need the values of the rows,
+-- which are aggregated a whole chunk group at a time
+EXPLAIN (analyze on, costs off, timing off, summary off)
+SELECT count(*), count(n), sum(i), sum(n), avg(i), avg(n) FROM agg_table WHERE i > 1500 AND i <= 7300;
+SELECT count(*), count(n), sum(i), sum(n), avg(i), avg(n) FROM agg_table WHERE i > 1500 AND i <= 7300;
+SELECT count(n), sum(n), avg(n), min(t), max(t) FROM agg_table;
+
+-- rows are aggregated one by one if the quals can't be evaluated over chunk groups
+EXPLAIN (analyze on, costs off, timing off, summary off)
+SELECT count(n), sum(n), avg(n) FROM agg_table WHERE i % 2 = 0;
+SELECT count(n), sum(n), avg(n) FROM agg_table WHERE i % 2 = 0;
+
+-- other aggregates are computed by a regular Aggregate
+EXPLAIN (costs off)
+SELECT count(*), sum(i + 1) FROM agg_table;
+EXPLAIN (costs off)
+SELECT sum(i::bigint) FROM agg_table;
+
+-- pending writes are flushed before answering from metadata
+BEGIN;
+INSERT INTO agg_table VALUES (20000, '20000', 20000);
+SELECT count(*), max(i), max(n) FROM agg_table;
+ROLLBACK;
+
+-- columns added after writing a stripe have no metadata in the stripe
+ALTER TABLE agg_table ADD COLUMN d int DEFAULT 7;
+SELECT count(*), min(d), max(d), sum(d) FROM agg_table;
+
+-- int2 columns are summed up as int64's, and dates are compared as integers
+CREATE TABLE typed_table (s int2, d date) USING columnar;
+ALTER TABLE typed_table SET (columnar.chunk_group_row_limit = 1000);
+INSERT INTO typed_table SELECT g % 1000, '2020-01-01'::date + g FROM generate_series(1, 5000) g;
+EXPLAIN (analyze on, costs off, timing off, summary off)
+SELECT count(s), sum(s), avg(s), min(d) - '2020-01-01', max(d) - '2020-01-01' FROM typed_table WHERE s < 10;
+SELECT count(s), sum(s), avg(s), min(d) - '2020-01-01', max(d) - '2020-01-01' FROM typed_table WHERE s < 10;
+
+-- results are the same with aggregate pushdown disabled
+SET columnar.enable_aggregate_pushdown TO off;
+EXPLAIN (costs off)
+SELECT count(*), min(i), max(i) FROM agg_table;
+SELECT count(*), min(i), max(i), min(t), max(t), min(n), max(n) FROM agg_table;
+SELECT count(*), min(i), max(i) FROM agg_table WHERE i > 1500 AND i <= 7300;
+SELECT count(*), min(n), max(n) FROM agg_table WHERE n > 5000;
+SELECT s, (SELECT max(i) FROM agg_table WHERE i < s) FROM (VALUES (0), (1500), (10001)) v(s);
+SELECT s, (SELECT sum(i) FROM agg_table WHERE i < s) FROM (VALUES (0), (1500), (10001)) v(s);
+SELECT count(*), count(n), sum(i), sum(n), avg(i), avg(n) FROM agg_table WHERE i > 1500 AND i <= 7300;
+SELECT count(n), sum(n), avg(n), min(t), max(t) FROM agg_table;
+SELECT count(n), sum(n), avg(n) FROM agg_table WHERE i % 2 = 0;
+SELECT count(*), min(d), max(d), sum(d) FROM agg_table;
+SELECT count(s), sum(s), avg(s), min(d) - '2020-01-01', max(d) - '2020-01-01' FROM typed_table WHERE s < 10;
+RESET columnar.enable_aggregate_pushdown;
+
+-- empty tables
+CREATE TABLE empty_table (i int) USING columnar;
+SELECT count(*), min(i), max(i) FROM empty_table;
+SELECT count(i), sum(i), avg(i) FROM empty_table;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA columnar_aggregate_pushdown CASCADE;
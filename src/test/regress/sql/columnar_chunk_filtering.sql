@@ -2,6 +2,10 @@
 -- Test chunk filtering in columnar using min/max values in stripe skip lists.
 --
 
+-- keep count(*) from being computed by a ColumnarAggregate, see
+-- columnar_aggregate_pushdown
+SET columnar.enable_aggregate_pushdown TO off;
+
 
 --
 -- filtered_row_count returns number of rows filtered by the WHERE clause.
@@ -445,3 +449,68 @@ RESET columnar.max_custom_scan_paths;
 RESET columnar.qual_pushdown_correlation_threshold;
 RESET columnar.planner_debug_level;
 DROP TABLE pushdown_test;
+
+-- Verify that vectorized filters skip the rows that don't satisfy the pushed
+-- down quals before they reach the executor
+SET columnar.qual_pushdown_correlation_threshold = 0.0;
+SET columnar.stripe_row_limit = 2000;
+SET columnar.chunk_group_row_limit = 1000;
+CREATE TABLE vectorized_filter_test (a int, b bigint, c date, d text) USING columnar;
+INSERT INTO vectorized_filter_test
+  SELECT i, i * 2, '2020-01-01'::date + (i % 100), i::text
+  FROM generate_series(1, 10000) i;
+INSERT INTO vectorized_filter_test VALUES (NULL, NULL, NULL, NULL);
+RESET columnar.stripe_row_limit;
+RESET columnar.chunk_group_row_limit;
+
+SET columnar.enable_vectorized_filter TO on;
+SELECT filtered_row_count('SELECT count(*) FROM vectorized_filter_test WHERE a < 200');
+SELECT filtered_row_count('SELECT count(*) FROM vectorized_filter_test WHERE 9900 < a');
+SELECT filtered_row_count('SELECT count(*) FROM vectorized_filter_test WHERE b <= 100::int2');
+SELECT filtered_row_count('SELECT count(*) FROM vectorized_filter_test WHERE d = ''42''');
+
+SELECT count(*), sum(a) FROM vectorized_filter_test WHERE a < 200;
+SELECT count(*), sum(a) FROM vectorized_filter_test WHERE 9900 < a;
+SELECT count(*), sum(a) FROM vectorized_filter_test WHERE b <= 100::int2;
+SELECT count(*), sum(a) FROM vectorized_filter_test WHERE c = '2020-01-05';
+SELECT count(*), sum(a) FROM vectorized_filter_test WHERE d = '42';
+SELECT count(*), sum(a) FROM vectorized_filter_test WHERE a > 100 AND a <= 200;
+
+-- quals that are not pushed down are still evaluated by the executor
+SELECT count(*), sum(a) FROM vectorized_filter_test WHERE a < 200 AND a % 2 = 0;
+
+-- payload columns are only materialized for chunk groups with matching rows
+SELECT count(*), sum(b), max(c) - min(c) FROM vectorized_filter_test WHERE d = '42';
+SELECT count(*), sum(b) FROM vectorized_filter_test WHERE a > 9995 OR d = '42';
+
+SET columnar.enable_vectorized_filter TO off;
+SELECT count(*), sum(a) FROM vectorized_filter_test WHERE c = '2020-01-05';
+
+RESET columnar.enable_vectorized_filter;
+RESET columnar.qual_pushdown_correlation_threshold;
+DROP TABLE vectorized_filter_test;
+
+-- chunk group filtering using distinct value sets and bloom filters
+CREATE TABLE membership_filter_test (id int, category text) USING columnar;
+ALTER TABLE membership_filter_test SET (columnar.bloom_filter_columns = 'id,nonexistent');
+ALTER TABLE membership_filter_test SET (columnar.bloom_filter_columns = 'id,category',
+                                        columnar.chunk_group_row_limit = 1000,
+                                        columnar.stripe_row_limit = 10000);
+-- ids are scattered over all chunk groups, so min/max filtering is useless
+INSERT INTO membership_filter_test
+  SELECT (i * 7919) % 10000,
+         CASE WHEN i = 4500 THEN 'b' WHEN i % 2 = 0 THEN 'a' ELSE 'c' END
+  FROM generate_series(1, 10000) i;
+
+EXPLAIN (analyze on, costs off, timing off, summary off)
+  SELECT count(*) FROM membership_filter_test WHERE category = 'b';
+
+SELECT count(*) FROM membership_filter_test WHERE category = 'a';
+SELECT count(*) FROM membership_filter_test WHERE category = 'b';
+SELECT count(*) FROM membership_filter_test WHERE id = 4242;
+SELECT count(*) FROM membership_filter_test WHERE id = 12345;
+SELECT count(*) FROM membership_filter_test WHERE 7919 = id;
+
+DROP TABLE membership_filter_test;
+
+RESET columnar.enable_aggregate_pushdown;
@@ -0,0 +1,52 @@
+--
+-- Test merging undersized stripes of columnar tables.
+--
+CREATE SCHEMA columnar_compact_stripes;
+SET search_path TO columnar_compact_stripes;
+
+CREATE TABLE trickle (i int, t text) USING columnar;
+ALTER TABLE trickle SET (columnar.stripe_row_limit = 1000);
+
+-- each insert creates a separate stripe
+INSERT INTO trickle SELECT i, i::text FROM generate_series(1, 300) i;
+INSERT INTO trickle SELECT i, i::text FROM generate_series(301, 600) i;
+INSERT INTO trickle SELECT i, i::text FROM generate_series(601, 900) i;
+INSERT INTO trickle SELECT i, i::text FROM generate_series(901, 1200) i;
+INSERT INTO trickle SELECT i, i::text FROM generate_series(1201, 2200) i;
+INSERT INTO trickle SELECT i, i::text FROM generate_series(2201, 2300) i;
+INSERT INTO trickle SELECT i, i::text FROM generate_series(2301, 2400) i;
+
+SELECT row_count FROM columnar.stripe WHERE relation = 'trickle'::regclass ORDER BY first_row_number;
+
+-- runs of undersized stripes are merged separately, full stripe stays as is
+SELECT columnar.compact_stripes('trickle');
+SELECT row_count FROM columnar.stripe WHERE relation = 'trickle'::regclass ORDER BY first_row_number;
+SELECT count(*), sum(i), min(i), max(i), sum(length(t)) FROM trickle;
+
+-- stripes that became adjacent are merged by the next call
+SELECT columnar.compact_stripes('trickle');
+SELECT row_count FROM columnar.stripe WHERE relation = 'trickle'::regclass ORDER BY first_row_number;
+
+-- pending writes of the current transaction are compacted as well
+BEGIN;
+INSERT INTO trickle SELECT i, i::text FROM generate_series(2401, 2500) i;
+SELECT columnar.compact_stripes('trickle');
+SELECT count(*), sum(i) FROM trickle;
+ROLLBACK;
+
+SELECT row_count FROM columnar.stripe WHERE relation = 'trickle'::regclass ORDER BY first_row_number;
+SELECT count(*), sum(i), min(i), max(i), sum(length(t)) FROM trickle;
+
+-- nothing left to merge
+SELECT columnar.compact_stripes('trickle');
+
+-- merged rows would get new row numbers
+CREATE TABLE trickle_with_index (i int) USING columnar;
+CREATE INDEX ON trickle_with_index (i);
+SELECT columnar.compact_stripes('trickle_with_index');
+
+CREATE TABLE heap_table (i int);
+SELECT columnar.compact_stripes('heap_table');
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA columnar_compact_stripes CASCADE;
@@ -0,0 +1,64 @@
+--
+-- Test lightweight encodings of columnar chunks.
+--
+
+CREATE SCHEMA columnar_encoding;
+SET search_path TO columnar_encoding;
+
+SET columnar.compression TO 'none';
+SET columnar.chunk_group_row_limit TO 1000;
+
+CREATE TABLE plain_table (status int, run int, ts bigint, small int2, label text, hash text) USING columnar;
+INSERT INTO plain_table
+  SELECT CASE WHEN i % 10 = 0 THEN NULL ELSE i % 4 END,
+         i / 500,
+         1000000 + i * 10,
+         (i % 7 - 3)::int2,
+         (ARRAY['red', 'green', 'blue'])[i % 3 + 1],
+         md5(i::text)
+  FROM generate_series(1, 10000) i;
+
+SET columnar.enable_column_encoding TO on;
+CREATE TABLE encoded_table (LIKE plain_table) USING columnar;
+INSERT INTO encoded_table SELECT * FROM plain_table;
+
+SET columnar.compression TO 'pglz';
+CREATE TABLE encoded_pglz_table (LIKE plain_table) USING columnar;
+INSERT INTO encoded_pglz_table SELECT * FROM plain_table;
+RESET columnar.enable_column_encoding;
+RESET columnar.compression;
+RESET columnar.chunk_group_row_limit;
+
+-- each column uses the encoding that suits its values best
+SELECT attr, array_agg(DISTINCT value_encoding_type) AS encodings
+FROM columnar_internal.chunk
+WHERE storage_id = columnar.get_storage_id('encoded_table'::regclass)
+GROUP BY attr ORDER BY attr;
+
+-- chunks written while encodings are disabled are not encoded
+SELECT DISTINCT value_encoding_type
+FROM columnar_internal.chunk
+WHERE storage_id = columnar.get_storage_id('plain_table'::regclass);
+
+SELECT pg_relation_size('encoded_table') < pg_relation_size('plain_table');
+
+-- encoded chunks decode to the original values
+SELECT count(*) FROM (TABLE plain_table EXCEPT ALL TABLE encoded_table) d;
+SELECT count(*) FROM (TABLE encoded_table EXCEPT ALL TABLE plain_table) d;
+SELECT count(*) FROM (TABLE plain_table EXCEPT ALL TABLE encoded_pglz_table) d;
+SELECT count(*) FROM (TABLE encoded_pglz_table EXCEPT ALL TABLE plain_table) d;
+
+SELECT count(status), sum(status), sum(run), sum(ts), sum(small),
+       count(DISTINCT label), count(DISTINCT hash)
+FROM encoded_pglz_table;
+
+-- index scans fetch single rows from encoded chunks
+CREATE INDEX ON encoded_table (ts);
+SET columnar.enable_custom_scan TO off;
+SET enable_seqscan TO off;
+SELECT status, run, ts, small, label, hash = md5('4242') FROM encoded_table WHERE ts = 1042420;
+RESET enable_seqscan;
+RESET columnar.enable_custom_scan;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA columnar_encoding CASCADE;
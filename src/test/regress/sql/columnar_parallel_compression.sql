@@ -0,0 +1,65 @@
+--
+-- Test compressing columnar stripes with parallel workers.
+--
+
+CREATE SCHEMA columnar_parallel_compression;
+SET search_path TO columnar_parallel_compression;
+
+SET columnar.compression TO 'pglz';
+SET columnar.chunk_group_row_limit TO 1000;
+SET columnar.stripe_row_limit TO 5000;
+
+-- n only has NULLs, so its chunks have nothing to compress
+CREATE TABLE serial_table (i int, t text, n int) USING columnar;
+INSERT INTO serial_table SELECT g, md5((g % 100)::text), NULL FROM generate_series(1, 12000) g;
+
+SET columnar.max_parallel_compression_workers TO 2;
+CREATE TABLE parallel_table (LIKE serial_table) USING columnar;
+INSERT INTO parallel_table SELECT * FROM serial_table;
+
+-- stripes that are flushed at commit are compressed the same way
+CREATE TABLE parallel_commit_table (LIKE serial_table) USING columnar;
+BEGIN;
+INSERT INTO parallel_commit_table SELECT * FROM serial_table WHERE i <= 3000;
+COMMIT;
+BEGIN;
+SAVEPOINT s1;
+INSERT INTO parallel_commit_table SELECT * FROM serial_table WHERE i > 3000 AND i <= 4000;
+RELEASE SAVEPOINT s1;
+COMMIT;
+RESET columnar.max_parallel_compression_workers;
+
+RESET columnar.stripe_row_limit;
+RESET columnar.chunk_group_row_limit;
+RESET columnar.compression;
+
+-- chunks are stored exactly as if they were compressed serially
+SELECT count(*) FROM columnar_internal.chunk
+WHERE storage_id = columnar.get_storage_id('parallel_table'::regclass);
+
+SELECT count(*) FROM (
+  SELECT stripe_num, attr_num, chunk_group_num, value_stream_offset, value_stream_length,
+         value_compression_type, value_decompressed_length
+  FROM columnar_internal.chunk
+  WHERE storage_id = columnar.get_storage_id('serial_table'::regclass)
+  EXCEPT
+  SELECT stripe_num, attr_num, chunk_group_num, value_stream_offset, value_stream_length,
+         value_compression_type, value_decompressed_length
+  FROM columnar_internal.chunk
+  WHERE storage_id = columnar.get_storage_id('parallel_table'::regclass)
+) d;
+
+SELECT attr_num, value_compression_type, count(*)
+FROM columnar_internal.chunk
+WHERE storage_id = columnar.get_storage_id('parallel_commit_table'::regclass)
+GROUP BY 1, 2 ORDER BY 1, 2;
+
+SELECT pg_relation_size('serial_table') = pg_relation_size('parallel_table');
+
+-- compressed chunks decompress to the original values
+SELECT count(*) FROM (TABLE serial_table EXCEPT ALL TABLE parallel_table) d;
+SELECT count(*) FROM (TABLE parallel_table EXCEPT ALL TABLE serial_table) d;
+SELECT count(*), sum(i), count(DISTINCT t), count(n) FROM parallel_commit_table;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA columnar_parallel_compression CASCADE;
@@ -0,0 +1,53 @@
+--
+-- Test parallel columnar custom scans.
+--
+CREATE SCHEMA columnar_parallel_scan;
+SET search_path TO columnar_parallel_scan;
+-- keep sum() from being computed by a ColumnarAggregate, see
+-- columnar_aggregate_pushdown
+SET columnar.enable_aggregate_pushdown TO off;
+
+CREATE TABLE parallel_scan (i int, t text) USING columnar;
+ALTER TABLE parallel_scan SET (columnar.stripe_row_limit = 10000);
+ALTER TABLE parallel_scan SET (parallel_workers = 4);
+INSERT INTO parallel_scan SELECT i, i::text FROM generate_series(1, 100000) i;
+
+SET parallel_setup_cost = 0;
+SET parallel_tuple_cost = 0;
+SET min_parallel_table_scan_size = 0;
+SET max_parallel_workers_per_gather = 4;
+
+-- stripes are divided between the participants
+EXPLAIN (costs off) SELECT count(*), sum(i), min(t), max(t) FROM parallel_scan;
+SELECT count(*), sum(i), min(t), max(t) FROM parallel_scan;
+SELECT count(*), sum(i) FROM parallel_scan WHERE i > 95000;
+
+-- pending writes of the leader are visible to the workers
+BEGIN;
+INSERT INTO parallel_scan SELECT i, i::text FROM generate_series(100001, 100010) i;
+SELECT count(*), sum(i) FROM parallel_scan;
+ROLLBACK;
+
+-- the parallel_workers reloption and max_parallel_workers_per_gather are honored
+ALTER TABLE parallel_scan SET (parallel_workers = 2);
+EXPLAIN (costs off) SELECT count(*), sum(i), min(t), max(t) FROM parallel_scan;
+SET max_parallel_workers_per_gather = 1;
+EXPLAIN (costs off) SELECT count(*), sum(i), min(t), max(t) FROM parallel_scan;
+SET max_parallel_workers_per_gather = 4;
+ALTER TABLE parallel_scan SET (parallel_workers = 4);
+-- scans with lateral references are not parallel
+SELECT x, c FROM (VALUES (1), (50000)) v(x),
+  LATERAL (SELECT count(*) c FROM parallel_scan WHERE i >= x) s ORDER BY x;
+
+SET columnar.enable_parallel_scan TO off;
+EXPLAIN (costs off) SELECT count(*), sum(i), min(t), max(t) FROM parallel_scan;
+RESET columnar.enable_parallel_scan;
+
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET max_parallel_workers_per_gather;
+RESET columnar.enable_aggregate_pushdown;
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA columnar_parallel_scan CASCADE;
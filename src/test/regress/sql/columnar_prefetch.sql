@@ -0,0 +1,51 @@
+--
+-- Test prefetching stripe data in columnar scans.
+--
+CREATE SCHEMA columnar_prefetch;
+SET search_path TO columnar_prefetch;
+-- keep count(*) from being computed by a ColumnarAggregate, see
+-- columnar_aggregate_pushdown
+SET columnar.enable_aggregate_pushdown TO off;
+
+CREATE TABLE prefetch_scan (i int, t text) USING columnar;
+ALTER TABLE prefetch_scan SET (columnar.stripe_row_limit = 2000);
+ALTER TABLE prefetch_scan SET (columnar.chunk_group_row_limit = 1000);
+INSERT INTO prefetch_scan SELECT i, i::text FROM generate_series(1, 10000) i;
+
+SET columnar.enable_prefetch TO on;
+SELECT count(*), sum(i), min(t), max(t) FROM prefetch_scan;
+
+-- chunk groups filtered while prefetching the next stripe are accounted for
+EXPLAIN (analyze on, costs off, timing off, summary off)
+SELECT count(*) FROM prefetch_scan WHERE i > 8500;
+
+-- rescans start over from the first stripe
+SELECT s, (SELECT count(*) FROM prefetch_scan WHERE i > s * 3000) FROM generate_series(0, 3) s;
+
+-- stop reading before the prefetched stripe
+BEGIN;
+DECLARE c CURSOR FOR SELECT i FROM prefetch_scan WHERE i % 1000 = 0;
+FETCH 3 FROM c;
+CLOSE c;
+COMMIT;
+
+-- pending writes are flushed before the scan picks any stripe
+BEGIN;
+INSERT INTO prefetch_scan SELECT i, i::text FROM generate_series(10001, 10500) i;
+SELECT count(*), sum(i) FROM prefetch_scan;
+ROLLBACK;
+
+-- prefetching is disabled when asynchronous I/O is disabled
+SET effective_io_concurrency TO 0;
+SELECT count(*), sum(i), min(t), max(t) FROM prefetch_scan;
+RESET effective_io_concurrency;
+
+SET columnar.enable_prefetch TO off;
+SELECT count(*), sum(i), min(t), max(t) FROM prefetch_scan;
+EXPLAIN (analyze on, costs off, timing off, summary off)
+SELECT count(*) FROM prefetch_scan WHERE i > 8500;
+RESET columnar.enable_prefetch;
+
+RESET columnar.enable_aggregate_pushdown;
+SET client_min_messages TO WARNING;
+DROP SCHEMA columnar_prefetch CASCADE;
@@ -0,0 +1,65 @@
+--
+-- Test sorting stripes of columnar tables by the sort_key option.
+--
+CREATE SCHEMA columnar_sort_key;
+SET search_path TO columnar_sort_key;
+-- keep count(*) from being computed by a ColumnarAggregate, see
+-- columnar_aggregate_pushdown
+SET columnar.enable_aggregate_pushdown TO off;
+
+CREATE TABLE unsorted_table (i int, t text) USING columnar;
+ALTER TABLE unsorted_table SET (columnar.chunk_group_row_limit = 1000);
+INSERT INTO unsorted_table SELECT (g * 7919) % 10000, g::text FROM generate_series(1, 10000) g;
+
+CREATE TABLE sorted_table (i int, t text) USING columnar;
+ALTER TABLE sorted_table SET (columnar.chunk_group_row_limit = 1000, columnar.sort_key = 'i');
+SELECT sort_key FROM columnar_internal.options WHERE regclass = 'sorted_table'::regclass;
+INSERT INTO sorted_table SELECT (g * 7919) % 10000, g::text FROM generate_series(1, 10000) g;
+
+-- both tables have the same rows, but only one of them is stored in sort key order
+SELECT count(*), sum(i), min(i), max(i) FROM unsorted_table;
+SELECT count(*), sum(i), min(i), max(i) FROM sorted_table;
+SELECT i FROM unsorted_table LIMIT 5;
+SELECT i FROM sorted_table LIMIT 5;
+
+-- sorted stripes let range quals skip chunk groups
+EXPLAIN (analyze on, costs off, timing off, summary off)
+SELECT count(*) FROM unsorted_table WHERE i < 1000;
+EXPLAIN (analyze on, costs off, timing off, summary off)
+SELECT count(*) FROM sorted_table WHERE i < 1000;
+
+-- multiple sort key columns, nulls are sorted last
+CREATE TABLE multi_key (a int, b text, p point) USING columnar;
+ALTER TABLE multi_key SET (columnar.sort_key = 'a, b');
+INSERT INTO multi_key (a, b) VALUES (2, 'b'), (NULL, 'a'), (1, 'z'), (2, 'a'), (1, NULL);
+SELECT a, b FROM multi_key;
+
+-- invalid sort keys
+ALTER TABLE multi_key SET (columnar.sort_key = 'c');
+ALTER TABLE multi_key SET (columnar.sort_key = 'p');
+
+-- the sort key can also be managed through the function interface
+SELECT alter_columnar_table_set('multi_key', sort_key => 'b, a');
+SELECT sort_key FROM columnar.options WHERE relation = 'multi_key'::regclass;
+SELECT alter_columnar_table_reset('multi_key', sort_key => true);
+SELECT sort_key FROM columnar.options WHERE relation = 'multi_key'::regclass;
+
+-- rows buffered for sorting are bounded by work_mem, stripes are flushed early
+CREATE TABLE small_work_mem (i int, t text) USING columnar;
+ALTER TABLE small_work_mem SET (columnar.sort_key = 'i');
+SET work_mem TO '64kB';
+INSERT INTO small_work_mem SELECT (g * 7919) % 10000, g::text FROM generate_series(1, 10000) g;
+RESET work_mem;
+SELECT count(*) > 1 AS multiple_stripes FROM columnar.stripe
+WHERE relation = 'small_work_mem'::regclass;
+SELECT count(*), sum(i), min(i), max(i) FROM small_work_mem;
+
+-- sort keys and indexes cannot be combined
+CREATE INDEX ON sorted_table (i);
+ALTER TABLE sorted_table RESET (columnar.sort_key);
+CREATE INDEX ON sorted_table (i);
+ALTER TABLE sorted_table SET (columnar.sort_key = 'i');
+
+RESET columnar.enable_aggregate_pushdown;
+SET client_min_messages TO WARNING;
+DROP SCHEMA columnar_sort_key CASCADE;
@@ -190,6 +190,10 @@ SELECT alter_columnar_table_reset('table_options', compression => true);
 SELECT * FROM columnar.options WHERE relation = 'table_options'::regclass;
 SELECT alter_columnar_table_set('table_options', compression_level => 1);
 SELECT * FROM columnar.options WHERE relation = 'table_options'::regclass;
+SELECT alter_columnar_table_set('table_options', bloom_filter_columns => 'a');
+SELECT * FROM columnar.options WHERE relation = 'table_options'::regclass;
+SELECT alter_columnar_table_reset('table_options', bloom_filter_columns => true);
+SELECT * FROM columnar.options WHERE relation = 'table_options'::regclass;
 
 -- error: set columnar options on heap tables
 CREATE TABLE heap_options(i int) USING heap;
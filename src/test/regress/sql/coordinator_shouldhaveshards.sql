@@ -460,6 +460,52 @@ BEGIN;
 COMMIT;
 
 RESET client_min_messages;
+-- local plans of shard queries are cached across tasks and executions
+SET citus.log_local_commands TO off;
+SET citus.max_cached_local_plans TO 16;
+CREATE TABLE local_plans (x int, y int);
+SELECT create_distributed_table('local_plans', 'x', colocate_with := 'none');
+INSERT INTO local_plans SELECT s, s FROM generate_series(1,10) s;
+BEGIN;
+SELECT y FROM local_plans WHERE x = 1;
+SELECT count(*), sum(y) FROM local_plans;
+SELECT count(*), sum(y) FROM local_plans;
+END;
+-- cached plans are removed when the shards change
+ALTER TABLE local_plans DROP COLUMN y;
+ALTER TABLE local_plans ADD COLUMN y bigint DEFAULT 2;
+BEGIN;
+SELECT y FROM local_plans WHERE x = 1;
+SELECT count(*), sum(y) FROM local_plans;
+END;
+DROP TABLE local_plans;
+RESET citus.max_cached_local_plans;
+-- local tasks of read-only queries can be executed by parallel workers
+SET citus.max_parallel_workers_per_local_execution TO 4;
+CREATE TABLE parallel_local (x int, y int);
+SELECT create_distributed_table('parallel_local', 'x', colocate_with := 'none', shard_count := 12);
+INSERT INTO parallel_local SELECT s, s FROM generate_series(1,100) s;
+SELECT count(*), sum(y) FROM parallel_local;
+BEGIN;
+INSERT INTO parallel_local VALUES (101, 101);
+UPDATE parallel_local SET y = y + 1;
+-- parallel workers see the changes of the transaction
+SET LOCAL client_min_messages TO DEBUG1;
+SELECT count(*), sum(y) FROM parallel_local;
+RESET client_min_messages;
+SELECT x, y FROM parallel_local WHERE x > 98 ORDER BY x;
+END;
+-- rows that columnar did not flush yet are not visible to parallel workers,
+-- so the local tasks are executed sequentially
+CREATE TABLE parallel_local_columnar (x int, y int) USING columnar;
+SELECT create_distributed_table('parallel_local_columnar', 'x', colocate_with := 'none', shard_count := 12);
+BEGIN;
+INSERT INTO parallel_local_columnar VALUES (1, 1), (2, 2), (3, 3), (4, 4), (5, 5), (6, 6), (7, 7), (8, 8), (9, 9), (10, 10);
+SELECT count(*), sum(y) FROM parallel_local_columnar;
+END;
+DROP TABLE parallel_local, parallel_local_columnar;
+RESET citus.max_parallel_workers_per_local_execution;
+SET citus.log_local_commands TO on;
 \set VERBOSITY terse
 DROP TABLE ref_table;
 
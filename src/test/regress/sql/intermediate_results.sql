@@ -329,6 +329,19 @@ BEGIN;
   SELECT * FROM security_definer_in_files_2(), security_definer_in_files();
 COMMIT;
 
+-- subplan results are broadcast in binary format when all types support it,
+-- both when they span multiple buffers and when they are empty
+SET search_path TO intermediate_results;
+CREATE TABLE binary_results (a int, b bigint, c float8);
+SELECT create_distributed_table('binary_results', 'a');
+INSERT INTO binary_results SELECT s, s * 2, s / 4.0 FROM generate_series(1, 20000) s;
+
+WITH big AS MATERIALIZED (SELECT a, b, c FROM binary_results ORDER BY a LIMIT 10000)
+SELECT count(*), sum(big.b), sum(big.c) FROM big JOIN binary_results USING (a);
+
+WITH empty AS MATERIALIZED (SELECT a, b, c FROM binary_results WHERE b < 0)
+SELECT count(*) FROM empty JOIN binary_results USING (a);
+
 -- cleanup
 SET client_min_messages TO ERROR;
 DROP SCHEMA other_schema CASCADE;
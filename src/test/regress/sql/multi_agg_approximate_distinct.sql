@@ -130,6 +130,62 @@ SELECT
 	ORDER BY 2 DESC, 1 DESC
 	LIMIT 10;
 
+-- Check the built-in approximation, which does not need the hll extension
+
+SET citus.enable_builtin_count_distinct_approximation TO on;
+SET citus.count_distinct_error_rate = 0.01;
+
+SELECT count(distinct l_orderkey) BETWEEN 2985 * 0.95 AND 2985 * 1.05 AS within_error_rate
+	FROM lineitem;
+
+SELECT count(distinct l_comment) > 0 AS has_distinct_comments FROM lineitem;
+
+SELECT n_regionkey, count(DISTINCT n_name) FROM test_count_distinct_schema.nation_hash
+	GROUP BY n_regionkey
+	ORDER BY n_regionkey;
+
+SELECT count(DISTINCT n_name) FILTER (WHERE n_regionkey = 1)
+	FROM test_count_distinct_schema.nation_hash;
+
+SELECT l_returnflag, count(DISTINCT l_shipdate) as count_distinct, count(*) as total
+	FROM lineitem
+	GROUP BY l_returnflag
+	ORDER BY count_distinct
+	LIMIT 10;
+
+RESET citus.enable_builtin_count_distinct_approximation;
+
+-- The built-in aggregates can also run in parallel workers, which compute the
+-- same sketches as a serial scan
+CREATE TABLE hll_parallel_test AS SELECT i, i % 100 AS g FROM generate_series(1, 20000) i;
+CREATE TABLE hll_parallel_sketches AS
+	SELECT g, citus_hll_add_agg(i, 12) AS sketch FROM hll_parallel_test GROUP BY g;
+
+SET max_parallel_workers_per_gather TO 0;
+SELECT md5(citus_hll_add_agg(i, 12)::text) AS serial_sketch,
+	(SELECT citus_hll_cardinality_agg(sketch) FROM hll_parallel_sketches) AS serial_estimate
+	FROM hll_parallel_test
+\gset
+
+SET parallel_setup_cost TO 0;
+SET parallel_tuple_cost TO 0;
+SET min_parallel_table_scan_size TO 0;
+SET max_parallel_workers_per_gather TO 2;
+
+EXPLAIN (COSTS OFF) SELECT citus_hll_add_agg(i, 12) FROM hll_parallel_test;
+SELECT md5(citus_hll_add_agg(i, 12)::text) = :'serial_sketch' AS same_sketch
+	FROM hll_parallel_test;
+
+EXPLAIN (COSTS OFF) SELECT citus_hll_cardinality_agg(sketch) FROM hll_parallel_sketches;
+SELECT citus_hll_cardinality_agg(sketch) = :serial_estimate AS same_estimate
+	FROM hll_parallel_sketches;
+
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET max_parallel_workers_per_gather;
+DROP TABLE hll_parallel_test, hll_parallel_sketches;
+
 -- Check that we can revert config and disable count(distinct) approximations
 
 SET citus.count_distinct_error_rate = 0.0;
@@ -240,4 +240,33 @@ DROP FUNCTION my_limit();
 SELECT l_orderkey FROM lineitem_hash ORDER BY l_orderkey LIMIT (SELECT 10);
 SELECT l_orderkey FROM lineitem_hash ORDER BY l_orderkey LIMIT 10 OFFSET (SELECT 10);
 
+-- merge the sorted task results on the coordinator
+SET citus.enable_sorted_merge TO on;
+SELECT l_orderkey FROM lineitem_hash ORDER BY l_orderkey LIMIT 5;
+SELECT l_orderkey FROM lineitem_hash ORDER BY l_orderkey LIMIT 10 OFFSET 5;
+-- rows of the tasks interleave in the merged order, and some tasks return
+-- fewer rows than the limit
+CREATE TABLE sorted_merge_test (key int, a int, b int);
+SELECT create_distributed_table('sorted_merge_test', 'key');
+INSERT INTO sorted_merge_test
+	SELECT i, CASE WHEN i % 10 = 0 THEN NULL ELSE (i * 37) % 50 END, i % 3
+	FROM generate_series(1, 100) i;
+SELECT key, a FROM sorted_merge_test ORDER BY a, key LIMIT 5;
+SELECT key, a FROM sorted_merge_test ORDER BY a, key LIMIT 4 OFFSET 40;
+-- NULLS FIRST/LAST and mixed sort directions
+SELECT key, a FROM sorted_merge_test ORDER BY a NULLS FIRST, key LIMIT 4 OFFSET 8;
+SELECT key, a FROM sorted_merge_test ORDER BY a DESC NULLS LAST, key LIMIT 5;
+SELECT key, a FROM sorted_merge_test ORDER BY a DESC, key LIMIT 3 OFFSET 9;
+SELECT key, a, b FROM sorted_merge_test ORDER BY b DESC, a, key DESC LIMIT 6;
+SELECT key, a FROM sorted_merge_test ORDER BY a, key LIMIT 10 OFFSET 95;
+-- the streaming execution stops once the merge produced LIMIT + OFFSET rows
+SET citus.executor_streaming_buffer_size TO '1kB';
+SELECT key, a FROM sorted_merge_test ORDER BY a, key LIMIT 3 OFFSET 30;
+SELECT key, a, b FROM sorted_merge_test ORDER BY b DESC, a, key DESC LIMIT 6;
+SELECT key, a FROM sorted_merge_test ORDER BY a, key LIMIT 10 OFFSET 95;
+SELECT count(*) FROM sorted_merge_test;
+RESET citus.executor_streaming_buffer_size;
+DROP TABLE sorted_merge_test;
+RESET citus.enable_sorted_merge;
+
 DROP TABLE lineitem_hash;
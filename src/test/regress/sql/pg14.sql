@@ -665,6 +665,73 @@ SELECT count(*) FROM
     UNION  select row(pg_proc.pronargs, pg_proc.proargtypes, pg_proc.prosrc, pg_proc.proowner)::text from pg_proc where proname = 'proc_with_out_param')
   as test;
 
+-- test pipelining BEGIN with the first task sent over a connection
+SET citus.next_shard_id TO 980500;
+CREATE TABLE pipelined (a int, b int);
+SELECT create_distributed_table('pipelined', 'a');
+INSERT INTO pipelined VALUES (1, 1), (2, 2);
+SET citus.enable_pipelining TO on;
+SET citus.log_remote_commands TO on;
+BEGIN;
+SELECT b FROM pipelined WHERE a = 1;
+SELECT b FROM pipelined WHERE a = 1;
+-- commands without binary results or parameters are not pipelined
+UPDATE pipelined SET b = 3 WHERE a = 2;
+SELECT b FROM pipelined WHERE a = 2;
+COMMIT;
+RESET citus.log_remote_commands;
+RESET citus.enable_pipelining;
+
+-- test caching prepared statements on worker connections
+SET citus.max_cached_prepared_statements TO 10;
+SET plan_cache_mode TO force_generic_plan;
+PREPARE select_pipelined(int) AS SELECT b FROM pipelined WHERE a = $1;
+SET citus.log_remote_commands TO on;
+EXECUTE select_pipelined(1);
+EXECUTE select_pipelined(1);
+EXECUTE select_pipelined(2);
+-- prepared statements are pipelined with BEGIN
+SET citus.enable_pipelining TO on;
+BEGIN;
+EXECUTE select_pipelined(2);
+EXECUTE select_pipelined(1);
+COMMIT;
+RESET citus.log_remote_commands;
+RESET citus.enable_pipelining;
+DEALLOCATE select_pipelined;
+-- statements are prepared again after the result type changes
+CREATE FUNCTION select_pipelined_b(key int) RETURNS text LANGUAGE plpgsql AS $$
+DECLARE
+    result text;
+BEGIN
+    SELECT b INTO result FROM pipelined WHERE a = key;
+    RETURN result;
+END;
+$$;
+CREATE FUNCTION select_pipelined_a(key int) RETURNS int LANGUAGE plpgsql AS $$
+DECLARE
+    result int;
+BEGIN
+    SELECT a INTO result FROM pipelined WHERE a = key;
+    RETURN result;
+END;
+$$;
+SELECT select_pipelined_b(1);
+ALTER TABLE pipelined ALTER COLUMN b TYPE bigint;
+SELECT select_pipelined_b(1);
+ALTER TABLE pipelined ALTER COLUMN b TYPE text;
+SELECT select_pipelined_b(1);
+-- statements are evicted and deallocated when the cache is full
+SET citus.max_cached_prepared_statements TO 1;
+SELECT select_pipelined_a(1);
+SELECT select_pipelined_b(1);
+SELECT select_pipelined_a(1);
+SELECT select_pipelined_b(1);
+SET citus.max_cached_prepared_statements TO 10;
+DROP FUNCTION select_pipelined_a(int), select_pipelined_b(int);
+RESET plan_cache_mode;
+RESET citus.max_cached_prepared_statements;
+
 set client_min_messages to error;
 drop schema pg14 cascade;
 
@@ -0,0 +1,79 @@
+--
+-- REFERENCE_TABLE_RESULT_CACHE
+--
+-- Tests that the results of router queries on reference tables are cached,
+-- and that the cached results are invalidated by modifications.
+--
+CREATE SCHEMA reference_table_result_cache;
+SET search_path TO reference_table_result_cache;
+SET citus.next_shard_id TO 1540000;
+
+ALTER SYSTEM SET citus.reference_table_result_cache_size TO '1MB';
+SELECT pg_reload_conf();
+SELECT pg_sleep(0.1);
+
+CREATE TABLE config (key text PRIMARY KEY, value text);
+SELECT create_reference_table('config');
+INSERT INTO config VALUES ('a', '1'), ('b', '2');
+
+SET citus.reference_table_result_cache_max_age TO '1h';
+SET client_min_messages TO DEBUG1;
+
+-- the second execution is answered from the cache
+SELECT value FROM config WHERE key = 'a';
+SELECT value FROM config WHERE key = 'a';
+SELECT value FROM config WHERE key = 'b';
+
+-- modifications invalidate the cached results
+UPDATE config SET value = '3' WHERE key = 'a';
+SELECT value FROM config WHERE key = 'a';
+SELECT value FROM config WHERE key = 'a';
+
+-- results of prepared statements are cached per parameter value
+PREPARE config_value(text) AS SELECT value FROM config WHERE key = $1;
+EXECUTE config_value('b');
+EXECUTE config_value('b');
+EXECUTE config_value('a');
+
+-- queries with mutable functions are not cached
+SELECT key FROM config WHERE now() > '2000-01-01' ORDER BY key;
+SELECT key FROM config WHERE now() > '2000-01-01' ORDER BY key;
+
+-- results read after a modification in the same transaction are not cached
+BEGIN;
+INSERT INTO config VALUES ('c', '4');
+SELECT value FROM config WHERE key = 'c';
+ROLLBACK;
+SELECT value FROM config WHERE key = 'c';
+SELECT value FROM config WHERE key = 'c';
+
+-- COPY invalidates the cached results as well
+COPY config FROM STDIN WITH (FORMAT 'csv');
+c,5
+\.
+SELECT value FROM config WHERE key = 'c';
+SELECT value FROM config WHERE key = 'c';
+
+-- results are neither cached nor read from the cache in transaction blocks
+BEGIN;
+SELECT value FROM config WHERE key = 'b';
+SELECT value FROM config WHERE key = 'b';
+COMMIT;
+BEGIN ISOLATION LEVEL REPEATABLE READ;
+SELECT value FROM config WHERE key = 'b';
+COMMIT;
+
+-- cached results are not used after citus.reference_table_result_cache_max_age
+SET citus.reference_table_result_cache_max_age TO 0;
+SELECT value FROM config WHERE key = 'c';
+SELECT value FROM config WHERE key = 'c';
+RESET citus.reference_table_result_cache_max_age;
+
+RESET client_min_messages;
+DEALLOCATE config_value;
+
+ALTER SYSTEM RESET citus.reference_table_result_cache_size;
+SELECT pg_reload_conf();
+
+SET client_min_messages TO WARNING;
+DROP SCHEMA reference_table_result_cache CASCADE;
@@ -535,6 +535,47 @@ WHERE
 ORDER BY
 	hostname, port;
 
+-- when the shared pool is full, connections are released at the end of
+-- the transaction instead of being cached if leasing is enabled
+RESET citus.max_cached_connection_lifetime;
+SET citus.max_cached_conns_per_worker TO 1;
+ALTER SYSTEM SET citus.max_shared_pool_size TO 1;
+SELECT pg_reload_conf();
+SELECT pg_sleep(0.1);
+
+SELECT count(*) FROM test WHERE a = 100;
+SELECT
+	coalesce(sum(connection_count_to_node), 0)
+FROM
+	citus_remote_connection_stats()
+WHERE
+	port IN (SELECT node_port FROM master_get_active_worker_nodes()) AND
+	database_name = 'regression';
+
+SET citus.enable_shared_pool_leasing TO on;
+SELECT count(*) FROM test WHERE a = 100;
+SELECT
+	coalesce(sum(connection_count_to_node), 0)
+FROM
+	citus_remote_connection_stats()
+WHERE
+	port IN (SELECT node_port FROM master_get_active_worker_nodes()) AND
+	database_name = 'regression';
+SELECT count(*) FROM test;
+SELECT
+	coalesce(sum(connection_count_to_node), 0)
+FROM
+	citus_remote_connection_stats()
+WHERE
+	port IN (SELECT node_port FROM master_get_active_worker_nodes()) AND
+	database_name = 'regression';
+
+RESET citus.enable_shared_pool_leasing;
+RESET citus.max_cached_conns_per_worker;
+ALTER SYSTEM RESET citus.max_shared_pool_size;
+SELECT pg_reload_conf();
+SELECT pg_sleep(0.1);
+
 -- in case other tests relies on these setting, reset them
 ALTER SYSTEM RESET citus.distributed_deadlock_detection_factor;
 ALTER SYSTEM RESET citus.recover_2pc_interval;
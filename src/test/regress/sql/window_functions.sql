@@ -619,6 +619,44 @@ GROUP BY 1 ORDER BY 1;
 select null = sum(null::int2) over ()
 from public.users_table as ut limit 1;
 
+-- Window functions that are not partitioned by the distribution column can be
+-- evaluated on the workers by repartitioning the table on a column that all
+-- windows are partitioned by
+CREATE TABLE window_repartition_events (user_id int, session_id int, event_time int);
+SELECT create_distributed_table('window_repartition_events', 'user_id');
+INSERT INTO window_repartition_events SELECT i % 7, i % 5, i FROM generate_series(1, 100) i;
+
+SET citus.enable_repartitioned_window_functions TO on;
+
+EXPLAIN (COSTS OFF)
+SELECT session_id, event_time - lag(event_time) OVER (PARTITION BY session_id ORDER BY event_time)
+FROM window_repartition_events;
+
+SELECT session_id, event_time, event_time - lag(event_time) OVER w AS gap, row_number() OVER w
+FROM window_repartition_events
+WHERE event_time > 90
+WINDOW w AS (PARTITION BY session_id ORDER BY event_time)
+ORDER BY session_id, event_time;
+
+-- windows that share only some of their partition columns, with a pushed down LIMIT
+SELECT user_id, session_id, event_time,
+	rank() OVER (PARTITION BY session_id ORDER BY event_time DESC),
+	count(*) OVER (PARTITION BY session_id, user_id)
+FROM window_repartition_events
+ORDER BY 4, 2, 1
+LIMIT 5;
+
+-- windows without a common partition column are still evaluated on the coordinator
+SELECT session_id, event_time,
+	rank() OVER (PARTITION BY session_id ORDER BY event_time),
+	rank() OVER (PARTITION BY user_id ORDER BY event_time)
+FROM window_repartition_events
+WHERE event_time <= 10
+ORDER BY event_time;
+
+RESET citus.enable_repartitioned_window_functions;
+DROP TABLE window_repartition_events;
+
 -- verify that this doesn't crash with DEBUG4
 SET log_min_messages TO DEBUG4;
 SELECT